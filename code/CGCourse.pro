@@ -9,42 +9,93 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    adaptivesampling.cpp \
+    asphericlens.cpp \
     baseobject.cpp \
+    bvh.cpp \
     camera.cpp \
+    csg.cpp \
     drawer.cpp \
     drawmanager.cpp \
+    emitterregistry.cpp \
+    grinlens.cpp \
+    hdrimage.cpp \
+    irradiancecache.cpp \
     main.cpp \
     mainwindow.cpp \
+    mesh.cpp \
+    meshinstance.cpp \
+    objloader.cpp \
     photon.cpp \
     polygon.cpp \
     polygonalmodel.cpp \
     primitives.cpp \
+    progressive.cpp \
+    raypacket.cpp \
     renderingwidget.cpp \
+    renderjobmanager.cpp \
+    renderprogress.cpp \
+    rendertarget.cpp \
     scene.cpp \
+    sceneintersector.cpp \
     scenemanager.cpp \
     scenewidget.cpp \
+    sequentiallens.cpp \
+    simdintersect.cpp \
+    spectrum.cpp \
     sphere.cpp \
+    spotanalysis.cpp \
     test_main.cpp\
     test_camera.cpp\
-    thinlens.cpp
+    thinlens.cpp \
+    threadpool.cpp \
+    tonemapper.cpp \
+    transform.cpp \
+    wavefront.cpp
 
 HEADERS += \
+    adaptivesampling.h \
+    asphericlens.h \
     baseobject.h \
+    bvh.h \
     camera.h \
+    csg.h \
     drawer.h \
     drawmanager.h \
+    emitterregistry.h \
+    grinlens.h \
+    hdrimage.h \
+    irradiancecache.h \
     light.h \
     mainwindow.h \
+    mesh.h \
+    meshinstance.h \
+    objloader.h \
     photon.h \
     polygon.h \
     polygonalmodel.h \
     primitives.h \
+    progressive.h \
+    raypacket.h \
     renderingwidget.h \
+    renderjobmanager.h \
+    renderprogress.h \
+    rendertarget.h \
     scene.h \
+    sceneintersector.h \
     scenemanager.h \
     scenewidget.h \
+    sequentiallens.h \
+    simdintersect.h \
+    spectrum.h \
     sphere.h \
-    thinlens.h
+    spotanalysis.h \
+    thinlens.h \
+    threadpool.h \
+    tonemapper.h \
+    transform.h \
+    vecmath.h \
+    wavefront.h
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -0,0 +1,115 @@
+#include "adaptivesampling.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+
+namespace
+{
+
+float luminance(const Vec3 &c)
+{
+    return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+}
+
+// Детерминированное псевдослучайное число в [0, 1) для пары (пиксель, сэмпл)
+float hashToUnit(uint32_t a, uint32_t b)
+{
+    uint32_t h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u) * 0x85EBCA77u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+}
+
+std::vector<float> pixelContrast(const std::vector<Vec3> &image, int width, int height)
+{
+    std::vector<float> lum(image.size());
+    for (size_t i = 0; i < image.size(); ++i)
+        lum[i] = luminance(image[i]);
+
+    std::vector<float> contrast(image.size(), 0.0f);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float l = lum[y * width + x];
+            float c = 0;
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    int nx = x + dx, ny = y + dy;
+                    if (nx >= 0 && nx < width && ny >= 0 && ny < height)
+                        c = std::max(c, std::fabs(lum[ny * width + nx] - l));
+                }
+            contrast[y * width + x] = c;
+        }
+    }
+    return contrast;
+}
+
+std::vector<int> allocateAdaptiveSamples(const std::vector<Vec3> &image, int width, int height,
+                                         float threshold, int budget, int maxSamples)
+{
+    std::vector<int> samples(image.size(), 0);
+    if (budget <= 0 || maxSamples <= 0 || threshold <= 0)
+        return samples;
+
+    std::vector<float> contrast = pixelContrast(image, width, height);
+
+    // Кандидаты — пиксели выше порога в блоках, где такие пиксели вообще есть
+    std::vector<std::pair<float, int>> candidates;
+    for (int by = 0; by < height; by += ADAPTIVE_BLOCK_SIZE)
+    {
+        for (int bx = 0; bx < width; bx += ADAPTIVE_BLOCK_SIZE)
+        {
+            int x1 = std::min(bx + ADAPTIVE_BLOCK_SIZE, width);
+            int y1 = std::min(by + ADAPTIVE_BLOCK_SIZE, height);
+
+            float blockContrast = 0;
+            for (int y = by; y < y1; ++y)
+                for (int x = bx; x < x1; ++x)
+                    blockContrast = std::max(blockContrast, contrast[y * width + x]);
+            if (blockContrast <= threshold)
+                continue;
+
+            for (int y = by; y < y1; ++y)
+                for (int x = bx; x < x1; ++x)
+                    if (contrast[y * width + x] > threshold)
+                        candidates.push_back({contrast[y * width + x], y * width + x});
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+
+    for (const auto &candidate : candidates)
+    {
+        if (budget <= 0)
+            break;
+        int wanted = std::min(maxSamples, static_cast<int>(std::ceil(candidate.first / threshold)));
+        int given = std::min(wanted, budget);
+        samples[candidate.second] = given;
+        budget -= given;
+    }
+    return samples;
+}
+
+void stratifiedOffset(int pixel, int k, int n, float &offsetX, float &offsetY)
+{
+    int m = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(n))));
+    // Слои обходятся с шагом, взаимно простым с m * m, чтобы при n < m * m сэмплы не скучивались в одном углу
+    int cells = m * m;
+    int step = cells / 2 + 1;
+    while (step < cells && std::gcd(step, cells) != 1)
+        ++step;
+    int cell = (k * step) % cells;
+
+    offsetX = (cell % m + hashToUnit(pixel, 2 * k)) / m;
+    offsetY = (cell / m + hashToUnit(pixel, 2 * k + 1)) / m;
+}
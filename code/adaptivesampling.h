@@ -0,0 +1,23 @@
+#ifndef ADAPTIVESAMPLING_H
+#define ADAPTIVESAMPLING_H
+
+#include <vector>
+#include "primitives.h"
+
+// Сторона блока пикселей, для которого оценивается необходимость дополнительных сэмплов
+const int ADAPTIVE_BLOCK_SIZE = 8;
+
+// Локальный контраст пикселя: наибольшая разность яркости с соседями в окрестности 3x3
+std::vector<float> pixelContrast(const std::vector<Vec3> &image, int width, int height);
+
+// Распределяет не более budget дополнительных сэмплов по пикселям с контрастом выше threshold.
+// Блоки, в которых все пиксели ниже порога, пропускаются целиком; в остальных пиксель получает
+// тем больше сэмплов (до maxSamples), чем выше его контраст. При нехватке бюджета приоритет
+// у пикселей с наибольшим контрастом
+std::vector<int> allocateAdaptiveSamples(const std::vector<Vec3> &image, int width, int height,
+                                         float threshold, int budget, int maxSamples);
+
+// Положение k-го из n дополнительных сэмплов пикселя: центр слоя сетки m x m со случайным сдвигом внутри слоя
+void stratifiedOffset(int pixel, int k, int n, float &offsetX, float &offsetY);
+
+#endif // ADAPTIVESAMPLING_H
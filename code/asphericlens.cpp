@@ -0,0 +1,333 @@
+#include "asphericlens.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+
+// Наименьшее расстояние до пересечения, чтобы луч, выпущенный с поверхности, не пересек ее повторно
+const float ASPHERIC_EPSILON = 1e-5f;
+// Допуск метода Ньютона по z в долях размера линзы
+const float ASPHERIC_TOLERANCE = 1e-6f;
+// Число точек профиля для проверки толщины и границ по z
+const int ASPHERIC_PROFILE_SAMPLES = 64;
+
+void tangentBasis(const Vec3 &n, Vec3 &t1, Vec3 &t2)
+{
+    Vec3 a = std::fabs(n.x) > 0.9f ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    t1 = a.cross(n).normalize();
+    t2 = n.cross(t1);
+}
+
+// Корни a t² + b t + c = 0 по возрастанию; число корней
+int solveQuadratic(float a, float b, float c, float roots[2])
+{
+    if (std::fabs(a) < 1e-12f)
+    {
+        if (std::fabs(b) < 1e-12f)
+            return 0;
+        roots[0] = -c / b;
+        return 1;
+    }
+    float discriminant = b * b - 4 * a * c;
+    if (discriminant < 0)
+        return 0;
+    // Устойчивая к сокращению форма
+    float q = -0.5f * (b + std::copysign(std::sqrt(discriminant), b));
+    roots[0] = q / a;
+    roots[1] = q != 0.0f ? c / q : roots[0];
+    if (roots[0] > roots[1])
+        std::swap(roots[0], roots[1]);
+    return 2;
+}
+
+}
+
+AsphericSurface::AsphericSurface(float curvature, float conic, const std::vector<float> &aspheric)
+    : curvature(curvature), conic(conic), aspheric(aspheric)
+{
+}
+
+float AsphericSurface::sag(float s) const
+{
+    float q = std::sqrt(std::max(0.0f, 1.0f - (1.0f + conic) * curvature * curvature * s));
+    float z = curvature * s / (1.0f + q);
+    // Схема Горнера по s = r²: s² (A4 + s (A6 + s (...)))
+    float polynomial = 0;
+    for (auto it = aspheric.rbegin(); it != aspheric.rend(); ++it)
+        polynomial = polynomial * s + *it;
+    return z + polynomial * s * s;
+}
+
+float AsphericSurface::sagDerivative(float s) const
+{
+    float q = std::sqrt(std::max(0.0f, 1.0f - (1.0f + conic) * curvature * curvature * s));
+    float dz = curvature / (2.0f * std::max(q, 1e-6f));
+    float polynomial = 0;
+    for (int i = int(aspheric.size()) - 1; i >= 0; --i)
+        polynomial = polynomial * s + aspheric[i] * (i + 2);
+    return dz + polynomial * s;
+}
+
+bool AsphericSurface::definedAt(float r) const
+{
+    return 1.0f - (1.0f + conic) * curvature * curvature * r * r >= -1e-6f;
+}
+
+AsphericLens::AsphericLens(const Vec3 &position, const Vec3 &direction, float radius, float thickness,
+                           const AsphericSurface &front, const AsphericSurface &back, const GraphicParams &params)
+    : _position(position), _direction(direction.normalize()), _radius(radius), _thickness(thickness),
+      _front(front), _back(back)
+{
+    _params = params;
+    tangentBasis(_direction, _u, _v);
+
+    if (radius <= 0 || thickness <= 0)
+        throw std::runtime_error("AsphericLens: radius and thickness must be positive");
+    if (!front.definedAt(radius) || !back.definedAt(radius))
+        throw std::runtime_error("AsphericLens: conic surface is undefined within the clear aperture");
+
+    // Поверхности не должны пересекаться внутри светового радиуса; на краю они могут сомкнуться, как у Lens
+    _zMin = std::numeric_limits<float>::max();
+    _zMax = -std::numeric_limits<float>::max();
+    for (int i = 0; i <= ASPHERIC_PROFILE_SAMPLES; ++i)
+    {
+        float r = radius * i / ASPHERIC_PROFILE_SAMPLES;
+        float zFront = -0.5f * thickness + front.sag(r * r);
+        float zBack = 0.5f * thickness + back.sag(r * r);
+        if (zBack < zFront - ASPHERIC_EPSILON)
+            throw std::runtime_error("AsphericLens: front and back surfaces intersect within the clear aperture");
+        _zMin = std::min(_zMin, zFront);
+        _zMax = std::max(_zMax, zBack);
+    }
+    // Запас на экстремумы полинома между точками профиля
+    float margin = 0.01f * (_zMax - _zMin) + ASPHERIC_EPSILON;
+    _zMin -= margin;
+    _zMax += margin;
+    updateBounds();
+}
+
+bool AsphericLens::intersect(const Ray &ray) const
+{
+    float t;
+    return intersect(ray, t);
+}
+
+bool AsphericLens::intersect(const Ray &ray, float &t) const
+{
+    return closestHit(ray, t);
+}
+
+Vec3 AsphericLens::position() const
+{
+    return _position;
+}
+
+void AsphericLens::setPosition(const Vec3 &position)
+{
+    _position = position;
+    updateBounds();
+}
+
+GraphicParams AsphericLens::hitParams(const Ray &ray, float t) const
+{
+    Vec3 q = toLocal(ray.origin + ray.direction * t - _position);
+    float s = q.x * q.x + q.y * q.y;
+
+    // Часть поверхности — та, уравнению которой точка удовлетворяет точнее
+    float frontError = std::fabs(q.z - (-0.5f * _thickness + _front.sag(s)));
+    float backError = std::fabs(q.z - (0.5f * _thickness + _back.sag(s)));
+    float edgeError = std::fabs(std::sqrt(s) - _radius);
+
+    Vec3 normal;
+    if (edgeError < frontError && edgeError < backError)
+    {
+        normal = Vec3(q.x, q.y, 0);
+    }
+    else if (frontError <= backError)
+    {
+        // Градиент z - sag(x² + y²), направленный наружу, против оси
+        float d = 2.0f * _front.sagDerivative(s);
+        normal = Vec3(q.x * d, q.y * d, -1.0f);
+    }
+    else
+    {
+        float d = 2.0f * _back.sagDerivative(s);
+        normal = Vec3(-q.x * d, -q.y * d, 1.0f);
+    }
+
+    GraphicParams result = _params;
+    result._normal = toWorld(normal).normalize();
+    return result;
+}
+
+std::shared_ptr<BaseObject> AsphericLens::clone() const
+{
+    return std::make_shared<AsphericLens>(*this);
+}
+
+Aabb AsphericLens::bounds() const
+{
+    return _bounds;
+}
+
+Vec3 AsphericLens::direction() const
+{
+    return _direction;
+}
+
+float AsphericLens::radius() const
+{
+    return _radius;
+}
+
+float AsphericLens::thickness() const
+{
+    return _thickness;
+}
+
+const AsphericSurface &AsphericLens::front() const
+{
+    return _front;
+}
+
+const AsphericSurface &AsphericLens::back() const
+{
+    return _back;
+}
+
+bool AsphericLens::intersectSurface(const AsphericSurface &surface, float vertex, const Vec3 &origin, const Vec3 &direction, float &t) const
+{
+    Vec3 p = origin - Vec3(0, 0, vertex);
+    const Vec3 &d = direction;
+    const float c = surface.curvature;
+    const float k1 = 1.0f + surface.conic;
+    const float radiusSq = _radius * _radius;
+    const float tolerance = ASPHERIC_TOLERANCE * (_radius + _thickness);
+
+    // Начальные приближения — пересечения с коникой c (r² + (1 + k) z²) - 2 z = 0 на ветви с вершиной в начале координат
+    float seeds[3];
+    int seedsNum = 0;
+    float roots[2];
+    int rootsNum = solveQuadratic(c * (d.x * d.x + d.y * d.y + k1 * d.z * d.z),
+                                  2.0f * (c * (p.x * d.x + p.y * d.y + k1 * p.z * d.z) - d.z),
+                                  c * (p.x * p.x + p.y * p.y + k1 * p.z * p.z) - 2.0f * p.z, roots);
+    for (int i = 0; i < rootsNum; ++i)
+        if (c * k1 * (p.z + d.z * roots[i]) <= 1.0f)
+            seeds[seedsNum++] = roots[i];
+    // Без подходящего корня — середина слоя, в котором лежит поверхность
+    if (seedsNum == 0 && std::fabs(d.z) > 1e-8f)
+        seeds[seedsNum++] = (0.5f * surface.sag(radiusSq) - p.z) / d.z;
+
+    bool found = false;
+    for (int i = 0; i < seedsNum; ++i)
+    {
+        float ti = seeds[i];
+        bool converged = false;
+        for (int iteration = 0; iteration < ASPHERIC_NEWTON_ITERATIONS; ++iteration)
+        {
+            Vec3 q = p + d * ti;
+            float s = q.x * q.x + q.y * q.y;
+            float g = q.z - surface.sag(s);
+            if (std::fabs(g) < tolerance)
+            {
+                converged = true;
+                break;
+            }
+            float dg = d.z - surface.sagDerivative(s) * 2.0f * (q.x * d.x + q.y * d.y);
+            if (std::fabs(dg) < 1e-12f)
+                break;
+            ti -= g / dg;
+        }
+        if (!converged || ti <= ASPHERIC_EPSILON || (found && ti >= t))
+            continue;
+
+        Vec3 q = p + d * ti;
+        if (q.x * q.x + q.y * q.y > radiusSq)
+            continue;
+        t = ti;
+        found = true;
+    }
+    return found;
+}
+
+bool AsphericLens::intersectEdge(const Vec3 &origin, const Vec3 &direction, float &t) const
+{
+    float roots[2];
+    int rootsNum = solveQuadratic(direction.x * direction.x + direction.y * direction.y,
+                                  2.0f * (origin.x * direction.x + origin.y * direction.y),
+                                  origin.x * origin.x + origin.y * origin.y - _radius * _radius, roots);
+    const float radiusSq = _radius * _radius;
+    const float zFront = -0.5f * _thickness + _front.sag(radiusSq);
+    const float zBack = 0.5f * _thickness + _back.sag(radiusSq);
+    for (int i = 0; i < rootsNum; ++i)
+    {
+        float z = origin.z + direction.z * roots[i];
+        if (roots[i] > ASPHERIC_EPSILON && z >= zFront && z <= zBack)
+        {
+            t = roots[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AsphericLens::closestHit(const Ray &ray, float &t) const
+{
+    Vec3 origin = toLocal(ray.origin - _position);
+    Vec3 direction = toLocal(ray.direction);
+
+    // Отсечение по слою z линзы
+    if (std::fabs(direction.z) > 1e-8f)
+    {
+        float t0 = (_zMin - origin.z) / direction.z;
+        float t1 = (_zMax - origin.z) / direction.z;
+        if (std::max(t0, t1) <= 0.0f)
+            return false;
+    }
+    else if (origin.z < _zMin || origin.z > _zMax)
+    {
+        return false;
+    }
+
+    bool found = false;
+    float ti;
+    if (intersectSurface(_front, -0.5f * _thickness, origin, direction, ti))
+    {
+        t = ti;
+        found = true;
+    }
+    if (intersectSurface(_back, 0.5f * _thickness, origin, direction, ti) && (!found || ti < t))
+    {
+        t = ti;
+        found = true;
+    }
+    if (intersectEdge(origin, direction, ti) && (!found || ti < t))
+    {
+        t = ti;
+        found = true;
+    }
+    return found;
+}
+
+Vec3 AsphericLens::toLocal(const Vec3 &v) const
+{
+    return Vec3(v.dot(_u), v.dot(_v), v.dot(_direction));
+}
+
+Vec3 AsphericLens::toWorld(const Vec3 &v) const
+{
+    return _u * v.x + _v * v.y + _direction * v.z;
+}
+
+void AsphericLens::updateBounds()
+{
+    _bounds = Aabb();
+    for (int i = 0; i < 8; ++i)
+    {
+        Vec3 corner((i & 1) ? _radius : -_radius, (i & 2) ? _radius : -_radius, (i & 4) ? _zMax : _zMin);
+        _bounds.expand(_position + toWorld(corner));
+    }
+}
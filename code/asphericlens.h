@@ -0,0 +1,80 @@
+#ifndef ASPHERICLENS_H
+#define ASPHERICLENS_H
+
+#include <vector>
+#include "baseobject.h"
+#include "primitives.h"
+
+// Осесимметричная асферическая поверхность, заданная стрелкой прогиба от вершины вдоль оси:
+// z(r) = c r² / (1 + sqrt(1 - (1 + k) c² r²)) + A4 r⁴ + A6 r⁶ + ...
+struct AsphericSurface
+{
+    // Кривизна в вершине 1 / R; 0 — плоскость. Положительная — центр кривизны дальше вершины вдоль оси
+    float curvature = 0;
+    // Коническая постоянная: 0 — сфера, -1 — парабола, < -1 — гипербола, иначе эллипсоид
+    float conic = 0;
+    // Коэффициенты A4, A6, A8, ... при четных степенях r начиная с четвертой
+    std::vector<float> aspheric;
+
+    AsphericSurface() = default;
+    AsphericSurface(float curvature, float conic = 0, const std::vector<float> &aspheric = {});
+
+    // Стрелка прогиба и ее производная по s = r²
+    float sag(float s) const;
+    float sagDerivative(float s) const;
+    // Определена ли поверхность на расстоянии r от оси (коника не уходит за свою вершину)
+    bool definedAt(float r) const;
+};
+
+// Линза с независимыми асферическими передней и задней поверхностями и цилиндрическим краем.
+// Вершины поверхностей лежат на оси direction на расстоянии thickness / 2 по обе стороны от position;
+// передняя поверхность обращена против direction, задняя — по нему.
+// Пересечение ищется методом Ньютона, начальное приближение — точное пересечение с коникой без
+// полиномиальных членов. Нормали вычисляются аналитически по производной стрелки прогиба
+class AsphericLens : public BaseObject
+{
+public:
+    // Наибольшее число шагов Ньютона при уточнении пересечения
+    static const int ASPHERIC_NEWTON_ITERATIONS = 8;
+
+    // std::runtime_error, если поверхности не определены на всем световом радиусе или пересекаются внутри него
+    AsphericLens(const Vec3 &position, const Vec3 &direction, float radius, float thickness,
+                 const AsphericSurface &front, const AsphericSurface &back, const GraphicParams &params);
+
+    virtual bool intersect(const Ray &ray) const override;
+    virtual bool intersect(const Ray &ray, float &t) const override;
+
+    virtual Vec3 position() const override;
+    virtual void setPosition(const Vec3 &position) override;
+    virtual GraphicParams hitParams(const Ray &ray, float t) const override;
+    virtual Aabb bounds() const override;
+    virtual std::shared_ptr<BaseObject> clone() const override;
+
+    Vec3 direction() const;
+    float radius() const;
+    float thickness() const;
+    const AsphericSurface &front() const;
+    const AsphericSurface &back() const;
+
+private:
+    // Ближайшее пересечение с поверхностью в локальных координатах (ось z вдоль _direction, начало в _position)
+    bool intersectSurface(const AsphericSurface &surface, float vertex, const Vec3 &origin, const Vec3 &direction, float &t) const;
+    bool intersectEdge(const Vec3 &origin, const Vec3 &direction, float &t) const;
+    bool closestHit(const Ray &ray, float &t) const;
+    Vec3 toLocal(const Vec3 &v) const;
+    Vec3 toWorld(const Vec3 &v) const;
+    void updateBounds();
+
+    Vec3 _position;
+    Vec3 _direction;
+    Vec3 _u, _v;
+    float _radius;
+    float _thickness;
+    AsphericSurface _front;
+    AsphericSurface _back;
+    // Диапазон z линзы в локальных координатах
+    float _zMin = 0, _zMax = 0;
+    Aabb _bounds;
+};
+
+#endif // ASPHERICLENS_H
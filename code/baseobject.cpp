@@ -1,2 +1,21 @@
 #include "baseobject.h"
 
+bool BaseObject::sampleSurface(const Vec3 &, float, float, Vec3 &, Vec3 &, float &) const
+{
+    return false;
+}
+
+bool BaseObject::sampleEmission(float, float, Vec3 &, Vec3 &, float &) const
+{
+    return false;
+}
+
+bool BaseObject::hasInterior() const
+{
+    return false;
+}
+
+bool BaseObject::traceInterior(Ray &, float, Vec3 &) const
+{
+    return false;
+}
@@ -1,6 +1,7 @@
 #ifndef BASEOBJECT_H
 #define BASEOBJECT_H
 
+#include <memory>
 #include "primitives.h"
 
 class BaseObject
@@ -14,6 +15,22 @@ public:
     virtual Vec3 position() const = 0;
     virtual void setPosition(const Vec3 &) = 0;
     virtual GraphicParams hitParams(const Ray& ray, float t) const = 0;
+    virtual Aabb bounds() const = 0;
+    // Независимая копия объекта: задание рендеринга работает с копией сцены, пока интерфейс правит оригинал
+    virtual std::shared_ptr<BaseObject> clone() const = 0;
+    // Точка на поверхности, видимой из from, по равномерным u1, u2 из [0, 1) — для выборки
+    // светящихся объектов по площади; normal обращена к from, pdf — плотность точки по площади.
+    // Объекты без выборки освещают как точечный источник в position()
+    virtual bool sampleSurface(const Vec3 &from, float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const;
+    // Точка излучающей поверхности для выпуска фотона: normal указывает сторону, в которую светит точка,
+    // pdf — плотность по площади с учетом выбора стороны. false — объект светит как точечный источник
+    virtual bool sampleEmission(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const;
+    // Объекты с неоднородной средой (градиентные линзы) сами ведут луч внутри себя через traceInterior,
+    // вместо преломления по hitParams и прямолинейного пути до следующей поверхности
+    virtual bool hasInterior() const;
+    // Проводит луч, попавший в объект снаружи на расстоянии t, до выхода из него. ray заменяется вышедшим лучом,
+    // weight умножается на пропускание поверхностей и цвет среды. false — луч не вышел из объекта
+    virtual bool traceInterior(Ray &ray, float t, Vec3 &weight) const;
 
 };
 #endif // BASEOBJECT_H
@@ -0,0 +1,101 @@
+#include "bvh.h"
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+
+// Раздвигает 10 младших бит через два нуля
+uint32_t expandBits(uint32_t v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+}
+
+uint32_t mortonCode(const Vec3 &p, const Aabb &bounds)
+{
+    Vec3 e = bounds.extent();
+    auto quantize = [](float v, float lo, float size) {
+        float n = size > 0 ? (v - lo) / size : 0.0f;
+        return static_cast<uint32_t>(std::min(std::max(n * 1023.0f, 0.0f), 1023.0f));
+    };
+    return (expandBits(quantize(p.x, bounds.min.x, e.x)) << 2) |
+           (expandBits(quantize(p.y, bounds.min.y, e.y)) << 1) |
+           expandBits(quantize(p.z, bounds.min.z, e.z));
+}
+
+void Bvh::build(const std::vector<Aabb> &boxes, int leafSize)
+{
+    clear();
+    if (boxes.empty())
+        return;
+
+    std::vector<Vec3> centers(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+        centers[i] = boxes[i].center();
+
+    _indices.resize(boxes.size());
+    std::iota(_indices.begin(), _indices.end(), 0);
+    _nodes.reserve(2 * boxes.size() / std::max(1, leafSize) + 1);
+
+    buildRecursive(boxes, centers, 0, boxes.size(), std::max(1, leafSize));
+}
+
+void Bvh::clear()
+{
+    _nodes.clear();
+    _indices.clear();
+}
+
+bool Bvh::isEmpty() const
+{
+    return _nodes.empty();
+}
+
+const std::vector<BvhNode> &Bvh::nodes() const
+{
+    return _nodes;
+}
+
+const std::vector<int> &Bvh::indices() const
+{
+    return _indices;
+}
+
+int Bvh::buildRecursive(const std::vector<Aabb> &boxes, const std::vector<Vec3> &centers, int first, int count, int leafSize)
+{
+    int nodeIndex = _nodes.size();
+    _nodes.emplace_back();
+
+    Aabb box, centerBox;
+    for (int i = first; i < first + count; ++i)
+    {
+        box.expand(boxes[_indices[i]]);
+        centerBox.expand(centers[_indices[i]]);
+    }
+    _nodes[nodeIndex].box = box;
+
+    if (count <= leafSize)
+    {
+        _nodes[nodeIndex].first = first;
+        _nodes[nodeIndex].count = count;
+        return nodeIndex;
+    }
+
+    // Разбиение по медиане вдоль самой длинной оси центров
+    int axis = centerBox.longestAxis();
+    int mid = first + count / 2;
+    std::nth_element(_indices.begin() + first, _indices.begin() + mid, _indices.begin() + first + count,
+                     [&centers, axis](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+    int left = buildRecursive(boxes, centers, first, mid - first, leafSize);
+    int right = buildRecursive(boxes, centers, mid, first + count - mid, leafSize);
+    _nodes[nodeIndex].left = left;
+    _nodes[nodeIndex].right = right;
+    return nodeIndex;
+}
@@ -0,0 +1,76 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <vector>
+#include "primitives.h"
+
+// 30-битный код Мортона точки, квантованной по 10 бит на ось внутри bounds
+uint32_t mortonCode(const Vec3 &p, const Aabb &bounds);
+
+struct BvhNode
+{
+    Aabb box;
+    int left = -1;   // индекс левого потомка (правый хранится следом за левым поддеревом)
+    int right = -1;
+    int first = 0;   // первый элемент листа в indices()
+    int count = 0;   // число элементов листа, 0 — внутренний узел
+
+    bool isLeaf() const { return count > 0; }
+};
+
+// Иерархия ограничивающих объемов над произвольным набором элементов, заданных своими AABB
+class Bvh
+{
+public:
+    Bvh() = default;
+
+    void build(const std::vector<Aabb> &boxes, int leafSize = 2);
+    void clear();
+
+    bool isEmpty() const;
+    const std::vector<BvhNode> &nodes() const;
+    const std::vector<int> &indices() const;
+
+    // Обход дерева: узлы, для которых cull(box) == true, пропускаются,
+    // для каждого элемента уцелевших листьев вызывается visit(index)
+    template <typename Cull, typename Visit>
+    void traverse(Cull cull, Visit visit) const;
+
+private:
+    int buildRecursive(const std::vector<Aabb> &boxes, const std::vector<Vec3> &centers, int first, int count, int leafSize);
+
+    std::vector<BvhNode> _nodes;
+    std::vector<int> _indices;
+};
+
+template <typename Cull, typename Visit>
+void Bvh::traverse(Cull cull, Visit visit) const
+{
+    if (_nodes.empty())
+        return;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const BvhNode &node = _nodes[stack[--top]];
+        if (cull(node.box))
+            continue;
+
+        if (node.isLeaf())
+        {
+            for (int i = node.first; i < node.first + node.count; ++i)
+                visit(_indices[i]);
+        }
+        else
+        {
+            stack[top++] = node.right;
+            stack[top++] = node.left;
+        }
+    }
+}
+
+#endif // BVH_H
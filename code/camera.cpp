@@ -1,4 +1,5 @@
 #include "camera.h"
+#include "vecmath.h"
 
 Camera::Camera()
 {
@@ -54,3 +55,58 @@ void Camera::setFov(double newFov)
 {
     _fov = newFov;
 }
+
+CameraRayGenerator::CameraRayGenerator(const Camera &camera, int width, int height)
+    : _width(width), _height(height)
+{
+    Vec3 cameraDir = camera.direction().normalize();
+    _origin = camera.position();
+    _screenCenter = cameraDir * camera.screenDistance();
+    _aspectRatio = double(width) / double(height);
+    _tanFov = tan(camera.fov() * M_PI / 360.0f);  // Тангенс половины угла обзора
+
+    // Базовые оси камеры (по умолчанию)
+    _right = Vec3(1, 0, 0).cross(cameraDir).normalize();
+    _up = cameraDir.cross(_right).normalize();
+}
+
+Vec3 CameraRayGenerator::direction(float px, float py) const
+{
+    // Преобразование пиксельных координат в мировые
+    float x = (2.0f * px / float(_width) - 1.0f) * _aspectRatio * _tanFov;
+    float y = (1.0f - 2.0f * py / float(_height)) * _tanFov;
+
+    // Направление на точку виртуального экрана; та же нормализация, что у directions
+    return normalizeFast(_screenCenter + _right * x + _up * y);
+}
+
+void CameraRayGenerator::directions(const float *px, float py, int count, Vec3 *out) const
+{
+    float y = (1.0f - 2.0f * py / float(_height)) * _tanFov;
+    for (int i = 0; i < count; ++i)
+    {
+        float x = (2.0f * px[i] / float(_width) - 1.0f) * _aspectRatio * _tanFov;
+        out[i] = _screenCenter + _right * x + _up * y;
+    }
+    normalizeBatch(out, count);
+}
+
+Ray CameraRayGenerator::ray(float px, float py) const
+{
+    return Ray(_origin, direction(px, py));
+}
+
+Vec3 CameraRayGenerator::origin() const
+{
+    return _origin;
+}
+
+int CameraRayGenerator::width() const
+{
+    return _width;
+}
+
+int CameraRayGenerator::height() const
+{
+    return _height;
+}
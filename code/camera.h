@@ -27,4 +27,31 @@ protected:
     double _fov;
 };
 
+// Построение первичных лучей камеры для кадра заданного размера
+class CameraRayGenerator
+{
+public:
+    CameraRayGenerator(const Camera &camera, int width, int height);
+
+    // px, py — координаты точки на кадре в пикселях (центр пикселя (i, j) — (i + 0.5, j + 0.5))
+    Vec3 direction(float px, float py) const;
+    // Направления для count точек строки py с координатами px[i], нормализуются пакетом normalizeBatch
+    void directions(const float *px, float py, int count, Vec3 *out) const;
+    Ray ray(float px, float py) const;
+    Vec3 origin() const;
+
+    int width() const;
+    int height() const;
+
+protected:
+    Vec3 _origin;
+    Vec3 _screenCenter;
+    Vec3 _right;
+    Vec3 _up;
+    float _aspectRatio;
+    float _tanFov;
+    int _width;
+    int _height;
+};
+
 #endif // CAMERA_H
@@ -0,0 +1,420 @@
+#include "csg.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+const float CSG_INFINITY = std::numeric_limits<float>::infinity();
+// Наименьшее расстояние до пересечения, чтобы луч, выпущенный с поверхности, не пересек ее повторно
+const float CSG_EPSILON = 1e-5f;
+
+void pushInterval(CsgIntervals &out, float tIn, float tOut, const CsgLeaf *leaf)
+{
+    if (tIn < tOut && tOut >= 0.0f)
+        out.push({tIn, tOut, leaf, leaf, false, false});
+}
+
+// Граница отрезка одного из операндов при обходе двух списков
+struct CsgEvent
+{
+    float t;
+    const CsgLeaf *leaf;
+    bool flip;
+    bool entering;
+};
+
+CsgEvent event(const CsgIntervals &list, int index, bool flip)
+{
+    const CsgInterval &interval = list.items[index / 2];
+    if (index % 2 == 0)
+        return {interval.tIn, interval.leafIn, interval.flipIn != flip, true};
+    return {interval.tOut, interval.leafOut, interval.flipOut != flip, false};
+}
+
+bool inside(CsgOperationType type, bool inLeft, bool inRight)
+{
+    switch (type)
+    {
+    case CsgOperationType::Union:
+        return inLeft || inRight;
+    case CsgOperationType::Intersection:
+        return inLeft && inRight;
+    case CsgOperationType::Difference:
+        return inLeft && !inRight;
+    }
+    return false;
+}
+
+// Слияние двух списков: границы обходятся по возрастанию t, отрезок результата открывается и закрывается
+// там, где меняется принадлежность точки результату операции. Границы вычитаемого тела входят с обращенной нормалью
+void combine(CsgOperationType type, const CsgIntervals &left, const CsgIntervals &right, CsgIntervals &out)
+{
+    const bool flipRight = type == CsgOperationType::Difference;
+    const int leftEvents = 2 * left.count;
+    const int rightEvents = 2 * right.count;
+    int i = 0, j = 0;
+    bool inLeft = false, inRight = false, inResult = false;
+    CsgEvent start = {0, nullptr, false, true};
+
+    while (i < leftEvents || j < rightEvents)
+    {
+        CsgEvent e;
+        bool fromLeft = j >= rightEvents || (i < leftEvents && event(left, i, false).t <= event(right, j, flipRight).t);
+        if (fromLeft)
+        {
+            e = event(left, i++, false);
+            inLeft = e.entering;
+        }
+        else
+        {
+            e = event(right, j++, flipRight);
+            inRight = e.entering;
+        }
+
+        bool now = inside(type, inLeft, inRight);
+        if (now == inResult)
+            continue;
+        if (now)
+            start = e;
+        else if (start.t < e.t)
+            out.push({start.t, e.t, start.leaf, e.leaf, start.flip, e.flip});
+        inResult = now;
+    }
+}
+
+}
+
+void CsgIntervals::push(const CsgInterval &interval)
+{
+    if (count < CSG_MAX_INTERVALS)
+        items[count++] = interval;
+}
+
+CsgSphere::CsgSphere(const Vec3 &center, float radius)
+    : _center(center), _radius(radius)
+{
+}
+
+CsgSphere::CsgSphere(const Sphere &sphere)
+    : _center(sphere._center), _radius(sphere._radius)
+{
+}
+
+void CsgSphere::intervals(const Ray &ray, CsgIntervals &out) const
+{
+    out.count = 0;
+    Vec3 oc = ray.origin - _center;
+    float a = ray.direction.dot(ray.direction);
+    float halfB = oc.dot(ray.direction);
+    float c = oc.dot(oc) - _radius * _radius;
+    float discriminant = halfB * halfB - a * c;
+    if (discriminant < 0)
+        return;
+    float root = std::sqrt(discriminant);
+    pushInterval(out, (-halfB - root) / a, (-halfB + root) / a, this);
+}
+
+Aabb CsgSphere::bounds() const
+{
+    Vec3 r(_radius, _radius, _radius);
+    return Aabb(_center - r, _center + r);
+}
+
+Vec3 CsgSphere::normal(const Vec3 &point) const
+{
+    return (point - _center).normalize();
+}
+
+CsgHalfSpace::CsgHalfSpace(const Vec3 &point, const Vec3 &normal)
+    : _point(point), _normal(normal.normalize())
+{
+}
+
+void CsgHalfSpace::intervals(const Ray &ray, CsgIntervals &out) const
+{
+    out.count = 0;
+    float s = (ray.origin - _point).dot(_normal);
+    float dn = ray.direction.dot(_normal);
+    if (std::fabs(dn) < 1e-12f)
+    {
+        if (s <= 0.0f)
+            pushInterval(out, -CSG_INFINITY, CSG_INFINITY, this);
+        return;
+    }
+    float t = -s / dn;
+    if (dn > 0.0f)
+        pushInterval(out, -CSG_INFINITY, t, this);
+    else
+        pushInterval(out, t, CSG_INFINITY, this);
+}
+
+Aabb CsgHalfSpace::bounds() const
+{
+    // Полупространство с нормалью вдоль оси координат ограничено с одной стороны, иначе — бесконечно
+    const float m = std::numeric_limits<float>::max();
+    Aabb box(Vec3(-m, -m, -m), Vec3(m, m, m));
+    float *mins[3] = {&box.min.x, &box.min.y, &box.min.z};
+    float *maxs[3] = {&box.max.x, &box.max.y, &box.max.z};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (_normal[axis] == 1.0f)
+            *maxs[axis] = _point[axis];
+        else if (_normal[axis] == -1.0f)
+            *mins[axis] = _point[axis];
+    }
+    return box;
+}
+
+Vec3 CsgHalfSpace::normal(const Vec3 &) const
+{
+    return _normal;
+}
+
+CsgCylinder::CsgCylinder(const Vec3 &center, const Vec3 &axis, float radius, float length)
+    : _center(center), _axis(axis.normalize()), _radius(radius), _length(length)
+{
+}
+
+void CsgCylinder::intervals(const Ray &ray, CsgIntervals &out) const
+{
+    out.count = 0;
+    Vec3 o = ray.origin - _center;
+    float oz = o.dot(_axis);
+    float dz = ray.direction.dot(_axis);
+    const float halfLength = 0.5f * _length;
+
+    // Слой между торцами
+    float tz0 = -CSG_INFINITY, tz1 = CSG_INFINITY;
+    if (std::fabs(dz) > 1e-12f)
+    {
+        tz0 = (-halfLength - oz) / dz;
+        tz1 = (halfLength - oz) / dz;
+        if (tz0 > tz1)
+            std::swap(tz0, tz1);
+    }
+    else if (std::fabs(oz) > halfLength)
+    {
+        return;
+    }
+
+    // Бесконечный цилиндр по составляющим, перпендикулярным оси
+    Vec3 op = o - _axis * oz;
+    Vec3 dp = ray.direction - _axis * dz;
+    float a = dp.dot(dp);
+    float c = op.dot(op) - _radius * _radius;
+    float tc0 = -CSG_INFINITY, tc1 = CSG_INFINITY;
+    if (a > 1e-12f)
+    {
+        float halfB = op.dot(dp);
+        float discriminant = halfB * halfB - a * c;
+        if (discriminant < 0)
+            return;
+        float root = std::sqrt(discriminant);
+        tc0 = (-halfB - root) / a;
+        tc1 = (-halfB + root) / a;
+    }
+    else if (c > 0)
+    {
+        return;
+    }
+
+    pushInterval(out, std::max(tz0, tc0), std::min(tz1, tc1), this);
+}
+
+Aabb CsgCylinder::bounds() const
+{
+    // Протяженность диска радиуса r с нормалью a вдоль оси координат — r sqrt(1 - a²)
+    Vec3 disk(_radius * std::sqrt(std::max(0.0f, 1.0f - _axis.x * _axis.x)),
+              _radius * std::sqrt(std::max(0.0f, 1.0f - _axis.y * _axis.y)),
+              _radius * std::sqrt(std::max(0.0f, 1.0f - _axis.z * _axis.z)));
+    Vec3 half = _axis * (0.5f * _length);
+    Aabb box;
+    box.expand(_center + half - disk);
+    box.expand(_center + half + disk);
+    box.expand(_center - half - disk);
+    box.expand(_center - half + disk);
+    return box;
+}
+
+Vec3 CsgCylinder::normal(const Vec3 &point) const
+{
+    Vec3 o = point - _center;
+    float z = o.dot(_axis);
+    Vec3 radial = o - _axis * z;
+    float r = radial.length();
+    if (_radius - r < 0.5f * _length - std::fabs(z) && r > 0.0f)
+        return radial / r;
+    return z >= 0.0f ? _axis : -_axis;
+}
+
+CsgOperation::CsgOperation(CsgOperationType type, const std::shared_ptr<const CsgNode> &left, const std::shared_ptr<const CsgNode> &right)
+    : _type(type), _left(left), _right(right)
+{
+    Aabb a = left->bounds();
+    Aabb b = right->bounds();
+    switch (type)
+    {
+    case CsgOperationType::Union:
+        _bounds = a;
+        _bounds.expand(b);
+        break;
+    case CsgOperationType::Intersection:
+        _bounds = Aabb(Vec3(std::max(a.min.x, b.min.x), std::max(a.min.y, b.min.y), std::max(a.min.z, b.min.z)),
+                       Vec3(std::min(a.max.x, b.max.x), std::min(a.max.y, b.max.y), std::min(a.max.z, b.max.z)));
+        break;
+    case CsgOperationType::Difference:
+        _bounds = a;
+        break;
+    }
+}
+
+void CsgOperation::intervals(const Ray &ray, CsgIntervals &out) const
+{
+    out.count = 0;
+    // Узел, границы которого луч не пересекает при t >= 0, не дает отрезков на луче
+    if (_bounds.isEmpty() || !_bounds.intersect(ray, std::numeric_limits<float>::max()))
+        return;
+
+    CsgIntervals left;
+    _left->intervals(ray, left);
+    if (left.count == 0 && _type != CsgOperationType::Union)
+        return;
+
+    CsgIntervals right;
+    _right->intervals(ray, right);
+    if (right.count == 0 && _type != CsgOperationType::Intersection)
+    {
+        out = left;
+        return;
+    }
+    combine(_type, left, right, out);
+}
+
+Aabb CsgOperation::bounds() const
+{
+    return _bounds;
+}
+
+CsgOperationType CsgOperation::type() const
+{
+    return _type;
+}
+
+std::shared_ptr<CsgNode> csgUnion(const std::shared_ptr<const CsgNode> &left, const std::shared_ptr<const CsgNode> &right)
+{
+    return std::make_shared<CsgOperation>(CsgOperationType::Union, left, right);
+}
+
+std::shared_ptr<CsgNode> csgIntersection(const std::shared_ptr<const CsgNode> &left, const std::shared_ptr<const CsgNode> &right)
+{
+    return std::make_shared<CsgOperation>(CsgOperationType::Intersection, left, right);
+}
+
+std::shared_ptr<CsgNode> csgDifference(const std::shared_ptr<const CsgNode> &left, const std::shared_ptr<const CsgNode> &right)
+{
+    return std::make_shared<CsgOperation>(CsgOperationType::Difference, left, right);
+}
+
+std::shared_ptr<CsgNode> csgLens(const Lens &lens)
+{
+    return csgIntersection(std::make_shared<CsgSphere>(lens._focalPos1, lens._curveRadius),
+                           std::make_shared<CsgSphere>(lens._focalPos2, lens._curveRadius));
+}
+
+CsgObject::CsgObject(const std::shared_ptr<const CsgNode> &root, const Vec3 &position, const GraphicParams &params)
+    : _root(root), _position(position)
+{
+    _params = params;
+}
+
+bool CsgObject::intersect(const Ray &ray) const
+{
+    float t;
+    return intersect(ray, t);
+}
+
+bool CsgObject::intersect(const Ray &ray, float &t) const
+{
+    Ray local(ray.origin - _position, ray.direction);
+    CsgIntervals list;
+    _root->intervals(local, list);
+    for (int i = 0; i < list.count; ++i)
+    {
+        const CsgInterval &interval = list.items[i];
+        if (interval.tIn > CSG_EPSILON)
+        {
+            t = interval.tIn;
+            return true;
+        }
+        if (interval.tOut > CSG_EPSILON && interval.tOut < CSG_INFINITY)
+        {
+            t = interval.tOut;
+            return true;
+        }
+    }
+    return false;
+}
+
+Vec3 CsgObject::position() const
+{
+    return _position;
+}
+
+void CsgObject::setPosition(const Vec3 &position)
+{
+    _position = position;
+}
+
+GraphicParams CsgObject::hitParams(const Ray &ray, float t) const
+{
+    // Нормаль берется у поверхности, на которой лежит ближайшая к t граница отрезков
+    Ray local(ray.origin - _position, ray.direction);
+    CsgIntervals list;
+    _root->intervals(local, list);
+
+    const CsgLeaf *leaf = nullptr;
+    bool flip = false;
+    float best = CSG_INFINITY;
+    for (int i = 0; i < list.count; ++i)
+    {
+        const CsgInterval &interval = list.items[i];
+        if (std::fabs(interval.tIn - t) < best)
+        {
+            best = std::fabs(interval.tIn - t);
+            leaf = interval.leafIn;
+            flip = interval.flipIn;
+        }
+        if (std::fabs(interval.tOut - t) < best)
+        {
+            best = std::fabs(interval.tOut - t);
+            leaf = interval.leafOut;
+            flip = interval.flipOut;
+        }
+    }
+
+    GraphicParams result = _params;
+    if (leaf)
+    {
+        Vec3 normal = leaf->normal(local.origin + local.direction * t);
+        result._normal = flip ? -normal : normal;
+    }
+    return result;
+}
+
+std::shared_ptr<BaseObject> CsgObject::clone() const
+{
+    return std::make_shared<CsgObject>(*this);
+}
+
+Aabb CsgObject::bounds() const
+{
+    Aabb box = _root->bounds();
+    return Aabb(box.min + _position, box.max + _position);
+}
+
+const std::shared_ptr<const CsgNode> &CsgObject::root() const
+{
+    return _root;
+}
@@ -0,0 +1,158 @@
+#ifndef CSG_H
+#define CSG_H
+
+#include <memory>
+#include "baseobject.h"
+#include "primitives.h"
+#include "sphere.h"
+#include "thinlens.h"
+
+class CsgLeaf;
+
+// Отрезок прямой луча внутри тела: вход и выход вместе с поверхностями, на которых они лежат.
+// flip — нормаль поверхности обращена (граница вычитаемого тела)
+struct CsgInterval
+{
+    float tIn;
+    float tOut;
+    const CsgLeaf *leafIn;
+    const CsgLeaf *leafOut;
+    bool flipIn;
+    bool flipOut;
+};
+
+// Наибольшее число отрезков в списке; лишние отрезки при объединении отбрасываются
+const int CSG_MAX_INTERVALS = 16;
+
+// Список отрезков по возрастанию t в буфере фиксированного размера на стеке
+struct CsgIntervals
+{
+    CsgInterval items[CSG_MAX_INTERVALS];
+    int count = 0;
+
+    void push(const CsgInterval &interval);
+};
+
+// Узел дерева конструктивной геометрии. Координаты узлов — локальные координаты CsgObject
+class CsgNode
+{
+public:
+    virtual ~CsgNode() = default;
+
+    // Все отрезки прямой ray.origin + t * ray.direction внутри тела, пересекающие луч при t >= 0
+    virtual void intervals(const Ray &ray, CsgIntervals &out) const = 0;
+    // Может быть бесконечным, как у полупространства
+    virtual Aabb bounds() const = 0;
+};
+
+// Примитив: кроме отрезков, дает внешнюю нормаль в точке своей поверхности
+class CsgLeaf : public CsgNode
+{
+public:
+    virtual Vec3 normal(const Vec3 &point) const = 0;
+};
+
+class CsgSphere : public CsgLeaf
+{
+public:
+    CsgSphere(const Vec3 &center, float radius);
+    explicit CsgSphere(const Sphere &sphere);
+
+    virtual void intervals(const Ray &ray, CsgIntervals &out) const override;
+    virtual Aabb bounds() const override;
+    virtual Vec3 normal(const Vec3 &point) const override;
+
+private:
+    Vec3 _center;
+    float _radius;
+};
+
+// Полупространство (x - point) · normal <= 0; нормаль направлена наружу
+class CsgHalfSpace : public CsgLeaf
+{
+public:
+    CsgHalfSpace(const Vec3 &point, const Vec3 &normal);
+
+    virtual void intervals(const Ray &ray, CsgIntervals &out) const override;
+    virtual Aabb bounds() const override;
+    virtual Vec3 normal(const Vec3 &point) const override;
+
+private:
+    Vec3 _point;
+    Vec3 _normal;
+};
+
+// Цилиндр с торцами: ось axis через center, длина length
+class CsgCylinder : public CsgLeaf
+{
+public:
+    CsgCylinder(const Vec3 &center, const Vec3 &axis, float radius, float length);
+
+    virtual void intervals(const Ray &ray, CsgIntervals &out) const override;
+    virtual Aabb bounds() const override;
+    virtual Vec3 normal(const Vec3 &point) const override;
+
+private:
+    Vec3 _center;
+    Vec3 _axis;
+    float _radius;
+    float _length;
+};
+
+enum class CsgOperationType
+{
+    Union,
+    Intersection,
+    // Левое тело без правого
+    Difference
+};
+
+// Булева операция над двумя узлами. Границы узла отсекают лучи до обхода потомков
+class CsgOperation : public CsgNode
+{
+public:
+    CsgOperation(CsgOperationType type, const std::shared_ptr<const CsgNode> &left, const std::shared_ptr<const CsgNode> &right);
+
+    virtual void intervals(const Ray &ray, CsgIntervals &out) const override;
+    virtual Aabb bounds() const override;
+
+    CsgOperationType type() const;
+
+private:
+    CsgOperationType _type;
+    std::shared_ptr<const CsgNode> _left;
+    std::shared_ptr<const CsgNode> _right;
+    Aabb _bounds;
+};
+
+std::shared_ptr<CsgNode> csgUnion(const std::shared_ptr<const CsgNode> &left, const std::shared_ptr<const CsgNode> &right);
+std::shared_ptr<CsgNode> csgIntersection(const std::shared_ptr<const CsgNode> &left, const std::shared_ptr<const CsgNode> &right);
+std::shared_ptr<CsgNode> csgDifference(const std::shared_ptr<const CsgNode> &left, const std::shared_ptr<const CsgNode> &right);
+// Линза как пересечение двух сфер, в тех же координатах, что и lens
+std::shared_ptr<CsgNode> csgLens(const Lens &lens);
+
+// Объект сцены из дерева конструктивной геометрии с общим материалом.
+// Дерево задается относительно position(), перемещение объекта сдвигает его целиком
+class CsgObject : public BaseObject
+{
+public:
+    // Границы корня должны быть конечными: неограниченное тело не помещается в BVH сцены
+    CsgObject(const std::shared_ptr<const CsgNode> &root, const Vec3 &position, const GraphicParams &params);
+
+    virtual bool intersect(const Ray &ray) const override;
+    virtual bool intersect(const Ray &ray, float &t) const override;
+
+    virtual Vec3 position() const override;
+    virtual void setPosition(const Vec3 &position) override;
+    virtual GraphicParams hitParams(const Ray &ray, float t) const override;
+    virtual Aabb bounds() const override;
+    virtual std::shared_ptr<BaseObject> clone() const override;
+
+    const std::shared_ptr<const CsgNode> &root() const;
+
+private:
+    std::shared_ptr<const CsgNode> _root;
+    Vec3 _position;
+};
+
+#endif // CSG_H
@@ -2,14 +2,74 @@
 #include <QOpenGLFunctions>
 #include <QImage>
 #include <QDebug>
-#include <future>
 #include <qalgorithms.h>
 #include <QElapsedTimer>
+#include <random>
+#include "threadpool.h"
+#include "adaptivesampling.h"
+#include "spectrum.h"
+
+namespace
+{
+
+// Размер порции фотонов, обрабатываемой одной задачей пула
+const int PHOTON_CHUNK_SIZE = 1024;
+// Границы радиуса записи кэша освещенности в долях размера сцены
+const float IRRADIANCE_MIN_RADIUS = 0.002f;
+const float IRRADIANCE_MAX_RADIUS = 0.1f;
+// Наибольшее число дополнительных сэмплов на пиксель при адаптивном сглаживании
+const int MAX_ADAPTIVE_SAMPLES = 15;
+
+float maxComponent(const Vec3 &v)
+{
+    return std::max(v.x, std::max(v.y, v.z));
+}
+
+float uniformRandom()
+{
+    thread_local std::mt19937 gen(std::random_device{}());
+    thread_local std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    return dist(gen);
+}
+
+uint32_t interleaveBits(uint32_t v)
+{
+    v &= 0x0000FFFFu;
+    v = (v | (v << 8)) & 0x00FF00FFu;
+    v = (v | (v << 4)) & 0x0F0F0F0Fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+// Левые верхние углы тайлов кадра в порядке кривой Мортона
+std::vector<std::pair<int, int>> mortonOrderedTiles(int width, int height, int tileSize)
+{
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    std::vector<std::pair<uint32_t, std::pair<int, int>>> keyed;
+    keyed.reserve(tilesX * tilesY);
+    for (int ty = 0; ty < tilesY; ++ty)
+        for (int tx = 0; tx < tilesX; ++tx)
+            keyed.push_back({interleaveBits(tx) | (interleaveBits(ty) << 1), {tx * tileSize, ty * tileSize}});
+    std::sort(keyed.begin(), keyed.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    std::vector<std::pair<int, int>> tiles;
+    tiles.reserve(keyed.size());
+    for (const auto &k : keyed)
+        tiles.push_back(k.second);
+    return tiles;
+}
+
+}
 
 Drawer::Drawer(RenderingWidget *widget, QObject *parrent) : QObject(parrent), _widget(widget)
 {
     initialize();
-    connect(this, &Drawer::progressChanged, _widget, &RenderingWidget::setProgress);
+    // Рендеринг идет в рабочем потоке, кадры доставляются виджету через очередь событий,
+    // а прогресс интерфейс опрашивает сам через progress()
+    connect(this, &Drawer::frameUpdated, _widget, &RenderingWidget::setImage, Qt::QueuedConnection);
 }
 
 Drawer::~Drawer()
@@ -17,343 +77,743 @@ Drawer::~Drawer()
 
 }
 
-void Drawer::renderFrame(const std::shared_ptr<Scene> &scene)
+void Drawer::renderFrame(const std::shared_ptr<Scene> &scene, bool preview)
 {
-    _frameProcessedRows = 0;
-    _framebuffer.resize(_widget->getImageWidgetSize().height() * _widget->getImageWidgetSize().width());
-    processPixels(0, _widget->getImageWidgetSize().height(), scene);
-    _widget->setImage(_framebuffer, _widget->getImageWidgetSize().width(), _widget->getImageWidgetSize().height());
+    int width = _frameSize.width();
+    int height = _frameSize.height();
+
+    ThreadPool::instance().setThreadsNum(_threadsNum);
+    buildIntersector(scene);
+    _framebuffer.assign(width * height, Vec3(0, 0, 0));
+    _accumulation.assign(width * height, Vec3(0, 0, 0));
+    _sampleCounts.assign(width * height, 0);
+    _irradianceCache = prepareIrradianceCache(scene);
+    _nextEventEstimation = scene->photonMapIndirectOnly();
+    // Реестр источников для теневых лучей строится по текущим объектам: с момента построения
+    // фотонной карты источники могли добавиться или изменить яркость
+    _emitters = EmitterRegistry(scene->objects());
+
+    // Черновой кадр — прогрессивные проходы с одним сэмплом на пиксель без адаптивного сглаживания
+    std::vector<RenderPass> passes = preview ? makeRenderPasses(true, 1) : makeRenderPasses(_progressive, _samplesPerPixel);
+    int passesNum = passes.size() + (_adaptiveSampling && !preview ? 1 : 0);
+    int tilesNum = ((width + _tileSize - 1) / _tileSize) * ((height + _tileSize - 1) / _tileSize);
+    _progress.begin(RenderStage::Frame, (long long)tilesNum * passesNum);
+    ToneMapper toneMapper(_toneMapping);
+    QElapsedTimer publishTimer;
+    for (int i = 0; i < passesNum && !cancelled(); ++i)
+    {
+        if (i < (int)passes.size())
+        {
+            processPixels(passes[i], scene);
+        }
+        else
+        {
+            // Дополнительные сэмплы только там, где после равномерных проходов высок локальный контраст
+            int budget = std::lround(_adaptiveBudget * width * height);
+            std::vector<int> extraSamples = allocateAdaptiveSamples(_framebuffer, width, height, _adaptiveThreshold,
+                                                                    budget, MAX_ADAPTIVE_SAMPLES);
+            processAdaptivePixels(extraSamples, scene);
+        }
+
+        // Промежуточные кадры публикуются не чаще раза в _previewInterval мс, первый и последний — всегда.
+        // Прерванный проход не публикуется, на экране остается последний завершенный
+        bool lastPass = i + 1 == passesNum;
+        if (cancelled())
+            break;
+        if (lastPass || !publishTimer.isValid() || publishTimer.elapsed() >= _previewInterval)
+        {
+            // Изображение готовится здесь же, в рабочем потоке; QImage передается без копирования пикселей
+            QImage image(width, height, QImage::Format_RGB32);
+            toneMapper.map(_framebuffer.data(), width, height, image.scanLine(0), image.bytesPerLine());
+            emit frameUpdated(image);
+            publishTimer.start();
+        }
+    }
+
+    // Линейный кадр без ограничения сохраняется для экспорта
+    auto frame = std::make_shared<HdrImage>();
+    frame->width = width;
+    frame->height = height;
+    frame->pixels = _framebuffer;
+    {
+        std::lock_guard<std::mutex> lock(_lastFrameMutex);
+        _lastFrame = frame;
+    }
+    _progress.finish();
+}
+
+void Drawer::buildIntersector(const std::shared_ptr<Scene> &scene)
+{
+    _intersector.build(scene->objects());
+    if (!_sequentialLenses)
+        return;
+    std::shared_ptr<SequentialLensSystem> lenses = scene->lensSystem();
+    _intersector.setLensSystem(lenses ? lenses : SequentialLensSystem::detect(scene->objects()));
 }
 
 void Drawer::initialize()
 {
-    _framebuffer.resize(_widget->getImageWidgetSize().height() * _widget->getImageWidgetSize().width());
-    for (auto &e : _framebuffer) e = Vec3(0,0,0);
-    _widget->setImage(_framebuffer, _widget->getImageWidgetSize().width(), _widget->getImageWidgetSize().height());
+    _frameSize = _widget->getImageWidgetSize();
+    _framebuffer.assign(_frameSize.height() * _frameSize.width(), Vec3(0, 0, 0));
+    QImage image(_frameSize, QImage::Format_RGB32);
+    image.fill(Qt::black);
+    _widget->setImage(image);
 }
 
-int Drawer::getClosestNodes(const Ray &ray, const std::shared_ptr<Scene> &scene, const PhotonTree &photonMap, const PhotonTree &causticsMap, int depth)
+Vec3 Drawer::trace(const Ray &ray, const std::shared_ptr<Scene> &scene, const PhotonTree &photonMap, const PhotonTree &causticsMap, int depth)
 {
     if (depth <= 0)
-        return 0;
+        return Vec3(0, 0, 0);
 
-    float t_min = std::numeric_limits<float>::max();
-    std::shared_ptr<BaseObject> hitObject = nullptr;
-    GraphicParams hitParams;
+    HitRecord hit;
+    if (_intersector.closestHit(ray, hit))
+        return shade(ray, hit, scene, photonMap, causticsMap, depth);
 
-    for (const auto &o : scene->objects())
+    return gi.color;
+}
+
+Vec3 Drawer::shade(const Ray &ray, const HitRecord &hit, const std::shared_ptr<Scene> &scene, const PhotonTree &photonMap, const PhotonTree &causticsMap, int depth)
+{
+    // Рекурсивный вариант поверх того же ядра затенения, что и волновой конвейер
+    SecondaryRay children[MAX_SECONDARY_RAYS];
+    int childrenNum = 0;
+    Vec3 color = shadeSurface(ray, hit, photonMap, causticsMap, Vec3(1, 1, 1), children, childrenNum);
+    for (int i = 0; i < childrenNum; ++i)
     {
-        float t = 0;
-        if (o->intersect(ray, t) && t < t_min)
+        if (children[i].lensEntry)
         {
-            t_min = t;
-            hitParams = o->hitParams(ray, t);
-            hitObject = o;
+            LensPath path = {children[i].ray, children[i].weight, children[i].lensEntry};
+            if (_intersector.lensSystem()->trace(path))
+                color += trace(path.ray, scene, photonMap, causticsMap, depth - 1) * path.weight;
+            continue;
         }
+        color += trace(children[i].ray, scene, photonMap, causticsMap, depth - 1) * children[i].weight;
     }
 
-    if (hitObject != nullptr)
+    // Нормализация цвета
+    color.x = std::min(color.x, 1.0f);
+    color.y = std::min(color.y, 1.0f);
+    color.z = std::min(color.z, 1.0f);
+    return color;
+}
+
+Vec3 Drawer::shadeSurface(const Ray &ray, const HitRecord &hit, const PhotonTree &photonMap, const PhotonTree &causticsMap,
+                          const Vec3 &throughput, SecondaryRay children[MAX_SECONDARY_RAYS], int &childrenNum) const
+{
+    float t_min = hit.t;
+    GraphicParams hitParams = hit.object->hitParams(ray, t_min);
+
+    Vec3 hitPoint = ray.origin + ray.direction * t_min;
+    Vec3 viewDir = -ray.direction;
+    Vec3 bias = hitParams._normal * 1e-4f;
+    Vec3 color(0.0f, 0.0f, 0.0f);
+    childrenNum = 0;
+
+    // // Прямой свет от точечных источников
+    // int lightsNum = 0; // Количество освещающих источников
+    // for (const auto &light : scene->lights())
+    // {
+    //     Vec3 lightDir = (light->position - hitPoint).normalize();
+    //     float lightDistance = (light->position - hitPoint).length();
+
+    //     // Проверка, не находится ли точка в тени
+    //     Ray shadowRay(hitPoint + bias, lightDir);
+    //     bool isInShadow = false;
+
+    //     for (const auto &obj : scene->objects())
+    //     {
+    //         float t = 0;
+    //         if (obj->intersect(shadowRay, t) && t < lightDistance)
+    //         {
+    //             isInShadow = true;
+    //             break;
+    //         }
+    //     }
+
+    //     // Если точка не в тени, добавляем прямое освещение
+    //     if (!isInShadow)
+    //     {
+    //         lightsNum++;
+    //         float intensity = std::max(0.0f, hitParams._normal.dot(lightDir));
+    //         color += hitParams._color * intensity * light->color * (1.0f - hitParams._transparency);
+    //     }
+    // }
+
+    // Прямое свечение от светящихся объектов
+
+    // for (const auto &lightObj : scene->objects())
+    // {
+    //     // Пропускаем объекты без эмиссии
+    //     if (lightObj->_params._emission.color == Vec3(0,0,0))
+    //         continue;
+
+    //     Vec3 lightDir = (lightObj->position() - hitPoint).normalize();
+    //     float lightDistance = (lightObj->position() - hitPoint).length();
+
+    //     // Проверка, не находится ли точка в тени
+    //     Ray shadowRay(hitPoint + bias, lightDir);
+    //     bool isInShadow = false;
+
+    //     for (const auto &obj : scene->objects())
+    //     {
+    //         if (obj == lightObj || obj == hitObject) continue;
+    //         float t = 0;
+    //         if (obj->intersect(shadowRay, t) && t < lightDistance)
+    //         {
+    //             isInShadow = true;
+    //             break;
+    //         }
+    //     }
+
+    //     // Если точка не в тени, добавляем эмиссию от светящегося объекта
+    //     if (!isInShadow)
+    //     {
+    //         float intensity = std::max(0.0f, hitParams._normal.dot(lightDir));
+    //         color += hitParams._color * (1.0f - hitParams._reflectivity) * intensity * lightObj->_params._emission.color * lightObj->_params._emission.intensity * (1.0f - hitParams._transparency);
+    //     }
+    // }
+
+
+    // Собственное свечение
+    color += hitParams._emission.color * hitParams._emission.intensity;
+    // color = hitParams._color;
+
+    // Вторичные лучи не трассируются здесь, а возвращаются вместе с весом их вклада.
+    // Отраженный луч прозрачной и отражающей поверхностей один и тот же, поэтому веса складываются
+    Vec3 reflectedWeight(0.0f, 0.0f, 0.0f);
+
+    // Обработка преломлений
+    const SequentialLensSystem *lenses = _intersector.lensSystem();
+    if (hitParams._transparency > 0.0f && lenses && lenses->contains(hit.object) && ray.direction.dot(hitParams._normal) < 0.0f)
     {
-        Vec3 hitPoint = ray.origin + ray.direction * t_min;
-        Vec3 bias = hitParams._normal * 1e-4f;
-        Vec3 color(0.0f, 0.0f, 0.0f);
+        // Вход в стопку линз: луч проходит ее целиком последовательной трассировкой, пропускание поверхностей
+        // учитывается там же. Здесь остается только отражение от первой поверхности
+        children[childrenNum++] = {ray, Vec3(1, 1, 1), hit.object};
+        reflectedWeight += hitParams._color * Vec3::fresnel(ray.direction, hitParams._normal, hitParams._refractiveIndex);
+    }
+    else if (hitParams._transparency > 0.0f && hit.object->hasInterior() && ray.direction.dot(hitParams._normal) < 0.0f)
+    {
+        // Неоднородная среда: объект сам проводит луч до выхода, пропускание поверхностей учитывается там же
+        Ray exitRay = ray;
+        Vec3 exitWeight(1.0f, 1.0f, 1.0f);
+        if (hit.object->traceInterior(exitRay, hit.t, exitWeight))
+            children[childrenNum++] = {exitRay, exitWeight};
+        reflectedWeight += hitParams._color * Vec3::fresnel(ray.direction, hitParams._normal, hitParams._refractiveIndex);
+    }
+    else if (hitParams._transparency > 0.0f)
+    {
+        // Дисперсия: путь, переносящий весь спектр, может свернуться к одной длине волны
+        SpectralRefraction refraction = refractSpectral(ray.direction, hitParams._normal, ray.previousRefraction,
+                                                        hitParams, ray.wavelength, uniformRandom());
+        Ray refractedRay(hitPoint + bias * ((ray.insideObject) ? -1.0f : 1.0f), refraction.direction.normalize(), !ray.insideObject, (ray.insideObject) ? refraction.refractiveIndex : 1.0f);
+        refractedRay.wavelength = refraction.wavelength;
+        float fresnelCoeff = Vec3::fresnel(ray.direction, hitParams._normal, refraction.refractiveIndex);
+        children[childrenNum++] = {refractedRay, hitParams._color * refraction.weight * (1.0f - fresnelCoeff)};
+        reflectedWeight += hitParams._color * fresnelCoeff;
+    }
 
-        int refractedPhotonsNum = 0;
-        int reflectedPhotonsNum = 0;
+    // Обработка отражений
+    if (hitParams._reflectivity > 0.0f)
+    {
+        reflectedWeight += hitParams._color * (1.0f - hitParams._reflectivity) * (1.0f - hitParams._transparency);
+        reflectedWeight += Vec3(1.0f, 1.0f, 1.0f) * hitParams._reflectivity * (1.0f - hitParams._transparency);
+    }
 
-        // Обработка преломлений
-        if (hitParams._transparency > 0.0f)
-        {
-            Vec3 refractedDir = Vec3::refract(ray.direction, hitParams._normal, ray.previousRefraction, hitParams._refractiveIndex).normalize();
-            Ray refractedRay(hitPoint + bias * ((ray.insideObject) ? -1.0f : 1.0f), refractedDir, !ray.insideObject, (ray.insideObject) ? hitParams._refractiveIndex : 1.0f);
-            refractedPhotonsNum = getClosestNodes(refractedRay, scene, photonMap, causticsMap, depth - 1);
-        }
+    if (hitParams._transparency > 0.0f || hitParams._reflectivity > 0.0f)
+    {
+        Vec3 reflectedDir = Vec3::reflect(ray.direction, hitParams._normal).normalize();
+        Ray reflectedRay(hitPoint + bias, reflectedDir);
+        reflectedRay.wavelength = ray.wavelength;
+        children[childrenNum++] = {reflectedRay, reflectedWeight};
+    }
 
-        // Обработка отражений
-        if (hitParams._reflectivity > 0.0f)
-        {
-            Vec3 reflectedDir = Vec3::reflect(ray.direction, hitParams._normal).normalize();
-            Ray reflectedRay(hitPoint + bias, reflectedDir);
-            refractedPhotonsNum = refractedPhotonsNum = getClosestNodes(reflectedRay, scene, photonMap, causticsMap, depth - 1);
-        }
+    // Сбор фотонов дает только диффузную часть с весом (1 - прозрачность); для чисто зеркальных
+    // и прозрачных поверхностей, а также при пренебрежимо малом вкладе пути он пропускается
+    float diffuseWeight = 1.0f - hitParams._transparency;
+    if (diffuseWeight <= 0.0f || maxComponent(hitParams._color * throughput) * diffuseWeight < _throughputCutoff)
+        return color;
 
+    if (_nextEventEstimation)
+        color += directLight(hitPoint, hitParams, hit.object);
 
+    color += gatherPhotons(causticsMap, hitPoint, hitParams);
 
-        std::vector<Photon> closestPhotons = photonMap.findPhotonsInRadius(hitPoint, _indirectLightMaxR);
+    // Диффузное переотражение берется из кэша освещенности. Глобальная карта без прямого света
+    // целиком заменяется кэшем, иначе из нее берется прямой свет
+    if (_irradianceCache)
+        color += hitParams._color * indirectIrradiance(hitPoint, hitParams._normal, photonMap, causticsMap, *_irradianceCache) * diffuseWeight;
 
-        if (closestPhotons.size() > 0)
-        {
-            _avgDirectPhotnsNum += closestPhotons.size();
-            _directPhotonsNum++;
-        }
+    if (!(_nextEventEstimation && _irradianceCache))
+        color += gatherPhotons(photonMap, hitPoint, hitParams);
 
-        std::vector<Photon> closestCaustics = causticsMap.findPhotonsInRadius(hitPoint, _indirectLightMaxR);
+    return color;
+}
 
+Vec3 Drawer::gatherPhotons(const PhotonTree &map, const Vec3 &point, const GraphicParams &params) const
+{
+    // Оценка плотности: освещенность — поток фотонов вокруг точки, деленный на площадь круга сбора.
+    // Конический фильтр весит фотон по расстоянию, интеграл его веса по кругу радиуса r равен
+    // π r² (1 - 2 / 3k) при k >= 1 и π r² k² / 3 при меньших k
+    double k = _filterConstant;
+    float r = _indirectLightMaxR;
+    double filterArea = M_PI * r * r * (k >= 1 ? 1 - 2 / (3 * k) : k * k / 3);
+    if (filterArea <= 0)
+        return Vec3(0, 0, 0);
 
-        return qMax((int)closestPhotons.size() + (int)closestCaustics.size(), qMax(refractedPhotonsNum, reflectedPhotonsNum));
+    std::vector<Photon> closestPhotons = map.findPhotonsInRadius(point, r);
+    Vec3 flux(0, 0, 0);
+    for (const auto &closestNode : closestPhotons)
+    {
+        // Фотоны, пришедшие с обратной стороны поверхности, ее не освещают
+        if (params._normal.dot(-closestNode.direction) <= 0)
+            continue;
+        float distance = (point - closestNode.position).length();
+        float w = std::max(0.0, 1 - distance / (k * r));
+        flux += closestNode.color * w;
     }
-    return 0;
-}
-
 
+    // Ламбертова поверхность отражает в каждом направлении долю альбедо / π освещенности
+    return params._color * flux * ((1.0f - params._transparency) / (M_PI * filterArea));
+}
 
-Vec3 Drawer::trace(const Ray &ray, const std::shared_ptr<Scene> &scene, const PhotonTree &photonMap, const PhotonTree &causticsMap, int depth)
+Vec3 Drawer::directLight(const Vec3 &point, const GraphicParams &params, const BaseObject *self) const
 {
-    if (depth <= 0)
+    if (_emitters.empty())
         return Vec3(0, 0, 0);
 
-    float t_min = std::numeric_limits<float>::max();
-    std::shared_ptr<BaseObject> hitObject = nullptr;
-    GraphicParams hitParams;
-
-    for (const auto &o : scene->objects())
+    Vec3 light(0, 0, 0);
+    Vec3 origin = point + params._normal * 1e-4f;
+    for (int i = 0; i < _directLightSamples; ++i)
     {
-        float t = 0;
-        if (o->intersect(ray, t) && t < t_min)
-        {
-            t_min = t;
-            hitParams = o->hitParams(ray, t);
-            hitObject = o;
+        // Источник выбирается пропорционально мощности, вклад делится на вероятность выбора
+        float pdf = 0;
+        const BaseObject *emitter = _emitters.emitter(_emitters.sample(uniformRandom(), pdf));
+        if (emitter == self)
+            continue;
 
-        }
-    }
+        // Объект без выборки поверхности — точечный источник в своем центре с силой света, равной яркости
+        Vec3 lightPoint, lightNormal;
+        float areaPdf = 0;
+        bool surface = emitter->sampleSurface(point, uniformRandom(), uniformRandom(), lightPoint, lightNormal, areaPdf);
+        if (!surface)
+            lightPoint = emitter->position();
 
-    if (hitObject != nullptr)
-    {
-        Vec3 hitPoint = ray.origin + ray.direction * t_min;
-        Vec3 viewDir = -ray.direction;
-        Vec3 bias = hitParams._normal * 1e-4f;
-        Vec3 color(0.0f, 0.0f, 0.0f);
-
-        // // Прямой свет от точечных источников
-        // int lightsNum = 0; // Количество освещающих источников
-        // for (const auto &light : scene->lights())
-        // {
-        //     Vec3 lightDir = (light->position - hitPoint).normalize();
-        //     float lightDistance = (light->position - hitPoint).length();
-
-        //     // Проверка, не находится ли точка в тени
-        //     Ray shadowRay(hitPoint + bias, lightDir);
-        //     bool isInShadow = false;
-
-        //     for (const auto &obj : scene->objects())
-        //     {
-        //         float t = 0;
-        //         if (obj->intersect(shadowRay, t) && t < lightDistance)
-        //         {
-        //             isInShadow = true;
-        //             break;
-        //         }
-        //     }
-
-        //     // Если точка не в тени, добавляем прямое освещение
-        //     if (!isInShadow)
-        //     {
-        //         lightsNum++;
-        //         float intensity = std::max(0.0f, hitParams._normal.dot(lightDir));
-        //         color += hitParams._color * intensity * light->color * (1.0f - hitParams._transparency);
-        //     }
-        // }
-
-        // Прямое свечение от светящихся объектов
-
-        // for (const auto &lightObj : scene->objects())
-        // {
-        //     // Пропускаем объекты без эмиссии
-        //     if (lightObj->_params._emission.color == Vec3(0,0,0))
-        //         continue;
-
-        //     Vec3 lightDir = (lightObj->position() - hitPoint).normalize();
-        //     float lightDistance = (lightObj->position() - hitPoint).length();
-
-        //     // Проверка, не находится ли точка в тени
-        //     Ray shadowRay(hitPoint + bias, lightDir);
-        //     bool isInShadow = false;
-
-        //     for (const auto &obj : scene->objects())
-        //     {
-        //         if (obj == lightObj || obj == hitObject) continue;
-        //         float t = 0;
-        //         if (obj->intersect(shadowRay, t) && t < lightDistance)
-        //         {
-        //             isInShadow = true;
-        //             break;
-        //         }
-        //     }
-
-        //     // Если точка не в тени, добавляем эмиссию от светящегося объекта
-        //     if (!isInShadow)
-        //     {
-        //         float intensity = std::max(0.0f, hitParams._normal.dot(lightDir));
-        //         color += hitParams._color * (1.0f - hitParams._reflectivity) * intensity * lightObj->_params._emission.color * lightObj->_params._emission.intensity * (1.0f - hitParams._transparency);
-        //     }
-        // }
-
-
-        // Собственное свечение
-        color += hitParams._emission.color * hitParams._emission.intensity;
-        // color = hitParams._color;
-
-        // Обработка преломлений
-        if (hitParams._transparency > 0.0f)
-        {
-            Vec3 refractedDir = Vec3::refract(ray.direction, hitParams._normal, ray.previousRefraction, hitParams._refractiveIndex).normalize();
-            Ray refractedRay(hitPoint + bias * ((ray.insideObject) ? -1.0f : 1.0f), refractedDir, !ray.insideObject, (ray.insideObject) ? hitParams._refractiveIndex : 1.0f);
-            Vec3 refractedColor = trace(refractedRay, scene, photonMap, causticsMap, depth - 1) * hitParams._color;
-            float fresnelCoeff = Vec3::fresnel(ray.direction, hitParams._normal, hitParams._refractiveIndex);
-            Vec3 reflectedDir = Vec3::reflect(ray.direction, hitParams._normal).normalize();
-            Ray reflectedRay(hitPoint + bias, reflectedDir);
-            Vec3 reflectedColor = trace(reflectedRay, scene, photonMap, causticsMap, depth - 1) * hitParams._color;
-            color += reflectedColor * fresnelCoeff + refractedColor * (1.0f - fresnelCoeff);
-        }
+        Vec3 toLight = lightPoint - origin;
+        float distanceSquared = toLight.lengthSquared();
+        if (distanceSquared <= 0)
+            continue;
+        float distance = std::sqrt(distanceSquared);
+        Vec3 dir = toLight / distance;
+        float cosine = params._normal.dot(dir);
+        if (cosine <= 0)
+            continue;
 
-        // Обработка отражений
-        if (hitParams._reflectivity > 0.0f)
+        // Выборка по площади переводится в телесный угол: dω = cosθ' dA / r²
+        float geometry = cosine / distanceSquared;
+        if (surface)
         {
-            Vec3 reflectedDir = Vec3::reflect(ray.direction, hitParams._normal).normalize();
-            Ray reflectedRay(hitPoint + bias, reflectedDir);
-            Vec3 reflectedColor = trace(reflectedRay, scene,photonMap, causticsMap, depth - 1);
-            Vec3 lightedColor = hitParams._color * (1.0f - hitParams._reflectivity) * reflectedColor * (1.0f - hitParams._transparency);
-            reflectedColor = reflectedColor * hitParams._reflectivity * (1 - hitParams._transparency);
-            color += lightedColor + reflectedColor;
+            float lightCosine = lightNormal.dot(-dir);
+            if (lightCosine <= 0)
+                continue;
+            geometry *= lightCosine / areaPdf;
         }
 
+        if (!_intersector.anyHit(Ray(origin, dir), distance * (1 - 1e-3f), emitter))
+            light += emitter->_params._emission.color * (emitter->_params._emission.intensity * geometry / pdf);
+    }
+    // Та же ламбертова отражательная способность, что и при сборе фотонов
+    return params._color * light * ((1.0f - params._transparency) / (M_PI * _directLightSamples));
+}
+
+Vec3 Drawer::indirectIrradiance(const Vec3 &point, const Vec3 &normal, const PhotonTree &photonMap, const PhotonTree &causticsMap,
+                                IrradianceCache &cache) const
+{
+    Vec3 irradiance;
+    if (cache.lookup(point, normal, irradiance))
+        return irradiance;
 
+    // Финальный сбор: яркость в точках попадания лучей полусферы оценивается по фотонным картам
+    int thetaSteps = std::max(1, (int)std::lround(std::sqrt(_finalGatherRays / 3.0)));
+    int phiSteps = 3 * thetaSteps;
+    std::vector<GatherSample> samples(thetaSteps * phiSteps);
+    Vec3 origin = point + normal * 1e-4f;
 
-        std::vector<Photon> closestPhotons = causticsMap.findPhotonsInRadius(hitPoint, _indirectLightMaxR);
-        double totalWeight = 0.0;
-        Vec3 indirectColor = Vec3(0,0,0);
-        for (const auto &closestNode : closestPhotons)
-        {
-            float intensity = std::max(0.0f, hitParams._normal.dot(-closestNode.direction));
-            float distance = (hitPoint - closestNode.position).length();
-            float w1 = std::max(0.0, 1 - distance / (_filterConstant * _indirectLightMaxR));
-            totalWeight += w1;
-            indirectColor += hitParams._color * intensity * w1 * closestNode.color * (1.0f - hitParams._transparency);
-        }
-        if (closestPhotons.size() > 0)
+    for (int j = 0; j < thetaSteps; ++j)
+    {
+        for (int k = 0; k < phiSteps; ++k)
         {
-            indirectColor /= totalWeight;
-            indirectColor *= (double)closestPhotons.size() / _maxNearestPhotonsNum;
-            // indirectColor /= _avgDirectPhotnsNum / _maxNearestPhotonsNum;
-            // qDebug() << totalWeight << avgDensity << closestPhotons.size();
-            // indirectColor *= w2;
-            color += indirectColor;
-        }
+            Ray ray(origin, IrradianceCache::hemisphereDirection(normal, j, k, thetaSteps, phiSteps, uniformRandom(), uniformRandom()));
+            GatherSample &sample = samples[j * phiSteps + k];
 
+            HitRecord hit;
+            if (!_intersector.closestHit(ray, hit))
+            {
+                sample = {gi.color, std::numeric_limits<float>::max()};
+                continue;
+            }
 
-        closestPhotons = photonMap.findPhotonsInRadius(hitPoint, _indirectLightMaxR);
-        totalWeight = 0.0;
-        indirectColor = Vec3(0,0,0);
-        for (const auto &closestNode : closestPhotons)
-        {
-            float intensity = std::max(0.0f, hitParams._normal.dot(-closestNode.direction));
-            float distance = (hitPoint - closestNode.position).length();
-            float w1 = std::max(0.0, 1 - distance / (_filterConstant * _indirectLightMaxR));
-            totalWeight += w1;
-            indirectColor += hitParams._color * intensity * w1 * closestNode.color * (1.0f - hitParams._transparency);
+            GraphicParams hitParams = hit.object->hitParams(ray, hit.t);
+            Vec3 hitPoint = ray.origin + ray.direction * hit.t;
+            Vec3 radiance = gatherPhotons(photonMap, hitPoint, hitParams) + gatherPhotons(causticsMap, hitPoint, hitParams);
+            if (_nextEventEstimation)
+                radiance += directLight(hitPoint, hitParams, hit.object);
+            sample = {radiance, hit.t};
         }
-        if (closestPhotons.size() > 0)
-        {
-            indirectColor /= totalWeight;
-            indirectColor *= _avgDirectPhotnsNum / _maxNearestPhotonsNum;
+    }
 
-            color += indirectColor;
-        }
+    float size = cache.bounds().extent().x;
+    IrradianceRecord record = IrradianceCache::makeRecord(point, normal, samples, thetaSteps, phiSteps,
+                                                          size * IRRADIANCE_MIN_RADIUS, size * IRRADIANCE_MAX_RADIUS);
+    cache.insert(record);
+    return record.irradiance;
+}
 
-        // Нормализация цвета
-        color.x = std::min(color.x, 1.0f);
-        color.y = std::min(color.y, 1.0f);
-        color.z = std::min(color.z, 1.0f);
-        return color;
-    }
+std::shared_ptr<IrradianceCache> Drawer::prepareIrradianceCache(const std::shared_ptr<Scene> &scene) const
+{
+    if (!_irradianceCaching)
+        return nullptr;
 
-    return gi.color;
+    IrradianceCacheSettings settings;
+    settings.accuracy = _irradianceAccuracy;
+    settings.gatherRadius = _indirectLightMaxR;
+    settings.filterConstant = _filterConstant;
+    settings.gatherRays = _finalGatherRays;
+
+    // Кэш живет в сцене между кадрами, пока не изменятся сцена, фотонная карта или параметры сбора
+    auto cache = scene->irradianceCache();
+    if (cache && cache->settings() == settings)
+        return cache;
+
+    Aabb bounds;
+    for (const auto &o : scene->objects())
+        bounds.expand(o->bounds());
+    if (bounds.isEmpty())
+        return nullptr;
+
+    cache = std::make_shared<IrradianceCache>(bounds, settings);
+    scene->setIrradianceCache(cache);
+    return cache;
 }
 
-void Drawer::processPixels(int startRow, int endRow, const std::shared_ptr<Scene> &scene)
+void Drawer::processPixels(const RenderPass &pass, const std::shared_ptr<Scene> &scene)
 {
 
     QElapsedTimer timer;
     timer.start();
 
-    double width = _widget->getImageWidgetSize().width();
-    double height = _widget->getImageWidgetSize().height();
-    double aspectRatio = width / height;
+    int width = _frameSize.width();
+    int height = _frameSize.height();
+    CameraRayGenerator rays(*scene->camera(), width, height);
+
+    // Кадр разбивается на тайлы, которые обходятся по кривой Мортона
+    std::vector<std::pair<int, int>> tiles = mortonOrderedTiles(width, height, _tileSize);
+    int tilesNum = tiles.size();
+
+    ThreadPool &pool = ThreadPool::instance();
+    ThreadPool::SizeLock sizeLock(pool);
+    std::vector<WavefrontQueues> queues(pool.threadsNum() + 1);
 
-    Vec3 cameraPos = scene->camera()->position();
-    Vec3 cameraDir = scene->camera()->direction().normalize();
-    double screenDistance = scene->camera()->screenDistance();
-    double fov = scene->camera()->fov();
-    double tanFov = tan(fov * M_PI / 360.0f);  // Тангенс половины угла обзора
+    pool.parallelFor(tilesNum, [&](int index) {
+        if (cancelled())
+            return;
+        int x0 = tiles[index].first;
+        int y0 = tiles[index].second;
+        int x1 = std::min(x0 + _tileSize, width);
+        int y1 = std::min(y0 + _tileSize, height);
 
-    // Базовые оси камеры (по умолчанию)
-    Vec3 right = Vec3(1, 0, 0).cross(cameraDir).normalize();
-    Vec3 up = cameraDir.cross(right).normalize();
+        traceTile(x0, y0, x1, y1, pass, rays, scene, queues[pool.currentThreadIndex()]);
 
-    // Вектор для хранения будущих задач
-    std::vector<std::future<void>> futures;
+        _progress.advance(1);
+    });
 
-    _maxNearestPhotonsNum = 1;
-    _avgDirectPhotnsNum = 0;
-    _directPhotonsNum = 0;
+    // qDebug() << "Фотонов на источник:" << _photonsPerLight  << "Время отрисовки:" << timer.elapsed() / 1000.0 << "c";
+}
+
+void Drawer::processAdaptivePixels(const std::vector<int> &extraSamples, const std::shared_ptr<Scene> &scene)
+{
+    int width = _frameSize.width();
+    int height = _frameSize.height();
+    CameraRayGenerator rays(*scene->camera(), width, height);
+
+    std::vector<std::pair<int, int>> tiles = mortonOrderedTiles(width, height, _tileSize);
+    int tilesNum = tiles.size();
+
+    ThreadPool &pool = ThreadPool::instance();
+    ThreadPool::SizeLock sizeLock(pool);
+    std::vector<WavefrontQueues> queues(pool.threadsNum() + 1);
+
+    pool.parallelFor(tilesNum, [&](int index) {
+        if (cancelled())
+            return;
+        int x0 = tiles[index].first;
+        int y0 = tiles[index].second;
+
+        traceAdaptiveTile(x0, y0, std::min(x0 + _tileSize, width), std::min(y0 + _tileSize, height), extraSamples, rays, scene,
+                          queues[pool.currentThreadIndex()]);
+
+        _progress.advance(1);
+    });
+}
+
+void Drawer::traceTile(int x0, int y0, int x1, int y1, const RenderPass &pass, const CameraRayGenerator &rays,
+                       const std::shared_ptr<Scene> &scene, WavefrontQueues &queues)
+{
+    int tileWidth = x1 - x0;
+    queues.reset(tileWidth * (y1 - y0));
+
+    // Первичные лучи трассируются пакетами 8x8 и сразу попадают в очередь вместе с пересечениями.
+    // Для прохода с шагом stride пакет покрывает 8 * stride пикселей по каждой оси
+    int s = pass.stride;
+    RayPacket packet;
+    for (int py = y0; py < y1; py += PACKET_DIM * s)
+    {
+        for (int px = x0; px < x1; px += PACKET_DIM * s)
+        {
+            int px1 = std::min(px + PACKET_DIM * s, x1);
+            int py1 = std::min(py + PACKET_DIM * s, y1);
+
+            // Направления строки пакета нормализуются вместе
+            float rowX[PACKET_DIM];
+            Vec3 rowDirections[PACKET_DIM];
+            int rowSize = 0;
+            for (int x = px; x < px1; x += s)
+                rowX[rowSize++] = x + pass.offsetX;
+
+            packet.reset();
+            bool empty = true;
+            for (int y = py; y < py1; y += s)
+            {
+                rays.directions(rowX, y + pass.offsetY, rowSize, rowDirections);
+                for (int x = px; x < px1; x += s)
+                {
+                    if (!pass.contains(x, y))
+                        continue;
+                    int column = (x - px) / s;
+                    packet.setRay((y - py) / s * PACKET_DIM + column, Ray(rays.origin(), rowDirections[column]));
+                    empty = false;
+                }
+            }
+            if (empty)
+                continue;
+
+            Vec3 corners[4] = {rays.direction(px, py), rays.direction(px1, py), rays.direction(px1, py1), rays.direction(px, py1)};
+            packet.frustum.build(rays.origin(), corners);
+            _intersector.closestHit(packet);
+
+            for (int y = py; y < py1; y += s)
+            {
+                for (int x = px; x < px1; x += s)
+                {
+                    int index = (y - py) / s * PACKET_DIM + (x - px) / s;
+                    if (!packet.isActive(index))
+                        continue;
+                    queues.pushPrimary(packet.ray(index), (y - y0) * tileWidth + (x - x0));
+                    queues.hits.push_back(packet.hits[index]);
+                }
+            }
+        }
+    }
 
-    double sumNearestPhotonsNum = 0;
+    traceQueue(queues, scene, true);
 
-    for (int j = startRow; j < endRow; ++j)
+    // Нормализация цвета и накопление сэмплов
+    int width = rays.width();
+    for (int y = y0; y < y1; y += s)
     {
-        for (int i = 0; i < width; ++i)
+        for (int x = x0; x < x1; x += s)
         {
-            // Преобразование пиксельных координат в мировые
-            float x = (2.0f * (i + 0.5f) / float(width) - 1.0f) * aspectRatio * tanFov;
-            float y = (1.0f - 2.0f * (j + 0.5f) / float(height)) * tanFov;
-
-            // Позиция на виртуальном экране
-            Vec3 pixelOnScreen = cameraPos + cameraDir * screenDistance + right * x + up * y;
-            Vec3 rayDirection = (pixelOnScreen - cameraPos).normalize();
-
-            Ray ray(cameraPos, rayDirection);
-            int v = getClosestNodes(ray, scene, scene->photonMap(), scene->causticsPhotonMap(), _renderingDepth);
-            _maxNearestPhotonsNum = qMax(_maxNearestPhotonsNum, v);
-            sumNearestPhotonsNum += v;
+            if (!pass.contains(x, y))
+                continue;
+
+            Vec3 color = queues.accumulator[(y - y0) * tileWidth + (x - x0)];
+            color.x = std::min(color.x, 1.0f);
+            color.y = std::min(color.y, 1.0f);
+            color.z = std::min(color.z, 1.0f);
+
+            int pixel = y * width + x;
+            if (pass.sampleIndex > 0)
+            {
+                _accumulation[pixel] += color;
+                _framebuffer[pixel] = _accumulation[pixel] / ++_sampleCounts[pixel];
+                continue;
+            }
+
+            // Грубый проход заливает весь блок, пока его не уточнят следующие проходы
+            _accumulation[pixel] = color;
+            _sampleCounts[pixel] = 1;
+            for (int by = y; by < std::min(y + s, rays.height()); ++by)
+                for (int bx = x; bx < std::min(x + s, width); ++bx)
+                    _framebuffer[by * width + bx] = color;
         }
     }
-    if (_directPhotonsNum > 0)
-        _avgDirectPhotnsNum /= _directPhotonsNum;
-    _maxNearestPhotonsNum = sumNearestPhotonsNum / width / height;
-    // Запускаем обработку строк в параллельных задачах
-    for (int j = startRow; j < endRow; ++j)
+}
+
+void Drawer::pushPath(WavefrontQueues &queues, const Ray &ray, Vec3 relative, const PathState &parent) const
+{
+    // Ветви с пренебрежимо малым вкладом отбрасываются, слабые разыгрываются русской рулеткой
+    Vec3 weight = parent.weight * relative;
+    float throughput = maxComponent(weight);
+    if (throughput < _throughputCutoff)
+        return;
+    if (throughput < _rouletteThreshold)
+    {
+        float survival = throughput / _rouletteThreshold;
+        if (uniformRandom() >= survival)
+            return;
+        weight /= survival;
+        relative /= survival;
+    }
+    queues.pushChild(ray, weight, relative, parent);
+}
+
+void Drawer::traceQueue(WavefrontQueues &queues, const std::shared_ptr<Scene> &scene, bool primaryHitsReady)
+{
+    const PhotonTree &photonMap = scene->photonMap();
+    const PhotonTree &causticsMap = scene->causticsPhotonMap();
+
+    // Каждая итерация — одно поколение лучей: пересечение всей очереди, затем затенение всей очереди
+    long long raysNum = 0;
+    for (int depth = _renderingDepth; depth > 0 && !queues.current.empty(); --depth)
     {
-        // Создаем задачу для обработки строки
-        futures.push_back(std::async(std::launch::async, [this, j, width, height, cameraPos, cameraDir, screenDistance, right, up, aspectRatio, &scene, tanFov]() {
-            for (int i = 0; i < width; ++i)
+        int pathsNum = queues.current.size();
+        raysNum += pathsNum;
+
+        if (depth != _renderingDepth || !primaryHitsReady)
+        {
+            queues.hits.assign(pathsNum, HitRecord());
+            for (int i = 0; i < pathsNum; ++i)
+                _intersector.closestHit(queues.current[i].ray, queues.hits[i]);
+        }
+
+        SecondaryRay children[MAX_SECONDARY_RAYS];
+        for (int i = 0; i < pathsNum; ++i)
+        {
+            const PathState &path = queues.current[i];
+            const HitRecord &hit = queues.hits[i];
+            PathNode &node = queues.nodes[path.node];
+            if (!hit.object)
             {
-                // Преобразование пиксельных координат в мировые
-                float x = (2.0f * (i + 0.5f) / float(width) - 1.0f) * aspectRatio * tanFov;
-                float y = (1.0f - 2.0f * (j + 0.5f) / float(height)) * tanFov;
+                node.color += gi.color;
+                continue;
+            }
 
-                // Позиция на виртуальном экране
-                Vec3 pixelOnScreen = cameraPos + cameraDir * screenDistance + right * x + up * y;
-                Vec3 rayDirection = (pixelOnScreen - cameraPos).normalize();
+            int childrenNum = 0;
+            node.color += shadeSurface(path.ray, hit, photonMap, causticsMap, path.weight, children, childrenNum);
+            node.shaded = true;
 
-                Ray ray(cameraPos, rayDirection);
-                _framebuffer[j * width + i] = trace(ray, scene, scene->photonMap(), scene->causticsPhotonMap(), _renderingDepth);
+            if (depth == 1)
+                continue;
+            for (int c = 0; c < childrenNum; ++c)
+            {
+                // Лучи, входящие в стопку линз, копятся и проходят ее пакетами после затенения поколения
+                if (children[c].lensEntry)
+                {
+                    queues.lensPaths.push_back({children[c].ray, children[c].weight, children[c].lensEntry});
+                    queues.lensParents.push_back(i);
+                    continue;
+                }
+                pushPath(queues, children[c].ray, children[c].weight, path);
             }
+        }
 
-            // Обновление прогресса
-            int completedRows = ++_frameProcessedRows;
-            emit progressNameChanged("Создание изображения");
-            emit progressChanged(((double)(completedRows) / height) * 100.0f);
-        }));
+        if (!queues.lensPaths.empty())
+        {
+            _intersector.lensSystem()->trace(queues.lensPaths);
+            for (size_t i = 0; i < queues.lensPaths.size(); ++i)
+                pushPath(queues, queues.lensPaths[i].ray, queues.lensPaths[i].weight, queues.current[queues.lensParents[i]]);
+            queues.lensPaths.clear();
+            queues.lensParents.clear();
+        }
+
+        sortPathStates(queues.next);
+        queues.current.swap(queues.next);
+        queues.next.clear();
     }
+    queues.resolve();
+    _progress.addItems(raysNum);
+}
 
-    // Ждем завершения всех задач
-    for (auto &future : futures)
+void Drawer::traceAdaptiveTile(int x0, int y0, int x1, int y1, const std::vector<int> &extraSamples, const CameraRayGenerator &rays,
+                               const std::shared_ptr<Scene> &scene, WavefrontQueues &queues)
+{
+    int width = rays.width();
+
+    // Каждый дополнительный сэмпл накапливается в своей ячейке, чтобы ограничение цвета применялось к сэмплу
+    int samplesNum = 0;
+    for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x)
+            samplesNum += extraSamples[y * width + x];
+    if (samplesNum == 0)
+        return;
+
+    queues.reset(samplesNum);
+    std::vector<int> samplePixels;
+    samplePixels.reserve(samplesNum);
+
+    for (int y = y0; y < y1; ++y)
     {
-        future.get();
+        for (int x = x0; x < x1; ++x)
+        {
+            int pixel = y * width + x;
+            int n = extraSamples[pixel];
+            for (int k = 0; k < n; ++k)
+            {
+                float ox = 0, oy = 0;
+                stratifiedOffset(pixel, k, n, ox, oy);
+                queues.pushPrimary(rays.ray(x + ox, y + oy), static_cast<int>(samplePixels.size()));
+                samplePixels.push_back(pixel);
+            }
+        }
     }
 
-    // qDebug() << "Фотонов на источник:" << _photonsPerLight  << "Время отрисовки:" << timer.elapsed() / 1000.0 << "c";
+    sortPathStates(queues.current);
+    traceQueue(queues, scene, false);
+
+    for (int i = 0; i < samplesNum; ++i)
+    {
+        Vec3 color = queues.accumulator[i];
+        color.x = std::min(color.x, 1.0f);
+        color.y = std::min(color.y, 1.0f);
+        color.z = std::min(color.z, 1.0f);
+        _accumulation[samplePixels[i]] += color;
+        ++_sampleCounts[samplePixels[i]];
+    }
+    for (int y = y0; y < y1; ++y)
+        for (int x = x0; x < x1; ++x)
+            if (extraSamples[y * width + x] > 0)
+                _framebuffer[y * width + x] = _accumulation[y * width + x] / _sampleCounts[y * width + x];
+}
+
+DrawerSettings Drawer::settings() const
+{
+    DrawerSettings settings;
+    settings.filterConstant = _filterConstant;
+    settings.indirectLightMaxR = _indirectLightMaxR;
+    settings.photonsPerLight = _photonsPerLight;
+    settings.threadsNum = threadsNum();
+    settings.samplesPerPixel = _samplesPerPixel;
+    settings.progressive = _progressive;
+    settings.adaptiveSampling = _adaptiveSampling;
+    settings.irradianceCaching = _irradianceCaching;
+    settings.directLighting = _directLighting;
+    settings.sequentialLenses = _sequentialLenses;
+    settings.renderTarget = _renderTarget;
+    return settings;
+}
+
+void Drawer::setSettings(const DrawerSettings &newSettings)
+{
+    setFilterConstant(newSettings.filterConstant);
+    setIndirectLightMaxR(newSettings.indirectLightMaxR);
+    setPhotonsPerLight(newSettings.photonsPerLight);
+    setThreadsNum(newSettings.threadsNum);
+    setSamplesPerPixel(newSettings.samplesPerPixel);
+    setProgressive(newSettings.progressive);
+    setAdaptiveSampling(newSettings.adaptiveSampling);
+    setIrradianceCaching(newSettings.irradianceCaching);
+    setDirectLighting(newSettings.directLighting);
+    setSequentialLenses(newSettings.sequentialLenses);
+    setRenderTarget(newSettings.renderTarget);
 }
 
 float Drawer::indirectLightMaxR() const
@@ -384,69 +844,88 @@ void Drawer::updatePhotonMap(const std::shared_ptr<Scene> &scene)
     // std::vector<photon> photons;
     std::vector<Photon> photons;
     std::vector<Photon> causticPhotons;
-    scene->updatePhotonMap(photons, causticPhotons,_nearestPhotonsNum);
-    double totalPhotons = _photonsPerLight * scene->lights().size();
-    double processedPhotons = 0;
-
-    for (const auto& o: scene->objects()) if(o->_params._emission.intensity > 0) totalPhotons += _photonsPerLight;
+    ThreadPool::instance().setThreadsNum(_threadsNum);
+    buildIntersector(scene);
+
+    // Фотоны распределяются между источниками пропорционально мощности, общее число —
+    // _photonsPerLight на источник. Мощность фотона делится на вероятность выбора источника,
+    // поэтому суммарный вклад каждого источника не зависит от распределения
+    EmitterRegistry emitters(scene->objects());
+    int totalPhotons = _photonsPerLight * emitters.size();
+    _progress.begin(RenderStage::PhotonMap, totalPhotons);
+
+    ThreadPool &pool = ThreadPool::instance();
+    int chunks = (totalPhotons + PHOTON_CHUNK_SIZE - 1) / PHOTON_CHUNK_SIZE;
+
+    // Каждая порция фотонов пишет в собственные массивы, затем они объединяются по порядку
+    std::vector<std::vector<Photon>> chunkPhotons(chunks);
+    std::vector<std::vector<Photon>> chunkCaustics(chunks);
+
+    pool.parallelFor(chunks, [&](int c) {
+        if (cancelled())
+            return;
+        int quota = std::min(PHOTON_CHUNK_SIZE, totalPhotons - c * PHOTON_CHUNK_SIZE);
+        for (int i = 0; i < quota; ++i)
+        {
+            float pdf = 0;
+            const BaseObject &light = *emitters.emitter(emitters.sample(uniformRandom(), pdf));
+            emitPhoton(light, 1.0f / (totalPhotons * pdf), chunkPhotons[c], chunkCaustics[c]);
+        }
+        _progress.advance(quota);
+        _progress.addItems(quota);
+    });
 
-    emit progressNameChanged("Рассчет фотонной карты");
+    // При отмене у сцены остается прежняя карта
+    if (cancelled())
+    {
+        _progress.finish();
+        return;
+    }
 
-    for (const auto &light : scene->objects())
+    for (int c = 0; c < chunks; ++c)
     {
-        if (light->_params._emission.color == Vec3(0, 0, 0))
-            continue;
+        photons.insert(photons.end(), chunkPhotons[c].begin(), chunkPhotons[c].end());
+        causticPhotons.insert(causticPhotons.end(), chunkCaustics[c].begin(), chunkCaustics[c].end());
+    }
+    // qDebug() << "Photons NUm: " << photons.size();
+    scene->updatePhotonMap(photons, causticPhotons, _nearestPhotonsNum, _directLighting);
+    _progress.finish();
+    //qDebug() << "Фотонов на источник:" << _photonsPerLight  << "Время построения карты:" << timer.elapsed() / 1000.0 << "c";
+}
 
-        for (int i = 0; i < _photonsPerLight; ++i)
+void Drawer::emitPhoton(const BaseObject &light, float powerScale, std::vector<Photon> &photons, std::vector<Photon> &causticPhotons)
+{
+    // Светящаяся поверхность излучает по Ламберту с яркостью L = цвет * интенсивность: точка берется по площади,
+    // направление — по косинусу, и фотон переносит поток π L / pdf. Объект без выборки поверхности —
+    // изотропный точечный источник с силой света L и потоком 4π L, как и в directLight
+    const LightColor &emission = light._params._emission;
+    Vec3 radiance = emission.color * emission.intensity;
+    Photon photon;
+    Vec3 point, normal;
+    float pdf = 0;
+    if (light.sampleEmission(uniformRandom(), uniformRandom(), point, normal, pdf))
+    {
+        photon.position = point + normal * 1e-4f;
+        photon.direction = cosineWeightedDirection(normal);
+        photon.color = radiance * (M_PI / pdf * powerScale);
+    }
+    else
+    {
+        photon.position = light.position();
+        photon.direction = Vec3::getRandomDirection();
+        float t;
+        Ray r(photon.position, photon.direction);
+        if (light.intersect(r, t))
         {
-            Vec3 randomDir = Vec3::getRandomDirection();
-            Vec3 colorMasks[3] = {Vec3(1,0,0), Vec3(0,1,0), Vec3(0,0,1)};
-            Photon photon;
-            photon.position = light->position();
-            photon.direction = randomDir;
-
-            // Проверка пересечения с объектами
-            bool intersectsObject = false;
-
-            for (const auto &object : scene->objects())
-            {
-                float t;
-                Ray r(photon.position, photon.direction);
-                if (object == light && object->intersect(r, t))
-                {
-                    Vec3 bias = object->hitParams(r, t)._normal * 1e-4f;
-                    photon.position = r.origin + r.direction * t + bias;
-                    break;
-                }
-            }
-            for (const auto &object : scene->objects())
-            {
-                float t;
-                if (object != light && object->intersect(Ray(photon.position, photon.direction), t))
-                {
-                    intersectsObject = true;
-                    break;
-                }
-            }
-
-
-            auto prevSize = photons.size();
-            for (int j = 0; j < 3 && intersectsObject; j++)
-            {
-                Photon tmpPhoton = photon;
-                tmpPhoton.color = light->_params._emission.color * light->_params._emission.intensity * colorMasks[j];
-                tracePhoton(tmpPhoton, scene->objects(), photons, causticPhotons, _renderingDepth, 1, _renderingDepth);
-            }
-            if (photons.size() > prevSize)
-                emit progressChanged((++processedPhotons) / totalPhotons * 95);
-            else
-                --i;
+            Vec3 bias = light.hitParams(r, t)._normal * 1e-4f;
+            photon.position = r.origin + r.direction * t + bias;
         }
+        photon.color = radiance * (4 * M_PI * powerScale);
     }
-    // qDebug() << "Photons NUm: " << photons.size();
-    scene->updatePhotonMap(photons, causticPhotons, _nearestPhotonsNum);
-    emit progressChanged((++processedPhotons) / totalPhotons * 100);
-    //qDebug() << "Фотонов на источник:" << _photonsPerLight  << "Время построения карты:" << timer.elapsed() / 1000.0 << "c";
+
+    // Фотон, ушедший из сцены, тоже считается выпущенным: его поток теряется, и оценка остается несмещенной.
+    // Один фотон переносит весь спектр источника, длины волн расходятся в tracePhoton на первой дисперсной поверхности
+    tracePhoton(photon, _intersector, photons, causticPhotons, _renderingDepth, 1, _renderingDepth, _directLighting);
 }
 
 int Drawer::nearestPhotonsNum() const
@@ -469,6 +948,138 @@ void Drawer::setPhotonsPerLight(int newPhotonsPerLight)
     _photonsPerLight = newPhotonsPerLight;
 }
 
+int Drawer::threadsNum() const
+{
+    return _threadsNum > 0 ? _threadsNum : ThreadPool::instance().threadsNum();
+}
+
+void Drawer::setThreadsNum(int newThreadsNum)
+{
+    // Пул может быть занят текущим заданием, поэтому размер меняется в начале следующего
+    _threadsNum = newThreadsNum;
+}
+
+bool Drawer::progressive() const
+{
+    return _progressive;
+}
+
+void Drawer::setProgressive(bool newProgressive)
+{
+    _progressive = newProgressive;
+}
+
+int Drawer::samplesPerPixel() const
+{
+    return _samplesPerPixel;
+}
+
+void Drawer::setSamplesPerPixel(int newSamplesPerPixel)
+{
+    _samplesPerPixel = std::max(1, newSamplesPerPixel);
+}
+
+bool Drawer::adaptiveSampling() const
+{
+    return _adaptiveSampling;
+}
+
+void Drawer::setAdaptiveSampling(bool newAdaptiveSampling)
+{
+    _adaptiveSampling = newAdaptiveSampling;
+}
+
+float Drawer::adaptiveThreshold() const
+{
+    return _adaptiveThreshold;
+}
+
+void Drawer::setAdaptiveThreshold(float newAdaptiveThreshold)
+{
+    _adaptiveThreshold = newAdaptiveThreshold;
+}
+
+float Drawer::adaptiveBudget() const
+{
+    return _adaptiveBudget;
+}
+
+void Drawer::setAdaptiveBudget(float newAdaptiveBudget)
+{
+    _adaptiveBudget = std::max(0.0f, newAdaptiveBudget);
+}
+
+bool Drawer::irradianceCaching() const
+{
+    return _irradianceCaching;
+}
+
+void Drawer::setIrradianceCaching(bool newIrradianceCaching)
+{
+    _irradianceCaching = newIrradianceCaching;
+}
+
+float Drawer::irradianceAccuracy() const
+{
+    return _irradianceAccuracy;
+}
+
+void Drawer::setIrradianceAccuracy(float newIrradianceAccuracy)
+{
+    _irradianceAccuracy = std::max(0.01f, newIrradianceAccuracy);
+}
+
+int Drawer::finalGatherRays() const
+{
+    return _finalGatherRays;
+}
+
+void Drawer::setFinalGatherRays(int newFinalGatherRays)
+{
+    _finalGatherRays = std::max(3, newFinalGatherRays);
+}
+
+float Drawer::throughputCutoff() const
+{
+    return _throughputCutoff;
+}
+
+void Drawer::setThroughputCutoff(float newThroughputCutoff)
+{
+    _throughputCutoff = std::max(0.0f, newThroughputCutoff);
+}
+
+float Drawer::rouletteThreshold() const
+{
+    return _rouletteThreshold;
+}
+
+void Drawer::setRouletteThreshold(float newRouletteThreshold)
+{
+    _rouletteThreshold = std::max(0.0f, newRouletteThreshold);
+}
+
+int Drawer::previewInterval() const
+{
+    return _previewInterval;
+}
+
+void Drawer::setPreviewInterval(int newPreviewInterval)
+{
+    _previewInterval = newPreviewInterval;
+}
+
+int Drawer::tileSize() const
+{
+    return _tileSize;
+}
+
+void Drawer::setTileSize(int newTileSize)
+{
+    // Размер тайла кратен стороне пакета первичных лучей
+    _tileSize = std::max(PACKET_DIM, newTileSize / PACKET_DIM * PACKET_DIM);
+}
+
 int Drawer::renderingDepth() const
 {
     return _renderingDepth;
@@ -478,3 +1089,89 @@ void Drawer::setRenderingDepth(int newRenderingDepth)
 {
     _renderingDepth = newRenderingDepth;
 }
+
+bool Drawer::directLighting() const
+{
+    return _directLighting;
+}
+
+void Drawer::setDirectLighting(bool newDirectLighting)
+{
+    _directLighting = newDirectLighting;
+}
+
+bool Drawer::sequentialLenses() const
+{
+    return _sequentialLenses;
+}
+
+void Drawer::setSequentialLenses(bool newSequentialLenses)
+{
+    _sequentialLenses = newSequentialLenses;
+}
+
+int Drawer::directLightSamples() const
+{
+    return _directLightSamples;
+}
+
+void Drawer::setDirectLightSamples(int newDirectLightSamples)
+{
+    _directLightSamples = std::max(1, newDirectLightSamples);
+}
+
+RenderingWidget *Drawer::widget() const
+{
+    return _widget;
+}
+
+ToneMapSettings Drawer::toneMapping() const
+{
+    return _toneMapping;
+}
+
+void Drawer::setToneMapping(const ToneMapSettings &newToneMapping)
+{
+    _toneMapping = newToneMapping;
+}
+
+std::shared_ptr<const HdrImage> Drawer::lastFrame() const
+{
+    std::lock_guard<std::mutex> lock(_lastFrameMutex);
+    return _lastFrame;
+}
+
+const RenderProgress &Drawer::progress() const
+{
+    return _progress;
+}
+
+RenderTarget Drawer::renderTarget() const
+{
+    return _renderTarget;
+}
+
+void Drawer::setRenderTarget(const RenderTarget &newRenderTarget)
+{
+    _renderTarget = newRenderTarget;
+}
+
+QSize Drawer::frameSize() const
+{
+    return _frameSize;
+}
+
+void Drawer::setFrameSize(const QSize &newFrameSize)
+{
+    _frameSize = newFrameSize;
+}
+
+void Drawer::setCancelFlag(const std::atomic<bool> *newCancelFlag)
+{
+    _cancelFlag = newCancelFlag;
+}
+
+bool Drawer::cancelled() const
+{
+    return _cancelFlag && *_cancelFlag;
+}
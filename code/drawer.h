@@ -1,6 +1,7 @@
 #ifndef DRAWER_H
 #define DRAWER_H
 
+#include <atomic>
 #include <mutex>
 #include <vector>
 #include <QObject>
@@ -8,10 +9,39 @@
 #include "photon.h"
 #include "renderingwidget.h"
 #include "scene.h"
+#include "sceneintersector.h"
+#include "raypacket.h"
+#include "wavefront.h"
+#include "progressive.h"
+#include "irradiancecache.h"
+#include "emitterregistry.h"
+#include "renderprogress.h"
+#include "tonemapper.h"
+#include "hdrimage.h"
+#include "rendertarget.h"
+
+// Параметры отрисовщика, задаваемые в интерфейсе. Задание рендеринга получает их копию при постановке
+// в очередь и применяет в рабочем потоке, поэтому правки в интерфейсе не меняют идущий кадр
+struct DrawerSettings
+{
+    double filterConstant = 1;
+    float indirectLightMaxR = 0.1f;
+    int photonsPerLight = 100000;
+    int threadsNum = 0;
+    int samplesPerPixel = 1;
+    bool progressive = true;
+    bool adaptiveSampling = true;
+    bool irradianceCaching = true;
+    bool directLighting = true;
+    bool sequentialLenses = false;
+    RenderTarget renderTarget;
+};
 
 class Drawer : public QObject
 {
     Q_OBJECT
+    // Тесты сравнивают волновой конвейер с рекурсивной трассировкой
+    friend class TestAll;
 public:
     Drawer(QObject *parrent) = delete;
     Drawer(RenderingWidget *widget, QObject *parrent);
@@ -19,6 +49,9 @@ public:
     int renderingDepth() const;
     void setRenderingDepth(int newRenderingDepth);
 
+    DrawerSettings settings() const;
+    void setSettings(const DrawerSettings &newSettings);
+
     int photonsPerLight() const;
     void setPhotonsPerLight(int newPhotonsPerLight);
 
@@ -31,43 +64,185 @@ public:
     float indirectLightMaxR() const;
     void setIndirectLightMaxR(float newIndirectLightMaxR);
 
+    int threadsNum() const;
+    void setThreadsNum(int newThreadsNum);
+
+    int tileSize() const;
+    void setTileSize(int newTileSize);
+
+    bool progressive() const;
+    void setProgressive(bool newProgressive);
+
+    int samplesPerPixel() const;
+    void setSamplesPerPixel(int newSamplesPerPixel);
+
+    bool adaptiveSampling() const;
+    void setAdaptiveSampling(bool newAdaptiveSampling);
+
+    // Порог локального контраста, выше которого пиксель получает дополнительные сэмплы
+    float adaptiveThreshold() const;
+    void setAdaptiveThreshold(float newAdaptiveThreshold);
+
+    // Бюджет дополнительных сэмплов на кадр, в среднем на пиксель
+    float adaptiveBudget() const;
+    void setAdaptiveBudget(float newAdaptiveBudget);
+
+    bool irradianceCaching() const;
+    void setIrradianceCaching(bool newIrradianceCaching);
+
+    // Допустимая ошибка интерполяции кэша освещенности (параметр a Уорда)
+    float irradianceAccuracy() const;
+    void setIrradianceAccuracy(float newIrradianceAccuracy);
+
+    // Число лучей финального сбора на одну запись кэша
+    int finalGatherRays() const;
+    void setFinalGatherRays(int newFinalGatherRays);
+
+    // Вклад пути, ниже которого ветвь отбрасывается и сбор фотонов не выполняется
+    float throughputCutoff() const;
+    void setThroughputCutoff(float newThroughputCutoff);
+
+    // Вклад пути, ниже которого ветвь продолжается с вероятностью, пропорциональной вкладу
+    float rouletteThreshold() const;
+    void setRouletteThreshold(float newRouletteThreshold);
+
+    // Прямой свет от излучающих объектов теневыми лучами; применяется при построении фотонной карты
+    bool directLighting() const;
+    void setDirectLighting(bool newDirectLighting);
+
+    // Число теневых лучей на точку, источник для каждого выбирается пропорционально мощности
+    int directLightSamples() const;
+    void setDirectLightSamples(int newDirectLightSamples);
+
+    // Последовательная трассировка стопки соосных линз (заданной в сцене или найденной автоматически)
+    bool sequentialLenses() const;
+    void setSequentialLenses(bool newSequentialLenses);
+
+    RenderingWidget *widget() const;
+
+    // Перевод в 8 бит для вывода; применяется со следующего кадра
+    ToneMapSettings toneMapping() const;
+    void setToneMapping(const ToneMapSettings &newToneMapping);
+
+    // Последний завершенный кадр в линейных значениях, для сохранения в HDR
+    std::shared_ptr<const HdrImage> lastFrame() const;
+
+    // Прогресс и скорость текущего этапа; безопасно читать из любого потока
+    const RenderProgress &progress() const;
+
+    // Разрешение кадра и масштаб черновых кадров, не зависящие от размера виджета
+    RenderTarget renderTarget() const;
+    void setRenderTarget(const RenderTarget &newRenderTarget);
+
+    // Размер кадра задается потоком интерфейса до запуска задания
+    QSize frameSize() const;
+    void setFrameSize(const QSize &newFrameSize);
+
+    // Флаг отмены текущего задания; прерванный кадр не публикуется, прерванная карта не заменяет прежнюю
+    void setCancelFlag(const std::atomic<bool> *newCancelFlag);
+    bool cancelled() const;
+
+    // Минимальный интервал между публикациями промежуточных кадров, мс
+    int previewInterval() const;
+    void setPreviewInterval(int newPreviewInterval);
+
 public slots:
-    void renderFrame(const std::shared_ptr<Scene> &_scene);
+    // preview — черновой кадр: прогрессивные проходы по одному сэмплу без адаптивного сглаживания
+    void renderFrame(const std::shared_ptr<Scene> &_scene, bool preview = false);
     void updatePhotonMap(const std::shared_ptr<Scene> &scene);
 private:
     void initialize();
+    // Перестраивает структуру поиска пересечений и последовательную систему линз для сцены
+    void buildIntersector(const std::shared_ptr<Scene> &scene);
 
     // Vec3 trace (const Ray &ray, const std::shared_ptr<Scene> &scene, int depth);
-    int getClosestNodes(const Ray &ray, const std::shared_ptr<Scene> &scene, const PhotonTree &photonMap, const PhotonTree &causticsMap, int depth);
     // double getLoghtFilter(const Ray &ray, const std::shared_ptr<Scene> &scene, const PhotonTree &photonMap, const PhotonTree &causticsMap);
     Vec3 trace (const Ray &ray, const std::shared_ptr<Scene> &scene, const PhotonTree &photonMap, const PhotonTree &causticsMap, int depth);
+    Vec3 shade(const Ray &ray, const HitRecord &hit, const std::shared_ptr<Scene> &scene, const PhotonTree &photonMap, const PhotonTree &causticsMap, int depth);
+    // Ядро затенения: локальный цвет точки попадания и порождаемые вторичные лучи с весами
+    // throughput — накопленный вес пути до точки попадания, по нему решается, нужен ли сбор фотонов
+    Vec3 shadeSurface(const Ray &ray, const HitRecord &hit, const PhotonTree &photonMap, const PhotonTree &causticsMap,
+                      const Vec3 &throughput, SecondaryRay children[MAX_SECONDARY_RAYS], int &childrenNum) const;
     // Vec3 trace(const Ray &ray, const std::shared_ptr<Scene> &scene, int depth);
 
-    void processPixels(int startRow, int endRow, const std::shared_ptr<Scene> &scene);
+    void processPixels(const RenderPass &pass, const std::shared_ptr<Scene> &scene);
+    // Яркость, отраженная диффузной частью поверхности, по освещенности от фотонов карты вокруг точки
+    Vec3 gatherPhotons(const PhotonTree &map, const Vec3 &point, const GraphicParams &params) const;
+    // Прямое освещение точки от излучающих объектов по выборкам их поверхности, self не освещает сам себя.
+    // Оценка суммы по всем источникам: каждый луч идет к одному источнику, выбранному по мощности.
+    // Источники и отражение те же, что при трассировке фотонов, поэтому оценка совпадает со сбором прямых фотонов
+    Vec3 directLight(const Vec3 &point, const GraphicParams &params, const BaseObject *self) const;
+    // Освещенность от диффузного переотражения: из кэша или финальным сбором с записью в кэш
+    Vec3 indirectIrradiance(const Vec3 &point, const Vec3 &normal, const PhotonTree &photonMap, const PhotonTree &causticsMap,
+                            IrradianceCache &cache) const;
+    std::shared_ptr<IrradianceCache> prepareIrradianceCache(const std::shared_ptr<Scene> &scene) const;
+
+    void processAdaptivePixels(const std::vector<int> &extraSamples, const std::shared_ptr<Scene> &scene);
+    // powerScale — доля фотона в общем потоке с поправкой на вероятность выбора источника
+    void emitPhoton(const BaseObject &light, float powerScale, std::vector<Photon> &photons, std::vector<Photon> &causticPhotons);
+    // Волновой конвейер для тайла кадра
+    void traceTile(int x0, int y0, int x1, int y1, const RenderPass &pass, const CameraRayGenerator &rays,
+                   const std::shared_ptr<Scene> &scene, WavefrontQueues &queues);
+    void traceAdaptiveTile(int x0, int y0, int x1, int y1, const std::vector<int> &extraSamples, const CameraRayGenerator &rays,
+                           const std::shared_ptr<Scene> &scene, WavefrontQueues &queues);
+    // Поколения лучей очереди до ее опустошения или исчерпания глубины
+    void traceQueue(WavefrontQueues &queues, const std::shared_ptr<Scene> &scene, bool primaryHitsReady);
+    // Постановка потомка пути parent в следующее поколение с отсечением и русской рулеткой по вкладу;
+    // relative — вес потомка относительно parent
+    void pushPath(WavefrontQueues &queues, const Ray &ray, Vec3 relative, const PathState &parent) const;
     // void processPixels(int startRow, int endRow, const std::shared_ptr<Scene> &scene);
 
 
 signals:
     void progressNameChanged(const QString &name);
     void progressChanged(double progress);
+    void frameUpdated(const QImage &image);
 
 
 private:
     std::vector<Vec3> _framebuffer;
+    // Сумма сэмплов пикселей при многосэмпловом накоплении
+    std::vector<Vec3> _accumulation;
+    std::vector<int> _sampleCounts;
 
-    std::atomic<int> _frameProcessedRows;
+    RenderProgress _progress;
+    ToneMapSettings _toneMapping;
+    std::shared_ptr<const HdrImage> _lastFrame;
+    mutable std::mutex _lastFrameMutex;
     std::mutex _processOutputMutex;
 
     RenderingWidget *_widget;
+    QSize _frameSize;
+    RenderTarget _renderTarget;
+    const std::atomic<bool> *_cancelFlag = nullptr;
+    SceneIntersector _intersector;
+    std::shared_ptr<IrradianceCache> _irradianceCache;
+    EmitterRegistry _emitters;
+    // Режим текущей фотонной карты: глобальная карта без прямого света
+    bool _nextEventEstimation = false;
 
     int _renderingDepth = 10;
     int _photonsPerLight = 100000;
     int _nearestPhotonsNum = 50;
-    int _maxNearestPhotonsNum = 50;
-    double _avgDirectPhotnsNum = 1;
-    int _directPhotonsNum = 1;
     float _indirectLightMaxR = 0.1;
     double _filterConstant = 1;
+    // 0 — по числу аппаратных потоков
+    int _threadsNum = 0;
+    int _tileSize = 32;
+    bool _progressive = true;
+    int _samplesPerPixel = 1;
+    int _previewInterval = 100;
+    bool _adaptiveSampling = true;
+    float _adaptiveThreshold = 0.05f;
+    float _adaptiveBudget = 1.0f;
+    float _throughputCutoff = 1e-3f;
+    bool _irradianceCaching = true;
+    float _irradianceAccuracy = 0.25f;
+    int _finalGatherRays = 108;
+    float _rouletteThreshold = 0.05f;
+    bool _directLighting = true;
+    int _directLightSamples = 4;
+    bool _sequentialLenses = false;
 
 
     const LightColor gi {
@@ -1,11 +1,35 @@
 #include "drawmanager.h"
 
+namespace
+{
+// Частота опроса прогресса, Гц
+const int PROGRESS_UPDATE_RATE = 30;
+}
+
 DrawManager::DrawManager(const std::shared_ptr<Drawer> &drawer, QObject *parrent)
     :QObject(parrent)
 {
+    _jobs = new RenderJobManager(this);
+    _progressTimer = new QTimer(this);
+    _progressTimer->setInterval(1000 / PROGRESS_UPDATE_RATE);
+    connect(_progressTimer, &QTimer::timeout, this, &DrawManager::updateProgress);
+
+    // Таймер работает только пока есть задания
+    connect(_jobs, &RenderJobManager::jobStarted, this, [this]() { _progressTimer->start(); }, Qt::QueuedConnection);
+    connect(_jobs, &RenderJobManager::jobFinished, this, [this]() {
+        updateProgress();
+        if (!_jobs->busy())
+            _progressTimer->stop();
+    }, Qt::QueuedConnection);
     setDrawer(drawer);
 }
 
+DrawManager::~DrawManager()
+{
+    // Задания используют отрисовщик, поэтому очередь останавливается раньше, чем он будет удален
+    delete _jobs;
+}
+
 std::shared_ptr<Drawer> DrawManager::drawer() const
 {
     return _drawer;
@@ -13,23 +37,72 @@ std::shared_ptr<Drawer> DrawManager::drawer() const
 
 void DrawManager::setDrawer(const std::shared_ptr<Drawer> &newDrawer)
 {
+    _jobs->cancelAll();
+    _jobs->waitIdle();
     _drawer = newDrawer;
 }
 
-void DrawManager::drawScene(const std::shared_ptr<Scene> scene)
+void DrawManager::drawScene(const std::shared_ptr<Scene> scene, const DrawerSettings &settings, RenderJobPriority priority)
 {
     if (_drawer)
     {
-        _drawer->renderFrame(scene);
+        // Размер кадра определяется здесь, в потоке интерфейса: по цели отрисовки, а если
+        // ее размер не задан — по области вывода
+        std::shared_ptr<Drawer> drawer = _drawer;
+        std::shared_ptr<Scene> snapshot = scene->snapshot();
+        bool preview = priority == RenderJobPriority::Preview;
+        QSize size = settings.renderTarget.frameSize(preview, drawer->widget()->getImageWidgetSize());
+        _jobs->submit(RenderJobKind::Frame, priority, [drawer, snapshot, settings, size, preview](const std::atomic<bool> &cancelled) {
+            drawer->setCancelFlag(&cancelled);
+            drawer->setSettings(settings);
+            drawer->setFrameSize(size);
+            drawer->renderFrame(snapshot, preview);
+            drawer->setCancelFlag(nullptr);
+        });
     }
 }
 
-void DrawManager::updateSceneMap(const std::shared_ptr<Scene> scene)
+void DrawManager::updateSceneMap(const std::shared_ptr<Scene> scene, const DrawerSettings &settings)
 {
     if (_drawer)
     {
-        connect(scene.get(), &Scene::progressChanged, _drawer.get(),&Drawer::progressChanged);
-        _drawer->updatePhotonMap(scene);
-        disconnect(scene.get(), &Scene::progressChanged, _drawer.get(), &Drawer::progressChanged);
+        // Карта строится по снимку и попадает в общее освещение сцены и ее следующих снимков
+        std::shared_ptr<Drawer> drawer = _drawer;
+        std::shared_ptr<Scene> snapshot = scene->snapshot();
+        _jobs->submit(RenderJobKind::PhotonMap, RenderJobPriority::Final, [drawer, snapshot, settings](const std::atomic<bool> &cancelled) {
+            drawer->setCancelFlag(&cancelled);
+            drawer->setSettings(settings);
+            drawer->updatePhotonMap(snapshot);
+            drawer->setCancelFlag(nullptr);
+        });
+    }
+}
+
+void DrawManager::cancel()
+{
+    _jobs->cancelAll();
+}
+
+void DrawManager::updateProgress()
+{
+    if (!_drawer)
+        return;
+
+    const RenderProgress &progress = _drawer->progress();
+    RenderStageTimings timings = progress.timings();
+    QString status;
+    switch (progress.stage())
+    {
+    case RenderStage::PhotonMap:
+        status = QString("Фотонная карта: %p% (%1 тыс. фотонов/с)").arg(timings.photonMap.rate() / 1e3, 0, 'f', 0);
+        break;
+    case RenderStage::Frame:
+        status = QString("Кадр: %p% (%1 млн лучей/с)").arg(timings.frame.rate() / 1e6, 0, 'f', 2);
+        break;
+    case RenderStage::Idle:
+        status = QString("Готово: %1 млн лучей/с").arg(timings.frame.rate() / 1e6, 0, 'f', 2);
+        break;
     }
+    _drawer->widget()->setProgress(progress.fraction() * 100.0);
+    _drawer->widget()->setStatus(status);
 }
@@ -2,24 +2,36 @@
 #define DRAWMANAGER_H
 
 #include <QObject>
+#include <QTimer>
 #include <memory>
 #include "scene.h"
 #include "baseobject.h"
 #include "drawer.h"
+#include "renderjobmanager.h"
 
+// Ставит расчет фотонной карты и кадры в очередь заданий, выполняемых вне потока интерфейса
 class DrawManager : public QObject
 {
     Q_OBJECT
 public:
     explicit DrawManager(QObject *parent = nullptr) = delete;
     DrawManager(const std::shared_ptr<Drawer> &drawer, QObject *parrent = nullptr);
+    ~DrawManager();
     std::shared_ptr<Drawer> drawer() const;
     void setDrawer(const std::shared_ptr<Drawer> &newDrawer);
-    void drawScene(const std::shared_ptr<Scene> scene);
-    void updateSceneMap(const std::shared_ptr<Scene> scene);
+    // Задание получает снимок сцены и копию параметров на момент постановки в очередь:
+    // правки в интерфейсе применяются к следующим заданиям, а не к выполняющемуся
+    void drawScene(const std::shared_ptr<Scene> scene, const DrawerSettings &settings, RenderJobPriority priority = RenderJobPriority::Final);
+    void updateSceneMap(const std::shared_ptr<Scene> scene, const DrawerSettings &settings);
+    void cancel();
 signals:
+protected slots:
+    // Переносит счетчики прогресса отрисовщика в виджет
+    void updateProgress();
 protected:
     std::shared_ptr<Drawer> _drawer;
+    RenderJobManager *_jobs;
+    QTimer *_progressTimer;
 };
 
 #endif // DRAWMANAGER_H
@@ -0,0 +1,120 @@
+#include "emitterregistry.h"
+#include <algorithm>
+#include <cmath>
+
+AliasTable::AliasTable(const std::vector<float> &weights)
+{
+    int n = weights.size();
+    double total = 0;
+    for (float w : weights)
+        total += std::max(0.0f, w);
+    if (n == 0 || total <= 0)
+        return;
+
+    _probability.assign(n, 1.0f);
+    _alias.resize(n);
+    _pdf.resize(n);
+
+    // Веса масштабируются к среднему 1 и делятся на недостающие и избыточные
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+    for (int i = 0; i < n; ++i)
+    {
+        _alias[i] = i;
+        _pdf[i] = std::max(0.0f, weights[i]) / total;
+        scaled[i] = _pdf[i] * n;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    // Каждая недостающая ячейка дополняется долей избыточной
+    while (!small.empty() && !large.empty())
+    {
+        int s = small.back();
+        small.pop_back();
+        int l = large.back();
+        large.pop_back();
+
+        _probability[s] = scaled[s];
+        _alias[s] = l;
+        scaled[l] = scaled[l] + scaled[s] - 1.0;
+        (scaled[l] < 1.0 ? small : large).push_back(l);
+    }
+    // Оставшиеся ячейки из-за ошибок округления заполнены полностью
+}
+
+int AliasTable::size() const
+{
+    return _alias.size();
+}
+
+int AliasTable::sample(float u) const
+{
+    int n = _alias.size();
+    float scaled = u * n;
+    int i = std::min(n - 1, (int)scaled);
+    return scaled - i < _probability[i] ? i : _alias[i];
+}
+
+float AliasTable::pdf(int i) const
+{
+    return _pdf[i];
+}
+
+EmitterRegistry::EmitterRegistry(const std::vector<std::shared_ptr<BaseObject>> &objects)
+{
+    for (const auto &o : objects)
+    {
+        float p = emitterPower(*o);
+        if (p <= 0)
+            continue;
+        _emitters.push_back(o.get());
+        _powers.push_back(p);
+    }
+    _table = AliasTable(_powers);
+}
+
+bool EmitterRegistry::empty() const
+{
+    return _emitters.empty();
+}
+
+int EmitterRegistry::size() const
+{
+    return _emitters.size();
+}
+
+const BaseObject *EmitterRegistry::emitter(int i) const
+{
+    return _emitters[i];
+}
+
+float EmitterRegistry::power(int i) const
+{
+    return _powers[i];
+}
+
+float EmitterRegistry::pdf(int i) const
+{
+    return _table.pdf(i);
+}
+
+int EmitterRegistry::sample(float u, float &pdf) const
+{
+    int i = _table.sample(u);
+    pdf = _table.pdf(i);
+    return i;
+}
+
+float EmitterRegistry::emitterPower(const BaseObject &object)
+{
+    const LightColor &emission = object._params._emission;
+    if (emission.intensity <= 0)
+        return 0;
+    float radiance = emission.intensity * (emission.color.x + emission.color.y + emission.color.z) / 3.0f;
+
+    Vec3 point, normal;
+    float pdf = 0;
+    if (object.sampleEmission(0.5f, 0.5f, point, normal, pdf) && pdf > 0)
+        return radiance * M_PI / pdf;
+    return radiance * 4 * M_PI;
+}
@@ -0,0 +1,58 @@
+#ifndef EMITTERREGISTRY_H
+#define EMITTERREGISTRY_H
+
+#include <memory>
+#include <vector>
+#include "baseobject.h"
+
+// Таблица псевдонимов (метод Уолкера в варианте Возе): выбор индекса
+// с вероятностью, пропорциональной весу, за O(1) по одному случайному числу
+class AliasTable
+{
+public:
+    AliasTable() = default;
+    // Отрицательные веса считаются нулевыми; при нулевой сумме таблица пуста
+    explicit AliasTable(const std::vector<float> &weights);
+
+    int size() const;
+    // u из [0, 1)
+    int sample(float u) const;
+    // Вероятность выбора индекса i
+    float pdf(int i) const;
+
+private:
+    std::vector<float> _probability;
+    std::vector<int> _alias;
+    std::vector<float> _pdf;
+};
+
+// Светящиеся объекты сцены и выбор среди них пропорционально мощности.
+// Строится по текущим объектам сцены при построении фотонной карты и заново для каждого кадра,
+// где по нему выбираются источники теневых лучей
+class EmitterRegistry
+{
+public:
+    EmitterRegistry() = default;
+    explicit EmitterRegistry(const std::vector<std::shared_ptr<BaseObject>> &objects);
+
+    bool empty() const;
+    int size() const;
+    const BaseObject *emitter(int i) const;
+    float power(int i) const;
+    float pdf(int i) const;
+
+    // Номер источника по u из [0, 1), pdf — вероятность его выбора
+    int sample(float u, float &pdf) const;
+
+    // Поток источника, усредненный по каналам цвета: π L на площадь излучающей поверхности
+    // или 4π L для точечного источника, где яркость L — интенсивность, умноженная на цвет.
+    // При неравномерном масштабе сетки площадь оценивается по плотности одной выборки
+    static float emitterPower(const BaseObject &object);
+
+private:
+    std::vector<const BaseObject *> _emitters;
+    std::vector<float> _powers;
+    AliasTable _table;
+};
+
+#endif // EMITTERREGISTRY_H
@@ -0,0 +1,315 @@
+#include "grinlens.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+// Смещение начала луча от поверхности при входе и выходе
+const float GRIN_BIAS = 1e-4f;
+// Пределы изменения шага за одну попытку
+const float GRIN_MIN_STEP_SCALE = 0.2f;
+const float GRIN_MAX_STEP_SCALE = 5.0f;
+// Наибольшее число делений пополам при поиске точки выхода
+const int GRIN_BOUNDARY_ITERATIONS = 40;
+
+void tangentBasis(const Vec3 &n, Vec3 &t1, Vec3 &t2)
+{
+    Vec3 a = std::fabs(n.x) > 0.9f ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    t1 = a.cross(n).normalize();
+    t2 = n.cross(t1);
+}
+
+// Новый шаг по оценке ошибки (ошибка нормирована на допуск): ошибка шага пятого порядка растет как h⁵
+float stepScale(float error)
+{
+    if (error <= 0.0f)
+        return GRIN_MAX_STEP_SCALE;
+    return std::clamp(0.9f * std::pow(error, -0.2f), GRIN_MIN_STEP_SCALE, GRIN_MAX_STEP_SCALE);
+}
+
+}
+
+float GrinProfile::index(const Vec3 &local) const
+{
+    float r2 = local.x * local.x + local.y * local.y;
+    return n0 + (radial2 + radial4 * r2) * r2 + (axial1 + axial2 * local.z) * local.z;
+}
+
+Vec3 GrinProfile::gradient(const Vec3 &local) const
+{
+    float r2 = local.x * local.x + local.y * local.y;
+    float radial = 2.0f * radial2 + 4.0f * radial4 * r2;
+    return Vec3(radial * local.x, radial * local.y, axial1 + 2.0f * axial2 * local.z);
+}
+
+GrinLens::GrinLens(const Vec3 &position, const Vec3 &direction, float radius, float length, const GrinProfile &profile, const GraphicParams &params)
+    : _position(position), _direction(direction.normalize()), _radius(radius), _length(length), _profile(profile)
+{
+    _params = params;
+    _params._refractiveIndex = profile.n0;
+    tangentBasis(_direction, _u, _v);
+}
+
+bool GrinLens::intersect(const Ray &ray) const
+{
+    float t;
+    return intersect(ray, t);
+}
+
+bool GrinLens::intersect(const Ray &ray, float &t) const
+{
+    Vec3 o = toLocal(ray.origin - _position);
+    Vec3 d = toLocal(ray.direction);
+    const float inf = std::numeric_limits<float>::max();
+    const float halfLength = 0.5f * _length;
+
+    // Пересечение слоя между торцами
+    float tz0 = -inf, tz1 = inf;
+    if (std::fabs(d.z) > 1e-8f)
+    {
+        tz0 = (-halfLength - o.z) / d.z;
+        tz1 = (halfLength - o.z) / d.z;
+        if (tz0 > tz1)
+            std::swap(tz0, tz1);
+    }
+    else if (std::fabs(o.z) > halfLength)
+    {
+        return false;
+    }
+
+    // Пересечение бесконечного цилиндра
+    float tc0 = -inf, tc1 = inf;
+    float a = d.x * d.x + d.y * d.y;
+    float c = o.x * o.x + o.y * o.y - _radius * _radius;
+    if (a > 1e-12f)
+    {
+        float b = 2.0f * (o.x * d.x + o.y * d.y);
+        float discriminant = b * b - 4.0f * a * c;
+        if (discriminant < 0)
+            return false;
+        float root = std::sqrt(discriminant);
+        tc0 = (-b - root) / (2.0f * a);
+        tc1 = (-b + root) / (2.0f * a);
+    }
+    else if (c > 0)
+    {
+        return false;
+    }
+
+    float tEnter = std::max(tz0, tc0);
+    float tExit = std::min(tz1, tc1);
+    if (tEnter >= tExit || tExit <= 0)
+        return false;
+    t = tEnter > 0 ? tEnter : tExit;
+    return true;
+}
+
+Vec3 GrinLens::position() const
+{
+    return _position;
+}
+
+void GrinLens::setPosition(const Vec3 &position)
+{
+    _position = position;
+}
+
+GraphicParams GrinLens::hitParams(const Ray &ray, float t) const
+{
+    Vec3 local = toLocal(ray.origin + ray.direction * t - _position);
+    GraphicParams result = _params;
+    result._normal = toWorld(surfaceNormal(local));
+    result._refractiveIndex = _profile.index(local);
+    return result;
+}
+
+std::shared_ptr<BaseObject> GrinLens::clone() const
+{
+    return std::make_shared<GrinLens>(*this);
+}
+
+Aabb GrinLens::bounds() const
+{
+    Aabb box;
+    for (int i = 0; i < 8; ++i)
+    {
+        Vec3 corner((i & 1) ? _radius : -_radius, (i & 2) ? _radius : -_radius, (i & 4) ? 0.5f * _length : -0.5f * _length);
+        box.expand(_position + toWorld(corner));
+    }
+    return box;
+}
+
+bool GrinLens::hasInterior() const
+{
+    return true;
+}
+
+bool GrinLens::traceInterior(Ray &ray, float t, Vec3 &weight) const
+{
+    int stepsNum = 0;
+    return traceInterior(ray, t, weight, stepsNum);
+}
+
+bool GrinLens::traceInterior(Ray &ray, float t, Vec3 &weight, int &stepsNum) const
+{
+    stepsNum = 0;
+    Vec3 entry = toLocal(ray.origin + ray.direction * t - _position);
+    Vec3 direction = toLocal(ray.direction);
+    Vec3 normal = surfaceNormal(entry);
+    if (direction.dot(normal) >= 0.0f)
+        return false;
+
+    // Вход: преломление на границе с показателем среды в точке входа
+    float index = _profile.index(entry);
+    Vec3 refracted = Vec3::refract(direction, normal, 1.0f, index).normalize();
+    weight *= _params._color * (1.0f - Vec3::fresnel(direction, normal, index));
+
+    State state = {entry + refracted * GRIN_BIAS, refracted * index};
+    State k1 = derivative(state);
+    const float size = _radius + _length;
+    const float maxStep = size / _profile.n0;
+    float h = 0.1f * maxStep;
+
+    for (int attempt = 0; attempt < GRIN_MAX_STEPS; ++attempt)
+    {
+        float error;
+        State k7;
+        State next = step(state, k1, h, error, k7);
+        if (error > 1.0f)
+        {
+            h *= stepScale(error);
+            continue;
+        }
+
+        if (outside(next.x) <= 0.0f)
+        {
+            state = next;
+            k1 = k7;
+            ++stepsNum;
+            h = std::min(maxStep, h * stepScale(error));
+            continue;
+        }
+
+        // Шаг выводит луч наружу: точка выхода ищется делением шага пополам
+        float lo = 0.0f, hi = h;
+        State boundary = state;
+        for (int i = 0; i < GRIN_BOUNDARY_ITERATIONS && outside(boundary.x) < -GRIN_TOLERANCE * size; ++i)
+        {
+            float mid = 0.5f * (lo + hi);
+            float midError;
+            State midK7;
+            State midState = step(state, k1, mid, midError, midK7);
+            if (outside(midState.x) > 0.0f)
+            {
+                hi = mid;
+            }
+            else
+            {
+                lo = mid;
+                boundary = midState;
+            }
+        }
+        ++stepsNum;
+
+        Vec3 exitNormal = surfaceNormal(boundary.x);
+        Vec3 exitDirection = boundary.t.normalize();
+        float exitIndex = _profile.index(boundary.x);
+        Vec3 out = Vec3::refract(exitDirection, exitNormal, 1.0f, exitIndex);
+        if (out.lengthSquared() == 0.0f)
+        {
+            // Полное внутреннее отражение: луч остается в среде
+            Vec3 reflected = Vec3::reflect(exitDirection, exitNormal);
+            state = {boundary.x - exitNormal * GRIN_BIAS, reflected * boundary.t.length()};
+            k1 = derivative(state);
+            continue;
+        }
+
+        weight *= 1.0f - Vec3::fresnel(exitDirection, exitNormal, exitIndex);
+        out = toWorld(out.normalize());
+        Ray exitRay(_position + toWorld(boundary.x) + out * GRIN_BIAS, out);
+        exitRay.wavelength = ray.wavelength;
+        ray = exitRay;
+        return true;
+    }
+    return false;
+}
+
+Vec3 GrinLens::direction() const
+{
+    return _direction;
+}
+
+float GrinLens::radius() const
+{
+    return _radius;
+}
+
+float GrinLens::length() const
+{
+    return _length;
+}
+
+const GrinProfile &GrinLens::profile() const
+{
+    return _profile;
+}
+
+GrinLens::State GrinLens::derivative(const State &state) const
+{
+    // dr/dτ = T, dT/dτ = n ∇n
+    return {state.t, _profile.gradient(state.x) * _profile.index(state.x)};
+}
+
+GrinLens::State GrinLens::step(const State &s, const State &k1, float h, float &error, State &k7) const
+{
+    // Таблица Бутчера схемы Дорманда — Принса; k7 вычисляется в новой точке и служит k1 следующего шага
+    auto at = [&](float a1, float a2, float a3, float a4, float a5, float a6,
+                  const State &d2, const State &d3, const State &d4, const State &d5, const State &d6) {
+        State r;
+        r.x = s.x + (k1.x * a1 + d2.x * a2 + d3.x * a3 + d4.x * a4 + d5.x * a5 + d6.x * a6) * h;
+        r.t = s.t + (k1.t * a1 + d2.t * a2 + d3.t * a3 + d4.t * a4 + d5.t * a5 + d6.t * a6) * h;
+        return r;
+    };
+    const State zero = {Vec3(0, 0, 0), Vec3(0, 0, 0)};
+
+    State k2 = derivative(at(1.0f / 5, 0, 0, 0, 0, 0, zero, zero, zero, zero, zero));
+    State k3 = derivative(at(3.0f / 40, 9.0f / 40, 0, 0, 0, 0, k2, zero, zero, zero, zero));
+    State k4 = derivative(at(44.0f / 45, -56.0f / 15, 32.0f / 9, 0, 0, 0, k2, k3, zero, zero, zero));
+    State k5 = derivative(at(19372.0f / 6561, -25360.0f / 2187, 64448.0f / 6561, -212.0f / 729, 0, 0, k2, k3, k4, zero, zero));
+    State k6 = derivative(at(9017.0f / 3168, -355.0f / 33, 46732.0f / 5247, 49.0f / 176, -5103.0f / 18656, 0, k2, k3, k4, k5, zero));
+    State next = at(35.0f / 384, 0, 500.0f / 1113, 125.0f / 192, -2187.0f / 6784, 11.0f / 84, k2, k3, k4, k5, k6);
+    k7 = derivative(next);
+
+    // Разность решений пятого и четвертого порядков
+    const float e1 = 71.0f / 57600, e3 = -71.0f / 16695, e4 = 71.0f / 1920, e5 = -17253.0f / 339200, e6 = 22.0f / 525, e7 = -1.0f / 40;
+    Vec3 errorX = (k1.x * e1 + k3.x * e3 + k4.x * e4 + k5.x * e5 + k6.x * e6 + k7.x * e7) * h;
+    Vec3 errorT = (k1.t * e1 + k3.t * e3 + k4.t * e4 + k5.t * e5 + k6.t * e6 + k7.t * e7) * h;
+    const float tolerance = GRIN_TOLERANCE * (_radius + _length);
+    error = std::max(errorX.length() / tolerance, errorT.length() / (GRIN_TOLERANCE * _profile.n0));
+    return next;
+}
+
+float GrinLens::outside(const Vec3 &local) const
+{
+    return std::max(std::sqrt(local.x * local.x + local.y * local.y) - _radius, std::fabs(local.z) - 0.5f * _length);
+}
+
+Vec3 GrinLens::surfaceNormal(const Vec3 &local) const
+{
+    float r = std::sqrt(local.x * local.x + local.y * local.y);
+    if (_radius - r < 0.5f * _length - std::fabs(local.z) && r > 0.0f)
+        return Vec3(local.x / r, local.y / r, 0);
+    return Vec3(0, 0, local.z >= 0 ? 1.0f : -1.0f);
+}
+
+Vec3 GrinLens::toLocal(const Vec3 &v) const
+{
+    return Vec3(v.dot(_u), v.dot(_v), v.dot(_direction));
+}
+
+Vec3 GrinLens::toWorld(const Vec3 &v) const
+{
+    return _u * v.x + _v * v.y + _direction * v.z;
+}
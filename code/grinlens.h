@@ -0,0 +1,84 @@
+#ifndef GRINLENS_H
+#define GRINLENS_H
+
+#include "baseobject.h"
+#include "primitives.h"
+
+// Распределение показателя преломления в градиентной среде по расстоянию r от оси и координате z вдоль нее
+// (z отсчитывается от центра объекта): n(r, z) = n0 + radial2 r² + radial4 r⁴ + axial1 z + axial2 z².
+// Параболический стержень n0 (1 - A r² / 2) задается radial2 = -n0 A / 2, его период P = 2π / sqrt(A)
+struct GrinProfile
+{
+    float n0 = 1.5f;
+    float radial2 = 0;
+    float radial4 = 0;
+    float axial1 = 0;
+    float axial2 = 0;
+
+    // Аргументы — точка в локальных координатах (ось z вдоль оси объекта)
+    float index(const Vec3 &local) const;
+    Vec3 gradient(const Vec3 &local) const;
+};
+
+// Градиентная линза: цилиндр радиуса radius и длины length вдоль direction с центром в position,
+// показатель преломления внутри задан GrinProfile. Внутри среды луч искривляется по уравнению
+// d/ds (n dr/ds) = ∇n, которое интегрируется методом Рунге — Кутты 5(4) Дорманда — Принса
+// с адаптивным шагом: в почти однородной среде шаг растет до размеров объекта.
+// На выходе луч преломляется с потерями по Френелю, при полном внутреннем отражении отражается и продолжает путь внутри
+class GrinLens : public BaseObject
+{
+public:
+    // Допустимая ошибка шага по положению в долях размера объекта
+    static constexpr float GRIN_TOLERANCE = 1e-5f;
+    // Наибольшее число шагов интегратора на один проход луча
+    static const int GRIN_MAX_STEPS = 4096;
+
+    GrinLens(const Vec3 &position, const Vec3 &direction, float radius, float length, const GrinProfile &profile, const GraphicParams &params);
+
+    virtual bool intersect(const Ray &ray) const override;
+    virtual bool intersect(const Ray &ray, float &t) const override;
+
+    virtual Vec3 position() const override;
+    virtual void setPosition(const Vec3 &position) override;
+    // _refractiveIndex — показатель среды у поверхности в точке попадания
+    virtual GraphicParams hitParams(const Ray &ray, float t) const override;
+    virtual Aabb bounds() const override;
+    virtual std::shared_ptr<BaseObject> clone() const override;
+
+    virtual bool hasInterior() const override;
+    virtual bool traceInterior(Ray &ray, float t, Vec3 &weight) const override;
+    // То же с числом принятых шагов интегратора
+    bool traceInterior(Ray &ray, float t, Vec3 &weight, int &stepsNum) const;
+
+    Vec3 direction() const;
+    float radius() const;
+    float length() const;
+    const GrinProfile &profile() const;
+
+private:
+    // Состояние луча: положение и оптический вектор T = n dr/ds в локальных координатах
+    struct State
+    {
+        Vec3 x;
+        Vec3 t;
+    };
+
+    State derivative(const State &state) const;
+    // Шаг Дорманда — Принса длины h по параметру τ (ds = n dτ) от state с производной k1 в нем.
+    // error — ошибка по встроенной схеме 4-го порядка в долях допуска, k7 — производная в новой точке
+    State step(const State &state, const State &k1, float h, float &error, State &k7) const;
+    // > 0 снаружи цилиндра, < 0 внутри
+    float outside(const Vec3 &local) const;
+    Vec3 surfaceNormal(const Vec3 &local) const;
+    Vec3 toLocal(const Vec3 &v) const;
+    Vec3 toWorld(const Vec3 &v) const;
+
+    Vec3 _position;
+    Vec3 _direction;
+    Vec3 _u, _v;
+    float _radius;
+    float _length;
+    GrinProfile _profile;
+};
+
+#endif // GRINLENS_H
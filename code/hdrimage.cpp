@@ -0,0 +1,32 @@
+#include "hdrimage.h"
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+void writePfm(const HdrImage &image, const std::string &path)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("Unable to open file: " + path);
+
+    // Отрицательный масштаб в заголовке означает порядок байтов little-endian
+    uint16_t probe = 1;
+    bool littleEndian = *reinterpret_cast<const uint8_t *>(&probe) == 1;
+    out << "PF\n" << image.width << " " << image.height << "\n" << (littleEndian ? "-1.0" : "1.0") << "\n";
+
+    std::vector<float> row(image.width * 3);
+    for (int y = image.height - 1; y >= 0; --y)
+    {
+        for (int x = 0; x < image.width; ++x)
+        {
+            const Vec3 &p = image.pixels[y * image.width + x];
+            row[x * 3] = p.x;
+            row[x * 3 + 1] = p.y;
+            row[x * 3 + 2] = p.z;
+        }
+        out.write(reinterpret_cast<const char *>(row.data()), row.size() * sizeof(float));
+    }
+
+    if (!out)
+        throw std::runtime_error("Unable to write file: " + path);
+}
@@ -0,0 +1,19 @@
+#ifndef HDRIMAGE_H
+#define HDRIMAGE_H
+
+#include <string>
+#include <vector>
+#include "primitives.h"
+
+// Кадр в линейных значениях без ограничения и гамма-коррекции, строки сверху вниз
+struct HdrImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<Vec3> pixels;
+};
+
+// Запись в Portable Float Map (RGB, 32 бита на канал, строки снизу вверх); исключение при ошибке записи
+void writePfm(const HdrImage &image, const std::string &path);
+
+#endif // HDRIMAGE_H
@@ -0,0 +1,240 @@
+#include "irradiancecache.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace
+{
+
+const float PI = 3.14159265358979f;
+// Наибольшая глубина октодерева
+const int MAX_OCTREE_DEPTH = 20;
+
+void tangentBasis(const Vec3 &n, Vec3 &t1, Vec3 &t2)
+{
+    Vec3 a = std::fabs(n.x) > 0.9f ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    t1 = a.cross(n).normalize();
+    t2 = n.cross(t1);
+}
+
+float channel(const Vec3 &v, int c)
+{
+    return c == 0 ? v.x : (c == 1 ? v.y : v.z);
+}
+
+}
+
+bool IrradianceCacheSettings::operator==(const IrradianceCacheSettings &other) const
+{
+    return accuracy == other.accuracy && gatherRadius == other.gatherRadius &&
+           filterConstant == other.filterConstant && gatherRays == other.gatherRays;
+}
+
+IrradianceCache::IrradianceCache(const Aabb &bounds, const IrradianceCacheSettings &settings)
+    : _settings(settings)
+{
+    // Корень — куб, описанный вокруг границ сцены
+    Vec3 center = bounds.center();
+    Vec3 e = bounds.extent();
+    float half = std::max(e.x, std::max(e.y, e.z)) * 0.5f * 1.01f + 1e-4f;
+    _root.box = Aabb(center - Vec3(half, half, half), center + Vec3(half, half, half));
+}
+
+Aabb IrradianceCache::childBox(const Aabb &box, int child)
+{
+    Vec3 c = box.center();
+    Vec3 min((child & 1) ? c.x : box.min.x, (child & 2) ? c.y : box.min.y, (child & 4) ? c.z : box.min.z);
+    Vec3 max((child & 1) ? box.max.x : c.x, (child & 2) ? box.max.y : c.y, (child & 4) ? box.max.z : c.z);
+    return Aabb(min, max);
+}
+
+bool IrradianceCache::insert(const IrradianceRecord &record)
+{
+    const Vec3 &p = record.position;
+    if (p.x < _root.box.min.x || p.y < _root.box.min.y || p.z < _root.box.min.z ||
+        p.x > _root.box.max.x || p.y > _root.box.max.y || p.z > _root.box.max.z)
+        return false;
+
+    // Запись опускается до самого мелкого узла, свободные границы которого (вдвое больше узла)
+    // еще покрывают всю область ее влияния радиуса accuracy * R
+    float influence = _settings.accuracy * record.radius;
+
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    Node *node = &_root;
+    for (int depth = 0; depth < MAX_OCTREE_DEPTH; ++depth)
+    {
+        float childSide = node->box.extent().x * 0.5f;
+        if (childSide < 2.0f * influence)
+            break;
+
+        Vec3 c = node->box.center();
+        int child = (p.x >= c.x ? 1 : 0) | (p.y >= c.y ? 2 : 0) | (p.z >= c.z ? 4 : 0);
+        if (!node->children[child])
+        {
+            node->children[child] = std::make_unique<Node>();
+            node->children[child]->box = childBox(node->box, child);
+        }
+        node = node->children[child].get();
+    }
+    node->records.push_back(record);
+    ++_size;
+    return true;
+}
+
+bool IrradianceCache::lookup(const Vec3 &position, const Vec3 &normal, Vec3 &irradiance) const
+{
+    Vec3 sum(0, 0, 0);
+    float weightSum = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        lookupRecursive(_root, position, normal, sum, weightSum);
+    }
+    if (weightSum <= 0)
+        return false;
+
+    irradiance = sum / weightSum;
+    return true;
+}
+
+void IrradianceCache::lookupRecursive(const Node &node, const Vec3 &position, const Vec3 &normal, Vec3 &sum, float &weightSum) const
+{
+    for (const auto &record : node.records)
+    {
+        Vec3 offset = position - record.position;
+
+        // Запись перед точкой (по нормали) не описывает ее освещение
+        if (offset.dot((normal + record.normal) * 0.5f) < -0.05f * record.radius)
+            continue;
+
+        float error = offset.length() / record.radius + std::sqrt(std::max(0.0f, 1.0f - normal.dot(record.normal)));
+        if (error >= _settings.accuracy)
+            continue;
+        float weight = error > 1e-6f ? 1.0f / error : 1e6f;
+
+        // Экстраполяция с градиентами поворота и переноса
+        Vec3 rotation = record.normal.cross(normal);
+        Vec3 value(std::max(0.0f, record.irradiance.x + rotation.dot(record.rotationalGradient[0]) + offset.dot(record.translationalGradient[0])),
+                   std::max(0.0f, record.irradiance.y + rotation.dot(record.rotationalGradient[1]) + offset.dot(record.translationalGradient[1])),
+                   std::max(0.0f, record.irradiance.z + rotation.dot(record.rotationalGradient[2]) + offset.dot(record.translationalGradient[2])));
+        sum += value * weight;
+        weightSum += weight;
+    }
+
+    for (const auto &child : node.children)
+    {
+        if (!child)
+            continue;
+        // Свободные границы потомка: его куб, расширенный на половину стороны
+        float margin = child->box.extent().x * 0.5f;
+        const Aabb &b = child->box;
+        if (position.x >= b.min.x - margin && position.x <= b.max.x + margin &&
+            position.y >= b.min.y - margin && position.y <= b.max.y + margin &&
+            position.z >= b.min.z - margin && position.z <= b.max.z + margin)
+            lookupRecursive(*child, position, normal, sum, weightSum);
+    }
+}
+
+int IrradianceCache::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    return _size;
+}
+
+const Aabb &IrradianceCache::bounds() const
+{
+    return _root.box;
+}
+
+const IrradianceCacheSettings &IrradianceCache::settings() const
+{
+    return _settings;
+}
+
+Vec3 IrradianceCache::hemisphereDirection(const Vec3 &normal, int j, int k, int thetaSteps, int phiSteps, float u, float v)
+{
+    Vec3 t1, t2;
+    tangentBasis(normal, t1, t2);
+    float sinTheta = std::sqrt((j + u) / thetaSteps);
+    float cosTheta = std::sqrt(std::max(0.0f, 1.0f - sinTheta * sinTheta));
+    float phi = 2.0f * PI * (k + v) / phiSteps;
+    return t1 * (std::cos(phi) * sinTheta) + t2 * (std::sin(phi) * sinTheta) + normal * cosTheta;
+}
+
+IrradianceRecord IrradianceCache::makeRecord(const Vec3 &position, const Vec3 &normal, const std::vector<GatherSample> &samples,
+                                             int thetaSteps, int phiSteps, float minRadius, float maxRadius)
+{
+    const int M = thetaSteps;
+    const int N = phiSteps;
+    auto L = [&](int j, int k) -> const Vec3 & { return samples[j * N + (k + N) % N].radiance; };
+    auto r = [&](int j, int k) { return samples[j * N + (k + N) % N].distance; };
+
+    Vec3 t1, t2;
+    tangentBasis(normal, t1, t2);
+
+    IrradianceRecord record;
+    record.position = position;
+    record.normal = normal;
+    record.irradiance = Vec3(0, 0, 0);
+
+    // При выборке по косинусу освещенность / pi — среднее яркостей, радиус — гармоническое среднее расстояний
+    float inverseDistanceSum = 0;
+    for (const auto &s : samples)
+    {
+        record.irradiance += s.radiance;
+        inverseDistanceSum += 1.0f / std::max(s.distance, 1e-6f);
+    }
+    record.irradiance /= M * N;
+    float radius = inverseDistanceSum > 0 ? (M * N) / inverseDistanceSum : maxRadius;
+
+    for (int c = 0; c < 3; ++c)
+    {
+        record.rotationalGradient[c] = Vec3(0, 0, 0);
+        record.translationalGradient[c] = Vec3(0, 0, 0);
+    }
+
+    // Градиенты Уорда-Хекберта (все величины поделены на pi, как и освещенность)
+    for (int k = 0; k < N; ++k)
+    {
+        float phi = 2.0f * PI * (k + 0.5f) / N;
+        float phiMinus = 2.0f * PI * k / N;
+        Vec3 u = t1 * std::cos(phi) + t2 * std::sin(phi);
+        Vec3 v = t2 * std::cos(phi) - t1 * std::sin(phi);
+        Vec3 vMinus = t2 * std::cos(phiMinus) - t1 * std::sin(phiMinus);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            float rotation = 0;
+            float acrossTheta = 0;
+            float acrossPhi = 0;
+            for (int j = 0; j < M; ++j)
+            {
+                float sinTheta = std::sqrt((j + 0.5f) / M);
+                float tanTheta = sinTheta / std::sqrt(std::max(1e-6f, 1.0f - sinTheta * sinTheta));
+                float sinMinus = std::sqrt(float(j) / M);
+                float cosMinus = std::sqrt(1.0f - sinMinus * sinMinus);
+                float cosPlus = std::sqrt(std::max(0.0f, 1.0f - float(j + 1) / M));
+
+                rotation -= tanTheta * channel(L(j, k), c);
+
+                if (j > 0)
+                    acrossTheta += sinMinus * cosMinus * cosMinus / std::min(r(j, k), r(j - 1, k)) *
+                                   (channel(L(j, k), c) - channel(L(j - 1, k), c));
+
+                acrossPhi += (cosMinus - cosPlus) / (sinTheta * std::min(r(j, k), r(j, k - 1))) *
+                             (channel(L(j, k), c) - channel(L(j, k - 1), c));
+            }
+            record.rotationalGradient[c] += v * (rotation / (M * N));
+            record.translationalGradient[c] += u * (acrossTheta * 2.0f / N) + vMinus * (acrossPhi / PI);
+        }
+    }
+
+    // Ограничение радиуса по градиенту, чтобы экстраполяция не уводила освещенность в минус
+    for (int c = 0; c < 3; ++c)
+    {
+        float gradient = record.translationalGradient[c].length();
+        if (gradient > 0)
+            radius = std::min(radius, channel(record.irradiance, c) / gradient);
+    }
+    record.radius = std::min(std::max(radius, minRadius), maxRadius);
+    return record;
+}
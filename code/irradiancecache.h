@@ -0,0 +1,80 @@
+#ifndef IRRADIANCECACHE_H
+#define IRRADIANCECACHE_H
+
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+#include "primitives.h"
+
+// Запись кэша освещенности: освещенность (деленная на pi) в точке с нормалью,
+// гармоническое среднее расстояние до окружающих поверхностей и градиенты по Уорду-Хекберту
+struct IrradianceRecord
+{
+    Vec3 position;
+    Vec3 normal;
+    Vec3 irradiance;
+    float radius = 0;
+    // Градиенты отдельно для каждого канала цвета
+    Vec3 rotationalGradient[3];
+    Vec3 translationalGradient[3];
+};
+
+// Результат одного луча финального сбора: яркость, пришедшая по направлению, и расстояние до попадания
+struct GatherSample
+{
+    Vec3 radiance;
+    float distance;
+};
+
+// Параметры, при которых посчитаны записи кэша: при их смене кэш строится заново
+struct IrradianceCacheSettings
+{
+    float accuracy = 0.25f;
+    float gatherRadius = 0;
+    double filterConstant = 1;
+    int gatherRays = 0;
+
+    bool operator==(const IrradianceCacheSettings &other) const;
+};
+
+// Кэш освещенности Уорда: записи хранятся в свободном октодереве и интерполируются
+// с весами 1 / (|p - p_i| / R_i + sqrt(1 - n * n_i)) с учетом градиентов.
+// Поиск и вставка потокобезопасны: чтение под разделяемой блокировкой, вставка под исключительной
+class IrradianceCache
+{
+public:
+    IrradianceCache(const Aabb &bounds, const IrradianceCacheSettings &settings);
+
+    // Интерполированная освещенность в точке; false, если ни одна запись не применима
+    bool lookup(const Vec3 &position, const Vec3 &normal, Vec3 &irradiance) const;
+    // Записи вне границ кэша не сохраняются
+    bool insert(const IrradianceRecord &record);
+
+    int size() const;
+    const Aabb &bounds() const;
+    const IrradianceCacheSettings &settings() const;
+
+    // Направление сэмпла (j, k) стратифицированной по косинусу полусферы M x N вокруг normal
+    static Vec3 hemisphereDirection(const Vec3 &normal, int j, int k, int thetaSteps, int phiSteps, float u, float v);
+    // Запись по результатам сбора; samples упорядочены как j * phiSteps + k
+    static IrradianceRecord makeRecord(const Vec3 &position, const Vec3 &normal, const std::vector<GatherSample> &samples,
+                                       int thetaSteps, int phiSteps, float minRadius, float maxRadius);
+
+private:
+    struct Node
+    {
+        Aabb box;
+        std::unique_ptr<Node> children[8];
+        std::vector<IrradianceRecord> records;
+    };
+
+    void lookupRecursive(const Node &node, const Vec3 &position, const Vec3 &normal, Vec3 &sum, float &weightSum) const;
+    static Aabb childBox(const Aabb &box, int child);
+
+    Node _root;
+    IrradianceCacheSettings _settings;
+    int _size = 0;
+    mutable std::shared_mutex _mutex;
+};
+
+#endif // IRRADIANCECACHE_H
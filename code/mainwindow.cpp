@@ -61,12 +61,15 @@ MainWindow::MainWindow(QWidget *parent)
     model.rotate(Vec3(1,0,0),0);
     model.rotate(Vec3(0,0,1), 0);
     model.rotate(Vec3(0,1,0), 0);
-    model.scale(0.15);
+    // Отрицательный масштаб отражает модель относительно центра: так DR.obj выводился всегда
+    model.scale(-0.15);
     _sceneManager->addObject(std::make_shared<PolygonalModel>(model));
 
 
     auto s = std::make_shared<Sphere>(Vec3(4,0,0), 1, Vec3(1,1,0));
-    s->_params._emission = {Vec3(1,1,1), 1};
+    // Яркость источника убывает с расстоянием как R² / d²: у объектов в четырех радиусах от него
+    // освещенность такая же, как прежде давала единичная интенсивность без затухания
+    s->_params._emission = {Vec3(1,1,1), 16};
     _sceneManager->addObject(s);
 
     s = std::make_shared<Sphere>(Vec3(-1.5,0,0), 1, Vec3(1,1,0), 1, 1.2,0);
@@ -77,16 +80,21 @@ MainWindow::MainWindow(QWidget *parent)
 
     _sceneManager->setCamera(std::make_shared<Camera>(Vec3(0,0,-10), Vec3(0,0,1), 1, 45));
 
-    _drawManager->drawScene(_sceneManager->getScene());
+    _drawManager->drawScene(_sceneManager->getScene(), _sceneWidget->drawerSettings(), RenderJobPriority::Preview);
 }
 MainWindow::~MainWindow() {}
 
 void MainWindow::updateMap()
 {
-    _drawManager->updateSceneMap(_sceneManager->getScene());
+    // Новая карта сразу показывается черновым кадром
+    DrawerSettings settings = _sceneWidget->drawerSettings();
+    _drawManager->updateSceneMap(_sceneManager->getScene(), settings);
+    _drawManager->drawScene(_sceneManager->getScene(), settings, RenderJobPriority::Preview);
 }
 
 void MainWindow::renderFrame()
 {
-    _drawManager->drawScene(_sceneManager->getScene());
+    DrawerSettings settings = _sceneWidget->drawerSettings();
+    _drawManager->drawScene(_sceneManager->getScene(), settings, RenderJobPriority::Preview);
+    _drawManager->drawScene(_sceneManager->getScene(), settings);
 }
@@ -0,0 +1,143 @@
+#include "mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+Mesh::Mesh(std::vector<Vec3> vertices, std::vector<uint32_t> indices, std::vector<Vec3> faceNormals)
+    : _vertices(std::move(vertices)), _indices(std::move(indices)), _faceNormals(std::move(faceNormals))
+{
+    if (_indices.size() % 3 != 0)
+        throw std::runtime_error("Mesh: number of indices is not a multiple of 3");
+    if (!_faceNormals.empty() && _faceNormals.size() != _indices.size() / 3)
+        throw std::runtime_error("Mesh: number of face normals does not match number of triangles");
+    for (Vec3 &n : _faceNormals)
+        n = n.normalize();
+    for (uint32_t index : _indices)
+    {
+        if (index >= _vertices.size())
+            throw std::runtime_error("Mesh: vertex index out of range");
+    }
+
+    int count = trianglesNum();
+    std::vector<Aabb> boxes(count);
+    _areaCdf.resize(count);
+    float area = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const Vec3 &v0 = _vertices[_indices[3 * i]];
+        const Vec3 &v1 = _vertices[_indices[3 * i + 1]];
+        const Vec3 &v2 = _vertices[_indices[3 * i + 2]];
+        boxes[i].expand(v0);
+        boxes[i].expand(v1);
+        boxes[i].expand(v2);
+        _bounds.expand(boxes[i]);
+        area += 0.5f * (v1 - v0).cross(v2 - v0).length();
+        _areaCdf[i] = area;
+    }
+    _bvh.build(boxes, MESH_LEAF_SIZE);
+}
+
+std::shared_ptr<Mesh> Mesh::fromPolygons(const std::vector<Polygon> &polygons)
+{
+    std::vector<Vec3> vertices;
+    std::vector<uint32_t> indices;
+    vertices.reserve(3 * polygons.size());
+    indices.reserve(3 * polygons.size());
+    for (const Polygon &polygon : polygons)
+    {
+        for (const Vec3 &v : {polygon.v0, polygon.v1, polygon.v2})
+        {
+            indices.push_back(static_cast<uint32_t>(vertices.size()));
+            vertices.push_back(v);
+        }
+    }
+    return std::make_shared<Mesh>(std::move(vertices), std::move(indices));
+}
+
+int Mesh::trianglesNum() const
+{
+    return static_cast<int>(_indices.size() / 3);
+}
+
+const std::vector<Vec3> &Mesh::vertices() const
+{
+    return _vertices;
+}
+
+const std::vector<uint32_t> &Mesh::indices() const
+{
+    return _indices;
+}
+
+const std::vector<Vec3> &Mesh::faceNormals() const
+{
+    return _faceNormals;
+}
+
+const Aabb &Mesh::bounds() const
+{
+    return _bounds;
+}
+
+float Mesh::area() const
+{
+    return _areaCdf.empty() ? 0.0f : _areaCdf.back();
+}
+
+bool Mesh::closestHit(const Ray &ray, float tMax, MeshHit &hit) const
+{
+    float closest = tMax;
+    int triangle = -1;
+    _bvh.traverse(
+        [&](const Aabb &box) { return !box.intersect(ray, closest); },
+        [&](int index)
+        {
+            float t;
+            const uint32_t *corners = &_indices[3 * index];
+            if (intersectTriangle(_vertices[corners[0]], _vertices[corners[1]], _vertices[corners[2]], ray, t) && t < closest)
+            {
+                closest = t;
+                triangle = index;
+            }
+        });
+
+    if (triangle < 0)
+        return false;
+    hit.t = closest;
+    hit.triangle = triangle;
+    return true;
+}
+
+Vec3 Mesh::normal(int triangle) const
+{
+    if (!_faceNormals.empty())
+        return _faceNormals[triangle];
+    return geometricNormal(triangle);
+}
+
+Vec3 Mesh::geometricNormal(int triangle) const
+{
+    const Vec3 &v0 = _vertices[_indices[3 * triangle]];
+    const Vec3 &v1 = _vertices[_indices[3 * triangle + 1]];
+    const Vec3 &v2 = _vertices[_indices[3 * triangle + 2]];
+    return (v1 - v0).cross(v2 - v0).normalize();
+}
+
+void Mesh::samplePoint(float u1, float u2, Vec3 &point, Vec3 &normal) const
+{
+    // Треугольник выбирается двоичным поиском по накопленной площади, остаток u1 переиспользуется внутри него
+    float target = u1 * area();
+    int triangle = static_cast<int>(std::upper_bound(_areaCdf.begin(), _areaCdf.end(), target) - _areaCdf.begin());
+    triangle = std::min(triangle, trianglesNum() - 1);
+    float start = triangle > 0 ? _areaCdf[triangle - 1] : 0.0f;
+    float size = _areaCdf[triangle] - start;
+    float u = size > 0 ? std::min((target - start) / size, 1.0f) : 0.0f;
+
+    const Vec3 &v0 = _vertices[_indices[3 * triangle]];
+    const Vec3 &v1 = _vertices[_indices[3 * triangle + 1]];
+    const Vec3 &v2 = _vertices[_indices[3 * triangle + 2]];
+    float su = std::sqrt(u);
+    point = v0 * (1.0f - su) + v1 * (su * (1.0f - u2)) + v2 * (su * u2);
+    normal = geometricNormal(triangle);
+}
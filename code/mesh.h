@@ -0,0 +1,86 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "bvh.h"
+#include "polygon.h"
+#include "primitives.h"
+
+// Пересечение луча с треугольником (Мёллер — Трумбор), с теми же допусками, что и Polygon::intersect.
+// Определено в заголовке, чтобы встраиваться в циклы по треугольникам
+inline bool intersectTriangle(const Vec3 &v0, const Vec3 &v1, const Vec3 &v2, const Ray &ray, float &t)
+{
+    Vec3 edge1 = v1 - v0;
+    Vec3 edge2 = v2 - v0;
+    Vec3 h = ray.direction.cross(edge2);
+    float a = edge1.dot(h);
+
+    if (std::fabs(a) < 1e-6f)
+        return false;
+
+    float f = 1.0f / a;
+    Vec3 s = ray.origin - v0;
+    float u = f * s.dot(h);
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    Vec3 q = s.cross(edge1);
+    float v = f * ray.direction.dot(q);
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = f * edge2.dot(q);
+    return t > 1e-6f;
+}
+
+struct MeshHit
+{
+    float t = 0;
+    int triangle = -1;
+};
+
+// Треугольная сетка в собственной системе координат с BVH по треугольникам.
+// Неизменяема после построения, поэтому одна сетка разделяется любым числом экземпляров (MeshInstance)
+class Mesh
+{
+public:
+    // Число треугольников в листе BVH
+    static const int MESH_LEAF_SIZE = 4;
+
+    Mesh() = default;
+    // Треугольник i — вершины indices[3i], indices[3i + 1], indices[3i + 2].
+    // faceNormals — по нормали на треугольник (например, из записей vn OBJ) или пусто: тогда нормаль считается по вершинам
+    Mesh(std::vector<Vec3> vertices, std::vector<uint32_t> indices, std::vector<Vec3> faceNormals = {});
+
+    static std::shared_ptr<Mesh> fromPolygons(const std::vector<Polygon> &polygons);
+
+    int trianglesNum() const;
+    const std::vector<Vec3> &vertices() const;
+    const std::vector<uint32_t> &indices() const;
+    const std::vector<Vec3> &faceNormals() const;
+    const Aabb &bounds() const;
+    float area() const;
+
+    // Ближайшее пересечение с t < tMax; направление луча не обязано быть единичным
+    bool closestHit(const Ray &ray, float tMax, MeshHit &hit) const;
+    // Нормаль для освещения: заданная в faceNormals, если они есть, иначе геометрическая
+    Vec3 normal(int triangle) const;
+    // Нормаль плоскости треугольника по его вершинам
+    Vec3 geometricNormal(int triangle) const;
+    // Точка, равномерно распределенная по площади сетки, и геометрическая нормаль в ней
+    void samplePoint(float u1, float u2, Vec3 &point, Vec3 &normal) const;
+
+private:
+    std::vector<Vec3> _vertices;
+    std::vector<uint32_t> _indices;
+    std::vector<Vec3> _faceNormals;
+    Bvh _bvh;
+    Aabb _bounds;
+    // Нарастающие суммы площадей треугольников для выборки по площади
+    std::vector<float> _areaCdf;
+};
+
+#endif // MESH_H
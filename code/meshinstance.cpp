@@ -0,0 +1,158 @@
+#include "meshinstance.h"
+#include <cmath>
+#include <limits>
+
+MeshInstance::MeshInstance(const std::shared_ptr<const Mesh> &mesh, const Transform &toWorld, const GraphicParams &params)
+    : _mesh(mesh)
+{
+    _params = params;
+    setTransform(toWorld);
+}
+
+Ray MeshInstance::toLocal(const Ray &ray) const
+{
+    Ray local = ray;
+    local.origin = _toLocal.point(ray.origin);
+    local.direction = _toLocal.vector(ray.direction);
+    return local;
+}
+
+bool MeshInstance::intersect(const Ray &ray) const
+{
+    float t;
+    return intersect(ray, t);
+}
+
+bool MeshInstance::intersect(const Ray &ray, float &t) const
+{
+    MeshHit hit;
+    if (!_mesh->closestHit(toLocal(ray), std::numeric_limits<float>::max(), hit))
+        return false;
+    t = hit.t;
+    return true;
+}
+
+Vec3 MeshInstance::position() const
+{
+    return _toWorld.translation;
+}
+
+void MeshInstance::setPosition(const Vec3 &position)
+{
+    Transform moved = _toWorld;
+    moved.translation = position;
+    setTransform(moved);
+}
+
+GraphicParams MeshInstance::hitParams(const Ray &ray, float t) const
+{
+    // t уже найдено intersect: обход BVH ограничен им и отсекает все узлы дальше точки попадания
+    GraphicParams result = _params;
+    MeshHit hit;
+    float tMax = t > 0 ? t * (1 + 1e-4f) : std::numeric_limits<float>::max();
+    if (!_mesh->closestHit(toLocal(ray), tMax, hit))
+        return result;
+
+    // Нормаль переводится транспонированной обратной матрицей, чтобы остаться перпендикулярной при неравномерном масштабе
+    result._normal = _toLocal.transposedVector(_mesh->normal(hit.triangle)).normalize();
+    if (result._normal.dot(ray.direction) > 0)
+        result._normal = -result._normal;
+    return result;
+}
+
+std::shared_ptr<BaseObject> MeshInstance::clone() const
+{
+    return std::make_shared<MeshInstance>(*this);
+}
+
+Aabb MeshInstance::bounds() const
+{
+    const Aabb &local = _mesh->bounds();
+    Aabb box;
+    if (local.isEmpty())
+        return box;
+    for (int i = 0; i < 8; ++i)
+    {
+        Vec3 corner((i & 1) ? local.max.x : local.min.x,
+                    (i & 2) ? local.max.y : local.min.y,
+                    (i & 4) ? local.max.z : local.min.z);
+        box.expand(_toWorld.point(corner));
+    }
+    return box;
+}
+
+bool MeshInstance::sampleSurface(const Vec3 &from, float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const
+{
+    // Выборка равномерна по площади сетки; при неравномерном масштабе треугольники растягиваются по-разному,
+    // поэтому плотность в мировом пространстве пересчитывается через растяжение площади в точке
+    if (!samplePoint(u1, u2, point, normal, pdf))
+        return false;
+    if (normal.dot(from - point) < 0)
+        normal = -normal;
+    return true;
+}
+
+bool MeshInstance::sampleEmission(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const
+{
+    // Треугольники светят обеими сторонами, как и Polygon: сторона выбирается по половине u1
+    bool back = u1 >= 0.5f;
+    u1 = back ? 2.0f * u1 - 1.0f : 2.0f * u1;
+    if (!samplePoint(u1, u2, point, normal, pdf))
+        return false;
+    if (back)
+        normal = -normal;
+    pdf *= 0.5f;
+    return true;
+}
+
+bool MeshInstance::samplePoint(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const
+{
+    if (_mesh->trianglesNum() == 0 || _mesh->area() <= 0)
+        return false;
+
+    Vec3 localPoint, localNormal;
+    _mesh->samplePoint(u1, u2, localPoint, localNormal);
+    // Площадь элемента поверхности растягивается в |det M| |M⁻ᵀ n| раз
+    Vec3 worldNormal = _toLocal.transposedVector(localNormal);
+    float stretch = std::fabs(_determinant) * worldNormal.length();
+    if (stretch <= 0)
+        return false;
+    point = _toWorld.point(localPoint);
+    normal = worldNormal.normalize();
+    pdf = 1.0f / (_mesh->area() * stretch);
+    return true;
+}
+
+void MeshInstance::rotate(const Vec3 &axis, double angle)
+{
+    Vec3 center = position();
+    setTransform(Transform::translate(center) * Transform::rotate(axis, angle) * Transform::translate(-center) * _toWorld);
+}
+
+void MeshInstance::scale(double k)
+{
+    Vec3 center = position();
+    setTransform(Transform::translate(center) * Transform::scale(Vec3(k, k, k)) * Transform::translate(-center) * _toWorld);
+}
+
+const std::shared_ptr<const Mesh> &MeshInstance::mesh() const
+{
+    return _mesh;
+}
+
+void MeshInstance::setMesh(const std::shared_ptr<const Mesh> &mesh)
+{
+    _mesh = mesh;
+}
+
+const Transform &MeshInstance::toWorld() const
+{
+    return _toWorld;
+}
+
+void MeshInstance::setTransform(const Transform &toWorld)
+{
+    _toWorld = toWorld;
+    _toLocal = toWorld.inverse();
+    _determinant = toWorld.rows[0].dot(toWorld.rows[1].cross(toWorld.rows[2]));
+}
@@ -0,0 +1,52 @@
+#ifndef MESHINSTANCE_H
+#define MESHINSTANCE_H
+
+#include <memory>
+#include "baseobject.h"
+#include "mesh.h"
+#include "transform.h"
+
+// Экземпляр разделяемой сетки: хранит только ссылку на Mesh, преобразование в мировые координаты и материал.
+// Луч переводится в систему координат сетки, поэтому перемещение, поворот и масштаб не трогают вершины и BVH сетки
+class MeshInstance : public BaseObject
+{
+public:
+    MeshInstance(const std::shared_ptr<const Mesh> &mesh, const Transform &toWorld, const GraphicParams &params);
+
+    virtual bool intersect(const Ray &ray) const override;
+    virtual bool intersect(const Ray &ray, float &t) const override;
+
+    // Начало координат сетки в мировом пространстве
+    virtual Vec3 position() const override;
+    virtual void setPosition(const Vec3 &position) override;
+    virtual GraphicParams hitParams(const Ray &ray, float t) const override;
+    virtual Aabb bounds() const override;
+    virtual std::shared_ptr<BaseObject> clone() const override;
+    virtual bool sampleSurface(const Vec3 &from, float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const override;
+    virtual bool sampleEmission(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const override;
+
+    // Поворот и масштаб относительно position(), угол в градусах; k < 0 дополнительно отражает относительно position()
+    void rotate(const Vec3 &axis, double angle);
+    void scale(double k);
+
+    const std::shared_ptr<const Mesh> &mesh() const;
+    const Transform &toWorld() const;
+    void setTransform(const Transform &toWorld);
+
+protected:
+    void setMesh(const std::shared_ptr<const Mesh> &mesh);
+
+private:
+    // Направление не нормируется: t в системе сетки совпадает с мировым t
+    Ray toLocal(const Ray &ray) const;
+    // Точка, равномерная по площади сетки, в мировых координатах; normal не обращается к наблюдателю
+    bool samplePoint(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const;
+
+    std::shared_ptr<const Mesh> _mesh;
+    Transform _toWorld;
+    Transform _toLocal;
+    // Определитель матрицы _toWorld: во сколько раз преобразование меняет объем
+    float _determinant = 1;
+};
+
+#endif // MESHINSTANCE_H
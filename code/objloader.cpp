@@ -0,0 +1,421 @@
+#include "objloader.h"
+#include <QFile>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "threadpool.h"
+
+namespace
+{
+
+// Угол грани без нормали
+const int64_t NO_NORMAL = std::numeric_limits<int64_t>::min();
+
+// Результат разбора одного куска. Индексы вершин еще не сведены к общему буферу:
+// положительные индексы OBJ уже абсолютные, отрицательные отсчитаны от начала куска
+// и перечислены в relative, к ним прибавляется число вершин в предыдущих кусках.
+// Индексы нормалей углов хранятся так же в cornerNormals и relativeNormals
+struct ObjChunk
+{
+    std::vector<Vec3> vertices;
+    std::vector<Vec3> normals;
+    std::vector<int64_t> corners;
+    std::vector<size_t> relative;
+    std::vector<int64_t> cornerNormals;
+    std::vector<size_t> relativeNormals;
+    bool hasNormals = false;
+    int faces = 0;
+    int skippedFaces = 0;
+    std::string error;
+};
+
+bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+void skipBlanks(const char *&p, const char *end)
+{
+    while (p < end && isBlank(*p))
+        ++p;
+}
+
+void skipToken(const char *&p, const char *end)
+{
+    while (p < end && *p != '\n' && !isBlank(*p))
+        ++p;
+}
+
+// Число с плавающей точкой в формате [+-]digits[.digits][(e|E)[+-]digits]. Мантисса копится в 64-битном целом,
+// порядок применяется одним умножением в double, поэтому результат точен в пределах float
+bool parseFloat(const char *&p, const char *end, float &value)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+        negative = *s++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s, ++digits)
+    {
+        if (mantissa < 1000000000000000000ULL)
+            mantissa = mantissa * 10 + (*s - '0');
+        else
+            ++exponent;
+    }
+    if (s < end && *s == '.')
+    {
+        for (++s; s < end && *s >= '0' && *s <= '9'; ++s, ++digits)
+        {
+            if (mantissa < 1000000000000000000ULL)
+            {
+                mantissa = mantissa * 10 + (*s - '0');
+                --exponent;
+            }
+        }
+    }
+    if (digits == 0)
+        return false;
+
+    if (s < end && (*s == 'e' || *s == 'E'))
+    {
+        const char *e = s + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+'))
+            negativeExponent = *e++ == '-';
+        int power = 0;
+        const char *first = e;
+        for (; e < end && *e >= '0' && *e <= '9'; ++e)
+            power = std::min(power * 10 + (*e - '0'), 10000);
+        if (e > first)
+        {
+            exponent += negativeExponent ? -power : power;
+            s = e;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (exponent >= 0 && exponent <= 22)
+        result *= powers[exponent];
+    else if (exponent < 0 && exponent >= -22)
+        result /= powers[-exponent];
+    else
+        result *= std::pow(10.0, exponent);
+
+    value = static_cast<float>(negative ? -result : result);
+    p = s;
+    return true;
+}
+
+bool parseIndex(const char *&p, const char *end, int64_t &value)
+{
+    const char *s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+'))
+        negative = *s++ == '-';
+
+    int64_t result = 0;
+    const char *first = s;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s)
+        result = std::min<int64_t>(result * 10 + (*s - '0'), INT64_C(1) << 40);
+    if (s == first)
+        return false;
+
+    value = negative ? -result : result;
+    p = s;
+    return true;
+}
+
+bool parseVec3(const char *&p, const char *end, Vec3 &v)
+{
+    float *coordinates[3] = {&v.x, &v.y, &v.z};
+    for (float *c : coordinates)
+    {
+        skipBlanks(p, end);
+        if (!parseFloat(p, end, *c))
+            return false;
+    }
+    return true;
+}
+
+void parseChunk(const char *p, const char *end, ObjChunk &chunk)
+{
+    std::vector<int64_t> face;
+    std::vector<bool> faceRelative;
+    std::vector<int64_t> faceNormals;
+    std::vector<bool> faceNormalRelative;
+    while (p < end)
+    {
+        skipBlanks(p, end);
+        if (p + 1 < end && p[0] == 'v' && isBlank(p[1]))
+        {
+            p += 2;
+            Vec3 vertex;
+            if (!parseVec3(p, end, vertex) && chunk.error.empty())
+                chunk.error = "Invalid vertex format in OBJ: expected three coordinates";
+            chunk.vertices.push_back(vertex);
+        }
+        else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+        {
+            p += 3;
+            Vec3 normal;
+            if (!parseVec3(p, end, normal) && chunk.error.empty())
+                chunk.error = "Invalid normal format in OBJ: expected three coordinates";
+            chunk.normals.push_back(normal);
+        }
+        else if (p + 1 < end && p[0] == 'f' && isBlank(p[1]))
+        {
+            p += 2;
+            face.clear();
+            faceRelative.clear();
+            faceNormals.clear();
+            faceNormalRelative.clear();
+            while (true)
+            {
+                skipBlanks(p, end);
+                if (p >= end || *p == '\n')
+                    break;
+                // Из записи вершина/текстура/нормаль берутся вершина и нормаль; нечисловые записи пропускаются
+                int64_t index;
+                if (parseIndex(p, end, index) && index != 0)
+                {
+                    bool relative = index < 0;
+                    face.push_back(relative ? static_cast<int64_t>(chunk.vertices.size()) + index : index - 1);
+                    faceRelative.push_back(relative);
+
+                    int64_t normal = NO_NORMAL;
+                    bool normalRelative = false;
+                    int64_t texture, normalIndex;
+                    if (p < end && *p == '/')
+                    {
+                        ++p;
+                        parseIndex(p, end, texture);
+                        if (p < end && *p == '/' && parseIndex(++p, end, normalIndex) && normalIndex != 0)
+                        {
+                            normalRelative = normalIndex < 0;
+                            normal = normalRelative ? static_cast<int64_t>(chunk.normals.size()) + normalIndex : normalIndex - 1;
+                        }
+                    }
+                    faceNormals.push_back(normal);
+                    faceNormalRelative.push_back(normalRelative);
+                }
+                skipToken(p, end);
+            }
+
+            ++chunk.faces;
+            if (face.size() < 3)
+            {
+                ++chunk.skippedFaces;
+            }
+            else
+            {
+                // Веер из первой вершины; для выпуклых граней, которые пишут все экспортеры, этого достаточно
+                for (size_t i = 1; i + 1 < face.size(); ++i)
+                {
+                    for (size_t corner : {size_t(0), i, i + 1})
+                    {
+                        if (faceRelative[corner])
+                            chunk.relative.push_back(chunk.corners.size());
+                        if (faceNormalRelative[corner])
+                            chunk.relativeNormals.push_back(chunk.cornerNormals.size());
+                        chunk.corners.push_back(face[corner]);
+                        chunk.cornerNormals.push_back(faceNormals[corner]);
+                        chunk.hasNormals = chunk.hasNormals || faceNormals[corner] != NO_NORMAL;
+                    }
+                }
+            }
+        }
+
+        while (p < end && *p != '\n')
+            ++p;
+        if (p < end)
+            ++p;
+    }
+}
+
+} // namespace
+
+ObjGeometry parseObjGeometry(const char *data, size_t size, ObjLoadStats *stats, size_t chunkSize)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Границы кусков сдвигаются к началу следующей строки, чтобы ни одна строка не делилась
+    std::vector<const char *> bounds = {data};
+    const char *end = data + size;
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    while (static_cast<size_t>(end - bounds.back()) > chunkSize)
+    {
+        const char *split = std::find(bounds.back() + chunkSize, end, '\n');
+        if (split == end)
+            break;
+        bounds.push_back(split + 1);
+    }
+    bounds.push_back(end);
+    int chunksNum = static_cast<int>(bounds.size()) - 1;
+
+    std::vector<ObjChunk> chunks(chunksNum);
+    ThreadPool::instance().parallelFor(chunksNum, [&](int i) { parseChunk(bounds[i], bounds[i + 1], chunks[i]); });
+
+    // Смещения кусков в общих буферах, затем параллельное копирование со сведением индексов
+    std::vector<size_t> vertexOffsets(chunksNum + 1, 0);
+    std::vector<size_t> normalOffsets(chunksNum + 1, 0);
+    std::vector<size_t> cornerOffsets(chunksNum + 1, 0);
+    bool hasNormals = false;
+    for (int i = 0; i < chunksNum; ++i)
+    {
+        if (!chunks[i].error.empty())
+            throw std::runtime_error(chunks[i].error);
+        vertexOffsets[i + 1] = vertexOffsets[i] + chunks[i].vertices.size();
+        normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size();
+        cornerOffsets[i + 1] = cornerOffsets[i] + chunks[i].corners.size();
+        hasNormals = hasNormals || chunks[i].hasNormals;
+    }
+    if (vertexOffsets.back() > UINT32_MAX)
+        throw std::runtime_error("OBJ has too many vertices for 32-bit indices");
+
+    ObjGeometry geometry;
+    std::vector<Vec3> &vertices = geometry.vertices;
+    std::vector<uint32_t> &indices = geometry.indices;
+    vertices.resize(vertexOffsets.back());
+    indices.resize(cornerOffsets.back());
+    std::vector<char> badIndex(chunksNum, 0);
+    int64_t verticesNum = static_cast<int64_t>(vertices.size());
+    ThreadPool::instance().parallelFor(chunksNum, [&](int i) {
+        ObjChunk &chunk = chunks[i];
+        std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + vertexOffsets[i]);
+        for (size_t position : chunk.relative)
+            chunk.corners[position] += static_cast<int64_t>(vertexOffsets[i]);
+        uint32_t *out = indices.data() + cornerOffsets[i];
+        for (int64_t corner : chunk.corners)
+        {
+            if (corner < 0 || corner >= verticesNum)
+            {
+                badIndex[i] = 1;
+                corner = 0;
+            }
+            *out++ = static_cast<uint32_t>(corner);
+        }
+    });
+    if (std::find(badIndex.begin(), badIndex.end(), 1) != badIndex.end())
+        throw std::runtime_error("OBJ face references a missing vertex");
+
+    // Нормаль треугольника — нормированная сумма нормалей vn его углов; если у угла нет нормали
+    // или сумма нулевая, берется геометрическая нормаль, так что сетка без vn не меняется
+    if (hasNormals)
+    {
+        std::vector<Vec3> normals(normalOffsets.back());
+        for (int i = 0; i < chunksNum; ++i)
+            std::copy(chunks[i].normals.begin(), chunks[i].normals.end(), normals.begin() + normalOffsets[i]);
+
+        geometry.faceNormals.resize(indices.size() / 3);
+        int64_t normalsNum = static_cast<int64_t>(normals.size());
+        ThreadPool::instance().parallelFor(chunksNum, [&](int i) {
+            ObjChunk &chunk = chunks[i];
+            for (size_t position : chunk.relativeNormals)
+                chunk.cornerNormals[position] += static_cast<int64_t>(normalOffsets[i]);
+            size_t firstTriangle = cornerOffsets[i] / 3;
+            for (size_t t = 0; 3 * t < chunk.cornerNormals.size(); ++t)
+            {
+                Vec3 sum(0, 0, 0);
+                bool complete = true;
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    int64_t normal = chunk.cornerNormals[3 * t + k];
+                    if (normal == NO_NORMAL)
+                        complete = false;
+                    else if (normal < 0 || normal >= normalsNum)
+                        badIndex[i] = 1;
+                    else
+                        sum += normals[normal];
+                }
+                if (!complete || sum.length() == 0)
+                {
+                    const uint32_t *corner = indices.data() + 3 * (firstTriangle + t);
+                    sum = (vertices[corner[1]] - vertices[corner[0]]).cross(vertices[corner[2]] - vertices[corner[0]]);
+                }
+                geometry.faceNormals[firstTriangle + t] = sum.normalize();
+            }
+        });
+        if (std::find(badIndex.begin(), badIndex.end(), 1) != badIndex.end())
+            throw std::runtime_error("OBJ face references a missing normal");
+    }
+
+    if (stats)
+    {
+        *stats = ObjLoadStats();
+        stats->bytes = size;
+        stats->chunks = chunksNum;
+        stats->vertices = static_cast<int>(vertices.size());
+        stats->triangles = static_cast<int>(indices.size() / 3);
+        for (const ObjChunk &chunk : chunks)
+        {
+            stats->faces += chunk.faces;
+            stats->skippedFaces += chunk.skippedFaces;
+        }
+        stats->parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return geometry;
+}
+
+std::shared_ptr<Mesh> parseObj(const char *data, size_t size, ObjLoadStats *stats, size_t chunkSize)
+{
+    ObjGeometry geometry = parseObjGeometry(data, size, stats, chunkSize);
+    auto start = std::chrono::steady_clock::now();
+    auto mesh = std::make_shared<Mesh>(std::move(geometry.vertices), std::move(geometry.indices),
+                                       std::move(geometry.faceNormals));
+    if (stats)
+        stats->buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return mesh;
+}
+
+ObjGeometry loadObjGeometry(const QString &filename, ObjLoadStats *stats)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        throw std::runtime_error("Unable to open file: " + filename.toStdString());
+
+    if (file.size() == 0)
+        return parseObjGeometry(nullptr, 0, stats);
+
+    // Если файловая система не поддерживает отображение, файл читается целиком
+    uchar *mapped = file.map(0, file.size());
+    if (!mapped)
+    {
+        QByteArray content = file.readAll();
+        return parseObjGeometry(content.constData(), static_cast<size_t>(content.size()), stats);
+    }
+
+    try
+    {
+        ObjGeometry geometry = parseObjGeometry(reinterpret_cast<const char *>(mapped), static_cast<size_t>(file.size()), stats);
+        file.unmap(mapped);
+        return geometry;
+    }
+    catch (...)
+    {
+        file.unmap(mapped);
+        throw;
+    }
+}
+
+std::shared_ptr<Mesh> loadObj(const QString &filename, ObjLoadStats *stats)
+{
+    ObjGeometry geometry = loadObjGeometry(filename, stats);
+    auto start = std::chrono::steady_clock::now();
+    auto mesh = std::make_shared<Mesh>(std::move(geometry.vertices), std::move(geometry.indices),
+                                       std::move(geometry.faceNormals));
+    if (stats)
+        stats->buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return mesh;
+}
@@ -0,0 +1,48 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "mesh.h"
+
+class QString;
+
+// Статистика загрузки OBJ
+struct ObjLoadStats
+{
+    size_t bytes = 0;
+    int chunks = 0;
+    int vertices = 0;
+    int faces = 0;
+    int triangles = 0;
+    // Грани, у которых меньше трех вершин
+    int skippedFaces = 0;
+    double parseSeconds = 0;
+    // Сборка объекта из разобранных буферов, для Mesh — вместе с ее BVH
+    double buildSeconds = 0;
+};
+
+// Разобранные вершины и индексы треугольников, еще не собранные в объект
+struct ObjGeometry
+{
+    std::vector<Vec3> vertices;
+    std::vector<uint32_t> indices;
+    // По нормали на треугольник, если в файле есть нормали vn, иначе пусто
+    std::vector<Vec3> faceNormals;
+};
+
+// Текст разбивается на куски не меньше этого размера, по границам строк
+const size_t OBJ_CHUNK_SIZE = 1 << 20;
+
+// Разбор OBJ из памяти: читаются вершины v, нормали vn и грани f, многоугольники разбиваются веером на треугольники,
+// остальные записи пропускаются. Куски разбираются параллельно в общем пуле потоков.
+// Ссылка грани на несуществующую вершину или нормаль, вершина или нормаль без трех координат — std::runtime_error
+ObjGeometry parseObjGeometry(const char *data, size_t size, ObjLoadStats *stats = nullptr, size_t chunkSize = OBJ_CHUNK_SIZE);
+std::shared_ptr<Mesh> parseObj(const char *data, size_t size, ObjLoadStats *stats = nullptr, size_t chunkSize = OBJ_CHUNK_SIZE);
+// Файл отображается в память и разбирается без копирования
+ObjGeometry loadObjGeometry(const QString &filename, ObjLoadStats *stats = nullptr);
+std::shared_ptr<Mesh> loadObj(const QString &filename, ObjLoadStats *stats = nullptr);
+
+#endif // OBJLOADER_H
@@ -1,4 +1,6 @@
 #include "photon.h"
+#include "spectrum.h"
+#include "sequentiallens.h"
 #include <iostream>
 #include <random>
 #include <limits>
@@ -7,6 +9,28 @@
 
 
 
+// Вероятность продолжения пути фотона при диффузном отражении ограничена сверху,
+// чтобы пути в замкнутых сценах с белыми стенами оставались конечными
+static const float PHOTON_MAX_SURVIVAL = 0.95f;
+
+static float photonRandom()
+{
+    thread_local std::mt19937 gen(std::random_device{}());
+    thread_local std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    return dist(gen);
+}
+
+Vec3 cosineWeightedDirection(const Vec3 &normal)
+{
+    Vec3 a = std::fabs(normal.x) > 0.9f ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    Vec3 t1 = a.cross(normal).normalize();
+    Vec3 t2 = normal.cross(t1);
+
+    float r = std::sqrt(photonRandom());
+    float phi = 2.0f * M_PI * photonRandom();
+    return (t1 * (r * std::cos(phi)) + t2 * (r * std::sin(phi)) + normal * std::sqrt(std::max(0.0f, 1.0f - r * r))).normalize();
+}
+
 // Вспомогательная функция для вычисления расстояния
 static float squaredDistance(const Vec3 &a, const Vec3 &b)
 {
@@ -113,26 +137,25 @@ void PhotonTree::nearestPhotonNodeRecursion(std::shared_ptr<PhotonNode> node, co
     }
 }
 
-void tracePhoton(Photon &photon, const std::vector<std::shared_ptr<BaseObject>> &objects,
-                 std::vector<Photon> &photons,std::vector<Photon> &causticPhotons, int depth, float currentRefractiveIndex, int maxDepth)
+void tracePhoton(Photon &photon, const SceneIntersector &scene,
+                 std::vector<Photon> &photons,std::vector<Photon> &causticPhotons, int depth, float currentRefractiveIndex, int maxDepth,
+                 bool indirectOnly, bool diffuseBounced, float wavelength)
 {
     if (depth <= 0 || photon.color == Vec3(0,0,0))
         return;
 
     float t_min = std::numeric_limits<float>::max();
-    std::shared_ptr<BaseObject> hitObject = nullptr;
+    const BaseObject *hitObject = nullptr;
     GraphicParams hitParams;
 
     // Поиск пересечения фотона с объектами
-    for (const auto &o : objects)
+    HitRecord hit;
+    Ray photonRay(photon.position, photon.direction);
+    if (scene.closestHit(photonRay, hit))
     {
-        float t = 0;
-        if (o->intersect(Ray(photon.position, photon.direction), t) && t < t_min)
-        {
-            t_min = t;
-            hitParams = o->hitParams(Ray(photon.position, photon.direction), t);
-            hitObject = o;
-        }
+        t_min = hit.t;
+        hitParams = hit.object->hitParams(photonRay, hit.t);
+        hitObject = hit.object;
     }
 
     if (hitObject != nullptr)
@@ -140,14 +163,31 @@ void tracePhoton(Photon &photon, const std::vector<std::shared_ptr<BaseObject>>
         photon.position += photon.direction * t_min; // Обновляем положение фотона
         if (hitParams._transparency < 1  && hitParams._reflectivity < 1)
         {
-            if (depth == maxDepth)
-                photons.push_back(photon); // Сохраняем фотон в карту общего освещения, если объект не прозрачный
-            else
+            if (diffuseBounced)
+                photons.push_back(photon); // Фотон после диффузного отражения — в карту общего освещения
+            else if (depth != maxDepth)
                 causticPhotons.push_back(photon); // Сохраяняем в карту каустиков, если фотон уже был преломлен
+            else if (!indirectOnly)
+                photons.push_back(photon); // Прямое попадание хранится, только если прямой свет не считается отдельно
         }
-        // Показатель преломления объекта
-        float objectRefractiveIndex = hitParams._refractiveIndex;
 
+        // Диффузное отражение с русской рулеткой: фотон продолжает путь с вероятностью, равной альбедо,
+        // а его мощность делится на эту вероятность
+        float diffuse = (1.0f - hitParams._transparency) * (1.0f - hitParams._reflectivity);
+        if (indirectOnly && diffuse > 0.0f)
+        {
+            Vec3 albedo = hitParams._color * diffuse;
+            float survival = std::min(PHOTON_MAX_SURVIVAL, std::max(albedo.x, std::max(albedo.y, albedo.z)));
+            if (survival > 0.0f && photonRandom() < survival)
+            {
+                Vec3 normal = hitParams._normal.dot(photon.direction) > 0 ? -hitParams._normal : hitParams._normal;
+                Photon bouncedPhoton = photon;
+                bouncedPhoton.position = photon.position + normal * 1e-4f;
+                bouncedPhoton.direction = cosineWeightedDirection(normal);
+                bouncedPhoton.color = photon.color * albedo / survival;
+                tracePhoton(bouncedPhoton, scene, photons, causticPhotons, depth - 1, currentRefractiveIndex, maxDepth, indirectOnly, true, wavelength);
+            }
+        }
         // Отражение фотона
         if (hitParams._reflectivity > 0.0f)
         {
@@ -155,35 +195,64 @@ void tracePhoton(Photon &photon, const std::vector<std::shared_ptr<BaseObject>>
             Photon reflectedPhoton = photon;
             reflectedPhoton.direction = reflectedDir;
             reflectedPhoton.color *= hitParams._reflectivity;
-            tracePhoton(reflectedPhoton, objects, photons,causticPhotons, depth - 1, currentRefractiveIndex);
+            tracePhoton(reflectedPhoton, scene, photons,causticPhotons, depth - 1, currentRefractiveIndex, 15, indirectOnly, diffuseBounced, wavelength);
         }
 
+        // Вход в стопку линз: фотон проходит ее последовательно и продолжает путь от выхода из системы
+        const SequentialLensSystem *lenses = scene.lensSystem();
+        if (hitParams._transparency > 0.0f && lenses && lenses->contains(hitObject) && photon.direction.dot(hitParams._normal) < 0.0f)
+        {
+            Ray incident = photonRay;
+            incident.wavelength = wavelength;
+            LensPath path = {incident, photon.color, hitObject};
+            if (lenses->trace(path))
+            {
+                Photon refractedPhoton = photon;
+                refractedPhoton.position = path.ray.origin;
+                refractedPhoton.direction = path.ray.direction;
+                refractedPhoton.color = path.weight;
+                tracePhoton(refractedPhoton, scene, photons, causticPhotons, depth - 1, currentRefractiveIndex, maxDepth, indirectOnly, diffuseBounced, path.ray.wavelength);
+            }
+        }
+        // Градиентная среда: фотон проходит ее интегрированием траектории и продолжает путь от точки выхода
+        else if (hitParams._transparency > 0.0f && hitObject->hasInterior() && photon.direction.dot(hitParams._normal) < 0.0f)
+        {
+            Ray interior = photonRay;
+            interior.wavelength = wavelength;
+            Vec3 weight = photon.color;
+            if (hitObject->traceInterior(interior, t_min, weight))
+            {
+                Photon refractedPhoton = photon;
+                refractedPhoton.position = interior.origin;
+                refractedPhoton.direction = interior.direction;
+                refractedPhoton.color = weight;
+                tracePhoton(refractedPhoton, scene, photons, causticPhotons, depth - 1, currentRefractiveIndex, maxDepth, indirectOnly, diffuseBounced, wavelength);
+            }
+        }
         // Преломление фотона
-        if (hitParams._transparency > 0.0f)
+        else if (hitParams._transparency > 0.0f)
         {
             // Vec3 refractedDir = Vec3::refract(photon.direction, hitParams._normal, currentRefractiveIndex, hitParams._refractiveIndex);
             // Photon refractedPhoton = photon;
             // refractedPhoton.direction = refractedDir;
             // refractedPhoton.color = photon.color;
-            // tracePhoton(refractedPhoton, objects, photonMap, depth - 1, hitParams._refractiveIndex, maxDepth);
-            photon.color *= (hitParams._transparency);
+            // tracePhoton(refractedPhoton, scene, photonMap, depth - 1, hitParams._refractiveIndex, maxDepth);
+            // Вместо трех дочерних фотонов по каналам RGB — один путь с четырьмя длинами волн,
+            // который сворачивается к ведущей, только если дисперсия разводит их направления.
+            // Показатель внешней среды не меняется: сторону поверхности refract определяет по нормали
+            SpectralRefraction refraction = refractSpectral(photon.direction, hitParams._normal, currentRefractiveIndex,
+                                                            hitParams, wavelength, photonRandom());
+            // Пропускание по Френелю, как у лучей камеры в shadeSurface и в последовательной системе линз
+            float fresnelCoeff = Vec3::fresnel(photon.direction, hitParams._normal, refraction.refractiveIndex);
+            photon.color *= hitParams._transparency * (1.0f - fresnelCoeff);
             photon.color *= hitParams._color;
-            float refractiveIndices[3];
-            refractiveIndices[0] = objectRefractiveIndex + hitParams._refractionDeltaR;
-            refractiveIndices[1] = objectRefractiveIndex;
-            refractiveIndices[2] = objectRefractiveIndex + hitParams._refractionDeltaB;
-
-            // Разделяем цвет на три компоненты (RGB)
-            Vec3 colors[3] = {photon.color * Vec3(1, 0, 0), photon.color * Vec3(0, 1, 0), photon.color * Vec3(0, 0, 1)};
 
-            for (int i = 0; i < 3; ++i)
-            {
-                Vec3 refractedDir = Vec3::refract(photon.direction, hitParams._normal, currentRefractiveIndex, refractiveIndices[i]);
-                Photon refractedPhoton = photon;
-                refractedPhoton.direction = refractedDir;
-                refractedPhoton.color = colors[i];
-                tracePhoton(refractedPhoton, objects, photons, causticPhotons, depth - 1, refractiveIndices[i], maxDepth);
-            }
+            // Смещение за поверхность: иначе фотон повторно попадает в ту же точку и еще раз теряет на отражении
+            Photon refractedPhoton = photon;
+            refractedPhoton.direction = refraction.direction;
+            refractedPhoton.position = photon.position + refraction.direction.normalize() * 1e-4f;
+            refractedPhoton.color *= refraction.weight;
+            tracePhoton(refractedPhoton, scene, photons, causticPhotons, depth - 1, currentRefractiveIndex, maxDepth, indirectOnly, diffuseBounced, refraction.wavelength);
         }
     }
 }
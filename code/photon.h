@@ -4,6 +4,7 @@
 #include "primitives.h"
 #include "light.h"
 #include "baseobject.h"
+#include "sceneintersector.h"
 #include <memory>
 #include <vector>
 #include <queue>
@@ -77,7 +78,14 @@ public:
 };
 
 
-void tracePhoton(Photon &photon, const std::vector<std::shared_ptr<BaseObject>> &objects,
-                 std::vector<Photon> &photonMap,std::vector<Photon> &causticPhotons, int depth = 15, float currentRefractiveIndex = 1, int maxDepth = 15);
+// Направление, распределенное по косинусу относительно normal (ламбертово отражение и излучение)
+Vec3 cosineWeightedDirection(const Vec3 &normal);
+
+// indirectOnly — прямой свет считается трассировкой теневых лучей: первые попадания не сохраняются
+// в глобальную карту, а фотоны продолжают путь диффузными отражениями.
+// wavelength — длина волны, к которой свернут путь после дисперсии (0 — фотон переносит весь спектр)
+void tracePhoton(Photon &photon, const SceneIntersector &scene,
+                 std::vector<Photon> &photonMap,std::vector<Photon> &causticPhotons, int depth = 15, float currentRefractiveIndex = 1, int maxDepth = 15,
+                 bool indirectOnly = false, bool diffuseBounced = false, float wavelength = 0);
 
 #endif // __PHOTON_H__
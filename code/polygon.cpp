@@ -80,9 +80,9 @@ void Polygon::move(const Vec3 &delta)
 
 void Polygon::scale(const Vec3 &center, double k)
 {
-    v0 = center + (center - v0) * k;
-    v1 = center + (center - v1) * k;
-    v2 = center + (center - v2) * k;
+    v0 = center + (v0 - center) * k;
+    v1 = center + (v1 - center) * k;
+    v2 = center + (v2 - center) * k;
 }
 
 GraphicParams Polygon::hitParams(const Ray &ray, float t) const
@@ -94,6 +94,52 @@ GraphicParams Polygon::hitParams(const Ray &ray, float t) const
     return rp;
 }
 
+std::shared_ptr<BaseObject> Polygon::clone() const
+{
+    return std::make_shared<Polygon>(*this);
+}
+
+Aabb Polygon::bounds() const
+{
+    Aabb box;
+    box.expand(v0);
+    box.expand(v1);
+    box.expand(v2);
+    return box;
+}
+
+bool Polygon::sampleSurface(const Vec3 &from, float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const
+{
+    // Равномерно по площади треугольника
+    float su = std::sqrt(u1);
+    point = v0 * (1.0f - su) + v1 * (su * (1.0f - u2)) + v2 * (su * u2);
+    Vec3 n = (v1 - v0).cross(v2 - v0);
+    float doubleArea = n.length();
+    if (doubleArea <= 0)
+        return false;
+    normal = n / doubleArea;
+    if (normal.dot(from - point) < 0)
+        normal = -normal;
+    pdf = 2.0f / doubleArea;
+    return true;
+}
+
+bool Polygon::sampleEmission(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const
+{
+    // Треугольник светит обеими сторонами: сторона выбирается по половине u1, остаток растягивается обратно
+    bool back = u1 >= 0.5f;
+    u1 = back ? 2.0f * u1 - 1.0f : 2.0f * u1;
+    float su = std::sqrt(u1);
+    point = v0 * (1.0f - su) + v1 * (su * (1.0f - u2)) + v2 * (su * u2);
+    Vec3 n = (v1 - v0).cross(v2 - v0);
+    float doubleArea = n.length();
+    if (doubleArea <= 0)
+        return false;
+    normal = n / (back ? -doubleArea : doubleArea);
+    pdf = 1.0f / doubleArea;
+    return true;
+}
+
 std::ostream& operator<<(std::ostream& os, const Polygon& polygon)
 {
     os << "Polygon: v0 = (" << polygon.v0.x << ", " << polygon.v0.y << ", " << polygon.v0.z << "), v1 = (" << polygon.v1.x << ", " << polygon.v1.y << ", " << polygon.v1.z << "), v2 = (" << polygon.v2.x << ", " << polygon.v2.y << ", " << polygon.v2.z << ")";
@@ -17,8 +17,13 @@ public:
     void move(const Vec3 &delta);
     void rotate(const Vec3&axis, double angle);
     void rotate(const Vec3 &center, const Vec3 &axis, double angle);
+    // Тот же смысл, что у MeshInstance::scale: k < 0 дополнительно отражает относительно center
     void scale(const Vec3& center, double k);
     virtual GraphicParams hitParams(const Ray& ray, float t) const override;
+    virtual Aabb bounds() const override;
+    virtual std::shared_ptr<BaseObject> clone() const override;
+    virtual bool sampleSurface(const Vec3 &from, float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const override;
+    virtual bool sampleEmission(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const override;
 };
 
 std::ostream& operator<<(std::ostream& os, const Polygon& polygon);
@@ -1,195 +1,119 @@
 #include "polygonalmodel.h"
-#include "qdir.h"
-
-
-Vec3 PolygonalModel::position() const
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include "transform.h"
+
+namespace
 {
-    return boundingSphereCenter;
-}
 
-void PolygonalModel::setPosition(const Vec3 &pos)
+// Ключ вершины — двоичное представление координат: объединяются только точно совпадающие вершины
+struct VertexKey
 {
-    Vec3 delta = pos - position();
-    for (auto & p : polygons)
+    uint32_t bits[3];
+
+    explicit VertexKey(const Vec3 &v)
     {
-        p.move(delta);
+        std::memcpy(bits, &v, sizeof(bits));
     }
-    boundingSphereCenter += delta;
-}
-
-PolygonalModel::PolygonalModel(const std::vector<Polygon>& polys)
-    : polygons(polys)
-{
-    calculateBoundingSphere();
-}
-
-bool PolygonalModel::intersect(const Ray &ray) const
-{
-    if (!intersectBoundingSphere(ray)) return false;
 
-    bool hasHit = false;
-    float closestT = std::numeric_limits<float>::max();
-
-    for (const auto& poly : polygons) {
-        float currentT;
-        if (poly.intersect(ray, currentT) && currentT < closestT) {
-            closestT = currentT;
-            hasHit = true;
-        }
+    bool operator==(const VertexKey &other) const
+    {
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
     }
-    return hasHit;
-}
-
-void PolygonalModel::calculateBoundingSphere() {
-    Vec3 centerSum(0, 0, 0);
-    int vertexCount = 0;
+};
 
-    for (const auto& poly : polygons) {
-        centerSum = centerSum + poly.v0 + poly.v1 + poly.v2;
-        vertexCount += 3;
+struct VertexKeyHash
+{
+    size_t operator()(const VertexKey &key) const
+    {
+        uint64_t h = key.bits[0];
+        h = h * 0x9E3779B97F4A7C15ULL ^ key.bits[1];
+        h = h * 0x9E3779B97F4A7C15ULL ^ key.bits[2];
+        return static_cast<size_t>(h ^ (h >> 29));
     }
+};
 
-    boundingSphereCenter = centerSum * (1.0f / vertexCount);
+} // namespace
 
-    boundingSphereRadius = 0.0f;
-    for (const auto& poly : polygons) {
-        boundingSphereRadius = std::max(boundingSphereRadius, (poly.v0 - boundingSphereCenter).length());
-        boundingSphereRadius = std::max(boundingSphereRadius, (poly.v1 - boundingSphereCenter).length());
-        boundingSphereRadius = std::max(boundingSphereRadius, (poly.v2 - boundingSphereCenter).length());
-    }
-}
 
-void PolygonalModel::setRefractionIndex(double refrIndex)
+PolygonalModel::PolygonalModel(const std::vector<Polygon>& polys)
+    : MeshInstance(std::make_shared<Mesh>(), Transform(), GraphicParams())
 {
-    for (auto &p : polygons)
-        p._params._refractiveIndex = refrIndex;
+    if (!polys.empty())
+        _params = polys.front()._params;
+
+    std::vector<Vec3> vertices;
+    std::vector<uint32_t> indices;
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> known;
+    known.reserve(3 * polys.size());
+    indices.reserve(3 * polys.size());
+    for (const auto &poly : polys)
+    {
+        for (const Vec3 &v : {poly.v0, poly.v1, poly.v2})
+        {
+            auto inserted = known.emplace(VertexKey(v), static_cast<uint32_t>(vertices.size()));
+            if (inserted.second)
+                vertices.push_back(v);
+            indices.push_back(inserted.first->second);
+        }
+    }
+    setGeometry(std::move(vertices), std::move(indices));
 }
 
-void PolygonalModel::setTransparency(double transparency)
+PolygonalModel::PolygonalModel(std::vector<Vec3> vertices, std::vector<uint32_t> indices, const GraphicParams &params)
+    : MeshInstance(std::make_shared<Mesh>(), Transform(), params)
 {
-    for(auto &p : polygons)
-        p._params._transparency = transparency;
-}
-
-bool PolygonalModel::intersectBoundingSphere(const Ray& ray) const {
-    Vec3 oc = ray.origin - boundingSphereCenter;
-    float half_b = oc.dot(ray.direction);
-    float c = oc.dot(oc) - boundingSphereRadius * boundingSphereRadius;
-    float discriminant = half_b * half_b - c;
-
-    return discriminant >= 0;
+    setGeometry(std::move(vertices), std::move(indices));
 }
 
-void PolygonalModel::load(const QString &filename)
+void PolygonalModel::setGeometry(std::vector<Vec3> vertices, std::vector<uint32_t> indices, std::vector<Vec3> faceNormals)
 {
-    polygons.clear(); // Очищаем текущие полигоны
-
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        throw std::runtime_error("Unable to open file: " + filename.toStdString());
-    }
-
-    std::vector<Vec3> vertices; // Вектор для хранения вершин
-    QTextStream in(&file);
-
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed(); // Читаем строку и удаляем пробелы по краям
-        if (line.isEmpty() || line.startsWith('#')) {
-            continue; // Игнорируем пустые строки и комментарии
-        }
-
-        QStringList parts = line.split(' ', Qt::SkipEmptyParts); // Разбиваем строку на части
-        if (parts.isEmpty()) {
-            continue; // Игнорируем пустые части
-        }
-
-        if (parts[0] == "v") { // Вершина
-            if (parts.size() < 4) {
-                throw std::runtime_error("Invalid vertex format in line: " + line.toStdString());
-            }
-            Vec3 vertex;
-            vertex.x = parts[1].toFloat();
-            vertex.y = parts[2].toFloat();
-            vertex.z = parts[3].toFloat();
-            vertices.push_back(vertex); // Добавляем вершину в вектор
-        }
-        else if (parts[0] == "f") { // Полигон
-            std::vector<int> faceIndices;
-            for (int i = 1; i < parts.size(); ++i) {
-                bool ok;
-                int index = parts[i].split("/")[0].toInt(&ok);
-                if (ok) {
-                    //throw std::runtime_error("Invalid face vertex index in line: " + line.toStdString());
-                    faceIndices.push_back(index - 1); // Индексы в OBJ начинаются с 1, а в векторе с 0
-                }
-            }
-
-            // Убедимся, что у нас есть ровно три вершины для полигона
-            if (faceIndices.size() >= 3) {
-                // throw std::runtime_error("Invalid face format, must have 3 vertices in line: " + line.toStdString());
-                // Создаем полигон и добавляем его в модель
-                Polygon poly(vertices[faceIndices[0]], vertices[faceIndices[1]], vertices[faceIndices[2]],
-                             _params._color, _params._transparency, _params._refractiveIndex, _params._reflectivity);
-                addPolygon(poly);
-            }
-
-        }
+    // Центр — среднее по вершинам треугольников, как и до перехода на общий буфер вершин
+    Vec3 center(0, 0, 0);
+    if (!indices.empty())
+    {
+        for (uint32_t index : indices)
+            center += vertices[index];
+        center = center * (1.0f / indices.size());
     }
+    for (Vec3 &v : vertices)
+        v -= center;
 
-    file.close(); // Закрываем файл
+    setMesh(std::make_shared<Mesh>(std::move(vertices), std::move(indices), std::move(faceNormals)));
+    setTransform(Transform::translate(center));
 }
 
-
-void PolygonalModel::scale(double k)
+std::shared_ptr<BaseObject> PolygonalModel::clone() const
 {
-    for (auto &p : polygons)
-    {
-        p.scale(position(), k);
-    }
+    return std::make_shared<PolygonalModel>(*this);
 }
 
-void PolygonalModel::rotate(const Vec3 &axis, double angle)
+int PolygonalModel::trianglesNum() const
 {
-    for (auto &p : polygons)
-        p.rotate(position(), axis, angle);
-    calculateBoundingSphere();
+    return mesh()->trianglesNum();
 }
 
-bool PolygonalModel::intersect(const Ray& ray, float& t) const {
-    if (!intersectBoundingSphere(ray)) return false;
-
-    bool hasHit = false;
-    float closestT = std::numeric_limits<float>::max();
-
-    for (const auto& poly : polygons) {
-        float currentT;
-        if (poly.intersect(ray, currentT) && currentT < closestT) {
-            closestT = currentT;
-            hasHit = true;
-        }
-    }
-
-    if (hasHit) {
-        t = closestT;
-    }
-    return hasHit;
+void PolygonalModel::setRefractionIndex(double refrIndex)
+{
+    _params._refractiveIndex = refrIndex;
 }
 
-GraphicParams PolygonalModel::hitParams(const Ray &ray, float t) const
+void PolygonalModel::setTransparency(double transparency)
 {
-    float closestT = std::numeric_limits<float>::max();
-    const Polygon *lastPoly = nullptr;
-    for (const auto& poly : polygons) {
-        float currentT;
-        if (poly.intersect(ray, currentT) && currentT < closestT) {
-            closestT = currentT;
-            lastPoly = &poly;
-        }
-    }
-    return lastPoly->hitParams(ray, t);
+    _params._transparency = transparency;
 }
 
-void PolygonalModel::addPolygon(const Polygon& poly) {
-    polygons.push_back(poly);
-    calculateBoundingSphere();
+ObjLoadStats PolygonalModel::load(const QString &filename)
+{
+    ObjLoadStats stats;
+    ObjGeometry geometry = loadObjGeometry(filename, &stats);
+
+    // Буферы загрузчика принимаются без копирования, BVH сетки строится один раз
+    auto start = std::chrono::steady_clock::now();
+    setGeometry(std::move(geometry.vertices), std::move(geometry.indices), std::move(geometry.faceNormals));
+    stats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
 }
@@ -1,32 +1,32 @@
 #ifndef __POLYGONALMODEL_H__
 #define __POLYGONALMODEL_H__
 
+#include <cstdint>
 #include <vector>
+#include "meshinstance.h"
+#include "objloader.h"
 #include "polygon.h"
 
-struct PolygonalModel : public BaseObject {
+// Модель из треугольников: экземпляр разделяемой сетки Mesh (общий буфер вершин, 32-битные индексы, BVH)
+// с одним материалом _params на всю модель. Вершины сетки хранятся относительно центра модели, поэтому
+// поворот и масштаб вокруг position() меняют только преобразование, а копии модели не копируют сетку
+struct PolygonalModel : public MeshInstance {
 public:
-    std::vector<Polygon> polygons;
-    Vec3 boundingSphereCenter;
-    float boundingSphereRadius;
-
+    // Совпадающие вершины полигонов объединяются; материалом модели становится материал первого полигона
     PolygonalModel(const std::vector<Polygon>& polys);
+    PolygonalModel(std::vector<Vec3> vertices, std::vector<uint32_t> indices, const GraphicParams &params = GraphicParams());
 
-    virtual bool intersect(const Ray& ray) const override;
-    virtual bool intersect(const Ray& ray, float& t) const override;
-
-    virtual Vec3 position() const override;
-    virtual void setPosition(const Vec3 &pos) override;
-    virtual GraphicParams hitParams(const Ray& ray, float t) const override;
+    virtual std::shared_ptr<BaseObject> clone() const override;
 
-    void addPolygon(const Polygon& poly);
-    void calculateBoundingSphere();
+    int trianglesNum() const;
     void setRefractionIndex(double refrIndex);
     void setTransparency(double transparency);
-    bool intersectBoundingSphere(const Ray& ray) const;
-    void load(const QString &filename);
-    void scale(double k);
-    void rotate(const Vec3& axis, double angle);
+    // Загрузка OBJ через loadObjGeometry; прежние поворот и масштаб сбрасываются
+    ObjLoadStats load(const QString &filename);
+
+private:
+    // Строит сетку из буферов в мировых координатах: вершины переносятся к центру, экземпляр — в центр
+    void setGeometry(std::vector<Vec3> vertices, std::vector<uint32_t> indices, std::vector<Vec3> faceNormals = {});
 };
 
 #endif // __POLYGONALMODEL_H__
@@ -2,123 +2,12 @@
 #include <ctime>
 #include <random>
 #include <algorithm>
-
-Vec3::Vec3() : x(0), y(0), z(0) {}
-
-Vec3::Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
-
-Vec3::Vec3(const Vec3 &other)
-{
-    x = other.x;
-    y = other.y;
-    z = other.z;
-}
-
-Vec3 &Vec3::operator=(const Vec3 &other)
-{
-    x = other.x;
-    y = other.y;
-    z = other.z;
-    return *this;
-}
-
-Vec3 Vec3::operator*(float b) const {
-    return Vec3(x * b, y * b, z * b);
-}
-
-Vec3 Vec3::operator/(float b) const {
-    return Vec3(x / b, y / b, z / b);
-}
-
-Vec3& Vec3::operator*=(float b) {
-    x *= b;
-    y *= b;
-    z *= b;
-    return *this;
-}
-
-Vec3& Vec3::operator*=(const Vec3 &b) {
-    x *= b.x;
-    y *= b.y;
-    z *= b.z;
-    return *this;
-}
-
-
-Vec3& Vec3::operator/=(float b) {
-    x /= b;
-    y /= b;
-    z /= b;
-    return *this;
-}
-
-bool Vec3::operator==(const Vec3 &obj) const
-{
-    return x == obj.x && y == obj.y && z == obj.z;
-}
-
-
-
-Vec3 Vec3::operator+(const Vec3& other) const {
-    return Vec3(x + other.x, y + other.y, z + other.z);
-}
-
-Vec3& Vec3::operator+=(const Vec3& other) {
-    x += other.x;
-    y += other.y;
-    z += other.z;
-    return *this;
-}
-
-Vec3 &Vec3::operator+=(const float &val)
-{
-    x += val;
-    y += val;
-    z += val;
-    return *this;
-}
-
-Vec3 Vec3::operator-() const {
-    return Vec3(-x, -y, -z);
-}
-
-Vec3 Vec3::operator-(const Vec3& other) const {
-    return Vec3(x - other.x, y - other.y, z - other.z);
-}
-
-Vec3& Vec3::operator-=(const Vec3& other) {
-    x -= other.x;
-    y -= other.y;
-    z -= other.z;
-    return *this;
-}
-
-
-Vec3 Vec3::operator*(const Vec3& other) const {
-    return Vec3(x * other.x, y * other.y, z * other.z);
-}
-
-float Vec3::operator[](const int &axes) const
-{
-    int r = axes % 3;
-    if (r == 0) return x;
-    else if (r == 1) return y;
-    else return z;
-}
-
-Vec3 Vec3::normalize() const {
-    float len = std::sqrt(x * x + y * y + z * z);
-    return Vec3(x / len, y / len, z / len);
-}
-
-float Vec3::dot(const Vec3& other) const {
-    return x * other.x + y * other.y + z * other.z;
-}
+#include <limits>
 
 Vec3 Vec3::randomUnitVector()
 {
-    static std::mt19937 gen(std::random_device{}());
-    static std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
 
     Vec3 p;
     do {
@@ -129,27 +18,9 @@ Vec3 Vec3::randomUnitVector()
 }
 
 
-Vec3 Vec3::cross(const Vec3& other) const {
-    return Vec3(
-        y * other.z - z * other.y,
-        z * other.x - x * other.z,
-        x * other.y - y * other.x
-        );
-}
-
-float Vec3::length() const
-{
-    return std::sqrt(x * x + y * y + z * z);
-}
-
-float Vec3::lengthSquared() const
-{
-    return x * x + y * y + z * z;
-}
-
 Vec3 Vec3::getRandomDirection()
 {
-    static std::default_random_engine generator(std::random_device{}());
+    thread_local std::default_random_engine generator(std::random_device{}());
     std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
 
     Vec3 dir(distribution(generator), distribution(generator), distribution(generator));
@@ -162,9 +33,11 @@ Vec3 Vec3::getRandomDirection()
 
 Vec3 Vec3::sampleHemisphere(const Vec3 &normal)
 {
-    // Генерируем случайные значения u1 и u2
-    float u1 = static_cast<float>(rand()) / RAND_MAX; // [0, 1)
-    float u2 = static_cast<float>(rand()) / RAND_MAX; // [0, 1)
+    // Генерируем случайные значения u1 и u2 (генератор свой у каждого потока)
+    thread_local std::mt19937 gen(std::random_device{}());
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    float u1 = dist(gen); // [0, 1)
+    float u2 = dist(gen); // [0, 1)
 
     // Преобразуем u1 в z-координату
     float z = u1; // z = cos(theta)
@@ -201,14 +74,9 @@ Vec3 Vec3::rotateAroundAxis(const Vec3 &v, const Vec3 &axis, float angle)
     return v * cosA + axis.cross(v) * sinA + axis * axis.dot(v) * (1 - cosA);
 }
 
-Vec3 Vec3::reflect(const Vec3 &incident, const Vec3 &normal)
-{
-    return incident - normal * 2.0f * incident.dot(normal);
-}
-
 Vec3 Vec3::refract(const Vec3 &incident, const Vec3 &normal, float etai, float etat)
 {
-    float cosi = std::clamp(-1.0f, 1.0f, incident.dot(normal));
+    float cosi = std::clamp(incident.dot(normal), -1.0f, 1.0f);
     Vec3 n = normal;
 
     if (cosi < 0)
@@ -237,7 +105,7 @@ Vec3 Vec3::refract(const Vec3 &incident, const Vec3 &normal, float etai, float e
 
 Vec3 Vec3::refract(const Vec3& incident, const Vec3& normal, float eta)
 {
-    float cosi = std::clamp(-1.0f, 1.0f, incident.dot(normal));
+    float cosi = std::clamp(incident.dot(normal), -1.0f, 1.0f);
     float etai = 1.0f;
     float etat = eta;
     Vec3 n = normal;
@@ -300,3 +168,74 @@ GraphicParams::GraphicParams()
     _refractiveIndex = 1;
     _transparency = 0;
 }
+
+float GraphicParams::refractiveIndexAt(float wavelength) const
+{
+    // Длины волн в мкм
+    float lambda = wavelength * 1e-3f;
+    const float reference = REFERENCE_WAVELENGTH * 1e-3f;
+    return _refractiveIndex + _cauchyB * (1.0f / (lambda * lambda) - 1.0f / (reference * reference));
+}
+
+Aabb::Aabb()
+    : min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()),
+    max(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max())
+{
+}
+
+Aabb::Aabb(const Vec3 &min, const Vec3 &max) : min(min), max(max) {}
+
+void Aabb::expand(const Vec3 &point)
+{
+    min = Vec3(std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z));
+    max = Vec3(std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z));
+}
+
+void Aabb::expand(const Aabb &box)
+{
+    expand(box.min);
+    expand(box.max);
+}
+
+bool Aabb::isEmpty() const
+{
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+Vec3 Aabb::center() const
+{
+    return (min + max) * 0.5f;
+}
+
+Vec3 Aabb::extent() const
+{
+    return max - min;
+}
+
+int Aabb::longestAxis() const
+{
+    Vec3 e = extent();
+    if (e.x >= e.y && e.x >= e.z) return 0;
+    return (e.y >= e.z) ? 1 : 2;
+}
+
+bool Aabb::intersect(const Vec3 &origin, const Vec3 &invDir, float tMax) const
+{
+    float t0 = 0.0f, t1 = tMax;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float tNear = (min[axis] - origin[axis]) * invDir[axis];
+        float tFar = (max[axis] - origin[axis]) * invDir[axis];
+        if (tNear > tFar) std::swap(tNear, tFar);
+        t0 = tNear > t0 ? tNear : t0;
+        t1 = tFar < t1 ? tFar : t1;
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+bool Aabb::intersect(const Ray &ray, float tMax) const
+{
+    Vec3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    return intersect(ray.origin, invDir, tMax);
+}
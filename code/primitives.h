@@ -4,58 +4,72 @@
 #include "qdebug.h"
 #include <cmath>
 #include <ostream>
+#include <type_traits>
 
+// Арифметика Vec3 определена в заголовке: операции встраиваются в горячие циклы
+// без LTO, а тривиальное копирование позволяет компилятору держать вектор в регистрах
 class Vec3 {
 public:
     float x, y, z;
 
 
-    Vec3();
-    Vec3(float x, float y, float z);
+    constexpr Vec3() : x(0), y(0), z(0) {}
+    constexpr Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
 
-    Vec3 (const Vec3 &other);
-    Vec3 &operator=(const Vec3 &other);
+    constexpr Vec3 operator*(float b) const { return Vec3(x * b, y * b, z * b); }
+    constexpr Vec3 operator/(float b) const { return Vec3(x / b, y / b, z / b); }
+    constexpr Vec3& operator*=(float b) { x *= b; y *= b; z *= b; return *this; }
+    constexpr Vec3& operator*=(const Vec3& b) { x *= b.x; y *= b.y; z *= b.z; return *this; }
+    constexpr Vec3& operator/=(float b) { x /= b; y /= b; z /= b; return *this; }
 
-    Vec3 operator*(float b) const;
-    Vec3 operator/(float b) const;
-    Vec3& operator*=(float b);
-    Vec3& operator*=(const Vec3& b);
-    Vec3& operator/=(float b);
+    constexpr bool operator==(const Vec3 &other) const { return x == other.x && y == other.y && z == other.z; }
 
-    bool operator==(const Vec3 &other) const;
+    constexpr Vec3 operator+(const Vec3& other) const { return Vec3(x + other.x, y + other.y, z + other.z); }
+    constexpr Vec3& operator+=(const Vec3& other) { x += other.x; y += other.y; z += other.z; return *this; }
 
-    Vec3 operator+(const Vec3& other) const;
-    Vec3& operator+=(const Vec3& other);
+    constexpr Vec3& operator+= (const float &val) { x += val; y += val; z += val; return *this; }
 
-    Vec3& operator+= (const float &val);
 
+    constexpr Vec3 operator-() const { return Vec3(-x, -y, -z); }
+    constexpr Vec3 operator-(const Vec3& other) const { return Vec3(x - other.x, y - other.y, z - other.z); }
+    constexpr Vec3& operator-=(const Vec3& other) { x -= other.x; y -= other.y; z -= other.z; return *this; }
 
-    Vec3 operator-() const;
-    Vec3 operator-(const Vec3& other) const;
-    Vec3& operator-=(const Vec3& other);
 
+    constexpr Vec3 operator*(const Vec3& other) const { return Vec3(x * other.x, y * other.y, z * other.z); }
 
-    Vec3 operator*(const Vec3& other) const;
-
-    float operator [](const int &axes) const;
+    constexpr float operator [](const int &axes) const
+    {
+        int r = axes % 3;
+        return r == 0 ? x : (r == 1 ? y : z);
+    }
 
 
-    Vec3 normalize() const;
+    Vec3 normalize() const
+    {
+        float len = std::sqrt(x * x + y * y + z * z);
+        return Vec3(x / len, y / len, z / len);
+    }
 
-    Vec3 cross(const Vec3& other) const;
+    constexpr Vec3 cross(const Vec3& other) const
+    {
+        return Vec3(y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x);
+    }
 
-    float length() const;
-    float lengthSquared() const;
+    float length() const { return std::sqrt(x * x + y * y + z * z); }
+    constexpr float lengthSquared() const { return x * x + y * y + z * z; }
 
 
-    float dot(const Vec3& other) const;
+    constexpr float dot(const Vec3& other) const { return x * other.x + y * other.y + z * other.z; }
 
     static Vec3 randomUnitVector();
     static Vec3 getRandomDirection();
     static Vec3 sampleHemisphere(const Vec3 &normal);
 
     static Vec3 rotateAroundAxis(const Vec3 &v, const Vec3 &axis, float angle);
-    static Vec3 reflect(const Vec3 &incident, const Vec3 &normal);
+    static constexpr Vec3 reflect(const Vec3 &incident, const Vec3 &normal)
+    {
+        return incident - normal * 2.0f * incident.dot(normal);
+    }
     static Vec3 refract(const Vec3 &incident, const Vec3 &normal, float etai, float etat);
     static Vec3 refract(const Vec3& incident, const Vec3& normal, float eta);
 
@@ -72,6 +86,9 @@ public:
 
 };
 
+static_assert(std::is_trivially_copyable<Vec3>::value, "Vec3 must stay trivially copyable");
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 must be three packed floats");
+
 
 
 struct LightColor {
@@ -79,6 +96,9 @@ struct LightColor {
     float intensity;    // Интенсивность света
 };
 
+// Длина волны, для которой задан GraphicParams::_refractiveIndex (линия d гелия), нм
+const float REFERENCE_WAVELENGTH = 587.6f;
+
 struct GraphicParams{
     Vec3 _color;
     float _transparency;
@@ -86,9 +106,14 @@ struct GraphicParams{
     float _reflectivity;
     Vec3 _normal;
     LightColor _emission = {Vec3(0.0f, 0.0f, 0.0f), 0};
-    float _refractionDeltaR = -0.005f;
-    float _refractionDeltaB = +0.004f;
+    // Коэффициент B формулы Коши n(λ) = A + B / λ², мкм²; A подбирается так, чтобы
+    // на опорной длине волны REFERENCE_WAVELENGTH показатель был равен _refractiveIndex.
+    // Значение по умолчанию соответствует стеклу BK7, 0 — материал без дисперсии
+    float _cauchyB = 0.0042f;
     GraphicParams();
+
+    // Показатель преломления для длины волны в нм
+    float refractiveIndexAt(float wavelength) const;
 };
 
 struct Ray {
@@ -97,9 +122,31 @@ struct Ray {
     Vec3 direction;
     bool insideObject;
     float previousRefraction;
+    // Длина волны, к которой свернут путь после дисперсии, нм; 0 — луч переносит весь спектр
+    float wavelength = 0.0f;
 
     Ray(const Vec3& o, const Vec3& d, bool inside = false, float refraction = 1.0f);
 };
 
+// Ограничивающий параллелепипед, выровненный по осям
+struct Aabb {
+    Vec3 min;
+    Vec3 max;
+
+    Aabb();
+    Aabb(const Vec3 &min, const Vec3 &max);
+
+    void expand(const Vec3 &point);
+    void expand(const Aabb &box);
+    bool isEmpty() const;
+    Vec3 center() const;
+    Vec3 extent() const;
+    int longestAxis() const;
+
+    // Проверка пересечения со слоями (slab test), invDir = 1 / direction
+    bool intersect(const Vec3 &origin, const Vec3 &invDir, float tMax) const;
+    bool intersect(const Ray &ray, float tMax) const;
+};
+
 
 #endif // PRIMITIVES_H
@@ -0,0 +1,47 @@
+#include "progressive.h"
+
+namespace
+{
+
+float radicalInverse(int index, int base)
+{
+    float result = 0;
+    float digit = 1.0f / base;
+    for (; index > 0; index /= base, digit /= base)
+        result += (index % base) * digit;
+    return result;
+}
+
+}
+
+bool RenderPass::contains(int x, int y) const
+{
+    if (x % stride != 0 || y % stride != 0)
+        return false;
+    return !(skipCoarse && x % (2 * stride) == 0 && y % (2 * stride) == 0);
+}
+
+std::vector<RenderPass> makeRenderPasses(bool progressive, int samplesPerPixel)
+{
+    std::vector<RenderPass> passes;
+
+    int firstStride = progressive ? PROGRESSIVE_MAX_STRIDE : 1;
+    for (int stride = firstStride; stride >= 1; stride /= 2)
+    {
+        RenderPass pass;
+        pass.stride = stride;
+        pass.skipCoarse = stride != firstStride;
+        passes.push_back(pass);
+    }
+
+    // Первый сэмпл берется в центре пикселя, остальные — по последовательности Халтона (2, 3)
+    for (int sample = 1; sample < samplesPerPixel; ++sample)
+    {
+        RenderPass pass;
+        pass.sampleIndex = sample;
+        pass.offsetX = radicalInverse(sample, 2);
+        pass.offsetY = radicalInverse(sample, 3);
+        passes.push_back(pass);
+    }
+    return passes;
+}
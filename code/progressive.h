@@ -0,0 +1,30 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include <vector>
+
+// Наибольший шаг сетки пикселей первого, самого грубого прохода
+const int PROGRESSIVE_MAX_STRIDE = 8;
+
+// Один проход прогрессивного рендеринга.
+// Проход с шагом stride считает пиксели с координатами, кратными stride, и заливает их цветом
+// блок stride x stride, пока более мелкие проходы его не уточнят
+struct RenderPass
+{
+    int stride = 1;
+    // Пропускать пиксели, уже посчитанные проходом с шагом 2 * stride
+    bool skipCoarse = false;
+    // Номер сэмпла пикселя: проходы с номером больше 0 накапливаются в среднее
+    int sampleIndex = 0;
+    // Положение сэмпла внутри пикселя
+    float offsetX = 0.5f;
+    float offsetY = 0.5f;
+
+    bool contains(int x, int y) const;
+};
+
+// Последовательность проходов: от шага PROGRESSIVE_MAX_STRIDE до 1 (если progressive),
+// затем по полному проходу на каждый дополнительный сэмпл со смещением из последовательности Халтона
+std::vector<RenderPass> makeRenderPasses(bool progressive, int samplesPerPixel);
+
+#endif // PROGRESSIVE_H
@@ -0,0 +1,69 @@
+#include "raypacket.h"
+
+void Frustum::build(const Vec3 &o, const Vec3 corners[4])
+{
+    origin = o;
+    Vec3 center = corners[0] + corners[1] + corners[2] + corners[3];
+    for (int i = 0; i < 4; ++i)
+    {
+        Vec3 n = corners[i].cross(corners[(i + 1) % 4]);
+        // Нормаль направлена внутрь пирамиды
+        if (n.dot(center) < 0)
+            n = -n;
+        normals[i] = n;
+    }
+}
+
+bool Frustum::outside(const Aabb &box) const
+{
+    for (const auto &n : normals)
+    {
+        // Вершина параллелепипеда, наиболее удаленная в направлении нормали
+        Vec3 p(n.x >= 0 ? box.max.x : box.min.x,
+               n.y >= 0 ? box.max.y : box.min.y,
+               n.z >= 0 ? box.max.z : box.min.z);
+        if (n.dot(p - origin) < 0)
+            return true;
+    }
+    return false;
+}
+
+void RayPacket::reset()
+{
+    for (int r = 0; r < PACKET_DIM; ++r)
+    {
+        activeMask[r] = 0;
+        for (int l = 0; l < SIMD_WIDTH; ++l)
+        {
+            rows[r].ox[l] = rows[r].oy[l] = rows[r].oz[l] = 0.0f;
+            rows[r].dx[l] = 1.0f;
+            rows[r].dy[l] = rows[r].dz[l] = 0.0f;
+        }
+    }
+    for (auto &hit : hits)
+        hit = HitRecord();
+}
+
+void RayPacket::setRay(int index, const Ray &ray)
+{
+    int r = index / PACKET_DIM, l = index % PACKET_DIM;
+    rows[r].ox[l] = ray.origin.x;
+    rows[r].oy[l] = ray.origin.y;
+    rows[r].oz[l] = ray.origin.z;
+    rows[r].dx[l] = ray.direction.x;
+    rows[r].dy[l] = ray.direction.y;
+    rows[r].dz[l] = ray.direction.z;
+    activeMask[r] |= 1 << l;
+}
+
+Ray RayPacket::ray(int index) const
+{
+    int r = index / PACKET_DIM, l = index % PACKET_DIM;
+    return Ray(Vec3(rows[r].ox[l], rows[r].oy[l], rows[r].oz[l]),
+               Vec3(rows[r].dx[l], rows[r].dy[l], rows[r].dz[l]));
+}
+
+bool RayPacket::isActive(int index) const
+{
+    return activeMask[index / PACKET_DIM] & (1 << (index % PACKET_DIM));
+}
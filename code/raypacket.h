@@ -0,0 +1,38 @@
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+#include "primitives.h"
+#include "simdintersect.h"
+#include "sceneintersector.h"
+
+// Сторона тайла первичных лучей: пакет покрывает 8×8 пикселей
+constexpr int PACKET_DIM = 8;
+constexpr int PACKET_SIZE = PACKET_DIM * PACKET_DIM;
+
+// Пирамида видимости пакета лучей с общим началом
+struct Frustum
+{
+    Vec3 origin;
+    Vec3 normals[4];
+
+    // corners — направления через углы тайла в порядке обхода по контуру
+    void build(const Vec3 &origin, const Vec3 corners[4]);
+    // true, если параллелепипед целиком лежит вне пирамиды
+    bool outside(const Aabb &box) const;
+};
+
+// Пакет когерентных первичных лучей: строка тайла — одна SIMD-группа из 8 лучей
+struct RayPacket
+{
+    RayLanes8 rows[PACKET_DIM];
+    int activeMask[PACKET_DIM];
+    HitRecord hits[PACKET_SIZE];
+    Frustum frustum;
+
+    void reset();
+    void setRay(int index, const Ray &ray);
+    Ray ray(int index) const;
+    bool isActive(int index) const;
+};
+
+#endif // RAYPACKET_H
@@ -5,9 +5,12 @@
 RenderingWidget::RenderingWidget(QWidget *parent)
     : QWidget(parent),
     imageLabel(new QLabel(this)),
-    progressBar(new QProgressBar(this)) {
+    progressBar(new QProgressBar(this)),
+    smoothScaleTimer(new QTimer(this)) {
 
     imageLabel->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    // Кадр другого разрешения выводится с сохранением пропорций по центру
+    imageLabel->setAlignment(Qt::AlignCenter);
     progressBar->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
     auto layout = new QVBoxLayout(this);
     layout->addWidget(imageLabel);
@@ -16,8 +19,10 @@ RenderingWidget::RenderingWidget(QWidget *parent)
     progressBar->setRange(0, 100);
     progressBar->setValue(0);
 
-    connect(this, &RenderingWidget::imageSizeChanged, this, [this]() {
-        updateScaledImage();
+    smoothScaleTimer->setSingleShot(true);
+    smoothScaleTimer->setInterval(150);
+    connect(smoothScaleTimer, &QTimer::timeout, this, [this]() {
+        updateScaledImage(Qt::SmoothTransformation);
     });
     setLayout(layout);
 }
@@ -26,14 +31,8 @@ QSize RenderingWidget::getImageWidgetSize() const {
     return imageLabel->size();
 }
 
-void RenderingWidget::setImage(const std::vector<Vec3>& buffer, int width, int height) {
-    currentImage = QImage(width, height, QImage::Format_RGB32);
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            const Vec3& pixel = buffer[y * width + x];
-            currentImage.setPixel(x, y, qRgb(pixel.x * 255, pixel.y * 255, pixel.z * 255));
-        }
-    }
+void RenderingWidget::setImage(const QImage& image) {
+    currentImage = image;
     updateScaledImage();
 }
 
@@ -41,6 +40,10 @@ void RenderingWidget::setProgress(double percent) {
     progressBar->setValue(percent);
 }
 
+void RenderingWidget::setStatus(const QString &text) {
+    progressBar->setFormat(text);
+}
+
 void RenderingWidget::setPixelColor(int x, int y, const Vec3& color) {
     if (x >= 0 && x < currentImage.width() && y >= 0 && y < currentImage.height()) {
         currentImage.setPixel(x, y, qRgb(color.x * 255, color.y * 255, color.z * 255));
@@ -48,14 +51,19 @@ void RenderingWidget::setPixelColor(int x, int y, const Vec3& color) {
     }
 }
 
-void RenderingWidget::updateScaledImage() {
-    if (!currentImage.isNull()) {
-        imageLabel->setPixmap(QPixmap::fromImage(currentImage.scaled(imageLabel->size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation)));
-    }
+void RenderingWidget::updateScaledImage(Qt::TransformationMode mode) {
+    if (currentImage.isNull())
+        return;
+    if (currentImage.size() == imageLabel->size())
+        imageLabel->setPixmap(QPixmap::fromImage(currentImage));
+    else
+        imageLabel->setPixmap(QPixmap::fromImage(currentImage.scaled(imageLabel->size(), Qt::KeepAspectRatio, mode)));
 }
 
 void RenderingWidget::resizeEvent(QResizeEvent* event) {
-    updateScaledImage();
+    // Пока размер меняется, изображение масштабируется быстро, сглаженно — после паузы
+    updateScaledImage(Qt::FastTransformation);
+    smoothScaleTimer->start();
     emit imageSizeChanged(imageLabel->size());
     QWidget::resizeEvent(event);
 }
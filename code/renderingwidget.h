@@ -6,6 +6,7 @@
 #include <QImage>
 #include <QVBoxLayout>
 #include <QLabel>
+#include <QTimer>
 #include <vector>
 #include "primitives.h"
 
@@ -20,8 +21,11 @@ protected:
     void resizeEvent(QResizeEvent* event) override;
 
 public slots:
-    void setImage(const std::vector<Vec3>& buffer, int width, int height);
+    // Готовое изображение из отрисовщика; при совпадении размеров выводится без масштабирования
+    void setImage(const QImage& image);
     void setProgress(double percent);
+    // Подпись индикатора прогресса, %p заменяется процентом
+    void setStatus(const QString &text);
     void setPixelColor(int x, int y, const Vec3& color);
 
 signals:
@@ -31,8 +35,10 @@ private:
     QLabel *imageLabel;
     QProgressBar *progressBar;
     QImage currentImage;
+    // Сглаженное масштабирование откладывается до окончания изменения размера
+    QTimer *smoothScaleTimer;
 
-    void updateScaledImage();
+    void updateScaledImage(Qt::TransformationMode mode = Qt::SmoothTransformation);
 };
 
 
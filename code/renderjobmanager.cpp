@@ -0,0 +1,151 @@
+#include "renderjobmanager.h"
+#include <algorithm>
+#include <vector>
+
+RenderJobManager::RenderJobManager(QObject *parent)
+    : QObject(parent)
+{
+    _thread = std::thread(&RenderJobManager::workerLoop, this);
+}
+
+RenderJobManager::~RenderJobManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+        _queue.clear();
+        if (_hasRunning)
+            *_running.cancelled = true;
+    }
+    _wakeUp.notify_all();
+    _thread.join();
+}
+
+int RenderJobManager::submit(RenderJobKind kind, RenderJobPriority priority, const Work &work)
+{
+    Job job;
+    job.kind = kind;
+    job.priority = priority;
+    job.work = work;
+    job.cancelled = std::make_shared<std::atomic<bool>>(false);
+
+    std::vector<int> superseded;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        job.id = _nextId++;
+
+        // Устаревшими считаются ожидающие задания того же вида и приоритета. Ожидающее чистовое задание
+        // черновым не удаляется, а выполняется после него, как и прерванное выполняющееся
+        for (auto it = _queue.begin(); it != _queue.end();)
+        {
+            if (it->kind == kind && it->priority == priority)
+            {
+                superseded.push_back(it->id);
+                it = _queue.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        // Выполняющееся чистовое задание уступает черновому и после него выполняется заново
+        if (_hasRunning && _running.kind == kind && _running.priority <= priority)
+        {
+            _preempted = _running.priority < priority;
+            *_running.cancelled = true;
+        }
+
+        _queue.push_back(job);
+    }
+    _wakeUp.notify_all();
+
+    for (int id : superseded)
+        emit jobFinished(id, true);
+    return job.id;
+}
+
+void RenderJobManager::cancelAll()
+{
+    std::vector<int> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &job : _queue)
+            cancelled.push_back(job.id);
+        _queue.clear();
+        if (_hasRunning)
+            *_running.cancelled = true;
+        _preempted = false;
+    }
+    _idle.notify_all();
+
+    for (int id : cancelled)
+        emit jobFinished(id, true);
+}
+
+bool RenderJobManager::busy() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hasRunning || !_queue.empty();
+}
+
+void RenderJobManager::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this]() { return !_hasRunning && _queue.empty(); });
+}
+
+void RenderJobManager::workerLoop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeUp.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+            if (_stopping)
+                return;
+            takeJob(job);
+            _running = job;
+            _hasRunning = true;
+        }
+
+        emit jobStarted(job.id);
+        job.work(*job.cancelled);
+
+        bool requeued = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_preempted && !_stopping)
+            {
+                job.cancelled = std::make_shared<std::atomic<bool>>(false);
+                _queue.push_back(job);
+                requeued = true;
+            }
+            _preempted = false;
+            _hasRunning = false;
+            _running = Job();
+        }
+        if (!requeued)
+            emit jobFinished(job.id, *job.cancelled);
+        _idle.notify_all();
+    }
+}
+
+bool RenderJobManager::takeJob(Job &job)
+{
+    if (_queue.empty())
+        return false;
+
+    // Кадры зависят от фотонной карты, поэтому ожидающая карта строится раньше любого кадра
+    auto before = [](const Job &a, const Job &b) {
+        if (a.kind != b.kind)
+            return a.kind < b.kind;
+        if (a.priority != b.priority)
+            return a.priority > b.priority;
+        return a.id < b.id;
+    };
+    auto best = std::min_element(_queue.begin(), _queue.end(), before);
+    job = std::move(*best);
+    _queue.erase(best);
+    return true;
+}
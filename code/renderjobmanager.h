@@ -0,0 +1,82 @@
+#ifndef RENDERJOBMANAGER_H
+#define RENDERJOBMANAGER_H
+
+#include <QObject>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Вид задания: ожидающий расчет фотонной карты выполняется раньше любых кадров
+enum class RenderJobKind
+{
+    PhotonMap,
+    Frame
+};
+
+// Среди заданий одного вида черновые обслуживаются раньше чистовых
+enum class RenderJobPriority
+{
+    Final,
+    Preview
+};
+
+// Очередь заданий рендеринга, выполняемых по одному в отдельном потоке вне потока интерфейса.
+// Новое задание вытесняет задания того же вида: ожидающие задания того же приоритета удаляются
+// из очереди, выполняющемуся с приоритетом не выше нового выставляется флаг отмены, который задание
+// проверяет само. Ожидающее чистовое задание остается в очереди после нового чернового,
+// а прерванное черновым возвращается в очередь и выполняется заново.
+// Сигналы испускаются из рабочего потока и доставляются получателям через очередь событий
+class RenderJobManager : public QObject
+{
+    Q_OBJECT
+public:
+    using Work = std::function<void(const std::atomic<bool> &cancelled)>;
+
+    explicit RenderJobManager(QObject *parent = nullptr);
+    ~RenderJobManager();
+
+    // Возвращает номер задания
+    int submit(RenderJobKind kind, RenderJobPriority priority, const Work &work);
+    void cancelAll();
+    // Есть ли ожидающие или выполняющиеся задания
+    bool busy() const;
+    // Дожидается опустошения очереди
+    void waitIdle();
+
+signals:
+    void jobStarted(int id);
+    void jobFinished(int id, bool cancelled);
+
+private:
+    struct Job
+    {
+        int id = 0;
+        RenderJobKind kind = RenderJobKind::Frame;
+        RenderJobPriority priority = RenderJobPriority::Final;
+        Work work;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    void workerLoop();
+    // Снимает с очереди следующее задание: карты раньше кадров, затем по приоритету и порядку постановки
+    bool takeJob(Job &job);
+
+    std::deque<Job> _queue;
+    Job _running;
+    bool _hasRunning = false;
+    // Выполняющееся задание прервано заданием более высокого приоритета
+    bool _preempted = false;
+    int _nextId = 1;
+    bool _stopping = false;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    std::condition_variable _idle;
+    std::thread _thread;
+};
+
+#endif // RENDERJOBMANAGER_H
@@ -0,0 +1,68 @@
+#include "renderprogress.h"
+#include <algorithm>
+
+double StageTiming::rate() const
+{
+    return seconds > 0 ? items / seconds : 0.0;
+}
+
+void RenderProgress::begin(RenderStage stage, long long total)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _done = 0;
+    _items = 0;
+    _total = std::max(1LL, total);
+    _start = std::chrono::steady_clock::now();
+    _stage = stage;
+}
+
+void RenderProgress::advance(long long done)
+{
+    _done.fetch_add(done, std::memory_order_relaxed);
+}
+
+void RenderProgress::addItems(long long items)
+{
+    _items.fetch_add(items, std::memory_order_relaxed);
+}
+
+void RenderProgress::finish()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    StageTiming timing = current();
+    if (_stage == RenderStage::PhotonMap)
+        _timings.photonMap = timing;
+    else if (_stage == RenderStage::Frame)
+        _timings.frame = timing;
+    _done = _total.load();
+    _stage = RenderStage::Idle;
+}
+
+RenderStage RenderProgress::stage() const
+{
+    return _stage;
+}
+
+double RenderProgress::fraction() const
+{
+    return std::min(1.0, (double)_done.load(std::memory_order_relaxed) / _total.load(std::memory_order_relaxed));
+}
+
+RenderStageTimings RenderProgress::timings() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    RenderStageTimings timings = _timings;
+    if (_stage == RenderStage::PhotonMap)
+        timings.photonMap = current();
+    else if (_stage == RenderStage::Frame)
+        timings.frame = current();
+    return timings;
+}
+
+StageTiming RenderProgress::current() const
+{
+    StageTiming timing;
+    timing.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    timing.items = _items.load(std::memory_order_relaxed);
+    return timing;
+}
@@ -0,0 +1,64 @@
+#ifndef RENDERPROGRESS_H
+#define RENDERPROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+enum class RenderStage
+{
+    Idle,
+    PhotonMap,
+    Frame
+};
+
+// Время и объем работы одного этапа: число выпущенных фотонов или оттрассированных лучей
+struct StageTiming
+{
+    double seconds = 0;
+    long long items = 0;
+
+    // Единиц работы в секунду
+    double rate() const;
+};
+
+// Показатели последних завершенных (или текущих) этапов
+struct RenderStageTimings
+{
+    StageTiming photonMap;
+    StageTiming frame;
+};
+
+// Прогресс текущего этапа в атомарных счетчиках.
+// Рабочие потоки только увеличивают счетчики порциями (тайл, порция фотонов),
+// интерфейс опрашивает их по таймеру, без событий на каждую единицу работы
+class RenderProgress
+{
+public:
+    void begin(RenderStage stage, long long total);
+    // Выполнена часть этапа
+    void advance(long long done);
+    // Обработано items фотонов или лучей
+    void addItems(long long items);
+    void finish();
+
+    RenderStage stage() const;
+    // Доля выполненного этапа в [0, 1]
+    double fraction() const;
+    // Для текущего этапа время и объем работы учитываются на момент вызова
+    RenderStageTimings timings() const;
+
+private:
+    StageTiming current() const;
+
+    std::atomic<RenderStage> _stage{RenderStage::Idle};
+    std::atomic<long long> _done{0};
+    std::atomic<long long> _total{0};
+    std::atomic<long long> _items{0};
+
+    mutable std::mutex _mutex;
+    std::chrono::steady_clock::time_point _start;
+    RenderStageTimings _timings;
+};
+
+#endif // RENDERPROGRESS_H
@@ -0,0 +1,52 @@
+#include "rendertarget.h"
+#include <algorithm>
+#include <cmath>
+
+RenderTarget::RenderTarget(int width, int height, float previewScale)
+{
+    setSize(width, height);
+    setPreviewScale(previewScale);
+}
+
+int RenderTarget::width() const
+{
+    return _width;
+}
+
+int RenderTarget::height() const
+{
+    return _height;
+}
+
+void RenderTarget::setSize(int width, int height)
+{
+    _width = std::max(0, width);
+    _height = std::max(0, height);
+}
+
+bool RenderTarget::fixedSize() const
+{
+    return _width > 0 && _height > 0;
+}
+
+float RenderTarget::previewScale() const
+{
+    return _previewScale;
+}
+
+void RenderTarget::setPreviewScale(float newPreviewScale)
+{
+    _previewScale = std::min(1.0f, std::max(0.01f, newPreviewScale));
+}
+
+QSize RenderTarget::frameSize(bool preview, const QSize &displaySize) const
+{
+    QSize size = fixedSize() ? QSize(_width, _height) : displaySize;
+    if (!preview)
+        return size;
+
+    // Пропорции сохраняются, но кадр не меньше одного пикселя по каждой оси
+    int width = std::max(1, (int)std::lround(size.width() * _previewScale));
+    int height = std::max(1, (int)std::lround(size.height() * _previewScale));
+    return QSize(width, height);
+}
@@ -0,0 +1,33 @@
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include <QSize>
+
+// Разрешение, в котором строится кадр. Виджет только выводит готовое изображение.
+// Нулевой размер означает кадр по размеру области вывода.
+// Черновые кадры строятся в previewScale от полного разрешения
+class RenderTarget
+{
+public:
+    RenderTarget() = default;
+    RenderTarget(int width, int height, float previewScale = 0.25f);
+
+    int width() const;
+    int height() const;
+    void setSize(int width, int height);
+    // Размер задан явно и не зависит от области вывода
+    bool fixedSize() const;
+
+    float previewScale() const;
+    void setPreviewScale(float newPreviewScale);
+
+    // Размер кадра для задания; displaySize используется, только если размер не задан явно
+    QSize frameSize(bool preview, const QSize &displaySize) const;
+
+private:
+    int _width = 0;
+    int _height = 0;
+    float _previewScale = 0.25f;
+};
+
+#endif // RENDERTARGET_H
@@ -1,12 +1,51 @@
 #include "scene.h"
+#include <stdexcept>
 
 Scene::Scene() {
     updatePhotonMap({}, {}, 1);
 }
 
+std::shared_ptr<Scene> Scene::snapshot() const
+{
+    auto copy = std::make_shared<Scene>();
+    std::vector<std::shared_ptr<Lens>> lenses;
+    copy->_objects.reserve(_objects.size());
+    for (const auto &obj : _objects)
+    {
+        copy->_objects.push_back(obj->clone());
+        if (_lensSystem && _lensSystem->contains(obj.get()))
+        {
+            if (auto lens = std::dynamic_pointer_cast<Lens>(copy->_objects.back()))
+                lenses.push_back(lens);
+        }
+    }
+    for (const auto &light : _lights)
+        copy->_lights.push_back(std::make_shared<Light>(*light));
+    if (_camera)
+        copy->_camera = std::make_shared<Camera>(*_camera);
+
+    // Явная стопка линз собирается заново из копий; если правки ее нарушили, снимок ищет стопку сам
+    if (!lenses.empty())
+    {
+        try
+        {
+            copy->_lensSystem = std::make_shared<SequentialLensSystem>(lenses);
+        }
+        catch (const std::runtime_error &)
+        {
+            copy->_lensSystem = nullptr;
+        }
+    }
+
+    copy->_lighting = _lighting;
+    copy->_revision = _revision.load();
+    return copy;
+}
+
 void Scene::addObject(const std::shared_ptr<BaseObject> &obj)
 {
     _objects.push_back(obj);
+    markChanged();
 }
 
 void Scene::addLight(const std::shared_ptr<Light> light)
@@ -36,21 +75,61 @@ void Scene::setCamera(const std::shared_ptr<Camera> &newCamera)
 
 const PhotonTree &Scene::photonMap() const
 {
-    return _photonMap;
+    return _lighting->photonMap;
 }
 
-void Scene::updatePhotonMap(const std::vector<Photon> &photons, const std::vector<Photon> &causticsPhotons, int k)
+void Scene::updatePhotonMap(const std::vector<Photon> &photons, const std::vector<Photon> &causticsPhotons, int k, bool indirectOnly)
 {
-    _photonMap = PhotonTree(photons, k);
-    _causticsPhotonMap = PhotonTree(causticsPhotons, k);
+    _lighting->photonMap = PhotonTree(photons, k);
+    _lighting->causticsPhotonMap = PhotonTree(causticsPhotons, k);
+    _lighting->photonMapIndirectOnly = indirectOnly;
+    _lighting->irradianceCache.reset();
+}
+
+bool Scene::photonMapIndirectOnly() const
+{
+    return _lighting->photonMapIndirectOnly;
 }
 
 void Scene::setCausticsPhotonMap(const PhotonTree &newCausticsPhotonMap)
 {
-    _causticsPhotonMap = newCausticsPhotonMap;
+    _lighting->causticsPhotonMap = newCausticsPhotonMap;
 }
 
 const PhotonTree &Scene::causticsPhotonMap() const
 {
-    return _causticsPhotonMap;
+    return _lighting->causticsPhotonMap;
+}
+
+std::shared_ptr<SequentialLensSystem> Scene::lensSystem() const
+{
+    return _lensSystem;
+}
+
+void Scene::setLensSystem(const std::shared_ptr<SequentialLensSystem> &newLensSystem)
+{
+    _lensSystem = newLensSystem;
+}
+
+unsigned Scene::revision() const
+{
+    return _revision;
+}
+
+void Scene::markChanged()
+{
+    ++_revision;
+}
+
+std::shared_ptr<IrradianceCache> Scene::irradianceCache() const
+{
+    if (_lighting->irradianceCacheRevision != _revision)
+        return nullptr;
+    return _lighting->irradianceCache;
+}
+
+void Scene::setIrradianceCache(const std::shared_ptr<IrradianceCache> &newIrradianceCache)
+{
+    _lighting->irradianceCache = newIrradianceCache;
+    _lighting->irradianceCacheRevision = _revision;
 }
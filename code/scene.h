@@ -5,16 +5,35 @@
 #include "light.h"
 #include "camera.h"
 #include "photon.h"
+#include "irradiancecache.h"
+#include "sequentiallens.h"
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <QObject>
 
 
+// Освещение сцены, которое строят и читают задания рендеринга: фотонные карты и кэш освещенности.
+// Оно общее у сцены и всех ее снимков, поэтому карта, построенная по снимку, видна следующим заданиям.
+// Задания выполняются по одному в рабочем потоке, поток интерфейса освещение не трогает
+struct SceneLighting
+{
+    PhotonTree photonMap;
+    PhotonTree causticsPhotonMap;
+    bool photonMapIndirectOnly = false;
+    std::shared_ptr<IrradianceCache> irradianceCache;
+    // Правка сцены, для которой построен кэш
+    unsigned irradianceCacheRevision = 0;
+};
+
 class Scene : public QObject
 {
     Q_OBJECT
 public:
     Scene();
+    // Снимок для задания рендеринга: копии объектов, источников и камеры с общим освещением.
+    // Правки исходной сцены в потоке интерфейса не затрагивают снимок, с которым работает задание
+    std::shared_ptr<Scene> snapshot() const;
     void addObject(const std::shared_ptr<BaseObject> &obj);
     void addLight(const std::shared_ptr<Light> light);
     std::vector<std::shared_ptr<BaseObject> > objects() const;
@@ -25,11 +44,27 @@ public:
     void setCamera(const std::shared_ptr<Camera> &newCamera);
 
     const PhotonTree &photonMap() const;
-    void updatePhotonMap(const std::vector<Photon> &photons, const std::vector<Photon> &causticsPhotons, int k);
+    // indirectOnly — глобальная карта построена без первых попаданий, прямой свет считается теневыми лучами
+    void updatePhotonMap(const std::vector<Photon> &photons, const std::vector<Photon> &causticsPhotons, int k, bool indirectOnly = false);
+    bool photonMapIndirectOnly() const;
     void setCausticsPhotonMap(const PhotonTree &newCausticsPhotonMap);
 
     const PhotonTree &causticsPhotonMap() const;
 
+    // Номер правки сцены: растет при добавлении объектов и изменении их параметров
+    unsigned revision() const;
+    void markChanged();
+
+    // Кэш освещенности переживает кадры и сбрасывается вместе с фотонной картой. Кэш, построенный
+    // до последней правки сцены, не возвращается
+    std::shared_ptr<IrradianceCache> irradianceCache() const;
+    void setIrradianceCache(const std::shared_ptr<IrradianceCache> &newIrradianceCache);
+
+
+    // Явно заданная последовательная система линз; если не задана, стопка ищется среди объектов сцены
+    std::shared_ptr<SequentialLensSystem> lensSystem() const;
+    void setLensSystem(const std::shared_ptr<SequentialLensSystem> &newLensSystem);
+
 signals:
     void progressNameChanged(const QString &);
     void progressChanged(const double &);
@@ -39,8 +74,10 @@ protected:
     std::vector<std::shared_ptr<BaseObject>> _objects;
     std::vector<std::shared_ptr<Light>> _lights;
     std::shared_ptr<Camera> _camera;
-    PhotonTree _photonMap;
-    PhotonTree _causticsPhotonMap;
+    // Правки приходят из потока интерфейса, пока рендеринг идет в рабочем потоке
+    std::atomic<unsigned> _revision{0};
+    std::shared_ptr<SceneLighting> _lighting = std::make_shared<SceneLighting>();
+    std::shared_ptr<SequentialLensSystem> _lensSystem;
 };
 
 #endif // SCENE_H
@@ -0,0 +1,261 @@
+#include "sceneintersector.h"
+#include <algorithm>
+#include "raypacket.h"
+#include "sphere.h"
+#include "thinlens.h"
+#include "sequentiallens.h"
+
+namespace
+{
+
+// Упорядочивает объекты по кривой Мортона, чтобы соседние в SoA-блоке примитивы были близки в пространстве
+template <typename T>
+std::vector<const T *> sortByMorton(std::vector<const T *> objs)
+{
+    Aabb bounds;
+    for (const auto *o : objs)
+        bounds.expand(o->position());
+
+    std::vector<std::pair<uint32_t, const T *>> keyed;
+    keyed.reserve(objs.size());
+    for (const auto *o : objs)
+        keyed.emplace_back(mortonCode(o->position(), bounds), o);
+    std::stable_sort(keyed.begin(), keyed.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    for (size_t i = 0; i < keyed.size(); ++i)
+        objs[i] = keyed[i].second;
+    return objs;
+}
+
+}
+
+SceneIntersector::SceneIntersector(const std::vector<std::shared_ptr<BaseObject>> &objects)
+{
+    build(objects);
+}
+
+void SceneIntersector::build(const std::vector<std::shared_ptr<BaseObject>> &objects)
+{
+    _objects = objects;
+    _spheres.clear();
+    _sphereObjects.clear();
+    _lenses.clear();
+    _lensObjects.clear();
+    _otherObjects.clear();
+    _items.clear();
+    _lensSystem.reset();
+
+    std::vector<const Sphere *> spheres;
+    std::vector<const Lens *> lenses;
+    for (const auto &o : _objects)
+    {
+        if (auto sphere = dynamic_cast<const Sphere *>(o.get()))
+            spheres.push_back(sphere);
+        else if (auto lens = dynamic_cast<const Lens *>(o.get()))
+            lenses.push_back(lens);
+        else
+            _otherObjects.push_back(o.get());
+    }
+
+    std::vector<Aabb> boxes;
+
+    for (const auto *sphere : sortByMorton(spheres))
+    {
+        _spheres.add(sphere->_center, sphere->_radius);
+        _sphereObjects.push_back(sphere);
+    }
+    for (int b = 0; b < _spheres.blocks(); ++b)
+    {
+        Aabb box;
+        for (int i = b * SIMD_WIDTH; i < std::min(_spheres.size, (b + 1) * SIMD_WIDTH); ++i)
+            box.expand(_sphereObjects[i]->bounds());
+        _items.push_back({ItemType::SphereBlock, b});
+        boxes.push_back(box);
+    }
+
+    for (const auto *lens : sortByMorton(lenses))
+    {
+        _lenses.add(lens->_focalPos1, lens->_focalPos2, lens->_curveRadius);
+        _lensObjects.push_back(lens);
+    }
+    for (int b = 0; b < _lenses.blocks(); ++b)
+    {
+        Aabb box;
+        for (int i = b * SIMD_WIDTH; i < std::min(_lenses.size, (b + 1) * SIMD_WIDTH); ++i)
+            box.expand(_lensObjects[i]->bounds());
+        _items.push_back({ItemType::LensBlock, b});
+        boxes.push_back(box);
+    }
+
+    for (size_t i = 0; i < _otherObjects.size(); ++i)
+    {
+        _items.push_back({ItemType::Object, static_cast<int>(i)});
+        boxes.push_back(_otherObjects[i]->bounds());
+    }
+
+    _bvh.build(boxes);
+}
+
+void SceneIntersector::intersectItem(const Item &item, const Ray &ray, HitRecord &hit) const
+{
+    float t[SIMD_WIDTH];
+    int mask = 0;
+    const std::vector<const BaseObject *> *owners = nullptr;
+
+    switch (item.type)
+    {
+    case ItemType::SphereBlock:
+        mask = _spheres.intersectBlock(ray, item.index, t);
+        owners = &_sphereObjects;
+        break;
+    case ItemType::LensBlock:
+        mask = _lenses.intersectBlock(ray, item.index, t);
+        owners = &_lensObjects;
+        break;
+    case ItemType::Object:
+    {
+        const BaseObject *o = _otherObjects[item.index];
+        float tObj = 0;
+        if (o->intersect(ray, tObj) && tObj < hit.t)
+        {
+            hit.t = tObj;
+            hit.object = o;
+        }
+        return;
+    }
+    }
+
+    for (int l = 0; mask; ++l, mask >>= 1)
+    {
+        if ((mask & 1) && t[l] < hit.t)
+        {
+            hit.t = t[l];
+            hit.object = (*owners)[item.index * SIMD_WIDTH + l];
+        }
+    }
+}
+
+void SceneIntersector::intersectItem(const Item &item, RayPacket &packet) const
+{
+    float t[SIMD_WIDTH];
+
+    if (item.type == ItemType::Object)
+    {
+        const BaseObject *o = _otherObjects[item.index];
+        if (packet.frustum.outside(o->bounds()))
+            return;
+        for (int i = 0; i < PACKET_SIZE; ++i)
+        {
+            if (!packet.isActive(i))
+                continue;
+            float tObj = 0;
+            if (o->intersect(packet.ray(i), tObj) && tObj < packet.hits[i].t)
+            {
+                packet.hits[i].t = tObj;
+                packet.hits[i].object = o;
+            }
+        }
+        return;
+    }
+
+    bool isSphere = item.type == ItemType::SphereBlock;
+    int count = isSphere ? _spheres.size : _lenses.size;
+    const auto &owners = isSphere ? _sphereObjects : _lensObjects;
+
+    for (int p = item.index * SIMD_WIDTH; p < std::min(count, (item.index + 1) * SIMD_WIDTH); ++p)
+    {
+        // Отсечение отдельного примитива пирамидой видимости пакета
+        if (packet.frustum.outside(owners[p]->bounds()))
+            continue;
+
+        for (int r = 0; r < PACKET_DIM; ++r)
+        {
+            if (!packet.activeMask[r])
+                continue;
+
+            int mask = isSphere
+                ? intersectSphereLanes(packet.rows[r], Vec3(_spheres.cx[p], _spheres.cy[p], _spheres.cz[p]), _spheres.r2[p], t)
+                : intersectLensLanes(packet.rows[r], Vec3(_lenses.c1x[p], _lenses.c1y[p], _lenses.c1z[p]),
+                                     Vec3(_lenses.c2x[p], _lenses.c2y[p], _lenses.c2z[p]), _lenses.r2[p], t);
+            mask &= packet.activeMask[r];
+
+            for (int l = 0; mask; ++l, mask >>= 1)
+            {
+                HitRecord &hit = packet.hits[r * PACKET_DIM + l];
+                if ((mask & 1) && t[l] < hit.t)
+                {
+                    hit.t = t[l];
+                    hit.object = owners[p];
+                }
+            }
+        }
+    }
+}
+
+bool SceneIntersector::closestHit(const Ray &ray, HitRecord &hit) const
+{
+    Vec3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    _bvh.traverse([&](const Aabb &box) { return !box.intersect(ray.origin, invDir, hit.t); },
+                  [&](int item) { intersectItem(_items[item], ray, hit); });
+    return hit.object != nullptr;
+}
+
+void SceneIntersector::closestHit(RayPacket &packet) const
+{
+    _bvh.traverse([&](const Aabb &box) { return packet.frustum.outside(box); },
+                  [&](int item) { intersectItem(_items[item], packet); });
+}
+
+bool SceneIntersector::anyHit(const Ray &ray, float tMax, const BaseObject *ignore) const
+{
+    bool found = false;
+    Vec3 invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+    _bvh.traverse([&](const Aabb &box) { return found || !box.intersect(ray.origin, invDir, tMax); },
+                  [&](int index) {
+                      if (found)
+                          return;
+                      const Item &item = _items[index];
+                      float t[SIMD_WIDTH];
+                      int mask = 0;
+                      const std::vector<const BaseObject *> *owners = nullptr;
+
+                      if (item.type == ItemType::SphereBlock)
+                      {
+                          mask = _spheres.intersectBlock(ray, item.index, t);
+                          owners = &_sphereObjects;
+                      }
+                      else if (item.type == ItemType::LensBlock)
+                      {
+                          mask = _lenses.intersectBlock(ray, item.index, t);
+                          owners = &_lensObjects;
+                      }
+                      else
+                      {
+                          const BaseObject *o = _otherObjects[item.index];
+                          float tObj = 0;
+                          found = o != ignore && o->intersect(ray, tObj) && tObj < tMax;
+                          return;
+                      }
+
+                      for (int l = 0; mask && !found; ++l, mask >>= 1)
+                          found = (mask & 1) && t[l] < tMax && (*owners)[item.index * SIMD_WIDTH + l] != ignore;
+                  });
+
+    return found;
+}
+
+const std::vector<std::shared_ptr<BaseObject>> &SceneIntersector::objects() const
+{
+    return _objects;
+}
+
+const SequentialLensSystem *SceneIntersector::lensSystem() const
+{
+    return _lensSystem.get();
+}
+
+void SceneIntersector::setLensSystem(const std::shared_ptr<const SequentialLensSystem> &lensSystem)
+{
+    _lensSystem = lensSystem;
+}
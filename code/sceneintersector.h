@@ -0,0 +1,72 @@
+#ifndef SCENEINTERSECTOR_H
+#define SCENEINTERSECTOR_H
+
+#include <limits>
+#include <memory>
+#include <vector>
+#include "baseobject.h"
+#include "bvh.h"
+#include "simdintersect.h"
+
+class SequentialLensSystem;
+
+struct HitRecord
+{
+    float t = std::numeric_limits<float>::max();
+    const BaseObject *object = nullptr;
+};
+
+struct RayPacket;
+
+// Поиск пересечений луча со сценой.
+// Сферы и линзы упорядочиваются по кривой Мортона и раскладываются в SoA-пакеты
+// по 8 штук, остальные объекты проверяются через виртуальный intersect.
+// Над блоками пакетов и объектами строится BVH верхнего уровня
+class SceneIntersector
+{
+public:
+    SceneIntersector() = default;
+    explicit SceneIntersector(const std::vector<std::shared_ptr<BaseObject>> &objects);
+
+    void build(const std::vector<std::shared_ptr<BaseObject>> &objects);
+
+    bool closestHit(const Ray &ray, HitRecord &hit) const;
+    // Пакетный поиск ближайших пересечений для лучей с общим началом
+    void closestHit(RayPacket &packet) const;
+    // Есть ли пересечение ближе tMax с любым объектом, кроме ignore
+    bool anyHit(const Ray &ray, float tMax = std::numeric_limits<float>::max(), const BaseObject *ignore = nullptr) const;
+
+    const std::vector<std::shared_ptr<BaseObject>> &objects() const;
+
+    // Стопка линз, которую лучи проходят последовательно, минуя поиск по сцене; nullptr — без нее
+    const SequentialLensSystem *lensSystem() const;
+    void setLensSystem(const std::shared_ptr<const SequentialLensSystem> &lensSystem);
+
+private:
+    enum class ItemType { SphereBlock, LensBlock, Object };
+    struct Item
+    {
+        ItemType type;
+        int index;
+    };
+
+    void intersectItem(const Item &item, const Ray &ray, HitRecord &hit) const;
+    void intersectItem(const Item &item, RayPacket &packet) const;
+
+    std::vector<std::shared_ptr<BaseObject>> _objects;
+
+    SpherePack _spheres;
+    std::vector<const BaseObject *> _sphereObjects;
+
+    LensPack _lenses;
+    std::vector<const BaseObject *> _lensObjects;
+
+    std::vector<const BaseObject *> _otherObjects;
+
+    std::vector<Item> _items;
+    Bvh _bvh;
+
+    std::shared_ptr<const SequentialLensSystem> _lensSystem;
+};
+
+#endif // SCENEINTERSECTOR_H
@@ -41,10 +41,21 @@ void SceneWidget::loadDrawer(const std::shared_ptr<Drawer> &drawer)
 {
     if (drawer)
     {
-        _drawer = drawer;
-        ui->filterConstantLineEdit->setText(QString::number(_drawer->filterConstant()));
-        ui->photonsNumLineEdit->setText(QString::number(_drawer->photonsPerLight()));
-        ui->photonsRadiusLineEdit->setText(QString::number(_drawer->indirectLightMaxR()));
+        // Отрисовщик читается один раз, до первых заданий; дальше параметры живут в виджете
+        _drawerSettings = drawer->settings();
+        ui->filterConstantLineEdit->setText(QString::number(_drawerSettings.filterConstant));
+        ui->photonsNumLineEdit->setText(QString::number(_drawerSettings.photonsPerLight));
+        ui->photonsRadiusLineEdit->setText(QString::number(_drawerSettings.indirectLightMaxR));
+        ui->threadsNumLineEdit->setText(QString::number(_drawerSettings.threadsNum));
+        ui->samplesPerPixelLineEdit->setText(QString::number(_drawerSettings.samplesPerPixel));
+        ui->progressiveCheckBox->setChecked(_drawerSettings.progressive);
+        ui->adaptiveSamplingCheckBox->setChecked(_drawerSettings.adaptiveSampling);
+        ui->irradianceCachingCheckBox->setChecked(_drawerSettings.irradianceCaching);
+        ui->directLightingCheckBox->setChecked(_drawerSettings.directLighting);
+        ui->sequentialLensesCheckBox->setChecked(_drawerSettings.sequentialLenses);
+        ui->renderWidthLineEdit->setText(QString::number(_drawerSettings.renderTarget.width()));
+        ui->renderHeightLineEdit->setText(QString::number(_drawerSettings.renderTarget.height()));
+        ui->previewScaleLineEdit->setText(QString::number(_drawerSettings.renderTarget.previewScale()));
     }
 }
 
@@ -88,14 +99,24 @@ void SceneWidget::setParams()
                                                                Vec3(ui->camDXLineEdit->text().toDouble(), ui->camDYLineEdit->text().toDouble(), ui->camDZLineEdit->text().toDouble()),
                                                                _scene->camera()->screenDistance(), ui->camFOVLineEdit->text().toDouble());
         _scene->setCamera(cam);
-        _drawer->setFilterConstant(ui->filterConstantLineEdit->text().toDouble());
-    }
-    if (_drawer)
-    {
-        _drawer->setFilterConstant(ui->filterConstantLineEdit->text().toDouble());
-        _drawer->setIndirectLightMaxR(ui->photonsRadiusLineEdit->text().toDouble());
-        _drawer->setPhotonsPerLight(ui->photonsNumLineEdit->text().toInt());
     }
+    _drawerSettings.filterConstant = ui->filterConstantLineEdit->text().toDouble();
+    _drawerSettings.indirectLightMaxR = ui->photonsRadiusLineEdit->text().toDouble();
+    _drawerSettings.photonsPerLight = ui->photonsNumLineEdit->text().toInt();
+    _drawerSettings.threadsNum = ui->threadsNumLineEdit->text().toInt();
+    _drawerSettings.samplesPerPixel = ui->samplesPerPixelLineEdit->text().toInt();
+    _drawerSettings.progressive = ui->progressiveCheckBox->isChecked();
+    _drawerSettings.adaptiveSampling = ui->adaptiveSamplingCheckBox->isChecked();
+    _drawerSettings.irradianceCaching = ui->irradianceCachingCheckBox->isChecked();
+    _drawerSettings.directLighting = ui->directLightingCheckBox->isChecked();
+    _drawerSettings.sequentialLenses = ui->sequentialLensesCheckBox->isChecked();
+    _drawerSettings.renderTarget = RenderTarget(ui->renderWidthLineEdit->text().toInt(), ui->renderHeightLineEdit->text().toInt(),
+                                                ui->previewScaleLineEdit->text().replace(",", ".").toDouble());
+}
+
+DrawerSettings SceneWidget::drawerSettings() const
+{
+    return _drawerSettings;
 }
 void SceneWidget::onObjectSelected(QListWidgetItem *item)
 {
@@ -103,6 +124,11 @@ void SceneWidget::onObjectSelected(QListWidgetItem *item)
     auto obj = _objectMap[item];
     QWidget *paramsWidget = createParamsWidgetForObject(obj);
     if (paramsWidget) {
+        // Любая правка параметров объекта — новая правка сцены, кэш освещенности ей уже не соответствует
+        for (QLineEdit *edit : paramsWidget->findChildren<QLineEdit *>())
+            connect(edit, &QLineEdit::textChanged, this, [this](){if (_scene) _scene->markChanged();});
+        for (QPushButton *button : paramsWidget->findChildren<QPushButton *>())
+            connect(button, &QPushButton::clicked, this, [this](){if (_scene) _scene->markChanged();});
         ui->objectParamsWidget->layout()->addWidget(paramsWidget);
     }
 }
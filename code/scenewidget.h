@@ -21,6 +21,8 @@ class SceneWidget : public QWidget
 public:
     explicit SceneWidget(QWidget *parent = nullptr);
     ~SceneWidget();
+    // Параметры отрисовщика из интерфейса для следующего задания рендеринга
+    DrawerSettings drawerSettings() const;
 public slots:
     void loadScene(const std::shared_ptr<Scene> &scene);
     void loadDrawer(const std::shared_ptr<Drawer> &drawer);
@@ -42,7 +44,7 @@ private:
 private:
     Ui::SceneWidget *ui;
     std::shared_ptr<Scene> _scene;
-    std::shared_ptr<Drawer> _drawer;
+    DrawerSettings _drawerSettings;
     QMap<QListWidgetItem*, std::shared_ptr<BaseObject>> _objectMap;
     bool _objsUpdated;
 
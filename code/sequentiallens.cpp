@@ -0,0 +1,526 @@
+#include "sequentiallens.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include "simdintersect.h"
+#include "spectrum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEQUENTIAL_LENS_X86
+#endif
+
+namespace
+{
+
+// Допуск соосности: косинус угла между осями и смещение центра от оси в долях радиуса линзы
+const float COAXIAL_COS_TOLERANCE = 1.0f - 1e-4f;
+const float COAXIAL_OFFSET_TOLERANCE = 1e-3f;
+// Сдвиг выходящего из системы луча, чтобы он не пересек последнюю поверхность повторно
+const float EXIT_BIAS = 1e-4f;
+
+float sequentialRandom()
+{
+    thread_local std::mt19937 gen(std::random_device{}());
+    thread_local std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    return dist(gen);
+}
+
+// 1 / λ² для длины волны в нм, λ в мкм
+float inverseWavelengthSq(float wavelength)
+{
+    float lambda = wavelength * 1e-3f;
+    return 1.0f / (lambda * lambda);
+}
+
+// Линза годится для последовательной системы: чисто преломляющая, с невырожденными поверхностями
+bool refractiveOnly(const Lens &lens)
+{
+    const GraphicParams &p = lens._params;
+    return p._transparency >= 1.0f && p._reflectivity <= 0.0f && p._emission.intensity <= 0.0f
+        && lens.curveRadius() > lens.radius();
+}
+
+bool coaxial(const Lens &base, const Lens &lens)
+{
+    Vec3 axis = base.direction().normalize();
+    if (std::fabs(axis.dot(lens.direction().normalize())) < COAXIAL_COS_TOLERANCE)
+        return false;
+    Vec3 rel = lens.position() - base.position();
+    float along = rel.dot(axis);
+    return rel.lengthSquared() - along * along <= std::pow(COAXIAL_OFFSET_TOLERANCE * lens.radius(), 2);
+}
+
+// Половина толщины линзы на оси (стрелка прогиба поверхности)
+float sag(const Lens &lens)
+{
+    float r = lens.curveRadius();
+    return r - std::sqrt(r * r - lens.radius() * lens.radius());
+}
+
+bool overlaps(const Aabb &a, const Aabb &b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x
+        && a.min.y <= b.max.y && b.min.y <= a.max.y
+        && a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+// Линзы по возрастанию координаты вдоль оси первой из них; false, если соседние перекрываются
+bool sortAlongAxis(std::vector<std::shared_ptr<Lens>> &lenses)
+{
+    Vec3 axis = lenses.front()->direction().normalize();
+    Vec3 origin = lenses.front()->position();
+    std::sort(lenses.begin(), lenses.end(), [&](const auto &a, const auto &b) {
+        return (a->position() - origin).dot(axis) < (b->position() - origin).dot(axis);
+    });
+    for (size_t i = 1; i < lenses.size(); ++i)
+    {
+        float gap = (lenses[i]->position() - lenses[i - 1]->position()).dot(axis);
+        if (gap < sag(*lenses[i]) + sag(*lenses[i - 1]))
+            return false;
+    }
+    return true;
+}
+
+}
+
+// Состояние до SIMD_WIDTH лучей одной группы в раскладке SoA
+struct SequentialLensSystem::Lanes
+{
+    RayLanes8 rays;
+    alignas(32) float wr[SIMD_WIDTH];
+    alignas(32) float wg[SIMD_WIDTH];
+    alignas(32) float wb[SIMD_WIDTH];
+    alignas(32) float inverseLambdaSq[SIMD_WIDTH];
+    // Номер шага обхода, с которого луч входит в систему
+    int startStep[SIMD_WIDTH];
+    // Лучи, еще идущие по системе, и погибшие внутри нее
+    int alive = 0;
+    int dead = 0;
+    // Лучи, прошедшие мимо входной поверхности своей же линзы
+    int bypassed = 0;
+};
+
+SequentialLensSystem::SequentialLensSystem(const std::vector<std::shared_ptr<Lens>> &lenses)
+{
+    if (lenses.empty())
+        throw std::runtime_error("Последовательная система должна содержать хотя бы одну линзу");
+
+    std::vector<std::shared_ptr<Lens>> sorted = lenses;
+    for (const auto &lens : sorted)
+    {
+        if (!refractiveOnly(*lens))
+            throw std::runtime_error("В последовательную систему входят только прозрачные линзы без отражения и свечения");
+        if (!coaxial(*sorted.front(), *lens))
+            throw std::runtime_error("Линзы последовательной системы должны быть соосными");
+    }
+    if (!sortAlongAxis(sorted))
+        throw std::runtime_error("Линзы последовательной системы перекрываются вдоль оси");
+
+    _axis = sorted.front()->direction().normalize();
+    _origin = sorted.front()->position();
+    for (const auto &lens : sorted)
+    {
+        float along = (lens->position() - _origin).dot(_axis);
+        float r = lens->curveRadius();
+        float offset = std::sqrt(r * r - lens->radius() * lens->radius());
+        float h = sag(*lens);
+
+        // Поверхность со стороны -axis — часть сферы с центром на стороне +axis, и наоборот
+        LensSurface surface;
+        surface.radiusSq = r * r;
+        surface.apertureSq = lens->radius() * lens->radius();
+        surface.refractiveIndex = lens->_params._refractiveIndex;
+        surface.cauchyB = lens->_params._cauchyB;
+        surface.color = lens->_params._color;
+        surface.lens = lens.get();
+
+        surface.center = _origin + _axis * (along + offset);
+        surface.vertex = along - h;
+        _surfaces.push_back(surface);
+        surface.center = _origin + _axis * (along - offset);
+        surface.vertex = along + h;
+        _surfaces.push_back(surface);
+
+        _lenses.push_back(lens.get());
+        _dispersive = _dispersive || surface.cauchyB != 0.0f;
+    }
+}
+
+std::shared_ptr<SequentialLensSystem> SequentialLensSystem::detect(const std::vector<std::shared_ptr<BaseObject>> &objects)
+{
+    std::vector<std::shared_ptr<Lens>> candidates;
+    for (const auto &o : objects)
+        if (auto lens = std::dynamic_pointer_cast<Lens>(o))
+            if (refractiveOnly(*lens))
+                candidates.push_back(lens);
+
+    std::vector<std::shared_ptr<Lens>> best;
+    for (const auto &seed : candidates)
+    {
+        std::vector<std::shared_ptr<Lens>> group;
+        for (const auto &lens : candidates)
+            if (coaxial(*seed, *lens))
+                group.push_back(lens);
+        if (group.size() < 2 || group.size() <= best.size() || !sortAlongAxis(group))
+            continue;
+
+        // Между поверхностями стопки лучи не ищут пересечений со сценой, поэтому другие объекты
+        // не должны заходить в ее ограничивающий параллелепипед
+        Aabb hull;
+        for (const auto &lens : group)
+            hull.expand(lens->bounds());
+        bool clear = true;
+        for (const auto &o : objects)
+        {
+            if (std::find(group.begin(), group.end(), o) != group.end())
+                continue;
+            if (overlaps(hull, o->bounds()))
+            {
+                clear = false;
+                break;
+            }
+        }
+        if (clear)
+            best = group;
+    }
+
+    if (best.empty())
+        return nullptr;
+    return std::make_shared<SequentialLensSystem>(best);
+}
+
+bool SequentialLensSystem::contains(const BaseObject *object) const
+{
+    return lensIndex(object) >= 0;
+}
+
+int SequentialLensSystem::lensesNum() const
+{
+    return _lenses.size();
+}
+
+const std::vector<LensSurface> &SequentialLensSystem::surfaces() const
+{
+    return _surfaces;
+}
+
+const Vec3 &SequentialLensSystem::axis() const
+{
+    return _axis;
+}
+
+int SequentialLensSystem::lensIndex(const BaseObject *object) const
+{
+    auto it = std::find(_lenses.begin(), _lenses.end(), object);
+    return it == _lenses.end() ? -1 : int(it - _lenses.begin());
+}
+
+bool SequentialLensSystem::trace(LensPath &path) const
+{
+    int index = 0;
+    traceGroup(&path, &index, 1, path.ray.direction.dot(_axis) >= 0.0f);
+    return !(path.weight == Vec3(0, 0, 0));
+}
+
+void SequentialLensSystem::trace(std::vector<LensPath> &paths) const
+{
+    // Порядок обхода поверхностей общий для группы, поэтому лучи делятся по направлению вдоль оси
+    std::vector<int> forward, backward;
+    for (int i = 0; i < (int)paths.size(); ++i)
+        (paths[i].ray.direction.dot(_axis) >= 0.0f ? forward : backward).push_back(i);
+
+    for (int i = 0; i < (int)forward.size(); i += SIMD_WIDTH)
+        traceGroup(paths.data(), forward.data() + i, std::min(SIMD_WIDTH, (int)forward.size() - i), true);
+    for (int i = 0; i < (int)backward.size(); i += SIMD_WIDTH)
+        traceGroup(paths.data(), backward.data() + i, std::min(SIMD_WIDTH, (int)backward.size() - i), false);
+}
+
+void SequentialLensSystem::traceGroup(LensPath *paths, const int *indices, int count, bool forward) const
+{
+    Lanes lanes;
+    const float inverseReferenceSq = inverseWavelengthSq(REFERENCE_WAVELENGTH);
+    int surfacesNum = _surfaces.size();
+    for (int l = 0; l < SIMD_WIDTH; ++l)
+    {
+        if (l >= count)
+        {
+            // Пустые дорожки заполняются безопасными значениями и не входят в маску
+            lanes.rays.ox[l] = lanes.rays.oy[l] = lanes.rays.oz[l] = 0.0f;
+            lanes.rays.dx[l] = _axis.x;
+            lanes.rays.dy[l] = _axis.y;
+            lanes.rays.dz[l] = _axis.z;
+            lanes.wr[l] = lanes.wg[l] = lanes.wb[l] = 0.0f;
+            lanes.inverseLambdaSq[l] = inverseReferenceSq;
+            lanes.startStep[l] = surfacesNum;
+            continue;
+        }
+
+        LensPath &path = paths[indices[l]];
+        // Дисперсионная стопка разводит длины волн почти на любом луче, поэтому путь, несущий весь спектр,
+        // сворачивается к ведущей длине волны сразу на входе
+        if (_dispersive && path.ray.wavelength <= 0.0f)
+        {
+            path.ray.wavelength = HeroWavelengths::sample(sequentialRandom()).hero();
+            path.weight *= wavelengthToRgb(path.ray.wavelength);
+        }
+
+        lanes.rays.ox[l] = path.ray.origin.x;
+        lanes.rays.oy[l] = path.ray.origin.y;
+        lanes.rays.oz[l] = path.ray.origin.z;
+        lanes.rays.dx[l] = path.ray.direction.x;
+        lanes.rays.dy[l] = path.ray.direction.y;
+        lanes.rays.dz[l] = path.ray.direction.z;
+        lanes.wr[l] = path.weight.x;
+        lanes.wg[l] = path.weight.y;
+        lanes.wb[l] = path.weight.z;
+        lanes.inverseLambdaSq[l] = path.ray.wavelength > 0.0f ? inverseWavelengthSq(path.ray.wavelength) : inverseReferenceSq;
+
+        // Шаги обхода: вход в линзу i — поверхность 2i при обходе вдоль оси и 2i + 1 при обходе против нее
+        int lens = std::max(0, lensIndex(path.entered));
+        lanes.startStep[l] = forward ? 2 * lens : surfacesNum - 2 - 2 * lens;
+        lanes.alive |= 1 << l;
+    }
+
+#ifdef SEQUENTIAL_LENS_X86
+    if (count > 1 && simdIntersectAvailable())
+        traceLanesAvx2(lanes, forward);
+    else
+#endif
+        traceLanesScalar(lanes, forward);
+
+    for (int l = 0; l < count; ++l)
+    {
+        LensPath &path = paths[indices[l]];
+        if (lanes.dead & (1 << l))
+        {
+            path.weight = Vec3(0, 0, 0);
+            continue;
+        }
+        if (lanes.bypassed & (1 << l))
+        {
+            refractIntoLens(path);
+            continue;
+        }
+        Vec3 direction(lanes.rays.dx[l], lanes.rays.dy[l], lanes.rays.dz[l]);
+        Vec3 origin(lanes.rays.ox[l], lanes.rays.oy[l], lanes.rays.oz[l]);
+        float wavelength = path.ray.wavelength;
+        path.ray = Ray(origin + direction * EXIT_BIAS, direction, false, 1.0f);
+        path.ray.wavelength = wavelength;
+        path.weight = Vec3(lanes.wr[l], lanes.wg[l], lanes.wb[l]);
+    }
+}
+
+void SequentialLensSystem::refractIntoLens(LensPath &path) const
+{
+    // Сферы модели смыкаются на световой высоте, а сама линза может быть задета лучом чуть дальше от оси.
+    // Такой луч преломляется на поверхности линзы так же, как вне системы, и продолжает путь внутри нее
+    float t;
+    if (!path.entered || !path.entered->intersect(path.ray, t))
+    {
+        path.weight = Vec3(0, 0, 0);
+        return;
+    }
+    GraphicParams params = path.entered->hitParams(path.ray, t);
+    Vec3 normal = params._normal.dot(path.ray.direction) > 0.0f ? -params._normal : params._normal;
+    float index = path.ray.wavelength > 0.0f ? params.refractiveIndexAt(path.ray.wavelength) : params._refractiveIndex;
+    Vec3 refracted = Vec3::refract(path.ray.direction, normal, index);
+    if (refracted == Vec3(0, 0, 0))
+    {
+        path.weight = Vec3(0, 0, 0);
+        return;
+    }
+
+    Vec3 point = path.ray.origin + path.ray.direction * t;
+    float wavelength = path.ray.wavelength;
+    path.weight *= params._color * (1.0f - Vec3::fresnel(path.ray.direction, normal, index));
+    path.ray = Ray(point - normal * EXIT_BIAS, refracted.normalize(), true, 1.0f);
+    path.ray.wavelength = wavelength;
+}
+
+void SequentialLensSystem::traceLanesScalar(Lanes &lanes, bool forward) const
+{
+    const float inverseReferenceSq = inverseWavelengthSq(REFERENCE_WAVELENGTH);
+    int surfacesNum = _surfaces.size();
+    for (int step = 0; step < surfacesNum && lanes.alive; ++step)
+    {
+        const LensSurface &s = _surfaces[forward ? step : surfacesNum - 1 - step];
+        // Поверхности обходятся парами: четный шаг — вход в стекло, нечетный — выход
+        bool entry = step % 2 == 0;
+        float invRadius = (entry ? 1.0f : -1.0f) / std::sqrt(s.radiusSq);
+
+        for (int l = 0; l < SIMD_WIDTH; ++l)
+        {
+            int bit = 1 << l;
+            if (!(lanes.alive & bit) || lanes.startStep[l] > step)
+                continue;
+
+            Vec3 o(lanes.rays.ox[l], lanes.rays.oy[l], lanes.rays.oz[l]);
+            Vec3 d(lanes.rays.dx[l], lanes.rays.dy[l], lanes.rays.dz[l]);
+            Vec3 oc = o - s.center;
+            float b = oc.dot(d);
+            float disc = b * b - (oc.dot(oc) - s.radiusSq);
+            float t = entry ? -b - std::sqrt(std::max(disc, 0.0f)) : -b + std::sqrt(std::max(disc, 0.0f));
+            Vec3 p = o + d * t;
+            Vec3 rel = p - _origin;
+            float along = rel.dot(_axis);
+            if (disc < 0.0f || t <= 0.0f || rel.lengthSquared() - along * along > s.apertureSq)
+            {
+                // Промах мимо входной поверхности — луч покидает систему в воздухе, мимо выходной — теряется.
+                // Мимо входа в свою же линзу луч проходит только у самого края, там он преломляется на ней отдельно
+                lanes.alive &= ~bit;
+                if (!entry)
+                    lanes.dead |= bit;
+                else if (step == lanes.startStep[l])
+                    lanes.bypassed |= bit;
+                continue;
+            }
+
+            // Нормаль навстречу лучу
+            Vec3 n = (p - s.center) * invRadius;
+            float index = s.refractiveIndex + s.cauchyB * (lanes.inverseLambdaSq[l] - inverseReferenceSq);
+            float n1 = entry ? 1.0f : index;
+            float n2 = entry ? index : 1.0f;
+            float eta = n1 / n2;
+            float cosi = -n.dot(d);
+            float k = 1.0f - eta * eta * (1.0f - cosi * cosi);
+            if (k < 0.0f)
+            {
+                lanes.alive &= ~bit;
+                lanes.dead |= bit;
+                continue;
+            }
+
+            float cost = std::sqrt(k);
+            Vec3 refracted = d * eta + n * (eta * cosi - cost);
+            float rs = (n2 * cosi - n1 * cost) / (n2 * cosi + n1 * cost);
+            float rp = (n1 * cosi - n2 * cost) / (n1 * cosi + n2 * cost);
+            float transmission = 1.0f - 0.5f * (rs * rs + rp * rp);
+
+            lanes.rays.ox[l] = p.x;
+            lanes.rays.oy[l] = p.y;
+            lanes.rays.oz[l] = p.z;
+            lanes.rays.dx[l] = refracted.x;
+            lanes.rays.dy[l] = refracted.y;
+            lanes.rays.dz[l] = refracted.z;
+            lanes.wr[l] *= s.color.x * transmission;
+            lanes.wg[l] *= s.color.y * transmission;
+            lanes.wb[l] *= s.color.z * transmission;
+        }
+    }
+}
+
+#ifdef SEQUENTIAL_LENS_X86
+
+__attribute__((target("avx2,fma")))
+void SequentialLensSystem::traceLanesAvx2(Lanes &lanes, bool forward) const
+{
+    const float inverseReferenceSq = inverseWavelengthSq(REFERENCE_WAVELENGTH);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i startStep = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes.startStep));
+    const __m256 inverseLambdaSq = _mm256_load_ps(lanes.inverseLambdaSq);
+
+    __m256 ox = _mm256_load_ps(lanes.rays.ox), oy = _mm256_load_ps(lanes.rays.oy), oz = _mm256_load_ps(lanes.rays.oz);
+    __m256 dx = _mm256_load_ps(lanes.rays.dx), dy = _mm256_load_ps(lanes.rays.dy), dz = _mm256_load_ps(lanes.rays.dz);
+    __m256 wr = _mm256_load_ps(lanes.wr), wg = _mm256_load_ps(lanes.wg), wb = _mm256_load_ps(lanes.wb);
+
+    int surfacesNum = _surfaces.size();
+    for (int step = 0; step < surfacesNum && lanes.alive; ++step)
+    {
+        const LensSurface &s = _surfaces[forward ? step : surfacesNum - 1 - step];
+        bool entry = step % 2 == 0;
+
+        // Участвуют живые лучи, уже вошедшие в систему
+        __m256i aliveBits = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(lanes.alive), laneBits), laneBits);
+        __m256i started = _mm256_cmpgt_epi32(_mm256_set1_epi32(step + 1), startStep);
+        int first = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_set1_epi32(step), startStep)));
+        __m256 active = _mm256_castsi256_ps(_mm256_and_si256(aliveBits, started));
+        if (_mm256_movemask_ps(active) == 0)
+            continue;
+
+        __m256 cx = _mm256_set1_ps(s.center.x), cy = _mm256_set1_ps(s.center.y), cz = _mm256_set1_ps(s.center.z);
+        __m256 ocx = _mm256_sub_ps(ox, cx), ocy = _mm256_sub_ps(oy, cy), ocz = _mm256_sub_ps(oz, cz);
+        __m256 b = _mm256_fmadd_ps(ocz, dz, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocx, dx)));
+        __m256 c = _mm256_sub_ps(_mm256_fmadd_ps(ocz, ocz, _mm256_fmadd_ps(ocy, ocy, _mm256_mul_ps(ocx, ocx))), _mm256_set1_ps(s.radiusSq));
+        __m256 disc = _mm256_fmsub_ps(b, b, c);
+        __m256 sq = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+        __m256 negB = _mm256_sub_ps(zero, b);
+        __m256 t = entry ? _mm256_sub_ps(negB, sq) : _mm256_add_ps(negB, sq);
+
+        __m256 px = _mm256_fmadd_ps(dx, t, ox), py = _mm256_fmadd_ps(dy, t, oy), pz = _mm256_fmadd_ps(dz, t, oz);
+        __m256 rx = _mm256_sub_ps(px, _mm256_set1_ps(_origin.x));
+        __m256 ry = _mm256_sub_ps(py, _mm256_set1_ps(_origin.y));
+        __m256 rz = _mm256_sub_ps(pz, _mm256_set1_ps(_origin.z));
+        __m256 along = _mm256_fmadd_ps(rz, _mm256_set1_ps(_axis.z), _mm256_fmadd_ps(ry, _mm256_set1_ps(_axis.y), _mm256_mul_ps(rx, _mm256_set1_ps(_axis.x))));
+        __m256 radialSq = _mm256_fnmadd_ps(along, along, _mm256_fmadd_ps(rz, rz, _mm256_fmadd_ps(ry, ry, _mm256_mul_ps(rx, rx))));
+
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(disc, zero, _CMP_GE_OQ), _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(radialSq, _mm256_set1_ps(s.apertureSq), _CMP_LE_OQ));
+
+        __m256 invRadius = _mm256_set1_ps((entry ? 1.0f : -1.0f) / std::sqrt(s.radiusSq));
+        __m256 nx = _mm256_mul_ps(_mm256_sub_ps(px, cx), invRadius);
+        __m256 ny = _mm256_mul_ps(_mm256_sub_ps(py, cy), invRadius);
+        __m256 nz = _mm256_mul_ps(_mm256_sub_ps(pz, cz), invRadius);
+
+        __m256 index = _mm256_fmadd_ps(_mm256_set1_ps(s.cauchyB), _mm256_sub_ps(inverseLambdaSq, _mm256_set1_ps(inverseReferenceSq)),
+                                       _mm256_set1_ps(s.refractiveIndex));
+        __m256 n1 = entry ? one : index;
+        __m256 n2 = entry ? index : one;
+        __m256 eta = _mm256_div_ps(n1, n2);
+        __m256 cosi = _mm256_sub_ps(zero, _mm256_fmadd_ps(nz, dz, _mm256_fmadd_ps(ny, dy, _mm256_mul_ps(nx, dx))));
+        __m256 k = _mm256_fnmadd_ps(_mm256_mul_ps(eta, eta), _mm256_fnmadd_ps(cosi, cosi, one), one);
+        __m256 refracts = _mm256_cmp_ps(k, zero, _CMP_GE_OQ);
+        __m256 cost = _mm256_sqrt_ps(_mm256_max_ps(k, zero));
+
+        __m256 scale = _mm256_fmsub_ps(eta, cosi, cost);
+        __m256 rdx = _mm256_fmadd_ps(nx, scale, _mm256_mul_ps(dx, eta));
+        __m256 rdy = _mm256_fmadd_ps(ny, scale, _mm256_mul_ps(dy, eta));
+        __m256 rdz = _mm256_fmadd_ps(nz, scale, _mm256_mul_ps(dz, eta));
+
+        __m256 n2cosi = _mm256_mul_ps(n2, cosi), n1cost = _mm256_mul_ps(n1, cost);
+        __m256 n1cosi = _mm256_mul_ps(n1, cosi), n2cost = _mm256_mul_ps(n2, cost);
+        __m256 rs = _mm256_div_ps(_mm256_sub_ps(n2cosi, n1cost), _mm256_add_ps(n2cosi, n1cost));
+        __m256 rp = _mm256_div_ps(_mm256_sub_ps(n1cosi, n2cost), _mm256_add_ps(n1cosi, n2cost));
+        __m256 transmission = _mm256_fnmadd_ps(half, _mm256_fmadd_ps(rs, rs, _mm256_mul_ps(rp, rp)), one);
+
+        __m256 update = _mm256_and_ps(active, _mm256_and_ps(hit, refracts));
+        ox = _mm256_blendv_ps(ox, px, update);
+        oy = _mm256_blendv_ps(oy, py, update);
+        oz = _mm256_blendv_ps(oz, pz, update);
+        dx = _mm256_blendv_ps(dx, rdx, update);
+        dy = _mm256_blendv_ps(dy, rdy, update);
+        dz = _mm256_blendv_ps(dz, rdz, update);
+        wr = _mm256_blendv_ps(wr, _mm256_mul_ps(wr, _mm256_mul_ps(transmission, _mm256_set1_ps(s.color.x))), update);
+        wg = _mm256_blendv_ps(wg, _mm256_mul_ps(wg, _mm256_mul_ps(transmission, _mm256_set1_ps(s.color.y))), update);
+        wb = _mm256_blendv_ps(wb, _mm256_mul_ps(wb, _mm256_mul_ps(transmission, _mm256_set1_ps(s.color.z))), update);
+
+        int missed = _mm256_movemask_ps(_mm256_andnot_ps(hit, active));
+        int reflected = _mm256_movemask_ps(_mm256_andnot_ps(refracts, _mm256_and_ps(active, hit)));
+        lanes.alive &= ~(missed | reflected);
+        lanes.dead |= reflected | (entry ? 0 : missed);
+        lanes.bypassed |= entry ? missed & first : 0;
+    }
+
+    _mm256_store_ps(lanes.rays.ox, ox);
+    _mm256_store_ps(lanes.rays.oy, oy);
+    _mm256_store_ps(lanes.rays.oz, oz);
+    _mm256_store_ps(lanes.rays.dx, dx);
+    _mm256_store_ps(lanes.rays.dy, dy);
+    _mm256_store_ps(lanes.rays.dz, dz);
+    _mm256_store_ps(lanes.wr, wr);
+    _mm256_store_ps(lanes.wg, wg);
+    _mm256_store_ps(lanes.wb, wb);
+}
+
+#else
+
+void SequentialLensSystem::traceLanesAvx2(Lanes &lanes, bool forward) const
+{
+    traceLanesScalar(lanes, forward);
+}
+
+#endif
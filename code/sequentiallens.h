@@ -0,0 +1,80 @@
+#ifndef SEQUENTIALLENS_H
+#define SEQUENTIALLENS_H
+
+#include <memory>
+#include <vector>
+#include "primitives.h"
+#include "thinlens.h"
+
+// Сферическая поверхность последовательной системы
+struct LensSurface
+{
+    Vec3 center;
+    float radiusSq = 0;
+    // Координата вершины вдоль оси системы
+    float vertex = 0;
+    // Квадрат световой высоты: поверхности линзы смыкаются на ее радиусе
+    float apertureSq = 0;
+    // Стекло линзы: показатель на опорной длине волны, коэффициент Коши и цвет пропускания
+    float refractiveIndex = 1;
+    float cauchyB = 0;
+    Vec3 color;
+    const BaseObject *lens = nullptr;
+};
+
+// Луч, вошедший в линзу последовательной системы снаружи
+struct LensPath
+{
+    Ray ray;
+    Vec3 weight;
+    // Линза, на которую попал луч
+    const BaseObject *entered = nullptr;
+};
+
+// Последовательная оптическая система: стопка соосных линз без промежуточных объектов.
+// Луч, попавший в линзу стопки, проходит поверхности строго по порядку вдоль оси без поиска по сцене:
+// для каждой вычисляются пересечение со сферой, световая высота, преломление и пропускание по Френелю.
+// Отражения на поверхностях внутри стопки (блики между линзами) и полное внутреннее отражение не отслеживаются.
+// В стопку входят только чисто преломляющие линзы: прозрачность 1, без отражения и свечения
+class SequentialLensSystem
+{
+public:
+    SequentialLensSystem() = default;
+    // Явно заданная стопка. Линзы должны быть соосными и не перекрываться вдоль оси, иначе std::runtime_error
+    explicit SequentialLensSystem(const std::vector<std::shared_ptr<Lens>> &lenses);
+
+    // Самая длинная (не меньше двух линз) стопка сцены, в пределы которой не заходят другие объекты; nullptr, если ее нет
+    static std::shared_ptr<SequentialLensSystem> detect(const std::vector<std::shared_ptr<BaseObject>> &objects);
+
+    bool contains(const BaseObject *object) const;
+    int lensesNum() const;
+    const std::vector<LensSurface> &surfaces() const;
+    const Vec3 &axis() const;
+
+    // Проход сквозь стопку от линзы path.entered до выхода из последней поверхности или промаха мимо следующей линзы.
+    // path.ray заменяется выходящим лучом, weight умножается на пропускание. false — луч погиб внутри системы.
+    // Луч, задевший край линзы мимо входной поверхности модели, возвращается преломленным внутрь этой линзы
+    // из точки попадания и дальше идет общим путем
+    bool trace(LensPath &path) const;
+    // То же для массива лучей: лучи одного направления вдоль оси обрабатываются группами по SIMD_WIDTH.
+    // У погибших лучей вес обнуляется
+    void trace(std::vector<LensPath> &paths) const;
+
+private:
+    struct Lanes;
+
+    void traceGroup(LensPath *paths, const int *indices, int count, bool forward) const;
+    void traceLanesScalar(Lanes &lanes, bool forward) const;
+    void traceLanesAvx2(Lanes &lanes, bool forward) const;
+    // Преломление на собственной поверхности линзы path.entered для луча, не попавшего во входную поверхность модели
+    void refractIntoLens(LensPath &path) const;
+    int lensIndex(const BaseObject *object) const;
+
+    std::vector<LensSurface> _surfaces;
+    std::vector<const BaseObject *> _lenses;
+    Vec3 _origin;
+    Vec3 _axis = Vec3(0, 0, 1);
+    bool _dispersive = false;
+};
+
+#endif // SEQUENTIALLENS_H
@@ -0,0 +1,423 @@
+#include "simdintersect.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_INTERSECT_X86
+#endif
+
+namespace
+{
+
+const float PAD_RADIUS_SQ = -std::numeric_limits<float>::infinity();
+
+// Дополняем массивы до кратного SIMD_WIDTH фиктивными элементами
+void padTo(std::vector<float> &v, int size, float value)
+{
+    v.resize(size, value);
+}
+
+int roundUp(int n)
+{
+    return (n + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+// Скалярные версии: используются, если AVX2 недоступен
+
+int sphereBlockScalar(const SpherePack &p, const Ray &ray, int block, float *t)
+{
+    int mask = 0;
+    int base = block * SIMD_WIDTH;
+    for (int l = 0; l < SIMD_WIDTH; ++l)
+    {
+        int i = base + l;
+        Vec3 oc(ray.origin.x - p.cx[i], ray.origin.y - p.cy[i], ray.origin.z - p.cz[i]);
+        float half_b = oc.dot(ray.direction);
+        float c = oc.dot(oc) - p.r2[i];
+        float discriminant = half_b * half_b - c;
+        if (discriminant < 0)
+            continue;
+
+        float sq = std::sqrt(discriminant);
+        float tl = -half_b - sq;
+        if (tl < 0) tl = -half_b + sq;
+        if (tl >= 0)
+        {
+            t[l] = tl;
+            mask |= 1 << l;
+        }
+    }
+    return mask;
+}
+
+int lensBlockScalar(const LensPack &p, const Ray &ray, int block, float *t)
+{
+    int mask = 0;
+    int base = block * SIMD_WIDTH;
+    for (int l = 0; l < SIMD_WIDTH; ++l)
+    {
+        int i = base + l;
+        Vec3 oc1(ray.origin.x - p.c1x[i], ray.origin.y - p.c1y[i], ray.origin.z - p.c1z[i]);
+        float b1 = oc1.dot(ray.direction);
+        float d1 = b1 * b1 - (oc1.dot(oc1) - p.r2[i]);
+        if (d1 < 0)
+            continue;
+
+        Vec3 oc2(ray.origin.x - p.c2x[i], ray.origin.y - p.c2y[i], ray.origin.z - p.c2z[i]);
+        float b2 = oc2.dot(ray.direction);
+        float d2 = b2 * b2 - (oc2.dot(oc2) - p.r2[i]);
+        if (d2 < 0)
+            continue;
+
+        float s1 = std::sqrt(d1), s2 = std::sqrt(d2);
+        float tEnter = std::max(-b1 - s1, -b2 - s2);
+        float tExit = std::min(-b1 + s1, -b2 + s2);
+        if (tEnter < tExit && tExit > 0)
+        {
+            t[l] = (tEnter > 0) ? tEnter : tExit;
+            mask |= 1 << l;
+        }
+    }
+    return mask;
+}
+
+int sphereLanesScalar(const RayLanes8 &r, const Vec3 &center, float radiusSq, float *t)
+{
+    int mask = 0;
+    for (int l = 0; l < SIMD_WIDTH; ++l)
+    {
+        Vec3 oc(r.ox[l] - center.x, r.oy[l] - center.y, r.oz[l] - center.z);
+        Vec3 dir(r.dx[l], r.dy[l], r.dz[l]);
+        float half_b = oc.dot(dir);
+        float discriminant = half_b * half_b - (oc.dot(oc) - radiusSq);
+        if (discriminant < 0)
+            continue;
+
+        float sq = std::sqrt(discriminant);
+        float tl = -half_b - sq;
+        if (tl < 0) tl = -half_b + sq;
+        if (tl >= 0)
+        {
+            t[l] = tl;
+            mask |= 1 << l;
+        }
+    }
+    return mask;
+}
+
+int lensLanesScalar(const RayLanes8 &r, const Vec3 &c1, const Vec3 &c2, float radiusSq, float *t)
+{
+    int mask = 0;
+    for (int l = 0; l < SIMD_WIDTH; ++l)
+    {
+        Vec3 dir(r.dx[l], r.dy[l], r.dz[l]);
+        Vec3 oc1(r.ox[l] - c1.x, r.oy[l] - c1.y, r.oz[l] - c1.z);
+        float b1 = oc1.dot(dir);
+        float d1 = b1 * b1 - (oc1.dot(oc1) - radiusSq);
+        Vec3 oc2(r.ox[l] - c2.x, r.oy[l] - c2.y, r.oz[l] - c2.z);
+        float b2 = oc2.dot(dir);
+        float d2 = b2 * b2 - (oc2.dot(oc2) - radiusSq);
+        if (d1 < 0 || d2 < 0)
+            continue;
+
+        float s1 = std::sqrt(d1), s2 = std::sqrt(d2);
+        float tEnter = std::max(-b1 - s1, -b2 - s2);
+        float tExit = std::min(-b1 + s1, -b2 + s2);
+        if (tEnter < tExit && tExit > 0)
+        {
+            t[l] = (tEnter > 0) ? tEnter : tExit;
+            mask |= 1 << l;
+        }
+    }
+    return mask;
+}
+
+#ifdef SIMD_INTERSECT_X86
+
+// Общая часть: half_b и дискриминант для 8 лучей и одной сферы
+__attribute__((target("avx2,fma")))
+inline void sphereLanesAvx2(const RayLanes8 &r, const Vec3 &center, __m256 radiusSq, __m256 &halfB, __m256 &disc)
+{
+    __m256 ocx = _mm256_sub_ps(_mm256_load_ps(r.ox), _mm256_set1_ps(center.x));
+    __m256 ocy = _mm256_sub_ps(_mm256_load_ps(r.oy), _mm256_set1_ps(center.y));
+    __m256 ocz = _mm256_sub_ps(_mm256_load_ps(r.oz), _mm256_set1_ps(center.z));
+    __m256 dx = _mm256_load_ps(r.dx);
+    __m256 dy = _mm256_load_ps(r.dy);
+    __m256 dz = _mm256_load_ps(r.dz);
+
+    halfB = _mm256_fmadd_ps(ocz, dz, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocx, dx)));
+    __m256 c = _mm256_sub_ps(_mm256_fmadd_ps(ocz, ocz, _mm256_fmadd_ps(ocy, ocy, _mm256_mul_ps(ocx, ocx))), radiusSq);
+    disc = _mm256_fmsub_ps(halfB, halfB, c);
+}
+
+__attribute__((target("avx2,fma")))
+int sphereLanesAvx2(const RayLanes8 &r, const Vec3 &center, float radiusSq, float *t)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 halfB, disc;
+    sphereLanesAvx2(r, center, _mm256_set1_ps(radiusSq), halfB, disc);
+
+    __m256 hit = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+    __m256 sq = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+    __m256 negB = _mm256_sub_ps(zero, halfB);
+    __m256 tNear = _mm256_sub_ps(negB, sq);
+    __m256 tFar = _mm256_add_ps(negB, sq);
+    __m256 tRes = _mm256_blendv_ps(tNear, tFar, _mm256_cmp_ps(tNear, zero, _CMP_LT_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(tRes, zero, _CMP_GE_OQ));
+
+    _mm256_storeu_ps(t, tRes);
+    return _mm256_movemask_ps(hit);
+}
+
+__attribute__((target("avx2,fma")))
+int lensLanesAvx2(const RayLanes8 &r, const Vec3 &c1, const Vec3 &c2, float radiusSq, float *t)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 r2 = _mm256_set1_ps(radiusSq);
+    __m256 b1, d1, b2, d2;
+    sphereLanesAvx2(r, c1, r2, b1, d1);
+    sphereLanesAvx2(r, c2, r2, b2, d2);
+
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(d1, zero, _CMP_GE_OQ), _mm256_cmp_ps(d2, zero, _CMP_GE_OQ));
+    __m256 s1 = _mm256_sqrt_ps(_mm256_max_ps(d1, zero));
+    __m256 s2 = _mm256_sqrt_ps(_mm256_max_ps(d2, zero));
+    __m256 nb1 = _mm256_sub_ps(zero, b1);
+    __m256 nb2 = _mm256_sub_ps(zero, b2);
+
+    __m256 tEnter = _mm256_max_ps(_mm256_sub_ps(nb1, s1), _mm256_sub_ps(nb2, s2));
+    __m256 tExit = _mm256_min_ps(_mm256_add_ps(nb1, s1), _mm256_add_ps(nb2, s2));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(tEnter, tExit, _CMP_LT_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(tExit, zero, _CMP_GT_OQ));
+    __m256 tRes = _mm256_blendv_ps(tExit, tEnter, _mm256_cmp_ps(tEnter, zero, _CMP_GT_OQ));
+
+    _mm256_storeu_ps(t, tRes);
+    return _mm256_movemask_ps(hit);
+}
+
+__attribute__((target("avx2,fma")))
+int sphereBlockAvx2(const SpherePack &p, const Ray &ray, int block, float *t)
+{
+    int base = block * SIMD_WIDTH;
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 ocx = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_loadu_ps(&p.cx[base]));
+    __m256 ocy = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_loadu_ps(&p.cy[base]));
+    __m256 ocz = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_loadu_ps(&p.cz[base]));
+
+    __m256 dx = _mm256_set1_ps(ray.direction.x);
+    __m256 dy = _mm256_set1_ps(ray.direction.y);
+    __m256 dz = _mm256_set1_ps(ray.direction.z);
+
+    __m256 halfB = _mm256_fmadd_ps(ocz, dz, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocx, dx)));
+    __m256 ocLen = _mm256_fmadd_ps(ocz, ocz, _mm256_fmadd_ps(ocy, ocy, _mm256_mul_ps(ocx, ocx)));
+    __m256 c = _mm256_sub_ps(ocLen, _mm256_loadu_ps(&p.r2[base]));
+    __m256 disc = _mm256_fmsub_ps(halfB, halfB, c);
+
+    __m256 hit = _mm256_cmp_ps(disc, zero, _CMP_GE_OQ);
+    __m256 sq = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+    __m256 negB = _mm256_sub_ps(zero, halfB);
+    __m256 tNear = _mm256_sub_ps(negB, sq);
+    __m256 tFar = _mm256_add_ps(negB, sq);
+
+    // Если ближний корень позади начала луча, берем дальний
+    __m256 tRes = _mm256_blendv_ps(tNear, tFar, _mm256_cmp_ps(tNear, zero, _CMP_LT_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(tRes, zero, _CMP_GE_OQ));
+
+    _mm256_storeu_ps(t, tRes);
+    return _mm256_movemask_ps(hit);
+}
+
+__attribute__((target("avx2,fma")))
+int lensBlockAvx2(const LensPack &p, const Ray &ray, int block, float *t)
+{
+    int base = block * SIMD_WIDTH;
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 ox = _mm256_set1_ps(ray.origin.x);
+    __m256 oy = _mm256_set1_ps(ray.origin.y);
+    __m256 oz = _mm256_set1_ps(ray.origin.z);
+    __m256 dx = _mm256_set1_ps(ray.direction.x);
+    __m256 dy = _mm256_set1_ps(ray.direction.y);
+    __m256 dz = _mm256_set1_ps(ray.direction.z);
+    __m256 r2 = _mm256_loadu_ps(&p.r2[base]);
+
+    // Первая сфера
+    __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(&p.c1x[base]));
+    __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(&p.c1y[base]));
+    __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(&p.c1z[base]));
+    __m256 b1 = _mm256_fmadd_ps(ocz, dz, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocx, dx)));
+    __m256 c1 = _mm256_sub_ps(_mm256_fmadd_ps(ocz, ocz, _mm256_fmadd_ps(ocy, ocy, _mm256_mul_ps(ocx, ocx))), r2);
+    __m256 d1 = _mm256_fmsub_ps(b1, b1, c1);
+
+    // Вторая сфера
+    ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(&p.c2x[base]));
+    ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(&p.c2y[base]));
+    ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(&p.c2z[base]));
+    __m256 b2 = _mm256_fmadd_ps(ocz, dz, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocx, dx)));
+    __m256 c2 = _mm256_sub_ps(_mm256_fmadd_ps(ocz, ocz, _mm256_fmadd_ps(ocy, ocy, _mm256_mul_ps(ocx, ocx))), r2);
+    __m256 d2 = _mm256_fmsub_ps(b2, b2, c2);
+
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(d1, zero, _CMP_GE_OQ), _mm256_cmp_ps(d2, zero, _CMP_GE_OQ));
+
+    __m256 s1 = _mm256_sqrt_ps(_mm256_max_ps(d1, zero));
+    __m256 s2 = _mm256_sqrt_ps(_mm256_max_ps(d2, zero));
+    __m256 nb1 = _mm256_sub_ps(zero, b1);
+    __m256 nb2 = _mm256_sub_ps(zero, b2);
+
+    // Пересечение интервалов [t1min, t1max] и [t2min, t2max]
+    __m256 tEnter = _mm256_max_ps(_mm256_sub_ps(nb1, s1), _mm256_sub_ps(nb2, s2));
+    __m256 tExit = _mm256_min_ps(_mm256_add_ps(nb1, s1), _mm256_add_ps(nb2, s2));
+
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(tEnter, tExit, _CMP_LT_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(tExit, zero, _CMP_GT_OQ));
+
+    __m256 tRes = _mm256_blendv_ps(tExit, tEnter, _mm256_cmp_ps(tEnter, zero, _CMP_GT_OQ));
+
+    _mm256_storeu_ps(t, tRes);
+    return _mm256_movemask_ps(hit);
+}
+
+bool detectAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+#endif
+
+using SphereKernel = int (*)(const SpherePack &, const Ray &, int, float *);
+using LensKernel = int (*)(const LensPack &, const Ray &, int, float *);
+
+// Выбор реализации выполняется один раз при первом обращении
+SphereKernel sphereKernel()
+{
+#ifdef SIMD_INTERSECT_X86
+    static const SphereKernel kernel = detectAvx2() ? sphereBlockAvx2 : sphereBlockScalar;
+    return kernel;
+#else
+    return sphereBlockScalar;
+#endif
+}
+
+LensKernel lensKernel()
+{
+#ifdef SIMD_INTERSECT_X86
+    static const LensKernel kernel = detectAvx2() ? lensBlockAvx2 : lensBlockScalar;
+    return kernel;
+#else
+    return lensBlockScalar;
+#endif
+}
+
+}
+
+bool simdIntersectAvailable()
+{
+#ifdef SIMD_INTERSECT_X86
+    static const bool available = detectAvx2();
+    return available;
+#else
+    return false;
+#endif
+}
+
+void SpherePack::clear()
+{
+    cx.clear();
+    cy.clear();
+    cz.clear();
+    r2.clear();
+    size = 0;
+}
+
+void SpherePack::add(const Vec3 &center, float radius)
+{
+    cx.resize(size);
+    cy.resize(size);
+    cz.resize(size);
+    r2.resize(size);
+
+    cx.push_back(center.x);
+    cy.push_back(center.y);
+    cz.push_back(center.z);
+    r2.push_back(radius * radius);
+    ++size;
+
+    int padded = roundUp(size);
+    padTo(cx, padded, 0.0f);
+    padTo(cy, padded, 0.0f);
+    padTo(cz, padded, 0.0f);
+    padTo(r2, padded, PAD_RADIUS_SQ);
+}
+
+int SpherePack::blocks() const
+{
+    return roundUp(size) / SIMD_WIDTH;
+}
+
+int SpherePack::intersectBlock(const Ray &ray, int block, float *t) const
+{
+    return sphereKernel()(*this, ray, block, t);
+}
+
+void LensPack::clear()
+{
+    c1x.clear();
+    c1y.clear();
+    c1z.clear();
+    c2x.clear();
+    c2y.clear();
+    c2z.clear();
+    r2.clear();
+    size = 0;
+}
+
+void LensPack::add(const Vec3 &focalPos1, const Vec3 &focalPos2, float curveRadius)
+{
+    for (auto *v : {&c1x, &c1y, &c1z, &c2x, &c2y, &c2z, &r2})
+        v->resize(size);
+
+    c1x.push_back(focalPos1.x);
+    c1y.push_back(focalPos1.y);
+    c1z.push_back(focalPos1.z);
+    c2x.push_back(focalPos2.x);
+    c2y.push_back(focalPos2.y);
+    c2z.push_back(focalPos2.z);
+    r2.push_back(curveRadius * curveRadius);
+    ++size;
+
+    int padded = roundUp(size);
+    for (auto *v : {&c1x, &c1y, &c1z, &c2x, &c2y, &c2z})
+        padTo(*v, padded, 0.0f);
+    padTo(r2, padded, PAD_RADIUS_SQ);
+}
+
+int LensPack::blocks() const
+{
+    return roundUp(size) / SIMD_WIDTH;
+}
+
+int LensPack::intersectBlock(const Ray &ray, int block, float *t) const
+{
+    return lensKernel()(*this, ray, block, t);
+}
+
+int intersectSphereLanes(const RayLanes8 &rays, const Vec3 &center, float radiusSq, float *t)
+{
+#ifdef SIMD_INTERSECT_X86
+    if (simdIntersectAvailable())
+        return sphereLanesAvx2(rays, center, radiusSq, t);
+#endif
+    return sphereLanesScalar(rays, center, radiusSq, t);
+}
+
+int intersectLensLanes(const RayLanes8 &rays, const Vec3 &focalPos1, const Vec3 &focalPos2, float radiusSq, float *t)
+{
+#ifdef SIMD_INTERSECT_X86
+    if (simdIntersectAvailable())
+        return lensLanesAvx2(rays, focalPos1, focalPos2, radiusSq, t);
+#endif
+    return lensLanesScalar(rays, focalPos1, focalPos2, radiusSq, t);
+}
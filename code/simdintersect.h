@@ -0,0 +1,60 @@
+#ifndef SIMDINTERSECT_H
+#define SIMDINTERSECT_H
+
+#include <vector>
+#include "primitives.h"
+
+// Ширина SIMD-блока: 8 примитивов за одну операцию AVX2
+constexpr int SIMD_WIDTH = 8;
+
+// SoA-пакет сфер. Массивы дополняются до кратного SIMD_WIDTH,
+// у фиктивных сфер квадрат радиуса равен -inf, поэтому они никогда не пересекаются
+struct SpherePack
+{
+    std::vector<float> cx, cy, cz, r2;
+    int size = 0;
+
+    void clear();
+    void add(const Vec3 &center, float radius);
+    int blocks() const;
+
+    // Пересечение луча с блоком из 8 сфер (логика Sphere::intersect).
+    // Возвращает битовую маску попаданий, расстояния записываются в t[SIMD_WIDTH]
+    int intersectBlock(const Ray &ray, int block, float *t) const;
+};
+
+// SoA-пакет линз: пары сфер с центрами в фокусных точках линзы
+struct LensPack
+{
+    std::vector<float> c1x, c1y, c1z;
+    std::vector<float> c2x, c2y, c2z;
+    std::vector<float> r2;
+    int size = 0;
+
+    void clear();
+    void add(const Vec3 &focalPos1, const Vec3 &focalPos2, float curveRadius);
+    int blocks() const;
+
+    // Пересечение луча с блоком из 8 линз, включая пересечение интервалов двух сфер (логика Lens::intersect)
+    int intersectBlock(const Ray &ray, int block, float *t) const;
+};
+
+// SoA-группа из 8 лучей для пакетной трассировки
+struct RayLanes8
+{
+    alignas(32) float ox[SIMD_WIDTH];
+    alignas(32) float oy[SIMD_WIDTH];
+    alignas(32) float oz[SIMD_WIDTH];
+    alignas(32) float dx[SIMD_WIDTH];
+    alignas(32) float dy[SIMD_WIDTH];
+    alignas(32) float dz[SIMD_WIDTH];
+};
+
+// Пересечение 8 лучей с одной сферой / линзой. Возвращает маску попаданий, расстояния пишутся в t
+int intersectSphereLanes(const RayLanes8 &rays, const Vec3 &center, float radiusSq, float *t);
+int intersectLensLanes(const RayLanes8 &rays, const Vec3 &focalPos1, const Vec3 &focalPos2, float radiusSq, float *t);
+
+// true, если процессор поддерживает AVX2 и используется векторная ветка
+bool simdIntersectAvailable();
+
+#endif // SIMDINTERSECT_H
@@ -0,0 +1,157 @@
+#include "spectrum.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+
+// Шаг таблицы цветов длин волн, нм
+const float SPECTRUM_TABLE_STEP = 1.0f;
+const int SPECTRUM_TABLE_SIZE = int((SPECTRUM_MAX_WAVELENGTH - SPECTRUM_MIN_WAVELENGTH) / SPECTRUM_TABLE_STEP) + 1;
+
+// Кусочно-гауссова функция аппроксимации кривых сложения цветов (Wyman, Sloan, Shirley 2013)
+float lobe(float wavelength, float mean, float sigmaLow, float sigmaHigh)
+{
+    float t = (wavelength - mean) / (wavelength < mean ? sigmaLow : sigmaHigh);
+    return std::exp(-0.5f * t * t);
+}
+
+Vec3 wavelengthToXyz(float wavelength)
+{
+    float x = 1.056f * lobe(wavelength, 599.8f, 37.9f, 31.0f) + 0.362f * lobe(wavelength, 442.0f, 16.0f, 26.7f)
+            - 0.065f * lobe(wavelength, 501.1f, 20.4f, 26.2f);
+    float y = 0.821f * lobe(wavelength, 568.8f, 46.9f, 40.5f) + 0.286f * lobe(wavelength, 530.9f, 16.3f, 31.1f);
+    float z = 1.217f * lobe(wavelength, 437.0f, 11.8f, 36.0f) + 0.681f * lobe(wavelength, 459.0f, 26.0f, 13.8f);
+    return Vec3(x, y, z);
+}
+
+// Линейный sRGB; цвета вне охвата sRGB обрезаются до неотрицательных
+Vec3 xyzToRgb(const Vec3 &c)
+{
+    return Vec3(std::max(0.0f, 3.2406f * c.x - 1.5372f * c.y - 0.4986f * c.z),
+                std::max(0.0f, -0.9689f * c.x + 1.8758f * c.y + 0.0415f * c.z),
+                std::max(0.0f, 0.0557f * c.x - 0.2040f * c.y + 1.0570f * c.z));
+}
+
+struct SpectrumTable
+{
+    std::array<Vec3, SPECTRUM_TABLE_SIZE> rgb;
+
+    SpectrumTable()
+    {
+        Vec3 sum(0, 0, 0);
+        for (int i = 0; i < SPECTRUM_TABLE_SIZE; ++i)
+        {
+            rgb[i] = xyzToRgb(wavelengthToXyz(SPECTRUM_MIN_WAVELENGTH + i * SPECTRUM_TABLE_STEP));
+            sum += rgb[i];
+        }
+        Vec3 norm(SPECTRUM_TABLE_SIZE / sum.x, SPECTRUM_TABLE_SIZE / sum.y, SPECTRUM_TABLE_SIZE / sum.z);
+        for (Vec3 &c : rgb)
+            c *= norm;
+    }
+};
+
+const SpectrumTable &spectrumTable()
+{
+    static const SpectrumTable table;
+    return table;
+}
+
+}
+
+HeroWavelengths HeroWavelengths::sample(float u)
+{
+    const float range = SPECTRUM_MAX_WAVELENGTH - SPECTRUM_MIN_WAVELENGTH;
+    float offsets[HERO_WAVELENGTHS_NUM];
+    for (int i = 0; i < HERO_WAVELENGTHS_NUM; ++i)
+        offsets[i] = std::fmod(u + float(i) / HERO_WAVELENGTHS_NUM, 1.0f);
+
+    HeroWavelengths result;
+    result.lanes = Vec4f(offsets[0], offsets[1], offsets[2], offsets[3]) * range + Vec4f::splat(SPECTRUM_MIN_WAVELENGTH);
+    return result;
+}
+
+float HeroWavelengths::hero() const
+{
+    return lanes[0];
+}
+
+float HeroWavelengths::lane(int i) const
+{
+    return lanes[i];
+}
+
+Vec3 wavelengthToRgb(float wavelength)
+{
+    const SpectrumTable &table = spectrumTable();
+    float t = (wavelength - SPECTRUM_MIN_WAVELENGTH) / SPECTRUM_TABLE_STEP;
+    if (t <= 0.0f)
+        return table.rgb.front();
+    if (t >= SPECTRUM_TABLE_SIZE - 1)
+        return table.rgb.back();
+
+    int i = int(t);
+    float f = t - i;
+    return table.rgb[i] * (1.0f - f) + table.rgb[i + 1] * f;
+}
+
+Vec4f refractiveIndices(const GraphicParams &params, const Vec4f &wavelengths)
+{
+    // Формула Коши для четырех полос сразу, длины волн в мкм
+    Vec4f lambda = wavelengths * 1e-3f;
+    const float reference = REFERENCE_WAVELENGTH * 1e-3f;
+    Vec4f inverseSquare = Vec4f::splat(1.0f) / (lambda * lambda);
+    return Vec4f::splat(params._refractiveIndex - params._cauchyB / (reference * reference))
+         + inverseSquare * params._cauchyB;
+}
+
+SpectralRefraction refractSpectral(const Vec3 &incident, const Vec3 &normal, float outsideIndex,
+                                   const GraphicParams &params, float wavelength, float u)
+{
+    SpectralRefraction result;
+
+    // Путь уже монохроматический или материал без дисперсии — одно направление
+    if (wavelength > 0.0f || params._cauchyB == 0.0f)
+    {
+        result.wavelength = wavelength;
+        result.refractiveIndex = wavelength > 0.0f ? params.refractiveIndexAt(wavelength) : params._refractiveIndex;
+        result.direction = Vec3::refract(incident, normal, outsideIndex, result.refractiveIndex);
+        return result;
+    }
+
+    HeroWavelengths wavelengths = HeroWavelengths::sample(u);
+    Vec4f indices = refractiveIndices(params, wavelengths.lanes);
+    Vec3 directions[HERO_WAVELENGTHS_NUM];
+    for (int i = 0; i < HERO_WAVELENGTHS_NUM; ++i)
+        directions[i] = Vec3::refract(incident, normal, outsideIndex, indices[i]);
+
+    // Полосы разделяются, если угол между направлениями больше допустимого
+    // или полное внутреннее отражение наступает не для всех длин волн
+    const float maxSin2 = SPECTRAL_SEPARATION_ANGLE * SPECTRAL_SEPARATION_ANGLE;
+    bool heroReflected = directions[0].lengthSquared() == 0.0f;
+    bool separated = false;
+    for (int i = 1; i < HERO_WAVELENGTHS_NUM && !separated; ++i)
+    {
+        bool reflected = directions[i].lengthSquared() == 0.0f;
+        if (reflected != heroReflected)
+            separated = true;
+        else if (!reflected)
+            separated = directions[0].cross(directions[i]).lengthSquared() > maxSin2 * directions[0].lengthSquared() * directions[i].lengthSquared();
+    }
+
+    if (!separated)
+    {
+        result.refractiveIndex = params._refractiveIndex;
+        result.direction = Vec3::refract(incident, normal, outsideIndex, result.refractiveIndex);
+        return result;
+    }
+
+    // Остальные полосы уходят по другим направлениям и отбрасываются: путь продолжает ведущая длина волны.
+    // Она распределена равномерно, поэтому среднее wavelengthToRgb по выборкам восстанавливает исходный цвет
+    result.wavelength = wavelengths.hero();
+    result.refractiveIndex = indices[0];
+    result.direction = directions[0];
+    result.weight = wavelengthToRgb(result.wavelength);
+    return result;
+}
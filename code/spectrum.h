@@ -0,0 +1,54 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "primitives.h"
+#include "vecmath.h"
+
+// Видимый диапазон, по которому выбираются длины волн, нм
+const float SPECTRUM_MIN_WAVELENGTH = 380.0f;
+const float SPECTRUM_MAX_WAVELENGTH = 720.0f;
+// Пути, направления длин волн которых расходятся меньше чем на этот угол, считаются неразделенными, рад
+const float SPECTRAL_SEPARATION_ANGLE = 1e-3f;
+// Число длин волн, переносимых одним путем
+const int HERO_WAVELENGTHS_NUM = 4;
+
+// Длины волн пути по схеме ведущей длины волны (hero wavelength): ведущая выбирается равномерно,
+// остальные сдвинуты по кругу на равные доли диапазона, так что четыре полосы покрывают спектр равномерно
+struct HeroWavelengths
+{
+    Vec4f lanes;
+
+    // u в [0, 1) задает ведущую длину волны
+    static HeroWavelengths sample(float u);
+
+    float hero() const;
+    float lane(int i) const;
+};
+
+// Вклад монохроматического пути длины волны wavelength в линейный RGB (по аппроксимации кривых CIE 1931).
+// Нормирован так, что среднее по диапазону равно (1, 1, 1): белый свет, разложенный на длины волн, остается белым
+Vec3 wavelengthToRgb(float wavelength);
+
+// Показатели преломления материала для четырех длин волн сразу
+Vec4f refractiveIndices(const GraphicParams &params, const Vec4f &wavelengths);
+
+// Результат преломления с учетом дисперсии
+struct SpectralRefraction
+{
+    Vec3 direction;
+    // Показатель преломления материала для длины волны пути
+    float refractiveIndex = 1.0f;
+    // Длина волны пути после преломления: 0 — путь по-прежнему переносит весь спектр
+    float wavelength = 0.0f;
+    // Множитель переносимой мощности: цвет ведущей длины волны, если путь свернут к ней
+    Vec3 weight = Vec3(1, 1, 1);
+};
+
+// Преломление через поверхность материала params. outsideIndex — показатель среды вне объекта,
+// wavelength — длина волны пути (0, если путь переносит весь спектр), u — случайное число в [0, 1).
+// Путь, переносящий весь спектр, преломляется сразу для четырех длин волн; если их направления расходятся
+// (или часть из них испытывает полное внутреннее отражение), путь сворачивается к ведущей длине волны
+SpectralRefraction refractSpectral(const Vec3 &incident, const Vec3 &normal, float outsideIndex,
+                                   const GraphicParams &params, float wavelength, float u);
+
+#endif // SPECTRUM_H
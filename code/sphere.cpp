@@ -14,11 +14,7 @@ Sphere::Sphere(const Sphere& other)
 {
     _center = other._center;
     _radius = other._radius;
-    _params._color = other._params._color;
-    _params._transparency = other._params._transparency;
-    _params._refractiveIndex = other._params._refractiveIndex;
-    _params._reflectivity = other._params._reflectivity;
-    _params._emission = other._params._emission;
+    _params = other._params;
 }
 
 bool Sphere::intersect(const Ray& ray) const {
@@ -58,3 +54,43 @@ GraphicParams Sphere::hitParams(const Ray &ray, float t) const
     rp._normal = (ray.origin + ray.direction * t - _center).normalize();
     return rp;
 }
+
+std::shared_ptr<BaseObject> Sphere::clone() const
+{
+    return std::make_shared<Sphere>(*this);
+}
+
+Aabb Sphere::bounds() const
+{
+    Vec3 r(_radius, _radius, _radius);
+    return Aabb(_center - r, _center + r);
+}
+
+bool Sphere::sampleSurface(const Vec3 &from, float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const
+{
+    // Равномерно по полусфере, обращенной к from: обратная сторона все равно закрыта самой сферой
+    Vec3 axis = (from - _center).normalize();
+    Vec3 a = std::fabs(axis.x) > 0.9f ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    Vec3 t1 = a.cross(axis).normalize();
+    Vec3 t2 = axis.cross(t1);
+
+    float cosTheta = u1;
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 2.0f * M_PI * u2;
+    normal = t1 * (std::cos(phi) * sinTheta) + t2 * (std::sin(phi) * sinTheta) + axis * cosTheta;
+    point = _center + normal * _radius;
+    pdf = 1.0f / (2.0f * M_PI * _radius * _radius);
+    return true;
+}
+
+bool Sphere::sampleEmission(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const
+{
+    // Равномерно по всей сфере, светит наружу
+    float cosTheta = 1.0f - 2.0f * u1;
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 2.0f * M_PI * u2;
+    normal = Vec3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+    point = _center + normal * _radius;
+    pdf = 1.0f / (4.0f * M_PI * _radius * _radius);
+    return true;
+}
@@ -26,6 +26,10 @@ public:
     virtual void setPosition(const Vec3 &) override;
 
     virtual GraphicParams hitParams(const Ray& ray, float t) const override;
+    virtual Aabb bounds() const override;
+    virtual std::shared_ptr<BaseObject> clone() const override;
+    virtual bool sampleSurface(const Vec3 &from, float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const override;
+    virtual bool sampleEmission(float u1, float u2, Vec3 &point, Vec3 &normal, float &pdf) const override;
 };
 
 
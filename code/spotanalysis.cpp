@@ -0,0 +1,283 @@
+#include "spotanalysis.h"
+#include <algorithm>
+#include <cmath>
+#include "threadpool.h"
+
+namespace
+{
+
+const float PI = 3.14159265358979f;
+// Смещение начала луча после преломления, чтобы не пересечь ту же поверхность повторно
+const float SPOT_RAY_BIAS = 1e-4f;
+// Высота параксиальных лучей для фокусного расстояния в долях радиуса зрачка
+const float PARAXIAL_HEIGHT = 1e-2f;
+
+void tangentBasis(const Vec3 &n, Vec3 &t1, Vec3 &t2)
+{
+    Vec3 a = std::fabs(n.x) > 0.9f ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    t1 = a.cross(n).normalize();
+    t2 = n.cross(t1);
+}
+
+// Последовательность R2 (Roberts): равномерное заполнение квадрата без случайного генератора,
+// i-я точка вычисляется независимо от остальных
+void r2Sequence(int index, float &u, float &v)
+{
+    const double a1 = 0.7548776662466927;
+    const double a2 = 0.5698402909980532;
+    double x = 0.5 + a1 * index;
+    double y = 0.5 + a2 * index;
+    u = float(x - std::floor(x));
+    v = float(y - std::floor(y));
+}
+
+// Взвешенные суммы по лучам пакета. (u, v) — точка на плоскости изображения,
+// (a, b) — наклон луча: смещение в плоскости на единицу сдвига вдоль нормали
+struct SpotMoments
+{
+    double weight = 0;
+    double u = 0, v = 0;
+    double a = 0, b = 0;
+    double uv2 = 0;
+    double ab2 = 0;
+    double uvab = 0;
+    int arrived = 0;
+
+    void add(const SpotMoments &other)
+    {
+        weight += other.weight;
+        u += other.u;
+        v += other.v;
+        a += other.a;
+        b += other.b;
+        uv2 += other.uv2;
+        ab2 += other.ab2;
+        uvab += other.uvab;
+        arrived += other.arrived;
+    }
+};
+
+}
+
+SpotAnalyzer::SpotAnalyzer(const SpotAnalysisSettings &settings)
+    : _settings(settings)
+{
+}
+
+const SpotAnalysisSettings &SpotAnalyzer::settings() const
+{
+    return _settings;
+}
+
+void SpotAnalyzer::setSettings(const SpotAnalysisSettings &settings)
+{
+    _settings = settings;
+}
+
+SpotAnalysisResult SpotAnalyzer::analyze(const std::vector<std::shared_ptr<BaseObject>> &objects) const
+{
+    SceneIntersector scene(objects);
+    return analyze(scene);
+}
+
+SpotAnalysisResult SpotAnalyzer::analyze(const SceneIntersector &scene) const
+{
+    SpotAnalysisResult result;
+    const Vec3 normal = _settings.planeNormal.normalize();
+    tangentBasis(normal, result.planeU, result.planeV);
+
+    const int raysNum = std::max(0, _settings.raysNum);
+    const int resolution = std::max(1, _settings.psfResolution);
+    const float halfSize = _settings.planeHalfSize;
+    const int spotsNum = std::min(raysNum, std::max(0, _settings.maxSpotPoints));
+    const int batchesNum = (raysNum + SPOT_BATCH_SIZE - 1) / SPOT_BATCH_SIZE;
+
+    ThreadPool &pool = ThreadPool::instance();
+    ThreadPool::SizeLock sizeLock(pool);
+    std::vector<SpotMoments> moments(batchesNum);
+    // Гистограммы по рабочим потокам и одна для внешнего потока
+    std::vector<std::vector<float>> histograms(pool.threadsNum() + 1);
+    std::vector<SpotPoint> spots(spotsNum);
+
+    pool.parallelFor(batchesNum, [&](int batch)
+    {
+        std::vector<float> &histogram = histograms[pool.currentThreadIndex()];
+        if (histogram.empty())
+            histogram.assign(resolution * resolution, 0.0f);
+
+        SpotMoments &m = moments[batch];
+        const int end = std::min(raysNum, (batch + 1) * SPOT_BATCH_SIZE);
+        for (int i = batch * SPOT_BATCH_SIZE; i < end; ++i)
+        {
+            Ray ray = pupilRay(i);
+            float weight = 1.0f;
+            if (!traceRay(scene, ray, weight) || weight <= 0.0f)
+                continue;
+
+            Vec3 offset = ray.origin - _settings.planePoint;
+            float u = offset.dot(result.planeU);
+            float v = offset.dot(result.planeV);
+            float dn = ray.direction.dot(normal);
+            float a = ray.direction.dot(result.planeU) / dn;
+            float b = ray.direction.dot(result.planeV) / dn;
+
+            m.weight += weight;
+            m.u += weight * u;
+            m.v += weight * v;
+            m.a += weight * a;
+            m.b += weight * b;
+            m.uv2 += weight * (double(u) * u + double(v) * v);
+            m.ab2 += weight * (double(a) * a + double(b) * b);
+            m.uvab += weight * (double(u) * a + double(v) * b);
+            ++m.arrived;
+
+            if (i < spotsNum)
+                spots[i] = {u, v, weight};
+
+            int ix = int(std::floor((u + halfSize) / (2.0f * halfSize) * resolution));
+            int iy = int(std::floor((v + halfSize) / (2.0f * halfSize) * resolution));
+            if (ix >= 0 && ix < resolution && iy >= 0 && iy < resolution)
+                histogram[iy * resolution + ix] += weight;
+        }
+    });
+
+    // Сложение пакетов по порядку: суммы не зависят от того, какой поток что обработал
+    SpotMoments total;
+    for (const SpotMoments &m : moments)
+        total.add(m);
+
+    result.tracedNum = raysNum;
+    result.arrivedNum = total.arrived;
+    result.transmittance = raysNum > 0 ? float(total.weight / raysNum) : 0.0f;
+    result.psfResolution = resolution;
+    result.psf.assign(resolution * resolution, 0.0f);
+    for (const std::vector<float> &histogram : histograms)
+        for (size_t i = 0; i < histogram.size(); ++i)
+            result.psf[i] += histogram[i] / std::max(1, raysNum);
+
+    for (const SpotPoint &spot : spots)
+        if (spot.weight > 0.0f)
+            result.spots.push_back(spot);
+
+    if (total.weight > 0.0)
+    {
+        double w = total.weight;
+        double mu = total.u / w, mv = total.v / w;
+        double ma = total.a / w, mb = total.b / w;
+        result.centroid = _settings.planePoint + result.planeU * float(mu) + result.planeV * float(mv);
+
+        // При сдвиге плоскости на z вдоль нормали точка луча смещается линейно: (u + a z, v + b z),
+        // поэтому квадрат радиуса пятна — парабола var0 + 2 cov z + varA z², минимум которой находится точно
+        double var0 = total.uv2 / w - (mu * mu + mv * mv);
+        double cov = total.uvab / w - (mu * ma + mv * mb);
+        double varA = total.ab2 / w - (ma * ma + mb * mb);
+        result.rmsRadius = float(std::sqrt(std::max(0.0, var0)));
+        if (varA > 1e-12)
+        {
+            result.bestFocusOffset = float(-cov / varA);
+            result.bestFocusRmsRadius = float(std::sqrt(std::max(0.0, var0 - cov * cov / varA)));
+        }
+        else
+        {
+            result.bestFocusRmsRadius = result.rmsRadius;
+        }
+    }
+
+    result.focalLength = focalLength(scene);
+    return result;
+}
+
+bool SpotAnalyzer::traceRay(const SceneIntersector &scene, Ray &ray, float &weight) const
+{
+    const Vec3 normal = _settings.planeNormal.normalize();
+    for (int i = 0; i <= _settings.maxInteractions; ++i)
+    {
+        HitRecord hit;
+        bool found = scene.closestHit(ray, hit);
+
+        // Плоскость изображения не является объектом сцены: луч останавливается на ней, если она ближе следующего попадания
+        float dn = ray.direction.dot(normal);
+        if (std::fabs(dn) > 1e-8f)
+        {
+            float tPlane = (_settings.planePoint - ray.origin).dot(normal) / dn;
+            if (tPlane > 0.0f && (!found || tPlane < hit.t))
+            {
+                ray.origin = ray.origin + ray.direction * tPlane;
+                return true;
+            }
+        }
+        if (!found || i == _settings.maxInteractions)
+            return false;
+
+        GraphicParams params = hit.object->hitParams(ray, hit.t);
+        if (params._transparency <= 0.0f)
+            return false;
+
+        // Градиентная среда ведет луч сама и возвращает его уже снаружи
+        if (hit.object->hasInterior() && ray.direction.dot(params._normal) < 0.0f)
+        {
+            Vec3 transmission(1.0f, 1.0f, 1.0f);
+            if (!hit.object->traceInterior(ray, hit.t, transmission))
+                return false;
+            weight *= (transmission.x + transmission.y + transmission.z) / 3.0f;
+            continue;
+        }
+
+        float index = _settings.wavelength > 0.0f ? params.refractiveIndexAt(_settings.wavelength) : params._refractiveIndex;
+        Vec3 direction = Vec3::refract(ray.direction, params._normal, 1.0f, index);
+        if (direction.lengthSquared() == 0.0f)
+            return false;
+
+        weight *= (1.0f - Vec3::fresnel(ray.direction, params._normal, index)) * params._transparency;
+        direction = direction.normalize();
+        ray.origin = ray.origin + ray.direction * hit.t + direction * SPOT_RAY_BIAS;
+        ray.direction = direction;
+    }
+    return false;
+}
+
+Ray SpotAnalyzer::pupilRay(int index) const
+{
+    const bool parallel = _settings.source == SpotSourceType::Parallel;
+    Vec3 axis = parallel ? _settings.direction.normalize() : (_settings.pupilCenter - _settings.sourcePosition).normalize();
+    Vec3 t1, t2;
+    tangentBasis(axis, t1, t2);
+
+    // Равномерная по площади точка круга зрачка
+    float u, v;
+    r2Sequence(index, u, v);
+    float r = _settings.pupilRadius * std::sqrt(u);
+    float phi = 2.0f * PI * v;
+    Vec3 point = _settings.pupilCenter + t1 * (r * std::cos(phi)) + t2 * (r * std::sin(phi));
+
+    if (parallel)
+        return Ray(point, axis);
+    return Ray(_settings.sourcePosition, (point - _settings.sourcePosition).normalize());
+}
+
+float SpotAnalyzer::focalLength(const SceneIntersector &scene) const
+{
+    if (_settings.source != SpotSourceType::Parallel)
+        return 0.0f;
+
+    // Два луча на малой высоте ±h от центра зрачка: f = -2h / (разность их наклонов после системы)
+    Vec3 axis = _settings.direction.normalize();
+    Vec3 t1, t2;
+    tangentBasis(axis, t1, t2);
+    const float h = PARAXIAL_HEIGHT * _settings.pupilRadius;
+
+    float slopes[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        Ray ray(_settings.pupilCenter + t1 * (i == 0 ? h : -h), axis);
+        float weight = 1.0f;
+        if (!traceRay(scene, ray, weight))
+            return 0.0f;
+        slopes[i] = ray.direction.dot(t1) / ray.direction.dot(axis);
+    }
+
+    float difference = slopes[0] - slopes[1];
+    if (std::fabs(difference) < 1e-7f)
+        return 0.0f;
+    return -2.0f * h / difference;
+}
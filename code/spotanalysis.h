@@ -0,0 +1,106 @@
+#ifndef SPOTANALYSIS_H
+#define SPOTANALYSIS_H
+
+#include <memory>
+#include <vector>
+#include "baseobject.h"
+#include "primitives.h"
+#include "sceneintersector.h"
+
+enum class SpotSourceType
+{
+    // Параллельный пучок вдоль direction через круглый зрачок
+    Parallel,
+    // Точечный источник в sourcePosition, лучи направлены в круглый зрачок
+    Point
+};
+
+struct SpotAnalysisSettings
+{
+    SpotSourceType source = SpotSourceType::Parallel;
+    Vec3 sourcePosition = Vec3(0, 0, -10);
+    // Направление параллельного пучка; для точечного источника не используется
+    Vec3 direction = Vec3(0, 0, 1);
+    // Входной зрачок: круг, перпендикулярный пучку, через который проходят все лучи
+    Vec3 pupilCenter = Vec3(0, 0, 0);
+    float pupilRadius = 1.0f;
+    int raysNum = 1000000;
+    // Длина волны, нм: показатели преломления берутся по формуле Коши материалов
+    float wavelength = REFERENCE_WAVELENGTH;
+    // Наибольшее число преломлений на пути луча
+    int maxInteractions = 16;
+
+    // Плоскость изображения и область гистограммы ФРТ на ней: квадрат со стороной 2 * planeHalfSize вокруг planePoint
+    Vec3 planePoint = Vec3(0, 0, 10);
+    Vec3 planeNormal = Vec3(0, 0, 1);
+    float planeHalfSize = 0.5f;
+    int psfResolution = 128;
+    // Сколько первых лучей сохраняется как точки диаграммы рассеяния
+    int maxSpotPoints = 20000;
+};
+
+// Точка диаграммы рассеяния в координатах плоскости изображения относительно planePoint
+struct SpotPoint
+{
+    float u = 0;
+    float v = 0;
+    float weight = 0;
+};
+
+struct SpotAnalysisResult
+{
+    int tracedNum = 0;
+    int arrivedNum = 0;
+    // Доля мощности, дошедшей до плоскости, с учетом потерь на отражение по Френелю
+    float transmittance = 0;
+
+    // Оси плоскости изображения, в которых заданы точки и гистограмма
+    Vec3 planeU;
+    Vec3 planeV;
+    Vec3 centroid;
+    // Среднеквадратичный радиус пятна относительно центроида
+    float rmsRadius = 0;
+    // Смещение плоскости наилучшей фокусировки вдоль planeNormal и радиус пятна в ней
+    float bestFocusOffset = 0;
+    float bestFocusRmsRadius = 0;
+    // Эффективное фокусное расстояние по параксиальным лучам; 0 для точечного источника или если оно не определено
+    float focalLength = 0;
+
+    std::vector<SpotPoint> spots;
+    // Функция рассеяния точки: psfResolution x psfResolution ячеек по строкам от -v к +v,
+    // в каждой — доля мощности источника, попавшая в ячейку
+    std::vector<float> psf;
+    int psfResolution = 0;
+};
+
+// Анализ оптической системы сцены трассировкой большого числа лучей от параллельного или точечного источника.
+// Лучи проходят прозрачные объекты по закону Снелла с потерями на отражение по Френелю
+// (отраженные лучи не прослеживаются), непрозрачный объект или полное внутреннее отражение лучи поглощают.
+// Объекты с неоднородной средой проводят луч сами через BaseObject::traceInterior.
+// Лучи раздаются пулу потоков пакетами по SPOT_BATCH_SIZE, точки зрачка — из квазислучайной последовательности,
+// поэтому статистика пятна не зависит от числа потоков
+class SpotAnalyzer
+{
+public:
+    static const int SPOT_BATCH_SIZE = 4096;
+
+    explicit SpotAnalyzer(const SpotAnalysisSettings &settings = SpotAnalysisSettings());
+
+    const SpotAnalysisSettings &settings() const;
+    void setSettings(const SpotAnalysisSettings &settings);
+
+    SpotAnalysisResult analyze(const std::vector<std::shared_ptr<BaseObject>> &objects) const;
+    SpotAnalysisResult analyze(const SceneIntersector &scene) const;
+
+    // Проводит луч через систему до плоскости изображения. ray заменяется последним отрезком пути
+    // с началом на плоскости, weight умножается на пропускание. false — луч поглощен или прошел мимо плоскости
+    bool traceRay(const SceneIntersector &scene, Ray &ray, float &weight) const;
+
+private:
+    Ray pupilRay(int index) const;
+    float focalLength(const SceneIntersector &scene) const;
+
+    SpotAnalysisSettings _settings;
+};
+
+#endif // SPOTANALYSIS_H
@@ -1,5 +1,28 @@
 #include "sphere.h"
 #include "thinlens.h"
+#include "simdintersect.h"
+#include "raypacket.h"
+#include "threadpool.h"
+#include "wavefront.h"
+#include "progressive.h"
+#include "adaptivesampling.h"
+#include "irradiancecache.h"
+#include "emitterregistry.h"
+#include "renderjobmanager.h"
+#include "renderprogress.h"
+#include "tonemapper.h"
+#include "rendertarget.h"
+#include "vecmath.h"
+#include "spectrum.h"
+#include "sequentiallens.h"
+#include "spotanalysis.h"
+#include "asphericlens.h"
+#include "grinlens.h"
+#include "csg.h"
+#include "meshinstance.h"
+#include "objloader.h"
+#include "polygonalmodel.h"
+#include "drawer.h"
 #ifdef TESTING
 #include "camera.h"
 #include "primitives.h"
@@ -64,6 +87,38 @@ private slots:
     void testLensSetRadius();
     void testLensSetCurveRadius();
 
+    void testSpherePackMatchesScalar();
+    void testLensPackMatchesScalar();
+    void testRayPacketMatchesSingleRays();
+    void testThreadPoolParallelFor();
+    void testSortPathStatesGroupsOctants();
+    void testRenderPassesCoverEachPixelOnce();
+    void testAdaptiveSamplesFollowEdges();
+    void testIrradianceCacheInterpolation();
+    void testEmitterSurfaceSampling();
+    void testAliasTableFollowsWeights();
+    void testRenderJobsSupersedeAndPreempt();
+    void testRenderProgressAccumulatesAcrossThreads();
+    void testToneMapperClampsAndMatchesScalarTail();
+    void testRenderTargetFrameSize();
+    void testVecMathMatchesVec3();
+    void benchmarkNormalize();
+    void benchmarkNormalizeBatch();
+    void testSpectralRefractionCollapsesWhenLanesSeparate();
+    void testSequentialLensSystemMatchesSceneTrace();
+    void testSpotAnalysisFindsFocus();
+    void testAsphericLensMatchesSphericalAndFocuses();
+    void testGrinRodFollowsPitch();
+    void testCsgBooleanOperations();
+    void testMeshInstancesShareMesh();
+    void testObjLoaderParsesChunksInParallel();
+    void testPolygonalModelIsIndexed();
+    void testWavefrontMatchesRecursiveTrace();
+    void testThroughputCutoffKeepsRadiance();
+    void testSceneSnapshotIsolatesEdits();
+    void testPhotonCarriesFullSpectrum();
+    void testDirectLightMatchesPhotonGather();
+
 };
 
 void TestAll::testLensParameterizedConstructor()
@@ -628,6 +683,1576 @@ void TestAll::testSphereHitParams()
     QCOMPARE(params._normal, expectedNormal);
 }
 
+void TestAll::testSpherePackMatchesScalar()
+{
+    std::vector<Sphere> spheres;
+    SpherePack pack;
+    for (int i = 0; i < 11; ++i)
+    {
+        spheres.emplace_back(Vec3(i - 5.0f, 0.5f * i, 2.0f), 0.5f + 0.1f * i, Vec3(1.0f, 1.0f, 1.0f));
+        pack.add(spheres.back()._center, spheres.back()._radius);
+    }
+    QCOMPARE(pack.blocks(), 2);
+
+    Ray ray(Vec3(-10.0f, 1.0f, 2.0f), Vec3(1.0f, 0.1f, 0.0f).normalize());
+    float t[SIMD_WIDTH];
+    for (int b = 0; b < pack.blocks(); ++b)
+    {
+        int mask = pack.intersectBlock(ray, b, t);
+        for (int l = 0; l < SIMD_WIDTH; ++l)
+        {
+            int i = b * SIMD_WIDTH + l;
+            float expectedT = 0;
+            bool expected = i < pack.size && spheres[i].intersect(ray, expectedT);
+            QCOMPARE(bool(mask & (1 << l)), expected);
+            if (expected)
+                QVERIFY(std::fabs(t[l] - expectedT) < 1e-4f);
+        }
+    }
+}
+
+void TestAll::testLensPackMatchesScalar()
+{
+    std::vector<Lens> lenses;
+    LensPack pack;
+    for (int i = 0; i < 9; ++i)
+    {
+        lenses.emplace_back(Vec3(0.0f, 0.0f, 3.0f * i), Vec3(0.0f, 0.1f * i, 1.0f), 5.0f, 2.0f, GraphicParams());
+        pack.add(lenses.back()._focalPos1, lenses.back()._focalPos2, lenses.back()._curveRadius);
+    }
+
+    Ray ray(Vec3(0.0f, 0.5f, -10.0f), Vec3(0.0f, 0.0f, 1.0f));
+    float t[SIMD_WIDTH];
+    for (int b = 0; b < pack.blocks(); ++b)
+    {
+        int mask = pack.intersectBlock(ray, b, t);
+        for (int l = 0; l < SIMD_WIDTH; ++l)
+        {
+            int i = b * SIMD_WIDTH + l;
+            float expectedT = 0;
+            bool expected = i < pack.size && lenses[i].intersect(ray, expectedT);
+            QCOMPARE(bool(mask & (1 << l)), expected);
+            if (expected)
+                QVERIFY(std::fabs(t[l] - expectedT) < 1e-4f);
+        }
+    }
+}
+
+void TestAll::testRayPacketMatchesSingleRays()
+{
+    std::vector<std::shared_ptr<BaseObject>> objects;
+    for (int i = 0; i < 12; ++i)
+        objects.push_back(std::make_shared<Sphere>(Vec3(i % 4 - 1.5f, i / 4 - 1.0f, 3.0f + i % 3), 0.4f, Vec3(1.0f, 1.0f, 1.0f)));
+    objects.push_back(std::make_shared<Lens>(Vec3(0.0f, 0.0f, 1.0f), Vec3(0.0f, 0.0f, 1.0f), 2.0f, 0.5f, GraphicParams()));
+    objects.push_back(std::make_shared<Polygon>(Vec3(-5.0f, -5.0f, 8.0f), Vec3(5.0f, -5.0f, 8.0f), Vec3(0.0f, 5.0f, 8.0f)));
+    SceneIntersector intersector(objects);
+
+    Camera camera(Vec3(0.0f, 0.0f, -5.0f), Vec3(0.0f, 0.0f, 1.0f), 1.0, 45.0);
+    CameraRayGenerator rays(camera, 64, 64);
+
+    for (int y0 = 0; y0 < 64; y0 += PACKET_DIM)
+    {
+        for (int x0 = 0; x0 < 64; x0 += PACKET_DIM)
+        {
+            RayPacket packet;
+            packet.reset();
+            for (int i = 0; i < PACKET_SIZE; ++i)
+                packet.setRay(i, rays.ray(x0 + i % PACKET_DIM + 0.5f, y0 + i / PACKET_DIM + 0.5f));
+            Vec3 corners[4] = {rays.direction(x0, y0), rays.direction(x0 + PACKET_DIM, y0),
+                               rays.direction(x0 + PACKET_DIM, y0 + PACKET_DIM), rays.direction(x0, y0 + PACKET_DIM)};
+            packet.frustum.build(rays.origin(), corners);
+            intersector.closestHit(packet);
+
+            for (int i = 0; i < PACKET_SIZE; ++i)
+            {
+                HitRecord single;
+                intersector.closestHit(packet.ray(i), single);
+                QCOMPARE(packet.hits[i].object, single.object);
+            }
+        }
+    }
+}
+
+void TestAll::testThreadPoolParallelFor()
+{
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> visited(1000);
+    for (auto &v : visited)
+        v = 0;
+
+    // Вложенный вызов не должен блокировать пул
+    pool.parallelFor(10, [&](int outer) {
+        pool.parallelFor(100, [&](int inner) { ++visited[outer * 100 + inner]; });
+    });
+
+    for (const auto &v : visited)
+        QCOMPARE(v.load(), 1);
+
+    // Смена числа потоков из другого потока не рушит идущие вызовы и разметку по потокам
+    std::atomic<bool> done(false);
+    std::thread resizer([&]() {
+        for (int i = 0; !done; ++i)
+            pool.setThreadsNum(2 + i % 3);
+    });
+    for (int round = 0; round < 50; ++round)
+    {
+        ThreadPool::SizeLock sizeLock(pool);
+        std::vector<long long> sums(pool.threadsNum() + 1, 0);
+        pool.parallelFor(200, [&](int i) { sums[pool.currentThreadIndex()] += i; });
+        long long total = 0;
+        for (long long sum : sums)
+            total += sum;
+        QCOMPARE(total, 199LL * 200 / 2);
+    }
+    done = true;
+    resizer.join();
+
+    // Два внешних потока одновременно: ячейка threadsNum() каждого вызова принадлежит только его потоку
+    std::atomic<int> wrong(0);
+    auto caller = [&]() {
+        for (int round = 0; round < 20; ++round)
+        {
+            ThreadPool::SizeLock sizeLock(pool);
+            std::vector<long long> sums(pool.threadsNum() + 1, 0);
+            std::vector<std::thread::id> owners(pool.threadsNum() + 1);
+            pool.parallelFor(300, [&](int i) {
+                int slot = pool.currentThreadIndex();
+                if (owners[slot] == std::thread::id())
+                    owners[slot] = std::this_thread::get_id();
+                else if (owners[slot] != std::this_thread::get_id())
+                    ++wrong;
+                sums[slot] += i;
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+            });
+            long long total = 0;
+            for (long long sum : sums)
+                total += sum;
+            if (total != 299LL * 300 / 2)
+                ++wrong;
+        }
+    };
+    std::thread first(caller);
+    std::thread second(caller);
+    first.join();
+    second.join();
+    QCOMPARE(wrong.load(), 0);
+}
+
+void TestAll::testSortPathStatesGroupsOctants()
+{
+    std::vector<PathState> paths;
+    for (int i = 0; i < 200; ++i)
+    {
+        Vec3 origin(std::sin(i * 1.3f) * 5, std::cos(i * 0.7f) * 5, (i % 11) - 5.0f);
+        paths.push_back({Ray(origin, Vec3::randomUnitVector()), Vec3(1, 1, 1), i});
+    }
+    sortPathStates(paths);
+
+    // Все пути сохранились, а лучи одного октанта идут подряд
+    std::vector<int> pixels;
+    int prevOctant = -1;
+    std::vector<bool> seenOctant(8, false);
+    for (const auto &path : paths)
+    {
+        pixels.push_back(path.pixel);
+        const Vec3 &d = path.ray.direction;
+        int octant = (d.x < 0 ? 1 : 0) | (d.y < 0 ? 2 : 0) | (d.z < 0 ? 4 : 0);
+        if (octant != prevOctant)
+        {
+            QVERIFY(!seenOctant[octant]);
+            seenOctant[octant] = true;
+            prevOctant = octant;
+        }
+    }
+    std::sort(pixels.begin(), pixels.end());
+    for (int i = 0; i < 200; ++i)
+        QCOMPARE(pixels[i], i);
+}
+
+void TestAll::testRenderPassesCoverEachPixelOnce()
+{
+    std::vector<RenderPass> passes = makeRenderPasses(true, 3);
+    QCOMPARE(passes.front().stride, PROGRESSIVE_MAX_STRIDE);
+    QCOMPARE((int)passes.size(), 4 + 2);
+
+    // Первый сэмпл каждого пикселя считается ровно одним из грубых и уточняющих проходов
+    for (int y = 0; y < 40; ++y)
+    {
+        for (int x = 0; x < 40; ++x)
+        {
+            int covered = 0;
+            for (const auto &pass : passes)
+                if (pass.sampleIndex == 0 && pass.contains(x, y))
+                    ++covered;
+            QCOMPARE(covered, 1);
+        }
+    }
+
+    // Дополнительные сэмплы смещены внутри пикселя
+    for (const auto &pass : passes)
+    {
+        QVERIFY(pass.offsetX >= 0.0f && pass.offsetX < 1.0f);
+        QVERIFY(pass.offsetY >= 0.0f && pass.offsetY < 1.0f);
+    }
+}
+
+void TestAll::testAdaptiveSamplesFollowEdges()
+{
+    // Левая половина черная, правая белая: контраст только на границе
+    int width = 32, height = 16;
+    std::vector<Vec3> image(width * height);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            image[y * width + x] = x < width / 2 ? Vec3(0, 0, 0) : Vec3(1, 1, 1);
+
+    std::vector<int> samples = allocateAdaptiveSamples(image, width, height, 0.1f, 1000, 4);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            bool edge = x == width / 2 - 1 || x == width / 2;
+            QCOMPARE(samples[y * width + x], edge ? 4 : 0);
+        }
+    }
+
+    // Бюджет не превышается
+    samples = allocateAdaptiveSamples(image, width, height, 0.1f, 10, 4);
+    int total = 0;
+    for (int n : samples)
+        total += n;
+    QCOMPARE(total, 10);
+
+    // Сэмплы лежат внутри пикселя
+    for (int k = 0; k < 7; ++k)
+    {
+        float ox = 0, oy = 0;
+        stratifiedOffset(5, k, 7, ox, oy);
+        QVERIFY(ox >= 0.0f && ox < 1.0f && oy >= 0.0f && oy < 1.0f);
+    }
+}
+
+void TestAll::testIrradianceCacheInterpolation()
+{
+    const int M = 4, N = 12;
+    Vec3 normal(0, 1, 0);
+
+    // Направления полусферы лежат над поверхностью
+    for (int j = 0; j < M; ++j)
+        for (int k = 0; k < N; ++k)
+            QVERIFY(IrradianceCache::hemisphereDirection(normal, j, k, M, N, 0.5f, 0.5f).dot(normal) > 0.0f);
+
+    // Постоянная яркость со всех сторон: освещенность равна яркости, градиенты нулевые
+    std::vector<GatherSample> samples(M * N, GatherSample{Vec3(0.5f, 0.25f, 1.0f), 2.0f});
+    IrradianceRecord record = IrradianceCache::makeRecord(Vec3(0, 0, 0), normal, samples, M, N, 0.01f, 10.0f);
+    QVERIFY(std::fabs(record.irradiance.x - 0.5f) < 1e-5f);
+    QVERIFY(std::fabs(record.irradiance.z - 1.0f) < 1e-5f);
+    QVERIFY(std::fabs(record.radius - 2.0f) < 1e-4f);
+    for (int c = 0; c < 3; ++c)
+    {
+        QVERIFY(record.rotationalGradient[c].length() < 1e-4f);
+        QVERIFY(record.translationalGradient[c].length() < 1e-4f);
+    }
+
+    IrradianceCacheSettings settings;
+    settings.accuracy = 0.25f;
+    IrradianceCache cache(Aabb(Vec3(-5, -5, -5), Vec3(5, 5, 5)), settings);
+    QVERIFY(cache.insert(record));
+    QCOMPARE(cache.size(), 1);
+
+    Vec3 irradiance;
+    QVERIFY(cache.lookup(Vec3(0.1f, 0, 0), normal, irradiance));
+    QVERIFY(std::fabs(irradiance.y - 0.25f) < 1e-5f);
+
+    // Вне области влияния и при сильно отличающейся нормали запись не применяется
+    QVERIFY(!cache.lookup(Vec3(1.0f, 0, 0), normal, irradiance));
+    QVERIFY(!cache.lookup(Vec3(0.1f, 0, 0), Vec3(1, 0, 0), irradiance));
+
+    // Кэш сцены действителен до ее следующей правки
+    Scene scene;
+    auto sceneCache = std::make_shared<IrradianceCache>(Aabb(Vec3(-5, -5, -5), Vec3(5, 5, 5)), settings);
+    scene.setIrradianceCache(sceneCache);
+    QCOMPARE(scene.irradianceCache(), sceneCache);
+    unsigned revision = scene.revision();
+    scene.addObject(std::make_shared<Sphere>(Vec3(0, 0, 0), 1.0f, Vec3(1, 1, 1)));
+    QVERIFY(scene.revision() != revision);
+    QVERIFY(!scene.irradianceCache());
+    scene.setIrradianceCache(sceneCache);
+    scene.markChanged();
+    QVERIFY(!scene.irradianceCache());
+}
+
+void TestAll::testEmitterSurfaceSampling()
+{
+    Sphere sphere(Vec3(1, 2, 3), 2.0f, Vec3(1, 1, 1));
+    Polygon polygon(Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(0, 1, 0));
+    Vec3 from(1, 2, 10);
+
+    for (int i = 0; i < 16; ++i)
+    {
+        float u1 = (i + 0.5f) / 16;
+        float u2 = ((i * 7) % 16 + 0.5f) / 16;
+        Vec3 point, normal;
+        float pdf = 0;
+
+        // Точка на сфере из полусферы, обращенной к from, плотность — обратная площадь полусферы
+        QVERIFY(sphere.sampleSurface(from, u1, u2, point, normal, pdf));
+        QVERIFY(std::fabs((point - Vec3(1, 2, 3)).length() - 2.0f) < 1e-4f);
+        QVERIFY(normal.dot(from - Vec3(1, 2, 3)) >= 0);
+        QVERIFY(std::fabs(pdf * 8 * M_PI - 1) < 1e-5f);
+
+        // Точка внутри треугольника, нормаль развернута к from
+        QVERIFY(polygon.sampleSurface(from, u1, u2, point, normal, pdf));
+        QVERIFY(std::fabs(point.z) < 1e-6f);
+        QVERIFY(point.x >= 0 && point.y >= 0 && point.x + point.y <= 1.0f + 1e-6f);
+        QVERIFY(normal.z > 0.999f);
+        QVERIFY(std::fabs(pdf - 2) < 1e-5f);
+
+        // Треугольник излучает обеими сторонами, сфера — наружу по всей площади
+        QVERIFY(polygon.sampleEmission(u1, u2, point, normal, pdf));
+        QVERIFY(std::fabs(std::fabs(normal.z) - 1) < 1e-6f && normal.z * (u1 < 0.5f ? 1 : -1) > 0);
+        QVERIFY(std::fabs(pdf - 1) < 1e-5f);
+        QVERIFY(sphere.sampleEmission(u1, u2, point, normal, pdf));
+        QVERIFY((point - Vec3(1, 2, 3) - normal * 2.0f).length() < 1e-4f);
+        QVERIFY(std::fabs(pdf * 16 * M_PI - 1) < 1e-5f);
+    }
+}
+void TestAll::testAliasTableFollowsWeights()
+{
+    std::vector<float> weights = {1, 0, 3, 4};
+    AliasTable table(weights);
+    QCOMPARE(table.size(), 4);
+    QVERIFY(std::fabs(table.pdf(2) - 0.375f) < 1e-6f);
+
+    // Равномерная сетка u дает частоты, точно пропорциональные весам
+    const int samples = 8000;
+    std::vector<int> counts(weights.size(), 0);
+    for (int i = 0; i < samples; ++i)
+        ++counts[table.sample((i + 0.5f) / samples)];
+
+    QCOMPARE(counts[1], 0);
+    for (int i = 0; i < (int)weights.size(); ++i)
+        QVERIFY(std::abs(counts[i] - samples * weights[i] / 8) <= 1);
+
+    // Объекты без излучения в реестр не попадают
+    auto dark = std::make_shared<Sphere>(Vec3(0, 0, 0), 1.0f, Vec3(1, 1, 1));
+    auto bright = std::make_shared<Sphere>(Vec3(3, 0, 0), 1.0f, Vec3(1, 1, 1));
+    bright->_params._emission = {Vec3(1, 1, 1), 2};
+    EmitterRegistry emitters({dark, bright});
+    QCOMPARE(emitters.size(), 1);
+    QVERIFY(emitters.emitter(0) == bright.get());
+    float pdf = 0;
+    QCOMPARE(emitters.sample(0.7f, pdf), 0);
+    QCOMPARE(pdf, 1.0f);
+
+    // Кадр видит источники, добавленные после построения фотонной карты
+    RenderingWidget widget;
+    Drawer drawer(&widget, nullptr);
+    drawer.setFrameSize(QSize(8, 8));
+    auto scene = std::make_shared<Scene>();
+    scene->setCamera(std::make_shared<Camera>(Vec3(0, 0, -5), Vec3(0, 0, 1), 1.0, 45.0));
+    scene->addObject(dark);
+    scene->addObject(bright);
+    drawer.updatePhotonMap(scene);
+    auto late = std::make_shared<Sphere>(Vec3(-3, 0, 0), 1.0f, Vec3(1, 1, 1));
+    late->_params._emission = {Vec3(1, 1, 1), 1};
+    scene->addObject(late);
+    drawer.renderFrame(scene);
+    QCOMPARE(drawer._emitters.size(), 2);
+}
+void TestAll::testRenderJobsSupersedeAndPreempt()
+{
+    RenderJobManager jobs;
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::atomic<bool> started(false);
+    std::atomic<bool> release(false);
+    auto record = [&](const std::string &name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(name);
+    };
+
+    // Выполняющийся кадр отменяется новым кадром, ожидающая карта строится раньше него
+    jobs.submit(RenderJobKind::Frame, RenderJobPriority::Final, [&](const std::atomic<bool> &cancelled) {
+        started = true;
+        while (!cancelled || !release)
+            std::this_thread::yield();
+        record("stale");
+    });
+    while (!started)
+        std::this_thread::yield();
+    jobs.submit(RenderJobKind::Frame, RenderJobPriority::Final, [&](const std::atomic<bool> &) { record("frame"); });
+    jobs.submit(RenderJobKind::PhotonMap, RenderJobPriority::Final, [&](const std::atomic<bool> &) { record("map"); });
+    release = true;
+    jobs.waitIdle();
+    QCOMPARE(order, std::vector<std::string>({"stale", "map", "frame"}));
+
+    // Черновой кадр прерывает чистовой, который затем выполняется заново
+    order.clear();
+    started = false;
+    release = false;
+    std::atomic<int> finalRuns(0);
+    jobs.submit(RenderJobKind::Frame, RenderJobPriority::Final, [&](const std::atomic<bool> &cancelled) {
+        if (++finalRuns == 1)
+        {
+            started = true;
+            while (!cancelled || !release)
+                std::this_thread::yield();
+        }
+        record(cancelled ? "final cancelled" : "final");
+    });
+    while (!started)
+        std::this_thread::yield();
+    jobs.submit(RenderJobKind::Frame, RenderJobPriority::Preview, [&](const std::atomic<bool> &) { record("preview"); });
+    release = true;
+    jobs.waitIdle();
+    QCOMPARE(order, std::vector<std::string>({"final cancelled", "preview", "final"}));
+
+    // Ожидающий чистовой кадр не удаляется черновыми: последний из них выполняется первым, чистовой — следом
+    order.clear();
+    started = false;
+    release = false;
+    jobs.submit(RenderJobKind::PhotonMap, RenderJobPriority::Final, [&](const std::atomic<bool> &) {
+        started = true;
+        while (!release)
+            std::this_thread::yield();
+        record("map");
+    });
+    while (!started)
+        std::this_thread::yield();
+    jobs.submit(RenderJobKind::Frame, RenderJobPriority::Final, [&](const std::atomic<bool> &) { record("final"); });
+    jobs.submit(RenderJobKind::Frame, RenderJobPriority::Preview, [&](const std::atomic<bool> &) { record("stale preview"); });
+    jobs.submit(RenderJobKind::Frame, RenderJobPriority::Preview, [&](const std::atomic<bool> &) { record("preview"); });
+    release = true;
+    jobs.waitIdle();
+    QCOMPARE(order, std::vector<std::string>({"map", "preview", "final"}));
+}
+void TestAll::testRenderProgressAccumulatesAcrossThreads()
+{
+    RenderProgress progress;
+    progress.begin(RenderStage::Frame, 64);
+    QCOMPARE(progress.stage(), RenderStage::Frame);
+    QCOMPARE(progress.fraction(), 0.0);
+
+    // Каждая задача отчитывается одной порцией
+    ThreadPool pool(4);
+    pool.parallelFor(64, [&](int) {
+        progress.advance(1);
+        progress.addItems(100);
+    });
+    QCOMPARE(progress.fraction(), 1.0);
+    QCOMPARE(progress.timings().frame.items, 6400LL);
+
+    progress.finish();
+    QCOMPARE(progress.stage(), RenderStage::Idle);
+    RenderStageTimings timings = progress.timings();
+    QCOMPARE(timings.frame.items, 6400LL);
+    QCOMPARE(timings.photonMap.items, 0LL);
+    QVERIFY(timings.frame.seconds >= 0);
+}
+void TestAll::testToneMapperClampsAndMatchesScalarTail()
+{
+    // Первые 4 пикселя идут через SIMD-ветку, остальные — через скалярную
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    std::vector<Vec3> row = {Vec3(0, 1, 2), Vec3(1, 0.5f, -1), Vec3(nan, 0, 0), Vec3(0.25f, 0.75f, 1),
+                             Vec3(0, 1, 2), Vec3(1, 0.5f, -1), Vec3(nan, 0, 0)};
+    std::vector<uint32_t> out(row.size());
+
+    ToneMapper clamp;
+    clamp.mapRow(row.data(), row.size(), out.data());
+    QCOMPARE(out[0], 0xff00ffffu);
+    QCOMPARE(out[1], 0xffff8000u);
+    QCOMPARE(out[2], 0xff000000u);
+    for (int i = 0; i < 3; ++i)
+        QCOMPARE(out[4 + i], out[i]);
+
+    // Рейнхард переводит 1 в 0.5
+    ToneMapSettings settings;
+    settings.op = ToneMapOperator::Reinhard;
+    ToneMapper reinhard(settings);
+    reinhard.mapRow(row.data(), row.size(), out.data());
+    QCOMPARE(out[1] >> 16 & 0xff, 128u);
+    for (int i = 0; i < 3; ++i)
+        QCOMPARE(out[4 + i], out[i]);
+}
+void TestAll::testRenderTargetFrameSize()
+{
+    // Без явного размера кадр следует области вывода
+    RenderTarget target;
+    QVERIFY(!target.fixedSize());
+    QCOMPARE(target.frameSize(false, QSize(640, 480)), QSize(640, 480));
+    QCOMPARE(target.frameSize(true, QSize(640, 480)), QSize(160, 120));
+
+    // Явный размер не зависит от области вывода
+    RenderTarget print(3000, 2000, 0.1f);
+    QVERIFY(print.fixedSize());
+    QCOMPARE(print.frameSize(false, QSize(640, 480)), QSize(3000, 2000));
+    QCOMPARE(print.frameSize(true, QSize(640, 480)), QSize(300, 200));
+
+    // Черновой кадр не вырождается
+    QCOMPARE(target.frameSize(true, QSize(2, 1)), QSize(1, 1));
+}
+
+void TestAll::testVecMathMatchesVec3()
+{
+    // Операции Vec3 вычисляются на этапе компиляции
+    constexpr Vec3 a(1.0f, 2.0f, 3.0f);
+    constexpr Vec3 b(-2.0f, 0.5f, 4.0f);
+    static_assert((a + b).z == 7.0f, "constexpr Vec3");
+    static_assert(a.dot(b) == 11.0f, "constexpr Vec3");
+    static_assert(a.cross(b)[0] == 6.5f, "constexpr Vec3");
+
+    Vec4f va(a), vb(b);
+    QCOMPARE(va.dot3(vb), a.dot(b));
+    Vec3 sum = (va + vb * 2.0f).toVec3();
+    QCOMPARE(sum, a + b * 2.0f);
+    QCOMPARE(Vec4f::min(va, vb).toVec3(), Vec3(-2.0f, 0.5f, 3.0f));
+    QCOMPARE(Vec4f::max(va, vb).toVec3(), Vec3(1.0f, 2.0f, 4.0f));
+
+    // Быстрая нормализация отличается от точной не более чем на ~1e-6,
+    // пакетная (включая хвост меньше 4 векторов) совпадает с поштучной
+    std::vector<Vec3> v;
+    for (int i = 0; i < 11; ++i)
+        v.push_back(Vec3(i - 5.0f, 0.5f * i + 0.1f, 100.0f - i * i));
+    std::vector<Vec3> batch = v;
+    normalizeBatch(batch.data(), batch.size());
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        Vec3 exact = v[i].normalize();
+        Vec3 fast = normalizeFast(v[i]);
+        QVERIFY((fast - exact).length() < 2e-6f);
+        QVERIFY((batch[i] - fast).length() < 1e-6f);
+    }
+
+    // Строка первичных лучей пакета совпадает с поштучно построенными
+    Camera camera(Vec3(0, 0, 0), Vec3(1, 0.2f, -0.1f), 1, 60);
+    CameraRayGenerator rays(camera, 64, 48);
+    float rowX[7];
+    Vec3 row[7];
+    for (int i = 0; i < 7; ++i)
+        rowX[i] = 3 * i + 0.25f;
+    rays.directions(rowX, 17.5f, 7, row);
+    for (int i = 0; i < 7; ++i)
+    {
+        QVERIFY((row[i] - rays.direction(rowX[i], 17.5f)).length() < 1e-6f);
+        QVERIFY(std::fabs(row[i].length() - 1.0f) < 2e-6f);
+    }
+}
+void TestAll::benchmarkNormalize()
+{
+    std::vector<Vec3> v(4096);
+    for (size_t i = 0; i < v.size(); ++i)
+        v[i] = Vec3(i + 1.0f, 0.5f * i, 3.0f);
+    QBENCHMARK
+    {
+        for (Vec3 &a : v)
+            a = a.normalize() * 2.0f;
+    }
+}
+void TestAll::benchmarkNormalizeBatch()
+{
+    std::vector<Vec3> v(4096);
+    for (size_t i = 0; i < v.size(); ++i)
+        v[i] = Vec3(i + 1.0f, 0.5f * i, 3.0f);
+    QBENCHMARK
+    {
+        normalizeBatch(v.data(), v.size());
+        for (Vec3 &a : v)
+            a *= 2.0f;
+    }
+}
+
+void TestAll::testSpectralRefractionCollapsesWhenLanesSeparate()
+{
+    // Полосы ведущей выборки сдвинуты на четверть диапазона и не выходят за него
+    HeroWavelengths wavelengths = HeroWavelengths::sample(0.9f);
+    const float range = SPECTRUM_MAX_WAVELENGTH - SPECTRUM_MIN_WAVELENGTH;
+    for (int i = 0; i < HERO_WAVELENGTHS_NUM; ++i)
+    {
+        float expected = SPECTRUM_MIN_WAVELENGTH + std::fmod(wavelengths.hero() - SPECTRUM_MIN_WAVELENGTH + i * range / HERO_WAVELENGTHS_NUM, range);
+        QVERIFY(std::abs(wavelengths.lane(i) - expected) < 1e-2f);
+    }
+
+    // Белый свет, разложенный по равномерно выбранным длинам волн, остается белым
+    Vec3 mean(0, 0, 0);
+    const int samplesNum = 3400;
+    for (int i = 0; i < samplesNum; ++i)
+        mean += wavelengthToRgb(SPECTRUM_MIN_WAVELENGTH + (i + 0.5f) * (SPECTRUM_MAX_WAVELENGTH - SPECTRUM_MIN_WAVELENGTH) / samplesNum);
+    mean /= samplesNum;
+    QVERIFY((mean - Vec3(1, 1, 1)).length() < 1e-2f);
+    QVERIFY(wavelengthToRgb(450.0f).z > wavelengthToRgb(450.0f).x);
+    QVERIFY(wavelengthToRgb(650.0f).x > wavelengthToRgb(650.0f).z);
+
+    // Нормальная дисперсия: синий преломляется сильнее красного, на опорной длине волны — заданный показатель
+    GraphicParams glass;
+    glass._refractiveIndex = 1.5168f;
+    glass._transparency = 1.0f;
+    QCOMPARE(glass.refractiveIndexAt(REFERENCE_WAVELENGTH), glass._refractiveIndex);
+    QVERIFY(glass.refractiveIndexAt(450.0f) > glass.refractiveIndexAt(650.0f));
+    Vec4f indices = refractiveIndices(glass, wavelengths.lanes);
+    for (int i = 0; i < HERO_WAVELENGTHS_NUM; ++i)
+        QVERIFY(std::abs(indices[i] - glass.refractiveIndexAt(wavelengths.lane(i))) < 1e-5f);
+
+    // При нормальном падении направления не расходятся, путь переносит весь спектр
+    Vec3 normal(0, 1, 0);
+    SpectralRefraction straight = refractSpectral(Vec3(0, -1, 0), normal, 1.0f, glass, 0.0f, 0.3f);
+    QCOMPARE(straight.wavelength, 0.0f);
+    QCOMPARE(straight.weight, Vec3(1, 1, 1));
+    QVERIFY((straight.direction - Vec3(0, -1, 0)).length() < 1e-6f);
+
+    // При наклонном падении путь сворачивается к ведущей длине волны по закону Снеллиуса
+    Vec3 incident = Vec3(1, -1, 0).normalize();
+    SpectralRefraction oblique = refractSpectral(incident, normal, 1.0f, glass, 0.0f, 0.3f);
+    float hero = HeroWavelengths::sample(0.3f).hero();
+    QCOMPARE(oblique.wavelength, hero);
+    QCOMPARE(oblique.weight, wavelengthToRgb(hero));
+    float sinT = oblique.direction.x / oblique.direction.length();
+    QVERIFY(std::abs(sinT * glass.refractiveIndexAt(hero) - incident.x) < 1e-5f);
+
+    // Свернутый путь дальше преломляется со своей длиной волны, материал без дисперсии путь не сворачивает
+    SpectralRefraction monochrome = refractSpectral(incident, normal, 1.0f, glass, 650.0f, 0.3f);
+    QCOMPARE(monochrome.wavelength, 650.0f);
+    QCOMPARE(monochrome.weight, Vec3(1, 1, 1));
+    glass._cauchyB = 0.0f;
+    QCOMPARE(refractSpectral(incident, normal, 1.0f, glass, 0.0f, 0.3f).wavelength, 0.0f);
+}
+
+void TestAll::testSequentialLensSystemMatchesSceneTrace()
+{
+    // Три соосные линзы вдоль z и стена в стороне от них
+    GraphicParams glass;
+    glass._transparency = 1.0f;
+    glass._refractiveIndex = 1.5f;
+    glass._cauchyB = 0.0f;
+    std::vector<std::shared_ptr<BaseObject>> objects;
+    std::vector<std::shared_ptr<Lens>> lenses;
+    for (int i = 0; i < 3; ++i)
+    {
+        lenses.push_back(std::make_shared<Lens>(Vec3(0, 0, 4.0f - 3.0f * i), Vec3(0, 0, 1), 3.0f + i, 1.0f, glass));
+        objects.push_back(lenses.back());
+    }
+    objects.push_back(std::make_shared<Sphere>(Vec3(10, 0, 0), 1.0f, Vec3(1, 1, 1)));
+
+    std::shared_ptr<SequentialLensSystem> system = SequentialLensSystem::detect(objects);
+    QVERIFY(system != nullptr);
+    QCOMPARE(system->lensesNum(), 3);
+    const std::vector<LensSurface> &surfaces = system->surfaces();
+    QCOMPARE((int)surfaces.size(), 6);
+    for (size_t i = 1; i < surfaces.size(); ++i)
+        QVERIFY(surfaces[i].vertex > surfaces[i - 1].vertex);
+
+    // Объект внутри стопки запрещает последовательный режим, несоосная линза не принимается
+    std::vector<std::shared_ptr<BaseObject>> blocked = objects;
+    blocked.push_back(std::make_shared<Sphere>(Vec3(0, 0, 2.5f), 0.2f, Vec3(1, 1, 1)));
+    QVERIFY(SequentialLensSystem::detect(blocked) == nullptr);
+    bool thrown = false;
+    try
+    {
+        SequentialLensSystem skewed({lenses[0], std::make_shared<Lens>(Vec3(0.5f, 0, 10), Vec3(0, 0, 1), 3.0f, 1.0f, glass)});
+    }
+    catch (const std::runtime_error &)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+
+    // Эталон — трассировка через общий поиск пересечений
+    SceneIntersector intersector(objects);
+    auto sceneTrace = [&](Ray ray) {
+        HitRecord hit;
+        while (intersector.closestHit(ray, hit))
+        {
+            Vec3 point = ray.origin + ray.direction * hit.t;
+            GraphicParams params = hit.object->hitParams(ray, hit.t);
+            ray = Ray(point + ray.direction * 1e-4f, Vec3::refract(ray.direction, params._normal, 1.0f, params._refractiveIndex).normalize());
+            hit = HitRecord();
+        }
+        return ray;
+    };
+
+    std::vector<LensPath> batch;
+    std::vector<Ray> expected;
+    for (int i = 0; i < 11; ++i)
+    {
+        // Лучи вдоль оси и против нее, с разной высотой и наклоном
+        bool forward = i % 3 != 0;
+        float h = 0.07f * i - 0.3f;
+        Ray ray(Vec3(h, 0.5f * h, forward ? -5.0f : 10.0f), Vec3(0.02f * (i % 4), -0.01f * i, forward ? 1.0f : -1.0f).normalize());
+        HitRecord hit;
+        QVERIFY(intersector.closestHit(ray, hit));
+        batch.push_back({ray, Vec3(1, 1, 1), hit.object});
+        expected.push_back(sceneTrace(ray));
+    }
+
+    std::vector<LensPath> single = batch;
+    system->trace(batch);
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        QVERIFY(system->trace(single[i]));
+        QVERIFY((batch[i].ray.direction - single[i].ray.direction).length() < 1e-5f);
+        QVERIFY((batch[i].weight - single[i].weight).length() < 1e-5f);
+        QVERIFY((batch[i].ray.direction.normalize() - expected[i].direction).length() < 1e-4f);
+        // Потери на отражение шести поверхностей около 4% каждая
+        QVERIFY(batch[i].weight.x > 0.7f && batch[i].weight.x < 0.95f);
+    }
+
+    // Луч, прошедший первую линзу мимо второй, покидает систему в воздухе за первой линзой
+    Ray wide(Vec3(0.3f, 0, 4.5f), Vec3(0.7f, 0, -1.0f).normalize());
+    HitRecord hit;
+    QVERIFY(intersector.closestHit(wide, hit));
+    QVERIFY(hit.object == lenses[0].get());
+    LensPath escaped = {wide, Vec3(1, 1, 1), hit.object};
+    QVERIFY(system->trace(escaped));
+    QVERIFY(escaped.ray.origin.z < surfaces[4].vertex && escaped.ray.origin.z > surfaces[3].vertex);
+    QVERIFY(!escaped.ray.insideObject);
+
+    // Луч, задевший линзу сбоку у края, проходит мимо входной сферы модели: он преломляется на самой линзе
+    // и продолжает путь изнутри нее от точки попадания, а не возвращается к исходной точке
+    Ray grazing(Vec3(3, 0, 4.001f), Vec3(-1, 0, 0.0005f).normalize());
+    HitRecord rimHit;
+    QVERIFY(intersector.closestHit(grazing, rimHit));
+    QVERIFY(rimHit.object == lenses[0].get());
+    Vec3 rimPoint = grazing.origin + grazing.direction * rimHit.t;
+    LensPath rimPath = {grazing, Vec3(1, 1, 1), rimHit.object};
+    std::vector<LensPath> rims(2, rimPath);
+    system->trace(rims);
+    QVERIFY(system->trace(rimPath));
+    rims.push_back(rimPath);
+    for (const LensPath &rim : rims)
+    {
+        QVERIFY((rim.ray.origin - rimPoint).length() < 1e-3f);
+        QVERIFY(rim.ray.insideObject);
+        QVERIFY(rim.weight.x > 0.0f && rim.weight.x < 1.0f);
+    }
+
+    // Фотон, прошедший стопку общим поиском пересечений, теряет на поверхностях столько же, сколько в системе
+    std::vector<std::shared_ptr<BaseObject>> screened = objects;
+    screened.push_back(std::make_shared<Polygon>(Vec3(-20, -20, -10), Vec3(20, -20, -10), Vec3(0, 20, -10), Vec3(1, 1, 1)));
+    SceneIntersector general(screened);
+    Photon photon;
+    photon.position = Vec3(0.1f, 0, 10);
+    photon.direction = Vec3(0, 0, -1);
+    photon.color = Vec3(1, 1, 1);
+    Ray axial(photon.position, photon.direction);
+    std::vector<Photon> stored, caustics;
+    tracePhoton(photon, general, stored, caustics);
+    QCOMPARE(caustics.size(), size_t(1));
+    HitRecord axialHit;
+    QVERIFY(intersector.closestHit(axial, axialHit));
+    LensPath axialPath = {axial, Vec3(1, 1, 1), axialHit.object};
+    QVERIFY(system->trace(axialPath));
+    QVERIFY((caustics[0].color - axialPath.weight).length() < 1e-3f);
+}
+
+void TestAll::testSpotAnalysisFindsFocus()
+{
+    // Двояковыпуклая линза R = 10, световой радиус 2, n = 1.5; плоскость изображения за параксиальным фокусом
+    GraphicParams glass;
+    glass._transparency = 1.0f;
+    glass._refractiveIndex = 1.5f;
+    glass._cauchyB = 0.0f;
+    const float R = 10.0f, r = 2.0f, n = 1.5f;
+    std::vector<std::shared_ptr<BaseObject>> objects = {std::make_shared<Lens>(Vec3(0, 0, 0), Vec3(0, 0, 1), R, r, glass)};
+
+    SpotAnalysisSettings settings;
+    settings.pupilCenter = Vec3(0, 0, -2);
+    settings.pupilRadius = 1.5f;
+    settings.raysNum = 20000;
+    settings.planePoint = Vec3(0, 0, 11);
+    settings.planeHalfSize = 0.5f;
+    settings.psfResolution = 64;
+    settings.maxSpotPoints = 100;
+    SpotAnalysisResult result = SpotAnalyzer(settings).analyze(objects);
+
+    QCOMPARE(result.tracedNum, 20000);
+    QCOMPARE(result.arrivedNum, 20000);
+    QCOMPARE((int)result.spots.size(), 100);
+    // Две поверхности теряют на отражение около 4% каждая
+    QVERIFY(result.transmittance > 0.88f && result.transmittance < 0.95f);
+    float psfSum = 0;
+    for (float p : result.psf)
+        psfSum += p;
+    QVERIFY(std::fabs(psfSum - result.transmittance) < 1e-3f);
+    QVERIFY((result.centroid - Vec3(0, 0, 11)).length() < 1e-3f);
+
+    // Фокусное расстояние толстой линзы: 1/f = (n - 1) (2/R - (n - 1) d / (n R²))
+    float d = 2.0f * (R - std::sqrt(R * R - r * r));
+    float f = 1.0f / ((n - 1) * (2.0f / R - (n - 1) * d / (n * R * R)));
+    QVERIFY(std::fabs(result.focalLength - f) < 0.01f * f);
+
+    // Наилучший фокус перед плоскостью: параксиальный фокус на задней вершине + задний отрезок,
+    // сферическая аберрация сдвигает его еще ближе к линзе
+    float paraxialFocus = d / 2 + f * (1 - (n - 1) * d / (n * R));
+    QVERIFY(result.bestFocusOffset < paraxialFocus - 11.0f);
+    QVERIFY(result.bestFocusOffset > paraxialFocus - 11.0f - 0.5f);
+    QVERIFY(result.bestFocusRmsRadius < 0.5f * result.rmsRadius);
+
+    // Проверка параболы: пятно на найденной плоскости совпадает с предсказанным
+    settings.planePoint = Vec3(0, 0, 11.0f + result.bestFocusOffset);
+    SpotAnalysisResult focused = SpotAnalyzer(settings).analyze(objects);
+    QVERIFY(std::fabs(focused.rmsRadius - result.bestFocusRmsRadius) < 1e-3f);
+    QVERIFY(std::fabs(focused.bestFocusOffset) < 1e-2f);
+}
+
+void TestAll::testAsphericLensMatchesSphericalAndFocuses()
+{
+    GraphicParams glass;
+    glass._transparency = 1.0f;
+    glass._refractiveIndex = 1.5f;
+    glass._cauchyB = 0.0f;
+
+    // Две сферические поверхности R = 10 повторяют Lens с тем же световым радиусом
+    const float R = 10.0f, r = 2.0f;
+    float thickness = 2.0f * (R - std::sqrt(R * R - r * r));
+    Lens lens(Vec3(1, 2, 3), Vec3(0, 1, 1), R, r, glass);
+    AsphericLens aspheric(Vec3(1, 2, 3), Vec3(0, 1, 1), r, thickness, AsphericSurface(1.0f / R), AsphericSurface(-1.0f / R), glass);
+    Vec3 axis = Vec3(0, 1, 1).normalize();
+    for (int i = 0; i < 20; ++i)
+    {
+        Vec3 target = Vec3(1, 2, 3) + Vec3(0.09f * i - 0.9f, 0.05f * (i % 7), -0.05f * (i % 7));
+        Vec3 origin = target - axis * 5.0f + Vec3(0.1f * (i % 3), 0, 0);
+        if (i % 2)
+            origin = target + axis * 5.0f;
+        Ray ray(origin, (target - origin).normalize());
+        float tLens, tAspheric;
+        QVERIFY(lens.intersect(ray, tLens));
+        QVERIFY(aspheric.intersect(ray, tAspheric));
+        QVERIFY(std::fabs(tLens - tAspheric) < 1e-4f);
+        QVERIFY(lens.hitParams(ray, tLens)._normal.dot(aspheric.hitParams(ray, tAspheric)._normal) > 0.9999f);
+    }
+    Ray miss(Vec3(1, 2, 3) + Vec3(2.5f, 0, 0) - axis * 5.0f, axis);
+    QVERIFY(!aspheric.intersect(miss));
+
+    // Выпуклая гипербола с k = -n² собирает параллельный пучок из стекла в точку без сферической аберрации
+    auto planoConvex = [&](float conic) {
+        std::vector<std::shared_ptr<BaseObject>> objects = {std::make_shared<AsphericLens>(
+            Vec3(0, 0, 0), Vec3(0, 0, 1), 2.0f, 1.0f, AsphericSurface(0.0f), AsphericSurface(-0.2f, conic), glass)};
+        SpotAnalysisSettings settings;
+        settings.pupilCenter = Vec3(0, 0, -2);
+        settings.pupilRadius = 1.8f;
+        settings.raysNum = 4096;
+        settings.planePoint = Vec3(0, 0, 10.5f);
+        return SpotAnalyzer(settings).analyze(objects);
+    };
+    SpotAnalysisResult spherical = planoConvex(0.0f);
+    SpotAnalysisResult hyperbolic = planoConvex(-2.25f);
+    QCOMPARE(hyperbolic.arrivedNum, 4096);
+    QVERIFY(std::fabs(hyperbolic.bestFocusOffset) < 1e-2f);
+    QVERIFY(hyperbolic.bestFocusRmsRadius < 1e-3f);
+    QVERIFY(hyperbolic.bestFocusRmsRadius < 0.05f * spherical.bestFocusRmsRadius);
+
+    // Полиномиальный член: точка пересечения лежит на поверхности, нормаль перпендикулярна ей
+    AsphericSurface front(0.1f, -0.5f, {0.002f, -1e-4f});
+    AsphericLens polynomial(Vec3(0, 0, 0), Vec3(0, 0, 1), 2.0f, 1.0f, front, AsphericSurface(-0.1f), glass);
+    for (int i = 0; i < 10; ++i)
+    {
+        Ray ray(Vec3(0.18f * i, 0.1f, -5), Vec3(0, 0.02f, 1).normalize());
+        float t;
+        QVERIFY(polynomial.intersect(ray, t));
+        Vec3 point = ray.origin + ray.direction * t;
+        float s = point.x * point.x + point.y * point.y;
+        QVERIFY(std::fabs(point.z - (-0.5f + front.sag(s))) < 1e-4f);
+        Vec3 normal = polynomial.hitParams(ray, t)._normal;
+        QVERIFY(normal.z < 0);
+        float ds = 1e-3f;
+        Vec3 tangent = Vec3(ds, 0, front.sag((point.x + ds) * (point.x + ds) + point.y * point.y) - front.sag(s));
+        QVERIFY(std::fabs(normal.dot(tangent.normalize())) < 1e-2f);
+    }
+
+    // Поверхности, пересекающиеся внутри светового радиуса, не принимаются
+    bool thrown = false;
+    try
+    {
+        AsphericLens broken(Vec3(0, 0, 0), Vec3(0, 0, 1), 2.0f, 0.1f, AsphericSurface(0.5f), AsphericSurface(0.0f), glass);
+    }
+    catch (const std::runtime_error &)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
+
+void TestAll::testGrinRodFollowsPitch()
+{
+    GraphicParams glass;
+    glass._transparency = 1.0f;
+
+    // Однородный стержень: луч вдоль оси проходит за несколько шагов и не отклоняется
+    GrinProfile uniform;
+    uniform.n0 = 1.6f;
+    GrinLens rod(Vec3(0, 0, 0), Vec3(0, 0, 1), 1.0f, 8.0f, uniform, glass);
+    Ray ray(Vec3(0.3f, 0.2f, -10), Vec3(0, 0, 1));
+    float t;
+    QVERIFY(rod.intersect(ray, t));
+    QVERIFY(std::fabs(t - 6.0f) < 1e-4f);
+    Vec3 weight(1, 1, 1);
+    int stepsNum = 0;
+    QVERIFY(rod.traceInterior(ray, t, weight, stepsNum));
+    QVERIFY(stepsNum <= 4);
+    QVERIFY((ray.origin - Vec3(0.3f, 0.2f, 4.0f)).length() < 1e-3f);
+    QVERIFY(ray.direction.dot(Vec3(0, 0, 1)) > 0.99999f);
+    // Потери на двух торцах по Френелю ((n - 1) / (n + 1))² каждая
+    float reflectance = (0.6f / 2.6f) * (0.6f / 2.6f);
+    QVERIFY(std::fabs(weight.x - (1 - reflectance) * (1 - reflectance)) < 1e-4f);
+
+    // Параболический профиль n0 (1 - A r² / 2) с периодом 8: стержень длиной в полпериода переворачивает луч,
+    // стержень в четверть периода собирает параллельный пучок в центре выходного торца
+    const float pitch = 8.0f;
+    const float A = (2 * 3.14159265f / pitch) * (2 * 3.14159265f / pitch);
+    GrinProfile parabolic;
+    parabolic.n0 = 1.6f;
+    parabolic.radial2 = -parabolic.n0 * A / 2;
+    GrinLens halfPitch(Vec3(0, 0, 0), Vec3(0, 0, 1), 1.0f, pitch / 2, parabolic, glass);
+    ray = Ray(Vec3(0.1f, 0, -5), Vec3(0, 0, 1));
+    QVERIFY(halfPitch.intersect(ray, t));
+    weight = Vec3(1, 1, 1);
+    QVERIFY(halfPitch.traceInterior(ray, t, weight, stepsNum));
+    QVERIFY(std::fabs(ray.origin.x + 0.1f) < 2e-3f);
+    QVERIFY(std::fabs(ray.origin.y) < 1e-4f);
+    QVERIFY(ray.direction.dot(Vec3(0, 0, 1)) > 0.9999f);
+    QVERIFY(stepsNum < 100);
+
+    std::vector<std::shared_ptr<BaseObject>> objects = {std::make_shared<GrinLens>(Vec3(0, 0, 0), Vec3(0, 0, 1), 1.0f, pitch / 4, parabolic, glass)};
+    SpotAnalysisSettings settings;
+    settings.pupilCenter = Vec3(0, 0, -3);
+    settings.pupilRadius = 0.2f;
+    settings.raysNum = 2000;
+    settings.planePoint = Vec3(0, 0, pitch / 8 + 1.0f);
+    SpotAnalysisResult result = SpotAnalyzer(settings).analyze(objects);
+    QCOMPARE(result.arrivedNum, 2000);
+    QVERIFY(std::fabs(result.bestFocusOffset + 1.0f) < 0.02f);
+    QVERIFY(result.bestFocusRmsRadius < 0.1f * result.rmsRadius);
+}
+
+void TestAll::testCsgBooleanOperations()
+{
+    GraphicParams params;
+
+    // Пересечение двух сфер повторяет Lens
+    Lens lens(Vec3(1, 0, 2), Vec3(0, 1, 1), 3.0f, 1.0f, params);
+    CsgObject lensCsg(csgLens(lens), Vec3(0, 0, 0), params);
+    for (int i = 0; i < 10; ++i)
+    {
+        Vec3 target = Vec3(1, 0, 2) + Vec3(0.15f * i - 0.7f, 0.05f * i, -0.05f * i);
+        Ray ray(target + Vec3(0.3f, -4, -4), (-Vec3(0.3f, -4, -4)).normalize());
+        float tLens, tCsg;
+        QCOMPARE(lens.intersect(ray, tLens), lensCsg.intersect(ray, tCsg));
+        if (!lens.intersect(ray, tLens))
+            continue;
+        QVERIFY(std::fabs(tLens - tCsg) < 1e-4f);
+        QVERIFY(lens.hitParams(ray, tLens)._normal.dot(lensCsg.hitParams(ray, tCsg)._normal) > 0.9999f);
+    }
+
+    // Полусфера: срез получает обращенную нормаль полупространства
+    auto sphere = std::make_shared<CsgSphere>(Vec3(0, 0, 0), 1.0f);
+    CsgObject hemisphere(csgDifference(sphere, std::make_shared<CsgHalfSpace>(Vec3(0, 0, 0), Vec3(0, 0, -1))), Vec3(0, 0, 3), params);
+    Ray down(Vec3(0.2f, 0, 8), Vec3(0, 0, -1));
+    float t;
+    QVERIFY(hemisphere.intersect(down, t));
+    QVERIFY(std::fabs(t - 5.0f) < 1e-5f);
+    QVERIFY((hemisphere.hitParams(down, t)._normal - Vec3(0, 0, 1)).length() < 1e-5f);
+    Ray up(Vec3(0, 0, -8), Vec3(0, 0, 1));
+    QVERIFY(hemisphere.intersect(up, t));
+    QVERIFY(std::fabs(t - 10.0f) < 1e-5f);
+    QVERIFY((hemisphere.hitParams(up, t)._normal - Vec3(0, 0, -1)).length() < 1e-5f);
+
+    // Кольцевая диафрагма: луч через отверстие проходит, луч на кольцо попадает в торец, луч из отверстия — во внутреннюю стенку
+    CsgObject aperture(csgDifference(std::make_shared<CsgCylinder>(Vec3(0, 0, 0), Vec3(0, 0, 1), 2.0f, 1.0f),
+                                     std::make_shared<CsgCylinder>(Vec3(0, 0, 0), Vec3(0, 0, 1), 1.0f, 2.0f)), Vec3(0, 0, 0), params);
+    QVERIFY(!aperture.intersect(Ray(Vec3(0.5f, 0.3f, -5), Vec3(0, 0, 1))));
+    Ray ring(Vec3(1.5f, 0, -5), Vec3(0, 0, 1));
+    QVERIFY(aperture.intersect(ring, t));
+    QVERIFY(std::fabs(t - 4.5f) < 1e-5f);
+    QVERIFY((aperture.hitParams(ring, t)._normal - Vec3(0, 0, -1)).length() < 1e-5f);
+    Ray sideways(Vec3(0, 0, 0.2f), Vec3(1, 0, 0));
+    QVERIFY(aperture.intersect(sideways, t));
+    QVERIFY(std::fabs(t - 1.0f) < 1e-5f);
+    QVERIFY((aperture.hitParams(sideways, t)._normal - Vec3(-1, 0, 0)).length() < 1e-5f);
+    QVERIFY(aperture.bounds().max.x >= 2.0f && aperture.bounds().max.z >= 0.5f);
+
+    // Объединение пересекающихся сфер — один отрезок, из него луч выходит через дальнюю сферу
+    auto other = std::make_shared<CsgSphere>(Vec3(1.5f, 0, 0), 1.0f);
+    auto merged = csgUnion(sphere, other);
+    CsgIntervals list;
+    merged->intervals(Ray(Vec3(-5, 0, 0), Vec3(1, 0, 0)), list);
+    QCOMPARE(list.count, 1);
+    QVERIFY(std::fabs(list.items[0].tIn - 4.0f) < 1e-5f && std::fabs(list.items[0].tOut - 7.5f) < 1e-5f);
+    CsgObject blob(merged, Vec3(0, 0, 0), params);
+    QVERIFY(blob.intersect(Ray(Vec3(0.5f, 0, 0), Vec3(1, 0, 0)), t));
+    QVERIFY(std::fabs(t - 2.0f) < 1e-5f);
+
+    // Непересекающиеся тела: пустые границы отсекают все лучи
+    auto far = std::make_shared<CsgSphere>(Vec3(10, 0, 0), 1.0f);
+    QVERIFY(std::static_pointer_cast<CsgOperation>(csgIntersection(sphere, far))->bounds().isEmpty());
+    CsgObject empty(csgIntersection(sphere, far), Vec3(0, 0, 0), params);
+    QVERIFY(!empty.intersect(Ray(Vec3(-5, 0, 0), Vec3(1, 0, 0))));
+}
+
+void TestAll::testMeshInstancesShareMesh()
+{
+    // Куб со стороной 2 с центром в начале координат: 12 треугольников
+    std::vector<Vec3> corners;
+    for (int i = 0; i < 8; ++i)
+        corners.push_back(Vec3((i & 1) ? 1 : -1, (i & 2) ? 1 : -1, (i & 4) ? 1 : -1));
+    const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    std::vector<Polygon> polygons;
+    for (const auto &f : faces)
+    {
+        polygons.push_back(Polygon(corners[f[0]], corners[f[1]], corners[f[2]]));
+        polygons.push_back(Polygon(corners[f[0]], corners[f[2]], corners[f[3]]));
+    }
+    std::shared_ptr<const Mesh> mesh = Mesh::fromPolygons(polygons);
+    QCOMPARE(mesh->trianglesNum(), 12);
+    QVERIFY(std::fabs(mesh->area() - 24.0f) < 1e-4f);
+
+    GraphicParams params;
+    std::vector<std::shared_ptr<BaseObject>> objects;
+    std::vector<std::vector<Polygon>> references;
+    for (int i = 0; i < 64; ++i)
+    {
+        Vec3 offset((i % 8) * 5.0f, (i / 8) * 5.0f, 0);
+        Vec3 axis(1, 0.5f * (i % 3), 0.3f * (i % 5));
+        double angle = 7.0 * i;
+        double k = 0.5 + 0.1 * (i % 4);
+        auto instance = std::make_shared<MeshInstance>(mesh, Transform(), params);
+        instance->rotate(axis, angle);
+        instance->scale(k);
+        instance->setPosition(offset);
+        objects.push_back(instance);
+
+        // Те же преобразования, примененные к копиям треугольников
+        std::vector<Polygon> copy = polygons;
+        for (Polygon &p : copy)
+        {
+            p.rotate(Vec3(0, 0, 0), axis, angle);
+            p.scale(Vec3(0, 0, 0), k);
+            p.move(offset);
+        }
+        references.push_back(copy);
+    }
+    // Экземпляры не копируют сетку
+    QCOMPARE(mesh.use_count(), 65L);
+
+    SceneIntersector scene(objects);
+    for (int i = 0; i < 2000; ++i)
+    {
+        Vec3 origin(-5.0f + 0.023f * i, 17.0f + 0.011f * (i % 97), 20.0f);
+        Vec3 direction = Vec3(0.3f - 0.0003f * i, -0.5f + 0.0007f * (i % 113), -1).normalize();
+        Ray ray(origin, direction);
+
+        float expected = std::numeric_limits<float>::max();
+        const Polygon *expectedPolygon = nullptr;
+        int expectedObject = -1;
+        for (size_t o = 0; o < references.size(); ++o)
+        {
+            for (const Polygon &p : references[o])
+            {
+                float t;
+                if (p.intersect(ray, t) && t < expected)
+                {
+                    expected = t;
+                    expectedPolygon = &p;
+                    expectedObject = static_cast<int>(o);
+                }
+            }
+        }
+
+        HitRecord hit;
+        bool found = scene.closestHit(ray, hit);
+        QCOMPARE(found, expectedPolygon != nullptr);
+        if (!found)
+            continue;
+        QVERIFY(std::fabs(hit.t - expected) < 1e-3f * expected);
+        QVERIFY(hit.object == objects[expectedObject].get());
+        Vec3 normal = hit.object->hitParams(ray, hit.t)._normal;
+        Vec3 expectedNormal = (expectedPolygon->v1 - expectedPolygon->v0).cross(expectedPolygon->v2 - expectedPolygon->v0).normalize();
+        QVERIFY(std::fabs(std::fabs(normal.dot(expectedNormal)) - 1.0f) < 1e-3f);
+        QVERIFY(normal.dot(direction) < 0);
+    }
+
+    // Неравномерный масштаб: нормаль остается перпендикулярной грани
+    MeshInstance stretched(mesh, Transform::scale(Vec3(1, 4, 1)) * Transform::rotate(Vec3(0, 0, 1), 45), params);
+    Ray ray(Vec3(10, 0.1f, 0.2f), Vec3(-1, 0, 0));
+    float t;
+    QVERIFY(stretched.intersect(ray, t));
+    Vec3 point = ray.origin + ray.direction * t;
+    // Луч приходит в грань x = 1 сетки, ее касательная (0, 1, 0) после растяжения наклонена иначе, чем нормаль
+    Vec3 faceEdge = stretched.toWorld().vector(Vec3(0, 1, 0));
+    QVERIFY(std::fabs(stretched.hitParams(ray, t)._normal.dot(faceEdge.normalize())) < 1e-4f);
+    QVERIFY(stretched.bounds().min.y <= point.y && point.y <= stretched.bounds().max.y);
+
+    Vec3 sample, sampleNormal;
+    float samplePdf = 0;
+    QVERIFY(stretched.sampleSurface(Vec3(10, 0, 0), 0.37f, 0.81f, sample, sampleNormal, samplePdf));
+    float ignored;
+    QVERIFY(!stretched.intersect(Ray(sample + sampleNormal * 1e-3f, sampleNormal), ignored));
+
+    // Заданная нормаль грани идет в освещение, выборка точек остается на геометрической нормали
+    auto shaded = std::make_shared<Mesh>(std::vector<Vec3>{Vec3(-1, -1, 0), Vec3(1, -1, 0), Vec3(0, 1, 0)},
+                                         std::vector<uint32_t>{0, 1, 2}, std::vector<Vec3>{Vec3(3, 0, 4)});
+    MeshInstance tilted(shaded, Transform(), params);
+    Ray down(Vec3(0, 0, 5), Vec3(0, 0, -1));
+    QVERIFY(tilted.intersect(down, t));
+    QVERIFY((tilted.hitParams(down, t)._normal - Vec3(0.6f, 0, 0.8f)).length() < 1e-5f);
+    QVERIFY(tilted.sampleSurface(Vec3(0, 0, 5), 0.37f, 0.81f, sample, sampleNormal, samplePdf));
+    QVERIFY(std::fabs(std::fabs(sampleNormal.z) - 1.0f) < 1e-5f);
+    QVERIFY(std::fabs(samplePdf - 0.5f) < 1e-5f);
+
+    bool thrown = false;
+    try
+    {
+        Mesh(std::vector<Vec3>{Vec3(-1, -1, 0), Vec3(1, -1, 0), Vec3(0, 1, 0)}, std::vector<uint32_t>{0, 1, 2},
+             std::vector<Vec3>{Vec3(0, 0, 1), Vec3(0, 0, 1)});
+    }
+    catch (const std::runtime_error &)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
+
+void TestAll::testObjLoaderParsesChunksInParallel()
+{
+    // Сетка из четырехугольников вперемешку с отрицательными индексами, записями v/vt/vn, комментариями и CRLF
+    const int side = 60;
+    std::string text = "# grid\r\nmtllib grid.mtl\r\n";
+    std::vector<Vec3> expected;
+    for (int y = 0; y <= side; ++y)
+    {
+        for (int x = 0; x <= side; ++x)
+        {
+            Vec3 v(x * 0.125f - 3.5f, y * 1.5e-3f, (x + y) % 2 ? -0.0625f : 1e2f);
+            expected.push_back(v);
+            char line[128];
+            std::snprintf(line, sizeof(line), "v %.6g\t%.6e %g\r\nvt 0.5 0.5\r\n", v.x, v.y, v.z);
+            text += line;
+        }
+    }
+    text += "vn 0 0 1\r\n";
+    for (int y = 0; y < side; ++y)
+    {
+        for (int x = 0; x < side; ++x)
+        {
+            int a = y * (side + 1) + x + 1;
+            char line[128];
+            if ((x + y) % 3 == 0)
+                std::snprintf(line, sizeof(line), "f %d/1/1 %d/1/1 %d//1 %d\r\n", a, a + 1, a + side + 2, a + side + 1);
+            else
+                std::snprintf(line, sizeof(line), "f %d %d %d\r\nf %d %d %d\r\n", a, a + 1, a + side + 2, a, a + side + 2, a + side + 1);
+            text += line;
+        }
+    }
+    // Пятиугольник через отрицательные индексы и вырожденная грань
+    text += "v 0 0 5\nv 1 0 5\nv 1 1 5\nv 0.5 2 5\nv 0 1 5\nf -5 -4 -3 -2 -1\nf 1 2\n";
+
+    ObjLoadStats single, chunked;
+    auto reference = parseObj(text.data(), text.size(), &single);
+    auto mesh = parseObj(text.data(), text.size(), &chunked, 256);
+    QCOMPARE(single.chunks, 1);
+    QVERIFY(chunked.chunks > 100);
+
+    int quads = side * side;
+    int splitQuads = (quads + 2) / 3;
+    QCOMPARE(chunked.vertices, (side + 1) * (side + 1) + 5);
+    QCOMPARE(chunked.faces, splitQuads + 2 * (quads - splitQuads) + 2);
+    QCOMPARE(chunked.skippedFaces, 1);
+    QCOMPARE(chunked.triangles, 2 * quads + 3);
+    QCOMPARE(chunked.bytes, text.size());
+
+    QVERIFY(mesh->vertices() == reference->vertices());
+    QVERIFY(mesh->indices() == reference->indices());
+    for (size_t i = 0; i < expected.size(); ++i)
+        QVERIFY((mesh->vertices()[i] - expected[i]).length() <= 1e-5f * std::max(1.0f, expected[i].length()));
+
+    // Веер пятиугольника опирается на его первую вершину
+    const std::vector<uint32_t> &indices = mesh->indices();
+    uint32_t first = static_cast<uint32_t>(expected.size());
+    std::vector<uint32_t> fan(indices.end() - 9, indices.end());
+    QVERIFY(fan == std::vector<uint32_t>({first, first + 1, first + 2, first, first + 2, first + 3, first, first + 3, first + 4}));
+
+    // Нормаль vn получают только треугольники, у всех углов которых она задана, остальные — геометрическую
+    const std::vector<Vec3> &normals = mesh->faceNormals();
+    QCOMPARE(normals.size(), indices.size() / 3);
+    QCOMPARE(reference->faceNormals().size(), normals.size());
+    for (size_t i = 0; i < normals.size(); ++i)
+    {
+        QVERIFY((normals[i] - reference->faceNormals()[i]).length() < 1e-6f);
+        int quad = static_cast<int>(i / 2);
+        bool fromVn = i % 2 == 0 && quad < quads && (quad % side + quad / side) % 3 == 0;
+        const Vec3 &v0 = mesh->vertices()[indices[3 * i]];
+        Vec3 geometric = (mesh->vertices()[indices[3 * i + 1]] - v0).cross(mesh->vertices()[indices[3 * i + 2]] - v0).normalize();
+        QVERIFY((normals[i] - (fromVn ? Vec3(0, 0, 1) : geometric)).length() < 1e-5f);
+    }
+    std::string plain = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1/1 2/1 3/1\n";
+    QVERIFY(parseObj(plain.data(), plain.size())->faceNormals().empty());
+
+    // Разбор чисел совпадает со стандартным
+    const char *numbers[] = {"0", "-0.5", "+3", "12345.678", "1e2", "6.02214076E23", "-1.17549435e-38", ".25", "7.", "0.1000000000000000000000001"};
+    for (const char *number : numbers)
+    {
+        std::string line = std::string("v ") + number + " 0 0\nf 1 1 1\n";
+        float x = parseObj(line.data(), line.size())->vertices()[0].x;
+        float reference = std::strtof(number, nullptr);
+        QVERIFY(std::fabs(x - reference) <= std::fabs(reference) * 1e-7f);
+    }
+
+    // Ссылка на несуществующую вершину или нормаль, вершина или нормаль без трех координат
+    for (std::string broken : {std::string("v 0 0 0\nv 1 0 0\nf 1 2 3\n"), std::string("v 0 0\n"),
+                               std::string("v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf 1//1 2//2 3//1\n"), std::string("vn 0 1\n")})
+    {
+        bool thrown = false;
+        try
+        {
+            parseObj(broken.data(), broken.size());
+        }
+        catch (const std::runtime_error &)
+        {
+            thrown = true;
+        }
+        QVERIFY(thrown);
+    }
+    QCOMPARE(parseObj(nullptr, 0)->trianglesNum(), 0);
+}
+
+void TestAll::testPolygonalModelIsIndexed()
+{
+    // Куб из 12 полигонов: общие вершины объединяются, материал берется у первого полигона
+    std::vector<Vec3> corners;
+    for (int i = 0; i < 8; ++i)
+        corners.push_back(Vec3((i & 1) ? 1 : -1, (i & 2) ? 1 : -1, (i & 4) ? 1 : -1));
+    const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    std::vector<Polygon> polygons;
+    for (const auto &f : faces)
+    {
+        polygons.push_back(Polygon(corners[f[0]], corners[f[1]], corners[f[2]], Vec3(0.2f, 0.4f, 0.6f), 0.5f, 1.5f));
+        polygons.push_back(Polygon(corners[f[0]], corners[f[2]], corners[f[3]], Vec3(0.2f, 0.4f, 0.6f), 0.5f, 1.5f));
+    }
+    PolygonalModel model(polygons);
+    QCOMPARE(model.mesh()->vertices().size(), size_t(8));
+    QCOMPARE(model.trianglesNum(), 12);
+    QVERIFY(model._params._color == Vec3(0.2f, 0.4f, 0.6f));
+
+    // Те же преобразования модели и отдельных полигонов
+    Vec3 axis(1, 2, 0.5f);
+    Vec3 offset(3, -1, 7);
+    model.rotate(axis, 33);
+    model.setPosition(offset);
+    for (Polygon &p : polygons)
+    {
+        p.rotate(Vec3(0, 0, 0), axis, 33);
+        p.move(offset);
+    }
+    // Копия модели разделяет сетку, поворот меняет только ее преобразование
+    PolygonalModel cached = model;
+    cached.rotate(Vec3(0, 1, 0), 90);
+    cached.rotate(Vec3(0, 1, 0), -90);
+    QVERIFY(cached.mesh() == model.mesh());
+
+    for (int i = 0; i < 500; ++i)
+    {
+        Vec3 target = offset + Vec3(0.003f * i - 0.75f, 0.5f - 0.002f * i, 0.0013f * i - 0.3f);
+        Vec3 origin = target + Vec3(std::sin(0.1f * i), std::cos(0.37f * i), 0.5f).normalize() * 10.0f;
+        Ray ray(origin, (target - origin).normalize());
+
+        float expected = std::numeric_limits<float>::max();
+        const Polygon *expectedPolygon = nullptr;
+        for (const Polygon &p : polygons)
+        {
+            float t;
+            if (p.intersect(ray, t) && t < expected)
+            {
+                expected = t;
+                expectedPolygon = &p;
+            }
+        }
+        QVERIFY(expectedPolygon != nullptr);
+
+        float t;
+        QVERIFY(model.intersect(ray, t));
+        QVERIFY(std::fabs(t - expected) < 1e-4f * expected);
+        GraphicParams params = model.hitParams(ray, t);
+        Vec3 expectedNormal = (expectedPolygon->v1 - expectedPolygon->v0).cross(expectedPolygon->v2 - expectedPolygon->v0).normalize();
+        QVERIFY(std::fabs(std::fabs(params._normal.dot(expectedNormal)) - 1.0f) < 1e-4f);
+        QVERIFY(params._normal.dot(ray.direction) < 0);
+        QCOMPARE(params._refractiveIndex, 1.5f);
+        QVERIFY((cached.hitParams(ray, t)._normal - params._normal).length() < 1e-3f);
+    }
+
+    // Масштаб относительно центра модели, с тем же смыслом знака k, что у полигона
+    Vec3 corner = model.toWorld().point(model.mesh()->vertices()[0]);
+    QVERIFY((corner - polygons[0].v0).length() < 1e-4f);
+    model.scale(0.5);
+    polygons[0].scale(offset, 0.5);
+    QVERIFY((model.toWorld().point(model.mesh()->vertices()[0]) - polygons[0].v0).length() < 1e-4f);
+    QVERIFY((polygons[0].v0 - (offset + (corner - offset) * 0.5f)).length() < 1e-5f);
+    model.scale(-1);
+    polygons[0].scale(offset, -1);
+    QVERIFY((model.toWorld().point(model.mesh()->vertices()[0]) - polygons[0].v0).length() < 1e-4f);
+
+    // Индексированная сетка занимает в разы меньше памяти, чем отдельные полигоны
+    std::string grid;
+    const int side = 100;
+    for (int y = 0; y <= side; ++y)
+        for (int x = 0; x <= side; ++x)
+            grid += "v " + std::to_string(x) + " " + std::to_string(y) + " 0\n";
+    for (int y = 0; y < side; ++y)
+    {
+        for (int x = 0; x < side; ++x)
+        {
+            int a = y * (side + 1) + x + 1;
+            grid += "f " + std::to_string(a) + " " + std::to_string(a + 1) + " " + std::to_string(a + side + 2) + " " + std::to_string(a + side + 1) + "\n";
+        }
+    }
+    ObjGeometry geometry = parseObjGeometry(grid.data(), grid.size());
+    PolygonalModel plane(std::move(geometry.vertices), std::move(geometry.indices));
+    size_t bytes = plane.mesh()->vertices().size() * sizeof(Vec3) + plane.mesh()->indices().size() * sizeof(uint32_t);
+    QVERIFY(5 * bytes <= sizeof(Polygon) * plane.trianglesNum());
+    float t;
+    QVERIFY(plane.intersect(Ray(Vec3(50.5f, 20.25f, 3), Vec3(0, 0, -1)), t));
+    QVERIFY(std::fabs(t - 3.0f) < 1e-5f);
+
+    // Выборка по площади: треугольник втрое большей площади получает втрое больше точек, в том числе после масштабирования.
+    // Плотность — обратная площадь в мировых координатах: 4 до масштаба, 16 после
+    PolygonalModel pair({Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(0, 2, 0), Vec3(4, 0, 0), Vec3(7, 0, 0), Vec3(4, 2, 0)}, {0, 1, 2, 3, 4, 5});
+    pair.scale(2);
+    const int samples = 4000;
+    int inLarge = 0;
+    for (int i = 0; i < samples; ++i)
+    {
+        Vec3 point, normal;
+        float pdf = 0;
+        QVERIFY(pair.sampleSurface(Vec3(0, 0, 10), (i + 0.5f) / samples, 0.5f, point, normal, pdf));
+        QVERIFY(std::fabs(normal.z - 1.0f) < 1e-5f);
+        QVERIFY(std::fabs(pdf * 16 - 1) < 1e-4f);
+        if (point.x > pair.position().x)
+            ++inLarge;
+    }
+    QVERIFY(std::abs(inLarge - samples * 3 / 4) <= 2);
+}
+
+namespace
+{
+
+// Небольшая сцена со стеклянным шаром на диффузном полу под сферическим источником
+std::shared_ptr<Scene> makeGlassTestScene()
+{
+    auto scene = std::make_shared<Scene>();
+    scene->setCamera(std::make_shared<Camera>(Vec3(0, 1, -1.5f), Vec3(0, 0, 1), 1.0, 60.0));
+    scene->addObject(std::make_shared<Polygon>(Vec3(-20, 0, -2), Vec3(0, 0, 30), Vec3(20, 0, -2), Vec3(0.8f, 0.8f, 0.8f)));
+    scene->addObject(std::make_shared<Sphere>(Vec3(0, 1, 1.5f), 1.0f, Vec3(0.4f, 0.4f, 0.4f), 1.0f, 1.5f, 0.1f));
+    auto light = std::make_shared<Sphere>(Vec3(0, 4, 1.5f), 0.5f, Vec3(1, 1, 1));
+    light->_params._emission = {Vec3(1, 1, 1), 32};
+    scene->addObject(light);
+    return scene;
+}
+
+void setupTestDrawer(Drawer &drawer)
+{
+    drawer.setFrameSize(QSize(32, 24));
+    drawer.setThreadsNum(2);
+    drawer.setPhotonsPerLight(20000);
+    drawer.setProgressive(false);
+    drawer.setSamplesPerPixel(1);
+    drawer.setAdaptiveSampling(false);
+    drawer.setIrradianceCaching(false);
+    // Без выборки источников освещенность берется только из фотонной карты и не зашумлена
+    drawer.setDirectLighting(false);
+}
+
+Vec3 meanRadiance(const HdrImage &image)
+{
+    Vec3 sum(0, 0, 0);
+    for (const Vec3 &pixel : image.pixels)
+        sum += pixel;
+    return sum / static_cast<float>(image.pixels.size());
+}
+
+}
+
+void TestAll::testWavefrontMatchesRecursiveTrace()
+{
+    RenderingWidget widget;
+    Drawer drawer(&widget, nullptr);
+    setupTestDrawer(drawer);
+    drawer.setThroughputCutoff(0);
+    drawer.setRouletteThreshold(0);
+    auto scene = makeGlassTestScene();
+    drawer.updatePhotonMap(scene);
+    drawer.renderFrame(scene);
+    std::shared_ptr<const HdrImage> frame = drawer.lastFrame();
+
+    // Рекурсивная трассировка тех же первичных лучей через центры пикселей с ограничением цвета на каждом отскоке
+    CameraRayGenerator rays(*scene->camera(), frame->width, frame->height);
+    Vec3 recursive(0, 0, 0);
+    for (int y = 0; y < frame->height; ++y)
+    {
+        for (int x = 0; x < frame->width; ++x)
+        {
+            Vec3 color = drawer.trace(rays.ray(x + 0.5f, y + 0.5f), scene, scene->photonMap(), scene->causticsPhotonMap(),
+                                      drawer.renderingDepth());
+            color.x = std::min(color.x, 1.0f);
+            color.y = std::min(color.y, 1.0f);
+            color.z = std::min(color.z, 1.0f);
+            recursive += color;
+        }
+    }
+    recursive /= static_cast<float>(frame->width * frame->height);
+
+    Vec3 wavefront = meanRadiance(*frame);
+    QVERIFY(recursive.length() > 0.05f);
+    QVERIFY((wavefront - recursive).length() < 0.03f * recursive.length());
+}
+
+void TestAll::testThroughputCutoffKeepsRadiance()
+{
+    RenderingWidget widget;
+    Drawer drawer(&widget, nullptr);
+    setupTestDrawer(drawer);
+    auto scene = makeGlassTestScene();
+    drawer.updatePhotonMap(scene);
+
+    // Без отсечения и рулетки трассируются все ветви до полной глубины
+    drawer.setThroughputCutoff(0);
+    drawer.setRouletteThreshold(0);
+    drawer.renderFrame(scene);
+    Vec3 reference = meanRadiance(*drawer.lastFrame());
+    long long referenceRays = drawer.progress().timings().frame.items;
+
+    drawer.setThroughputCutoff(1e-2f);
+    drawer.setRouletteThreshold(0.1f);
+    drawer.renderFrame(scene);
+    Vec3 cut = meanRadiance(*drawer.lastFrame());
+    long long cutRays = drawer.progress().timings().frame.items;
+
+    QVERIFY(cutRays < referenceRays);
+    QVERIFY((cut - reference).length() < 0.03f * reference.length());
+
+    // Прозрачная поверхность без диффузной части не собирает фотоны, даже если они лежат рядом
+    drawer.setIndirectLightMaxR(0.3f);
+    Polygon veil(Vec3(-2, 0.01f, -1), Vec3(0, 0.01f, 4), Vec3(2, 0.01f, -1), Vec3(1, 1, 1), 1.0f, 1.0f);
+    Ray down(Vec3(1.2f, 1, -0.5f), Vec3(0, -1, 0));
+    HitRecord hit;
+    QVERIFY(veil.intersect(down, hit.t));
+    hit.object = &veil;
+    QVERIFY(!scene->photonMap().findPhotonsInRadius(down.origin + down.direction * hit.t, drawer.indirectLightMaxR()).empty());
+    SecondaryRay children[MAX_SECONDARY_RAYS];
+    int childrenNum = 0;
+    Vec3 color = drawer.shadeSurface(down, hit, scene->photonMap(), scene->causticsPhotonMap(), Vec3(1, 1, 1), children, childrenNum);
+    QCOMPARE(color, Vec3(0, 0, 0));
+    QVERIFY(childrenNum > 0);
+}
+
+void TestAll::testSceneSnapshotIsolatesEdits()
+{
+    auto scene = makeGlassTestScene();
+    auto floor = std::dynamic_pointer_cast<Polygon>(scene->objects()[0]);
+    std::shared_ptr<Scene> snapshot = scene->snapshot();
+
+    // Правки исходной сцены не видны снимку
+    floor->_params._color = Vec3(0, 0, 1);
+    scene->addObject(std::make_shared<Sphere>(Vec3(3, 1, 1), 0.5f, Vec3(1, 1, 1)));
+    scene->setCamera(std::make_shared<Camera>(Vec3(5, 5, 5), Vec3(0, 0, 1), 1.0, 45.0));
+    QCOMPARE(snapshot->objects().size(), size_t(3));
+    QVERIFY(snapshot->objects()[0] != scene->objects()[0]);
+    QCOMPARE(snapshot->objects()[0]->_params._color, Vec3(0.8f, 0.8f, 0.8f));
+    QCOMPARE(snapshot->camera()->position(), Vec3(0, 1, -1.5f));
+
+    // Фотонная карта, построенная по снимку, общая с исходной сценой
+    RenderingWidget widget;
+    Drawer drawer(&widget, nullptr);
+    setupTestDrawer(drawer);
+    drawer.updatePhotonMap(snapshot);
+    QVERIFY(!scene->photonMap().findPhotonsInRadius(Vec3(1.2f, 0, -0.5f), 0.3f).empty());
+
+    // Кэш освещенности снимка действует, пока исходная сцена не изменилась после снимка
+    std::shared_ptr<Scene> current = scene->snapshot();
+    auto cache = std::make_shared<IrradianceCache>(Aabb(Vec3(-5, -5, -5), Vec3(5, 5, 5)), IrradianceCacheSettings());
+    current->setIrradianceCache(cache);
+    QVERIFY(scene->irradianceCache() == cache);
+    scene->markChanged();
+    QVERIFY(scene->irradianceCache() == nullptr);
+    QVERIFY(current->irradianceCache() == cache);
+
+    // Параметры отрисовщика переносятся в задание целиком
+    DrawerSettings settings;
+    settings.samplesPerPixel = 3;
+    settings.directLighting = false;
+    settings.renderTarget = RenderTarget(64, 48, 0.5f);
+    drawer.setSettings(settings);
+    QCOMPARE(drawer.samplesPerPixel(), 3);
+    QCOMPARE(drawer.directLighting(), false);
+    QCOMPARE(drawer.settings().renderTarget.width(), 64);
+    QCOMPARE(drawer.settings().renderTarget.height(), 48);
+}
+
+void TestAll::testPhotonCarriesFullSpectrum()
+{
+    // Источник внутри диффузной сферы: каждый выпущенный фотон попадает в нее ровно один раз
+    auto scene = std::make_shared<Scene>();
+    scene->setCamera(std::make_shared<Camera>(Vec3(0, 0, -5), Vec3(0, 0, 1), 1.0, 60.0));
+    scene->addObject(std::make_shared<Sphere>(Vec3(0, 0, 0), 10.0f, Vec3(0.5f, 0.5f, 0.5f)));
+    auto light = std::make_shared<Sphere>(Vec3(0, 0, 0), 0.5f, Vec3(1, 1, 1));
+    light->_params._emission = {Vec3(1, 0.5f, 0.25f), 2};
+    scene->addObject(light);
+
+    RenderingWidget widget;
+    Drawer drawer(&widget, nullptr);
+    setupTestDrawer(drawer);
+    drawer.setPhotonsPerLight(2000);
+    drawer.updatePhotonMap(scene);
+
+    // Один фотон на выпуск, с полным цветом источника: суммарная мощность та же, что у трех фотонов по каналам.
+    // Все фотоны вместе переносят поток источника π L * 4π R² = π² L
+    std::vector<Photon> photons = scene->photonMap().findPhotonsInRadius(Vec3(0, 0, 0), 20.0f);
+    QCOMPARE(photons.size(), size_t(2000));
+    Vec3 flux = Vec3(2, 1, 0.5f) * (M_PI * M_PI / 2000);
+    for (const Photon &photon : photons)
+        QVERIFY((photon.color - flux).length() < 1e-5f * flux.length());
+}
+
+void TestAll::testDirectLightMatchesPhotonGather()
+{
+    // Диффузный пол под сферическим источником: под центром источника освещенность π L R² / h²,
+    // отраженная яркость — альбедо * L R² / h²
+    auto scene = std::make_shared<Scene>();
+    scene->setCamera(std::make_shared<Camera>(Vec3(0, 2, -2), Vec3(0, -1, 1).normalize(), 1.0, 50.0));
+    scene->addObject(std::make_shared<Polygon>(Vec3(-20, 0, -10), Vec3(0, 0, 30), Vec3(20, 0, -10), Vec3(0.8f, 0.8f, 0.8f)));
+    auto light = std::make_shared<Sphere>(Vec3(0, 2, 1), 0.5f, Vec3(0, 0, 0));
+    light->_params._emission = {Vec3(1, 1, 1), 4};
+    scene->addObject(light);
+    const float expected = 0.8f * 4 * 0.25f / 4;
+
+    RenderingWidget widget;
+    Drawer drawer(&widget, nullptr);
+    setupTestDrawer(drawer);
+    // Около 4000 фотонов в круге сбора: шум оценки около 2%, смещение от размытия по кругу меньше 2%
+    drawer.setPhotonsPerLight(400000);
+    drawer.setIndirectLightMaxR(0.4f);
+
+    // Теневые лучи: выборка по площади, переведенная в телесный угол; шум оценки около 0.5%
+    drawer.buildIntersector(scene);
+    drawer._emitters = EmitterRegistry(scene->objects());
+    drawer.setDirectLightSamples(65536);
+    GraphicParams floor = scene->objects()[0]->_params;
+    floor._normal = Vec3(0, 1, 0);
+    Vec3 direct = drawer.directLight(Vec3(0, 0, 1), floor, scene->objects()[0].get());
+    QVERIFY(std::fabs(direct.x - expected) < 0.02f * expected);
+
+    // Сбор прямых фотонов дает ту же яркость
+    drawer.updatePhotonMap(scene);
+    Vec3 gathered = drawer.gatherPhotons(scene->photonMap(), Vec3(0, 0, 1), floor);
+    QVERIFY(std::fabs(gathered.x - expected) < 0.1f * expected);
+
+    // Кадр с теневыми лучами и кадр только по фотонной карте совпадают в среднем
+    drawer.renderFrame(scene);
+    Vec3 photonsOnly = meanRadiance(*drawer.lastFrame());
+    drawer.setDirectLighting(true);
+    drawer.setDirectLightSamples(16);
+    drawer.updatePhotonMap(scene);
+    drawer.renderFrame(scene);
+    Vec3 withShadowRays = meanRadiance(*drawer.lastFrame());
+    QVERIFY(photonsOnly.x > 0.02f);
+    QVERIFY((withShadowRays - photonsOnly).length() < 0.05f * photonsOnly.length());
+}
 
 #include "test_camera.moc"
 #endif
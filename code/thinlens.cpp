@@ -68,6 +68,18 @@ GraphicParams Lens::hitParams(const Ray& ray, float t) const {
     return res;
 }
 
+std::shared_ptr<BaseObject> Lens::clone() const
+{
+    return std::make_shared<Lens>(*this);
+}
+
+Aabb Lens::bounds() const
+{
+    // Линза целиком лежит внутри сферы радиуса _radius вокруг центра (при _curveRadius >= _radius)
+    Vec3 r(_radius, _radius, _radius);
+    return Aabb(_position - r, _position + r);
+}
+
 float Lens::radius() const
 {
     return _radius;
@@ -14,6 +14,8 @@ public:
     virtual Vec3 position() const override { return _position; };
     virtual void setPosition(const Vec3 &pos) override;
     virtual GraphicParams hitParams(const Ray& ray, float t) const override;
+    virtual Aabb bounds() const override;
+    virtual std::shared_ptr<BaseObject> clone() const override;
 
 public:
     Vec3 _position;
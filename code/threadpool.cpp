@@ -0,0 +1,234 @@
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace
+{
+// Пул и номер, к которым относится текущий рабочий поток
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local int currentIndex = -1;
+// Пулы, размер которых удерживает текущий внешний поток
+thread_local std::vector<const ThreadPool *> sizeLockedPools;
+}
+
+ThreadPool::ThreadPool(int threadsNum)
+{
+    start(threadsNum);
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+ThreadPool &ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+int ThreadPool::threadsNum() const
+{
+    return _threads.size();
+}
+
+void ThreadPool::setThreadsNum(int threadsNum)
+{
+    int n = threadsNum > 0 ? threadsNum : std::max(1u, std::thread::hardware_concurrency());
+    std::unique_lock<std::shared_mutex> lock(_sizeMutex);
+    if (n == this->threadsNum())
+        return;
+    stop();
+    start(n);
+}
+
+ThreadPool::SizeLock::SizeLock(ThreadPool &pool)
+    : _pool(pool), _locked(pool.lockSize())
+{
+}
+
+ThreadPool::SizeLock::~SizeLock()
+{
+    if (_locked)
+        _pool.unlockSize();
+}
+
+bool ThreadPool::lockSize()
+{
+    if (currentPool == this)
+        return false;
+    if (std::find(sizeLockedPools.begin(), sizeLockedPools.end(), this) != sizeLockedPools.end())
+        return false;
+    _sizeMutex.lock_shared();
+    sizeLockedPools.push_back(this);
+    return true;
+}
+
+void ThreadPool::unlockSize()
+{
+    sizeLockedPools.erase(std::find(sizeLockedPools.begin(), sizeLockedPools.end(), this));
+    _sizeMutex.unlock_shared();
+}
+
+int ThreadPool::currentThreadIndex() const
+{
+    return currentPool == this ? currentIndex : threadsNum();
+}
+
+void ThreadPool::start(int threadsNum)
+{
+    int n = threadsNum > 0 ? threadsNum : std::max(1u, std::thread::hardware_concurrency());
+    _stopping = false;
+    _queues.clear();
+    for (int i = 0; i < n; ++i)
+        _queues.push_back(std::make_unique<WorkerQueue>());
+    for (int i = 0; i < n; ++i)
+        _threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stopping = true;
+    }
+    _wakeUp.notify_all();
+    for (auto &t : _threads)
+        t.join();
+    _threads.clear();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &func)
+{
+    if (count <= 0)
+        return;
+
+    SizeLock sizeLock(*this);
+    int workers = _queues.size();
+    std::atomic<int> pending(count);
+
+    // Каждому потоку — непрерывный диапазон индексов
+    for (int w = 0; w < workers; ++w)
+    {
+        int first = (long long)count * w / workers;
+        int last = (long long)count * (w + 1) / workers;
+        if (first == last)
+            continue;
+
+        std::lock_guard<std::mutex> lock(_queues[w]->mutex);
+        for (int i = first; i < last; ++i)
+            _queues[w]->tasks.push_back({[&func, i]() { func(i); }, &pending});
+    }
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _queued += count;
+    }
+    _wakeUp.notify_all();
+
+    // Вызывающий поток тоже участвует в работе, поэтому вложенные вызовы не блокируются.
+    // Внешний поток берет только задачи своего вызова: все внешние потоки делят номер threadsNum(),
+    // и чужая задача писала бы в ячейку, которую одновременно занимает ее собственный вызывающий
+    int self = currentThreadIndex();
+    bool external = self >= workers;
+    Task task;
+    while (pending > 0)
+    {
+        if (external ? takeOwnTask(&pending, task) : takeTask(self, task))
+        {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _taskDone.wait_for(lock, std::chrono::milliseconds(1), [&pending]() { return pending == 0; });
+    }
+}
+
+void ThreadPool::workerLoop(int index)
+{
+    currentPool = this;
+    currentIndex = index;
+
+    Task task;
+    while (true)
+    {
+        if (takeTask(index, task))
+        {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wakeUp.wait(lock, [this]() { return _stopping || _queued > 0; });
+        if (_stopping && _queued == 0)
+            return;
+    }
+}
+
+bool ThreadPool::takeTask(int index, Task &task)
+{
+    int workers = _queues.size();
+
+    // Сначала своя очередь с начала: задачи идут в порядке обхода кадра
+    if (index < workers)
+    {
+        std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+        auto &tasks = _queues[index]->tasks;
+        if (!tasks.empty())
+        {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            --_queued;
+            return true;
+        }
+    }
+
+    // Затем перехват с конца чужих очередей
+    for (int k = 1; k <= workers; ++k)
+    {
+        int victim = (index + k) % workers;
+        if (victim == index)
+            continue;
+        std::lock_guard<std::mutex> lock(_queues[victim]->mutex);
+        auto &tasks = _queues[victim]->tasks;
+        if (!tasks.empty())
+        {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+            --_queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::takeOwnTask(const std::atomic<int> *pending, Task &task)
+{
+    // Задачи вызова лежат в конце очередей, поэтому поиск идет с конца
+    for (auto &queue : _queues)
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        auto &tasks = queue->tasks;
+        for (auto it = tasks.rbegin(); it != tasks.rend(); ++it)
+        {
+            if (it->pending == pending)
+            {
+                task = std::move(*it);
+                tasks.erase(std::next(it).base());
+                --_queued;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTask(Task &task)
+{
+    task.func();
+    if (--(*task.pending) == 0)
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _taskDone.notify_all();
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+// Постоянный пул потоков с перехватом задач (work stealing).
+// Каждый рабочий поток выполняет свою очередь с начала, а освободившиеся потоки
+// забирают задачи с конца чужих очередей. Общий для рендеринга и трассировки фотонов
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threadsNum = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    static ThreadPool &instance();
+
+    int threadsNum() const;
+    // 0 — по числу аппаратных потоков. Ждет завершения всех parallelFor и снятия всех SizeLock;
+    // из задач пула не вызывается
+    void setThreadsNum(int threadsNum);
+
+    // Пока объект жив, число потоков пула не меняется. Нужен вызывающему, который размечает данные
+    // по потокам через threadsNum() до parallelFor: иначе пул может смениться между разметкой и вызовом
+    class SizeLock
+    {
+    public:
+        explicit SizeLock(ThreadPool &pool);
+        ~SizeLock();
+
+        SizeLock(const SizeLock &) = delete;
+        SizeLock &operator=(const SizeLock &) = delete;
+
+    private:
+        ThreadPool &_pool;
+        bool _locked;
+    };
+
+    // Выполняет func(i) для всех i из [0, count) и дожидается завершения.
+    // Индексы раздаются потокам непрерывными диапазонами, соседние индексы обрабатываются одним потоком.
+    // На время вызова число потоков удерживается, как SizeLock
+    void parallelFor(int count, const std::function<void(int)> &func);
+
+    // Номер текущего рабочего потока в [0, threadsNum()), для внешних потоков — threadsNum().
+    // Внешний поток внутри parallelFor выполняет только задачи своего вызова, поэтому ячейка threadsNum()
+    // в данных одного вызова не делится между потоками, даже если вызовов из разных внешних потоков несколько
+    int currentThreadIndex() const;
+
+private:
+    struct Task
+    {
+        std::function<void()> func;
+        std::atomic<int> *pending = nullptr;
+    };
+
+    struct WorkerQueue
+    {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    void start(int threadsNum);
+    void stop();
+    // Захват размера пула внешним потоком; вложенные захваты тем же потоком и захваты из рабочих потоков
+    // пропускаются: их уже прикрывает внешний вызов, который ждет их завершения
+    bool lockSize();
+    void unlockSize();
+    void workerLoop(int index);
+    bool takeTask(int index, Task &task);
+    bool takeOwnTask(const std::atomic<int> *pending, Task &task);
+    void runTask(Task &task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    std::vector<std::thread> _threads;
+
+    // Разделяемо — parallelFor и SizeLock, монопольно — setThreadsNum
+    std::shared_mutex _sizeMutex;
+
+    std::mutex _sleepMutex;
+    std::condition_variable _wakeUp;
+    std::condition_variable _taskDone;
+    std::atomic<int> _queued{0};
+    bool _stopping = false;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,101 @@
+#include "tonemapper.h"
+#include <algorithm>
+#include <cmath>
+#include "threadpool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TONE_MAP_X86
+#endif
+
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 must be three packed floats");
+
+namespace
+{
+
+// Строк кадра на одну задачу пула
+const int TONE_MAP_ROWS_PER_TASK = 16;
+
+inline uint32_t packRgb(const std::vector<uint8_t> &lut, int r, int g, int b)
+{
+    return 0xff000000u | (uint32_t(lut[r]) << 16) | (uint32_t(lut[g]) << 8) | uint32_t(lut[b]);
+}
+
+}
+
+bool ToneMapSettings::operator==(const ToneMapSettings &other) const
+{
+    return op == other.op && exposure == other.exposure && gamma == other.gamma;
+}
+
+ToneMapper::ToneMapper(const ToneMapSettings &settings)
+    : _settings(settings), _lut(TONE_MAP_LUT_SIZE)
+{
+    float invGamma = settings.gamma > 0 ? 1.0f / settings.gamma : 1.0f;
+    for (int i = 0; i < TONE_MAP_LUT_SIZE; ++i)
+    {
+        float v = std::pow(i / float(TONE_MAP_LUT_SIZE - 1), invGamma);
+        _lut[i] = std::min(255, (int)(v * 255.0f + 0.5f));
+    }
+}
+
+const ToneMapSettings &ToneMapper::settings() const
+{
+    return _settings;
+}
+
+void ToneMapper::mapRow(const Vec3 *src, int width, uint32_t *dst) const
+{
+    const float *in = reinterpret_cast<const float *>(src);
+    const float scale = TONE_MAP_LUT_SIZE - 1;
+    const bool reinhard = _settings.op == ToneMapOperator::Reinhard;
+    int x = 0;
+
+#ifdef TONE_MAP_X86
+    // 4 пикселя — 12 чисел в трех регистрах; все операции поканальные, поэтому порядок каналов не важен
+    const __m128 exposure = _mm_set1_ps(_settings.exposure);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 lutScale = _mm_set1_ps(scale);
+    const __m128 half = _mm_set1_ps(0.5f);
+    alignas(16) int32_t idx[12];
+    for (; x + 4 <= width; x += 4)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(in + x * 3 + k * 4), exposure);
+            if (reinhard)
+                v = _mm_div_ps(v, _mm_add_ps(one, _mm_max_ps(v, zero)));
+            // max(v, 0) дает 0 и для NaN
+            v = _mm_min_ps(_mm_max_ps(v, zero), one);
+            _mm_store_si128(reinterpret_cast<__m128i *>(idx + k * 4), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, lutScale), half)));
+        }
+        for (int p = 0; p < 4; ++p)
+            dst[x + p] = packRgb(_lut, idx[p * 3], idx[p * 3 + 1], idx[p * 3 + 2]);
+    }
+#endif
+
+    for (; x < width; ++x)
+    {
+        int c[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            float v = in[x * 3 + k] * _settings.exposure;
+            if (reinhard)
+                v = v / (1.0f + std::max(v, 0.0f));
+            v = v > 0.0f ? std::min(v, 1.0f) : 0.0f;
+            c[k] = (int)(v * scale + 0.5f);
+        }
+        dst[x] = packRgb(_lut, c[0], c[1], c[2]);
+    }
+}
+
+void ToneMapper::map(const Vec3 *src, int width, int height, uint8_t *dst, int bytesPerLine) const
+{
+    int tasks = (height + TONE_MAP_ROWS_PER_TASK - 1) / TONE_MAP_ROWS_PER_TASK;
+    ThreadPool::instance().parallelFor(tasks, [&](int t) {
+        int y1 = std::min(height, (t + 1) * TONE_MAP_ROWS_PER_TASK);
+        for (int y = t * TONE_MAP_ROWS_PER_TASK; y < y1; ++y)
+            mapRow(src + y * width, width, reinterpret_cast<uint32_t *>(dst + (size_t)y * bytesPerLine));
+    });
+}
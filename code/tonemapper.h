@@ -0,0 +1,47 @@
+#ifndef TONEMAPPER_H
+#define TONEMAPPER_H
+
+#include <cstdint>
+#include <vector>
+#include "primitives.h"
+
+enum class ToneMapOperator
+{
+    // Значения выше 1 обрезаются, как в исходном выводе
+    Clamp,
+    // x / (1 + x) по каждому каналу
+    Reinhard
+};
+
+struct ToneMapSettings
+{
+    ToneMapOperator op = ToneMapOperator::Clamp;
+    float exposure = 1.0f;
+    // 1 — значения выводятся как есть, без гамма-коррекции
+    float gamma = 1.0f;
+
+    bool operator==(const ToneMapSettings &other) const;
+};
+
+// Перевод линейного кадра в 8-битный RGB32 (0xffRRGGBB).
+// Экспозиция, оператор и ограничение считаются по 4 пикселя в SSE-регистрах,
+// гамма-коррекция — по таблице на TONE_MAP_LUT_SIZE значений
+class ToneMapper
+{
+public:
+    static const int TONE_MAP_LUT_SIZE = 4096;
+
+    explicit ToneMapper(const ToneMapSettings &settings = ToneMapSettings());
+
+    const ToneMapSettings &settings() const;
+
+    void mapRow(const Vec3 *src, int width, uint32_t *dst) const;
+    // Кадр целиком, строки распределяются по пулу потоков; bytesPerLine — шаг строк в dst
+    void map(const Vec3 *src, int width, int height, uint8_t *dst, int bytesPerLine) const;
+
+private:
+    ToneMapSettings _settings;
+    std::vector<uint8_t> _lut;
+};
+
+#endif // TONEMAPPER_H
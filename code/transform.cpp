@@ -0,0 +1,82 @@
+#include "transform.h"
+#include <cmath>
+
+Transform Transform::translate(const Vec3 &offset)
+{
+    Transform result;
+    result.translation = offset;
+    return result;
+}
+
+Transform Transform::rotate(const Vec3 &axis, double angle)
+{
+    Vec3 a = axis.normalize();
+    double radians = angle * M_PI / 180.0;
+    float c = std::cos(radians);
+    float s = std::sin(radians);
+    float k = 1.0f - c;
+
+    Transform result;
+    result.rows[0] = Vec3(c + a.x * a.x * k, a.x * a.y * k - a.z * s, a.x * a.z * k + a.y * s);
+    result.rows[1] = Vec3(a.y * a.x * k + a.z * s, c + a.y * a.y * k, a.y * a.z * k - a.x * s);
+    result.rows[2] = Vec3(a.z * a.x * k - a.y * s, a.z * a.y * k + a.x * s, c + a.z * a.z * k);
+    return result;
+}
+
+Transform Transform::scale(const Vec3 &k)
+{
+    Transform result;
+    result.rows[0] = Vec3(k.x, 0, 0);
+    result.rows[1] = Vec3(0, k.y, 0);
+    result.rows[2] = Vec3(0, 0, k.z);
+    return result;
+}
+
+Transform Transform::operator*(const Transform &other) const
+{
+    // Столбцы other переводятся матрицей this
+    Vec3 c0 = vector(Vec3(other.rows[0].x, other.rows[1].x, other.rows[2].x));
+    Vec3 c1 = vector(Vec3(other.rows[0].y, other.rows[1].y, other.rows[2].y));
+    Vec3 c2 = vector(Vec3(other.rows[0].z, other.rows[1].z, other.rows[2].z));
+
+    Transform result;
+    result.rows[0] = Vec3(c0.x, c1.x, c2.x);
+    result.rows[1] = Vec3(c0.y, c1.y, c2.y);
+    result.rows[2] = Vec3(c0.z, c1.z, c2.z);
+    result.translation = point(other.translation);
+    return result;
+}
+
+Transform Transform::inverse() const
+{
+    // Обратная матрица — присоединенная, деленная на определитель; строки присоединенной — векторные произведения столбцов
+    Vec3 c0(rows[0].x, rows[1].x, rows[2].x);
+    Vec3 c1(rows[0].y, rows[1].y, rows[2].y);
+    Vec3 c2(rows[0].z, rows[1].z, rows[2].z);
+    Vec3 r0 = c1.cross(c2);
+    Vec3 r1 = c2.cross(c0);
+    Vec3 r2 = c0.cross(c1);
+    float inverseDeterminant = 1.0f / c0.dot(r0);
+
+    Transform result;
+    result.rows[0] = r0 * inverseDeterminant;
+    result.rows[1] = r1 * inverseDeterminant;
+    result.rows[2] = r2 * inverseDeterminant;
+    result.translation = -result.vector(translation);
+    return result;
+}
+
+Vec3 Transform::point(const Vec3 &p) const
+{
+    return vector(p) + translation;
+}
+
+Vec3 Transform::vector(const Vec3 &v) const
+{
+    return Vec3(rows[0].dot(v), rows[1].dot(v), rows[2].dot(v));
+}
+
+Vec3 Transform::transposedVector(const Vec3 &v) const
+{
+    return rows[0] * v.x + rows[1] * v.y + rows[2] * v.z;
+}
@@ -0,0 +1,28 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "primitives.h"
+
+// Аффинное преобразование p' = M p + translation, матрица M хранится по строкам
+struct Transform
+{
+    Vec3 rows[3] = {Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1)};
+    Vec3 translation = Vec3(0, 0, 0);
+
+    static Transform translate(const Vec3 &offset);
+    // Поворот вокруг оси через начало координат, угол в градусах, как у Polygon::rotate
+    static Transform rotate(const Vec3 &axis, double angle);
+    static Transform scale(const Vec3 &k);
+
+    // Композиция: сначала other, затем this
+    Transform operator*(const Transform &other) const;
+    // Для вырожденной матрицы результат не определен
+    Transform inverse() const;
+
+    Vec3 point(const Vec3 &p) const;
+    Vec3 vector(const Vec3 &v) const;
+    // Mᵀ v: нормали переводятся в мировое пространство транспонированной обратной матрицей
+    Vec3 transposedVector(const Vec3 &v) const;
+};
+
+#endif // TRANSFORM_H
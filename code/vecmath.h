@@ -0,0 +1,157 @@
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <cmath>
+#include "primitives.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VEC_MATH_X86
+#endif
+
+// Четырехкомпонентный вектор в одном SSE-регистре (w не используется геометрией и обычно равен 0).
+// Предназначен для внутренних циклов; хранение в структурах сцены остается за Vec3
+struct alignas(16) Vec4f
+{
+#ifdef VEC_MATH_X86
+    __m128 v;
+
+    Vec4f() : v(_mm_setzero_ps()) {}
+    explicit Vec4f(__m128 v) : v(v) {}
+    Vec4f(float x, float y, float z, float w = 0.0f) : v(_mm_set_ps(w, z, y, x)) {}
+    explicit Vec4f(const Vec3 &a) : v(_mm_set_ps(0.0f, a.z, a.y, a.x)) {}
+
+    static Vec4f splat(float s) { return Vec4f(_mm_set1_ps(s)); }
+
+    Vec4f operator+(const Vec4f &b) const { return Vec4f(_mm_add_ps(v, b.v)); }
+    Vec4f operator-(const Vec4f &b) const { return Vec4f(_mm_sub_ps(v, b.v)); }
+    Vec4f operator*(const Vec4f &b) const { return Vec4f(_mm_mul_ps(v, b.v)); }
+    Vec4f operator*(float s) const { return Vec4f(_mm_mul_ps(v, _mm_set1_ps(s))); }
+    Vec4f operator/(const Vec4f &b) const { return Vec4f(_mm_div_ps(v, b.v)); }
+
+    float operator[](int i) const
+    {
+        alignas(16) float f[4];
+        _mm_store_ps(f, v);
+        return f[i & 3];
+    }
+
+    static Vec4f min(const Vec4f &a, const Vec4f &b) { return Vec4f(_mm_min_ps(a.v, b.v)); }
+    static Vec4f max(const Vec4f &a, const Vec4f &b) { return Vec4f(_mm_max_ps(a.v, b.v)); }
+
+    // Скалярное произведение по x, y, z
+    float dot3(const Vec4f &b) const
+    {
+        __m128 m = _mm_mul_ps(v, b.v);
+        __m128 sh = _mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 s = _mm_add_ss(m, sh);
+        sh = _mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 1, 0, 2));
+        return _mm_cvtss_f32(_mm_add_ss(s, sh));
+    }
+
+    Vec3 toVec3() const
+    {
+        alignas(16) float f[4];
+        _mm_store_ps(f, v);
+        return Vec3(f[0], f[1], f[2]);
+    }
+#else
+    float x, y, z, w;
+
+    Vec4f() : x(0), y(0), z(0), w(0) {}
+    Vec4f(float x, float y, float z, float w = 0.0f) : x(x), y(y), z(z), w(w) {}
+    explicit Vec4f(const Vec3 &a) : x(a.x), y(a.y), z(a.z), w(0) {}
+
+    static Vec4f splat(float s) { return Vec4f(s, s, s, s); }
+
+    Vec4f operator+(const Vec4f &b) const { return Vec4f(x + b.x, y + b.y, z + b.z, w + b.w); }
+    Vec4f operator-(const Vec4f &b) const { return Vec4f(x - b.x, y - b.y, z - b.z, w - b.w); }
+    Vec4f operator*(const Vec4f &b) const { return Vec4f(x * b.x, y * b.y, z * b.z, w * b.w); }
+    Vec4f operator*(float s) const { return Vec4f(x * s, y * s, z * s, w * s); }
+    Vec4f operator/(const Vec4f &b) const { return Vec4f(x / b.x, y / b.y, z / b.z, w / b.w); }
+
+    float operator[](int i) const
+    {
+        const float f[4] = {x, y, z, w};
+        return f[i & 3];
+    }
+
+    static Vec4f min(const Vec4f &a, const Vec4f &b)
+    {
+        return Vec4f(std::fmin(a.x, b.x), std::fmin(a.y, b.y), std::fmin(a.z, b.z), std::fmin(a.w, b.w));
+    }
+    static Vec4f max(const Vec4f &a, const Vec4f &b)
+    {
+        return Vec4f(std::fmax(a.x, b.x), std::fmax(a.y, b.y), std::fmax(a.z, b.z), std::fmax(a.w, b.w));
+    }
+
+    float dot3(const Vec4f &b) const { return x * b.x + y * b.y + z * b.z; }
+
+    Vec3 toVec3() const { return Vec3(x, y, z); }
+#endif
+};
+
+// Нормализация через приближенный обратный корень с одним шагом Ньютона:
+// относительная погрешность порядка 1e-6 против 1e-7 у normalize()
+inline Vec3 normalizeFast(const Vec3 &a)
+{
+    float len2 = a.lengthSquared();
+#ifdef VEC_MATH_X86
+    float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(len2)));
+    r = r * (1.5f - 0.5f * len2 * r * r);
+#else
+    float r = 1.0f / std::sqrt(len2);
+#endif
+    return a * r;
+}
+
+// Нормализация массива векторов на месте, по 4 за итерацию:
+// 12 чисел загружаются тремя регистрами и переставляются в раздельные x, y, z
+inline void normalizeBatch(Vec3 *v, int count)
+{
+    int i = 0;
+#ifdef VEC_MATH_X86
+    float *f = reinterpret_cast<float *>(v);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    for (; i + 4 <= count; i += 4)
+    {
+        float *p = f + i * 3;
+        // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+        __m128 a = _mm_loadu_ps(p);
+        __m128 b = _mm_loadu_ps(p + 4);
+        __m128 c = _mm_loadu_ps(p + 8);
+        __m128 t0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)); // x2 x2 x3 x3
+        __m128 x = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)); // y0 y0 y1 y1
+        __m128 t2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)); // y2 y2 y3 y3
+        __m128 y = _mm_shuffle_ps(t1, t2, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 t3 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)); // z0 z0 z1 z1
+        __m128 t4 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)); // z2 z2 z3 z3
+        __m128 z = _mm_shuffle_ps(t3, t4, _MM_SHUFFLE(2, 0, 2, 0));
+
+        __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 r = _mm_rsqrt_ps(len2);
+        r = _mm_mul_ps(r, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, len2), _mm_mul_ps(r, r))));
+
+        x = _mm_mul_ps(x, r);
+        y = _mm_mul_ps(y, r);
+        z = _mm_mul_ps(z, r);
+
+        // Обратная перестановка в порядок x y z
+        __m128 a0 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 1, 0)); // x0 x1 y0 y0
+        __m128 b0 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)); // z0 z0 x1 x1
+        __m128 a1 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)); // y1 y1 z1 z1
+        __m128 b1 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)); // x2 x2 y2 y2
+        __m128 a2 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)); // z2 z2 x3 x3
+        __m128 b2 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)); // y3 y3 z3 z3
+        _mm_storeu_ps(p, _mm_shuffle_ps(a0, b0, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(p + 4, _mm_shuffle_ps(a1, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(p + 8, _mm_shuffle_ps(a2, b2, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+#endif
+    for (; i < count; ++i)
+        v[i] = normalizeFast(v[i]);
+}
+
+#endif // VECMATH_H
@@ -0,0 +1,73 @@
+#include "wavefront.h"
+#include <algorithm>
+#include <cstdint>
+#include "bvh.h"
+
+void WavefrontQueues::reset(int pixelsNum)
+{
+    current.clear();
+    next.clear();
+    hits.clear();
+    nodes.clear();
+    lensPaths.clear();
+    lensParents.clear();
+    accumulator.assign(pixelsNum, Vec3(0, 0, 0));
+}
+
+void WavefrontQueues::pushPrimary(const Ray &ray, int pixel)
+{
+    current.push_back({ray, Vec3(1, 1, 1), pixel, static_cast<int>(nodes.size())});
+    nodes.push_back({-1, Vec3(1, 1, 1), Vec3(0, 0, 0), pixel, false});
+}
+
+void WavefrontQueues::pushChild(const Ray &ray, const Vec3 &weight, const Vec3 &relative, const PathState &parent)
+{
+    next.push_back({ray, weight, parent.pixel, static_cast<int>(nodes.size())});
+    nodes.push_back({parent.node, relative, Vec3(0, 0, 0), parent.pixel, false});
+}
+
+void WavefrontQueues::resolve()
+{
+    // Потомки всегда создаются позже родителей, поэтому обратный порядок сворачивает дерево снизу вверх
+    for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; --i)
+    {
+        PathNode &node = nodes[i];
+        Vec3 color = node.color;
+        if (node.shaded)
+        {
+            color.x = std::min(color.x, 1.0f);
+            color.y = std::min(color.y, 1.0f);
+            color.z = std::min(color.z, 1.0f);
+        }
+        if (node.parent >= 0)
+            nodes[node.parent].color += color * node.weight;
+        else
+            accumulator[node.pixel] += color;
+    }
+    nodes.clear();
+}
+
+void sortPathStates(std::vector<PathState> &paths)
+{
+    if (paths.size() < 2)
+        return;
+
+    Aabb bounds;
+    for (const auto &path : paths)
+        bounds.expand(path.ray.origin);
+
+    std::vector<std::pair<uint32_t, int>> keys(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        const Vec3 &d = paths[i].ray.direction;
+        uint32_t octant = (d.x < 0 ? 1u : 0u) | (d.y < 0 ? 2u : 0u) | (d.z < 0 ? 4u : 0u);
+        keys[i] = {(octant << 29) | (mortonCode(paths[i].ray.origin, bounds) >> 1), static_cast<int>(i)};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<PathState> sorted;
+    sorted.reserve(paths.size());
+    for (const auto &key : keys)
+        sorted.push_back(paths[key.second]);
+    paths.swap(sorted);
+}
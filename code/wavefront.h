@@ -0,0 +1,72 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <vector>
+#include "primitives.h"
+#include "sceneintersector.h"
+#include "sequentiallens.h"
+
+// Наибольшее число вторичных лучей, порождаемых одним попаданием (отраженный и преломленный)
+const int MAX_SECONDARY_RAYS = 2;
+
+// Вторичный луч, порожденный ядром затенения, и его вклад в цвет точки попадания
+struct SecondaryRay
+{
+    Ray ray;
+    Vec3 weight;
+    // Линза последовательной системы, в которую входит луч: ray — падающий луч, проход стопки выполняется отдельно
+    const BaseObject *lensEntry = nullptr;
+};
+
+// Состояние пути в волновом конвейере: луч, накопленный вес, пиксель, в который идет вклад,
+// и узел дерева лучей пикселя, в который записывается цвет точки попадания
+struct PathState
+{
+    Ray ray;
+    Vec3 weight;
+    int pixel;
+    int node = -1;
+};
+
+// Узел дерева лучей пикселя. Цвет узла — цвет точки попадания вместе со вкладом потомков — ограничивается
+// единицей на каждом отскоке, как в рекурсивной трассировке, а не один раз для пикселя
+struct PathNode
+{
+    // -1 — первичный луч, его цвет идет в pixel
+    int parent;
+    // Вес вклада узла в цвет родителя
+    Vec3 weight;
+    Vec3 color;
+    int pixel;
+    // Луч попал в объект; цвет фона для промаха не ограничивается, как и в рекурсивной трассировке
+    bool shaded;
+};
+
+// Очереди лучей волнового конвейера одного тайла.
+// Память переиспользуется между тайлами, обрабатываемыми одним потоком
+struct WavefrontQueues
+{
+    std::vector<PathState> current;
+    std::vector<PathState> next;
+    std::vector<HitRecord> hits;
+    std::vector<Vec3> accumulator;
+    std::vector<PathNode> nodes;
+    // Лучи поколения, входящие в последовательную систему линз, с весом относительно родителя,
+    // и номера родительских путей в current
+    std::vector<LensPath> lensPaths;
+    std::vector<int> lensParents;
+
+    void reset(int pixelsNum);
+    // Первичный луч пикселя: корень дерева лучей
+    void pushPrimary(const Ray &ray, int pixel);
+    // Потомок пути parent в следующем поколении; weight — накопленный вес, relative — вес относительно родителя
+    void pushChild(const Ray &ray, const Vec3 &weight, const Vec3 &relative, const PathState &parent);
+    // Сворачивает деревья лучей от листьев к корням с ограничением цвета каждого узла и складывает цвета корней в accumulator
+    void resolve();
+};
+
+// Упорядочивает лучи по октанту направления, а внутри октанта — по кривой Мортона от начала луча,
+// чтобы соседние в очереди лучи обходили одни и те же узлы BVH
+void sortPathStates(std::vector<PathState> &paths);
+
+#endif // WAVEFRONT_H